@@ -308,6 +308,7 @@ ni_do_arp(int argc, char **argv)
 	unsigned int      opt_nprobes;
 	unsigned int      opt_nclaims;
 	struct arp_handle handle;
+	const ni_capture_txq_stats_t *stats;
 
 	memset(&handle, 0, sizeof(handle));
 	handle.nprobes = opt_nprobes = 3;
@@ -413,6 +414,11 @@ ni_do_arp(int argc, char **argv)
 					ni_sockaddr_print(&handle.ipaddr));
 			}
 		}
+		if ((stats = ni_capture_txq_stats(NULL)) && stats->queued) {
+			printf("%s: Sent %lu of %lu ARP packets in %lu send calls\n",
+					handle.ifname, stats->sent, stats->queued,
+					stats->syscalls);
+		}
 	}
 
 cleanup:
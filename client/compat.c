@@ -73,6 +73,7 @@ ni_compat_ifconfig_destroy(ni_compat_ifconfig_t *conf)
 	if (conf) {
 		ni_string_free(&conf->schema);
 		ni_compat_netdev_array_destroy(&conf->netdevs);
+		xml_document_array_destroy(&conf->docs);
 	}
 }
 
@@ -2687,40 +2688,76 @@ ni_compat_generate_ifcfg(const ni_compat_netdev_t *compat, xml_document_t *doc)
 	return ifnode;
 }
 
+/*
+ * Generate the config document of a compat netdev; the origin
+ * is stored in the metadata of the interface node.
+ */
+xml_document_t *
+ni_compat_generate_interface(ni_compat_netdev_t *compat, const char *schema)
+{
+	ni_client_state_t *cs = ni_netdev_get_client_state(compat->dev);
+	ni_client_state_config_t *conf = &cs->config;
+	xml_document_t *config_doc;
+
+	config_doc = xml_document_new();
+
+	if (ni_string_empty(conf->origin))
+		ni_string_dup(&conf->origin, schema);
+
+	ni_compat_generate_ifcfg(compat, config_doc);
+	ni_ifconfig_metadata_add_to_node(xml_document_root(config_doc), conf);
+	return config_doc;
+}
+
+static ni_bool_t
+ni_compat_add_interface(xml_document_array_t *array, xml_document_t *config_doc,
+			ni_bool_t check_prio, ni_bool_t raw)
+{
+	ni_client_state_config_t conf = NI_CLIENT_STATE_CONFIG_INIT;
+	xml_node_t *root = xml_document_root(config_doc);
+	ni_bool_t ret = FALSE;
+
+	ni_ifconfig_metadata_get_from_node(&conf, root);
+	ni_ifconfig_metadata_clear(root);
+	if (!raw)
+		ni_ifconfig_metadata_add_to_node(root, &conf);
+
+	xml_node_location_relocate(root, conf.origin);
+
+	if (ni_ifconfig_validate_adding_doc(config_doc, check_prio)) {
+		ni_debug_ifconfig("%s: %s", __func__, xml_node_location(root));
+		xml_document_array_append(array, config_doc);
+		ret = TRUE;
+	} else {
+		xml_document_free(config_doc);
+	}
+	ni_client_state_config_reset(&conf);
+	return ret;
+}
+
 unsigned int
 ni_compat_generate_interfaces(xml_document_array_t *array, ni_compat_ifconfig_t *ifcfg, ni_bool_t check_prio, ni_bool_t raw)
 {
 	xml_document_t *config_doc;
-	xml_node_t *root;
-	unsigned int i;
+	unsigned int i, count = 0;
 
 	if (!ifcfg)
 		return 0;
 
-	for (i = 0; i < ifcfg->netdevs.count; ++i) {
+	for (i = 0; i < ifcfg->netdevs.count; ++i, ++count) {
 		ni_compat_netdev_t *compat = ifcfg->netdevs.data[i];
-		ni_client_state_t *cs = ni_netdev_get_client_state(compat->dev);
-		ni_client_state_config_t *conf = &cs->config;
 
-		config_doc = xml_document_new();
-		root = xml_document_root(config_doc);
-
-		if (ni_string_empty(conf->origin))
-			ni_string_dup(&conf->origin, ifcfg->schema);
-
-		ni_compat_generate_ifcfg(compat, config_doc);
-		if (!raw)
-			ni_ifconfig_metadata_add_to_node(root, conf);
-
-		xml_node_location_relocate(root, conf->origin);
+		config_doc = ni_compat_generate_interface(compat, ifcfg->schema);
+		ni_compat_add_interface(array, config_doc, check_prio, raw);
+	}
 
-		if (ni_ifconfig_validate_adding_doc(config_doc, check_prio)) {
-			ni_debug_ifconfig("%s: %s", __func__, xml_node_location(root));
-			xml_document_array_append(array, config_doc);
-		} else {
-			xml_document_free(config_doc);
-		}
+	/* the documents are consumed */
+	for (i = 0; i < ifcfg->docs.count; ++i, ++count) {
+		config_doc = ifcfg->docs.data[i];
+		ifcfg->docs.data[i] = NULL;
+		ni_compat_add_interface(array, config_doc, check_prio, raw);
 	}
+	xml_document_array_destroy(&ifcfg->docs);
 
-	return i;
+	return count;
 }
@@ -39,6 +39,8 @@
 #include <wicked/logging.h>
 #include <wicked/fsm.h>
 
+#include "client/ifconfig.h"
+
 #include "wicked-client.h"
 #include "appconfig.h"
 #include "ifcheck.h"
@@ -47,6 +49,46 @@
 #include "ifreload.h"
 #include "ifstatus.h"
 
+/*
+ * Check if the changes to the applied config can be applied by the
+ * ifup run only, without to set the device down and to bounce the link.
+ */
+static ni_bool_t
+ni_ifreload_worker_in_place(ni_ifworker_t *w)
+{
+	ni_string_array_t changed = NI_STRING_ARRAY_INIT;
+	ni_ifconfig_reload_t mode;
+	ni_client_state_t *cs;
+	xml_node_t *applied;
+	char *names = NULL;
+
+	if (!w->device || !(cs = w->device->client_state))
+		return FALSE;
+
+	if (!(applied = ni_ifconfig_applied_load(&cs->config.uuid))) {
+		ni_debug_application("%s: applied config %s not available", w->name,
+				ni_uuid_print(&cs->config.uuid));
+		return FALSE;
+	}
+
+	mode = ni_ifconfig_reload_mode(applied, w->config.node, &changed);
+	xml_node_free(applied);
+
+	if (!ni_string_join(&names, &changed, ", "))
+		ni_string_dup(&names, "element order only");
+	if (mode == NI_IFCONFIG_RELOAD_FULL) {
+		ni_debug_application("%s: changed %s, reload requires ifdown",
+				w->name, names);
+	} else {
+		ni_info("reloading %s interface in place: changed %s",
+				w->name, names);
+	}
+	ni_string_free(&names);
+	ni_string_array_destroy(&changed);
+
+	return mode != NI_IFCONFIG_RELOAD_FULL;
+}
+
 static int
 ni_do_ifreload_direct(int argc, char **argv)
 {
@@ -297,6 +339,12 @@ usage:
 					"device is not configured by wicked", w->name);
 				continue;
 			}
+			if (ni_ifworker_array_index(&up_marked, w) >= 0 &&
+			    ni_ifreload_worker_in_place(w)) {
+				ni_ifworker_array_remove(&down_marked, w);
+				--i;
+				continue;
+			}
 			w->target_range.min = NI_FSM_STATE_NONE;
 			switch (w->iftype) {
 			case NI_IFTYPE_TEAM:
@@ -627,6 +675,12 @@ usage:
 					"device is not configured by wicked", w->name);
 				continue;
 			}
+			if (ni_ifworker_array_index(&up_marked, w) >= 0 &&
+			    ni_ifreload_worker_in_place(w)) {
+				ni_ifworker_array_remove(&down_marked, w);
+				--i;
+				continue;
+			}
 			w->target_range.min = NI_FSM_STATE_NONE;
 			switch (w->iftype) {
 			case NI_IFTYPE_TEAM:
@@ -1104,6 +1104,10 @@ do_lease(int argc, char **argv)
 
 		lease_node = xml_node_new("lease", doc->root);
 		/* xml_node_new_element("update", lease_node, "all"); */
+	} else if (!strcmp(opt_cmd, "export")) {
+		/* read from the lease store, not from the document */
+		doc = NULL;
+		lease_node = NULL;
 	} else {
 		if (!(doc = __get_lease_document(opt_file)))
 			goto failed;
@@ -1346,6 +1350,71 @@ do_lease(int argc, char **argv)
 			ni_error("unable to install addrconf lease");
 			goto failed;
 		}
+	} else if (!strcmp(opt_cmd, "export")) {
+		static struct option export_options[] = {
+			{ "device", required_argument, NULL, 'd' },
+			{ "type",   required_argument, NULL, 't' },
+			{ "family", required_argument, NULL, 'f' },
+			{ NULL }
+		};
+		const char *opt_device = NULL;
+		int opt_type = NI_ADDRCONF_DHCP;
+		int opt_family = AF_INET;
+		ni_addrconf_lease_t *lease;
+		xml_node_t *xml = NULL;
+
+		while ((c = getopt_long(argc, argv, "", export_options, NULL)) != EOF) {
+			switch (c) {
+			case 'd':
+				opt_device = optarg;
+				break;
+
+			case 't':
+				if ((opt_type = ni_addrconf_name_to_type(optarg)) < 0) {
+					ni_error("unknown addrconf type \"%s\"", optarg);
+					goto failed;
+				}
+				break;
+
+			case 'f':
+				if ((opt_family = ni_addrfamily_name_to_type(optarg)) < 0) {
+					ni_error("unknown address family \"%s\"", optarg);
+					goto failed;
+				}
+				break;
+
+			default:
+				goto usage;
+			}
+		}
+
+		if (opt_device == NULL) {
+			ni_error("missing --device argument");
+			goto usage;
+		}
+
+		if (!(lease = ni_addrconf_lease_file_read(opt_device, opt_type, opt_family))) {
+			ni_error("no %s:%s lease stored for %s",
+					ni_addrfamily_type_to_name(opt_family),
+					ni_addrconf_type_to_name(opt_type), opt_device);
+			goto failed;
+		}
+
+		if (ni_addrconf_lease_to_xml(lease, &xml, opt_device) != 0) {
+			ni_error("unable to represent %s lease as XML", opt_device);
+			ni_addrconf_lease_free(lease);
+			goto failed;
+		}
+		ni_addrconf_lease_free(lease);
+
+		doc = xml_document_new();
+		xml_node_add_child(doc->root, xml);
+
+		ni_info("Writing lease info to %s", opt_file);
+		if (xml_document_write(doc, opt_file) < 0) {
+			ni_error("unable to write %s lease to %s", opt_device, opt_file);
+			goto failed;
+		}
 	} else if (!strcmp(opt_cmd, "help")) {
 		ret = 0;
 		goto usage;
@@ -1362,6 +1431,7 @@ usage:
 			"  {set|add}-route <ipaddr>/prefixlen [netmask <ipmask>] [gateway <ipaddr>]\n"
 			"  {set|add}-resolver [default-domain <domain>] [server <ipaddr> ...] [search <domain> ...]\n"
 			"  install --device <object-path>\n"
+			"  export --device <ifname> [--type <addrconf-type>] [--family <address-family>]\n"
 		       );
 		return ret;
 	}
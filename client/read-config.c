@@ -36,13 +36,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <sys/time.h>
 
 #include <wicked/util.h>
 #include <wicked/logging.h>
 #include <wicked/netinfo.h>
 
+#include "util_priv.h"
 #include "wicked-client.h"
 #include "client/ifconfig.h"
+#include "appconfig.h"
 
 #if defined(COMPAT_AUTO) || defined(COMPAT_SUSE)
 extern ni_bool_t	__ni_suse_get_ifconfig(const char *, const char *,
@@ -110,6 +113,12 @@ static ni_bool_t	ni_ifconfig_read_firmware(xml_document_array_t *,
 						const char *,
 						ni_bool_t,
 						ni_bool_t);
+static ni_bool_t	ni_ifconfig_read_firmware_doc(xml_document_array_t *,
+						const char *,
+						const char *,
+						xml_document_t *,
+						ni_bool_t,
+						ni_bool_t);
 
 static const ni_ifconfig_type_t *
 __ni_ifconfig_find_map(const ni_ifconfig_type_t *map, const char *name, size_t len)
@@ -199,17 +208,136 @@ static const ni_ifconfig_type_t	__ni_ifconfig_types[] = {
 	{ NULL,		{ .guess= ni_ifconfig_guess_type	} },
 };
 
+/*
+ * The firmware discovery scripts of all firmware sources are started
+ * in the background first and the other sources are read meanwhile.
+ * The config priority validation is deferred until the documents of
+ * all sources are merged in the source order, so the result is the
+ * same as reading the sources one after another.
+ *
+ * The files themselves are still parsed one after another: wicked is
+ * single threaded, the xml node and location objpools are not locked,
+ * and the compat-suse reader keeps the global config, dhcp defaults
+ * and routes of a load in static variables. The runtime of the
+ * discovery scripts is what the parallel load overlaps.
+ */
+typedef struct ni_ifconfig_source {
+	const char *			location;
+	const ni_ifconfig_type_t *	firmware;
+	const char *			path;
+	ni_netconfig_firmware_t *	discovery;
+	xml_document_array_t		docs;
+	struct timeval			started;
+} ni_ifconfig_source_t;
+
+static const ni_ifconfig_type_t *
+ni_ifconfig_source_firmware(const char *location, const char **path)
+{
+	const ni_ifconfig_type_t *map;
+	size_t len;
+
+	len = strcspn(location, ":");
+	if (location[len] != ':')
+		return NULL;
+
+	map = __ni_ifconfig_find_map(__ni_ifconfig_types, location, len);
+	if (!map || map->ops.read != ni_ifconfig_read_firmware)
+		return NULL;
+
+	*path = location + len + 1;
+	return map;
+}
+
+static void
+ni_ifconfig_source_loaded(const ni_ifconfig_source_t *src)
+{
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	timersub(&now, &src->started, &delta);
+	ni_debug_ifconfig("%s: loaded %u config documents in %ld.%03lds",
+			src->location, src->docs.count,
+			(long)delta.tv_sec, (long)delta.tv_usec / 1000);
+}
+
+static ni_bool_t
+ni_ifconfig_load_sources(xml_document_array_t *docs, const char *root,
+			const ni_string_array_t *locations, ni_bool_t check_prio, ni_bool_t raw)
+{
+	ni_ifconfig_source_t *sources, *src;
+	xml_document_t *config_doc;
+	ni_bool_t parallel, rv = TRUE;
+	unsigned int i, j;
+
+	if (!locations->count)
+		return TRUE;
+
+	parallel = ni_config_sources_parallel_jobs() > 1;
+	sources = xcalloc(locations->count, sizeof(*sources));
+	for (i = 0; i < locations->count; ++i) {
+		src = &sources[i];
+		src->location = locations->data[i];
+		src->firmware = ni_ifconfig_source_firmware(src->location, &src->path);
+
+		ni_timer_get_time(&src->started);
+		if (parallel && src->firmware)
+			src->discovery = ni_netconfig_firmware_discovery_start(root, src->path);
+	}
+
+	for (i = 0; rv && i < locations->count; ++i) {
+		src = &sources[i];
+		if (src->discovery)
+			continue;
+
+		ni_timer_get_time(&src->started);
+		if (!ni_ifconfig_read(&src->docs, root, src->location, FALSE, raw))
+			rv = FALSE;
+		else
+			ni_ifconfig_source_loaded(src);
+	}
+
+	for (i = 0; i < locations->count; ++i) {
+		src = &sources[i];
+		if (src->discovery) {
+			config_doc = ni_netconfig_firmware_discovery_finish(src->discovery);
+			src->discovery = NULL;
+
+			if (!rv) {
+				xml_document_free(config_doc);
+				continue;
+			}
+			if (!ni_ifconfig_read_firmware_doc(&src->docs, src->firmware->name,
+						src->path, config_doc, FALSE, raw))
+				rv = FALSE;
+			else
+				ni_ifconfig_source_loaded(src);
+		}
+
+		for (j = 0; rv && j < src->docs.count; ++j) {
+			config_doc = src->docs.data[j];
+			src->docs.data[j] = NULL;
+
+			if (ni_ifconfig_validate_adding_doc(config_doc, check_prio))
+				xml_document_array_append(docs, config_doc);
+			else
+				xml_document_free(config_doc);
+		}
+		xml_document_array_destroy(&src->docs);
+	}
+
+	free(sources);
+	return rv;
+}
+
 ni_bool_t
 ni_ifconfig_load(ni_fsm_t *fsm, const char *root, ni_string_array_t *opt_ifconfig, ni_bool_t check_prio, ni_bool_t raw)
 {
 	xml_document_array_t docs = XML_DOCUMENT_ARRAY_INIT;
 	unsigned int i;
 
-	for (i = 0; i < opt_ifconfig->count; ++i) {
-		if (!ni_ifconfig_read(&docs, root, opt_ifconfig->data[i], check_prio, raw)) {
-			xml_document_array_destroy(&docs);
-			return FALSE;
-		}
+	if (!ni_ifconfig_load_sources(&docs, root, opt_ifconfig, check_prio, raw)) {
+		xml_document_array_destroy(&docs);
+		return FALSE;
 	}
 
 	for (i = 0; i < docs.count; i++) {
@@ -606,15 +734,14 @@ ni_ifconfig_read_compat(xml_document_array_t *array, const char *type,
 	return FALSE;
 }
 
-ni_bool_t
-ni_ifconfig_read_firmware(xml_document_array_t *array, const char *type,
-			const char *root, const char *path, ni_bool_t check_prio, ni_bool_t raw)
+static ni_bool_t
+ni_ifconfig_read_firmware_doc(xml_document_array_t *array, const char *type,
+			const char *path, xml_document_t *config_doc,
+			ni_bool_t check_prio, ni_bool_t raw)
 {
-	xml_document_t *config_doc;
 	ni_client_state_config_t conf = NI_CLIENT_STATE_CONFIG_INIT;
 	xml_node_t *rnode, *cnode, *next;
 
-	config_doc = ni_netconfig_firmware_discovery(root, path);
 	if (!config_doc) {
 		ni_error("unable to get firmware interface definitions from %s:%s",
 			type, path);
@@ -658,6 +785,15 @@ ni_ifconfig_read_firmware(xml_document_array_t *array, const char *type,
 	return TRUE;
 }
 
+ni_bool_t
+ni_ifconfig_read_firmware(xml_document_array_t *array, const char *type,
+			const char *root, const char *path, ni_bool_t check_prio, ni_bool_t raw)
+{
+	return ni_ifconfig_read_firmware_doc(array, type, path,
+			ni_netconfig_firmware_discovery(root, path),
+			check_prio, raw);
+}
+
 const char *
 ni_ifconfig_format_origin(char **origin, const char *schema, const char *path)
 {
@@ -73,7 +73,9 @@
 #include "duid.h"
 #include "dhcp.h"
 #include "client/suse/ifsysctl.h"
+#include "client/suse/ifcfg-cache.h"
 #include "client/wicked-client.h"
+#include "client/ifconfig.h"
 
 typedef ni_bool_t (*try_function_t)(const ni_sysconfig_t *, ni_netdev_t *, const char *);
 
@@ -105,6 +107,7 @@ static ni_sysconfig_t *		__ni_suse_config_defaults;
 static ni_sysconfig_t *		__ni_suse_dhcp_defaults;
 static ni_route_table_t *	__ni_suse_global_routes;
 static ni_var_array_t		__ni_suse_global_ifsysctl;
+static ni_string_array_t	__ni_suse_global_files;
 static ni_bool_t		__ni_ipv6_disbled;
 
 /* compat: no default script scheme as a safeguard (boo#907215, bsc#920070, bsc#919496) */
@@ -130,7 +133,9 @@ static ni_bool_t		__ni_ipv6_disbled;
 #define __NI_SUSE_CONFIG_DHCP			"dhcp"
 #define __NI_SUSE_ROUTES_IFPREFIX		"ifroute-"
 #define __NI_SUSE_ROUTES_GLOBAL			"routes"
+#define __NI_SUSE_RULES_IFPREFIX		"ifrule-"
 #define __NI_SUSE_IFSYSCTL_FILE			"ifsysctl"
+#define __NI_SUSE_PROVIDERS_DIR			"providers"
 
 #define __NI_VLAN_TAG_MAX			4094
 #define __NI_WIRELESS_WPA_PSK_HEX_LEN	64
@@ -204,6 +209,310 @@ __ni_suse_ifcfg_scan_files(const char *dirname, ni_string_array_t *res)
 	return res->count - count;
 }
 
+static void
+__ni_suse_read_interfaces(const char *dirname, const ni_string_array_t *files,
+				ni_compat_ifconfig_t *result)
+{
+	size_t pfxlen = sizeof(__NI_SUSE_CONFIG_IFPREFIX)-1;
+	ni_compat_netdev_t *compat;
+	char pathbuf[PATH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < files->count; ++i) {
+		const char *filename = files->data[i];
+		const char *ifname = filename + pfxlen;
+
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s", dirname, filename);
+		if (!(compat = __ni_suse_read_interface(pathbuf, ifname)))
+			continue;
+
+		ni_compat_netdev_set_origin(compat, result->schema, pathbuf);
+		ni_compat_netdev_array_append(&result->netdevs, compat);
+	}
+
+	__ni_suse_adjust_slaves(&result->netdevs);
+	__ni_suse_show_unapplied_routes();
+}
+
+/*
+ * Incremental read of the ifcfg files using the parse result cache.
+ *
+ * The generated configs of the unchanged ifcfg files are taken from
+ * the cache. As a master adjusts its slaves/ports configs and the
+ * slaves configs without an ifcfg file are generated from the master,
+ * all files related to a changed one are parsed again together.
+ */
+static ni_bool_t
+__ni_suse_ifcfg_name_add(ni_string_array_t *names, const char *name)
+{
+	if (ni_string_empty(name) || ni_string_array_index(names, name) != -1)
+		return FALSE;
+	return ni_string_array_append(names, name) == 0;
+}
+
+static ni_bool_t
+__ni_suse_ifcfg_names_match(const ni_string_array_t *names, const ni_string_array_t *list)
+{
+	unsigned int i;
+
+	for (i = 0; i < list->count; ++i) {
+		if (ni_string_array_index(names, list->data[i]) != -1)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+__ni_suse_ifcfg_relations(const ni_compat_netdev_t *compat, ni_string_array_t *names)
+{
+	const ni_netdev_t *dev = compat->dev;
+	const ni_bonding_slave_t *slave;
+	unsigned int i;
+
+	__ni_suse_ifcfg_name_add(names, dev->link.masterdev.name);
+	__ni_suse_ifcfg_name_add(names, compat->link_port.ovsbr.bridge.name);
+
+	switch (dev->link.type) {
+	case NI_IFTYPE_BOND:
+		for (i = 0; dev->bonding && i < dev->bonding->slaves.count; ++i) {
+			if ((slave = dev->bonding->slaves.data[i]))
+				__ni_suse_ifcfg_name_add(names, slave->device.name);
+		}
+		break;
+	case NI_IFTYPE_BRIDGE:
+		for (i = 0; dev->bridge && i < dev->bridge->ports.count; ++i)
+			__ni_suse_ifcfg_name_add(names, dev->bridge->ports.data[i]->ifname);
+		break;
+	case NI_IFTYPE_OVS_BRIDGE:
+		__ni_suse_ifcfg_name_add(names, ni_linktype_type_to_name(NI_IFTYPE_OVS_SYSTEM));
+		for (i = 0; dev->ovsbr && i < dev->ovsbr->ports.count; ++i)
+			__ni_suse_ifcfg_name_add(names, dev->ovsbr->ports.data[i]->device.name);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+__ni_suse_ifcfg_siblings(const char *path, const char *ifname, ni_string_array_t *siblings)
+{
+	static const char *prefixes[] = {
+		__NI_SUSE_ROUTES_IFPREFIX,
+		__NI_SUSE_RULES_IFPREFIX,
+		__NI_SUSE_IFSYSCTL_FILE"-",
+		NULL
+	}, **prefix;
+
+	ni_string_array_destroy(siblings);
+	for (prefix = prefixes; *prefix; ++prefix) {
+		ni_string_array_append(siblings,
+			ni_sibling_path_printf(path, "%s%s", *prefix, ifname));
+	}
+}
+
+static const char *
+__ni_suse_ifcfg_fingerprint(const char *dirname, const char *schema, char **fingerprint)
+{
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	char pathbuf[PATH_MAX];
+	char *salt = NULL;
+	unsigned int i;
+
+	if (ni_global.config) {
+		for (i = 0; i < ni_global.config->files.count; ++i) {
+			ni_string_array_append(&__ni_suse_global_files,
+					ni_global.config->files.data[i]);
+		}
+	}
+	snprintf(pathbuf, sizeof(pathbuf), "%s/%s", dirname, __NI_SUSE_PROVIDERS_DIR);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
+	if (ni_scandir(pathbuf, NULL, &names)) {
+		for (i = 0; i < names.count; ++i) {
+			snprintf(pathbuf, sizeof(pathbuf), "%s/%s/%s", dirname,
+					__NI_SUSE_PROVIDERS_DIR, names.data[i]);
+			ni_string_array_append(&__ni_suse_global_files, pathbuf);
+		}
+	}
+	ni_string_array_destroy(&names);
+
+	ni_string_printf(&salt, "%s:%s:ipv6=%u", schema, dirname, __ni_ipv6_disbled);
+	ni_suse_ifcfg_fingerprint(salt, &__ni_suse_global_files, fingerprint);
+	ni_string_free(&salt);
+	return *fingerprint;
+}
+
+static void
+__ni_suse_ifcfg_cache_output(const ni_suse_ifcfg_cache_entry_t *entry, ni_compat_ifconfig_t *result)
+{
+	xml_document_t *doc;
+	xml_node_t *ifnode;
+
+	for (ifnode = entry->configs->children; ifnode; ifnode = ifnode->next) {
+		doc = xml_document_new();
+		xml_node_clone(ifnode, xml_document_root(doc));
+		xml_document_array_append(&result->docs, doc);
+	}
+}
+
+static void
+__ni_suse_ifcfg_cache_store(ni_suse_ifcfg_cache_t *cache, const ni_string_array_t *paths,
+				ni_compat_netdev_t *compat, const char *schema)
+{
+	size_t pfxlen = sizeof(__NI_SUSE_CONFIG_IFPREFIX)-1;
+	ni_string_array_t siblings = NI_STRING_ARRAY_INIT;
+	ni_suse_ifcfg_cache_entry_t *entry;
+	const char *origin, *path, *name;
+	xml_document_t *doc;
+	xml_node_t *ifnode;
+	ni_client_state_t *cs;
+	ni_uuid_t uuid;
+	size_t len;
+
+	doc = ni_compat_generate_interface(compat, schema);
+	ifnode = xml_document_root(doc)->children;
+
+	cs = ni_netdev_get_client_state(compat->dev);
+	origin = cs->config.origin;
+	len = ni_string_len(schema);
+	if (!ifnode || strncmp(origin, schema, len) || origin[len] != ':')
+		goto done;
+
+	path = origin + len + 1;
+	name = ni_basename(path);
+	if (!__ni_suse_ifcfg_valid_prefix(name, __NI_SUSE_CONFIG_IFPREFIX))
+		goto done;
+	name += pfxlen;
+
+	if (!(entry = ni_suse_ifcfg_cache_entry_find(cache, path))) {
+		if (!(entry = ni_suse_ifcfg_cache_entry_new(cache, path, name)))
+			goto done;
+
+		if (ni_string_array_index(paths, path) != -1) {
+			__ni_suse_ifcfg_siblings(path, name, &siblings);
+			ni_suse_ifcfg_cache_entry_update(entry, &siblings);
+			ni_string_array_destroy(&siblings);
+		}
+	}
+
+	if (ni_ifconfig_generate_uuid(ifnode, &uuid)) {
+		xml_node_add_attr(ifnode, NI_CLIENT_STATE_XML_CONFIG_UUID_NODE,
+				ni_uuid_print(&uuid));
+	}
+	ni_suse_ifcfg_cache_entry_add_config(entry, ifnode);
+	__ni_suse_ifcfg_relations(compat, &entry->depends);
+
+done:
+	xml_document_free(doc);
+}
+
+static void
+__ni_suse_read_interfaces_cached(const char *dirname, const ni_string_array_t *files,
+				ni_compat_ifconfig_t *result)
+{
+	size_t pfxlen = sizeof(__NI_SUSE_CONFIG_IFPREFIX)-1;
+	ni_string_array_t siblings = NI_STRING_ARRAY_INIT;
+	ni_string_array_t paths = NI_STRING_ARRAY_INIT;
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_suse_ifcfg_cache_entry_t *entry;
+	ni_suse_ifcfg_cache_t *cache;
+	ni_compat_netdev_t *compat;
+	char *fingerprint = NULL;
+	char pathbuf[PATH_MAX];
+	unsigned int i, nparsed = 0;
+	ni_bool_t *parsed;
+	ni_bool_t changed;
+	const char *name;
+
+	__ni_suse_ifcfg_fingerprint(dirname, result->schema, &fingerprint);
+	cache = ni_suse_ifcfg_cache_load(fingerprint);
+	ni_string_free(&fingerprint);
+
+	/* the names of the new and changed files ... */
+	for (i = 0; i < files->count; ++i) {
+		name = files->data[i] + pfxlen;
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s", dirname, files->data[i]);
+		ni_string_array_append(&paths, pathbuf);
+
+		entry = ni_suse_ifcfg_cache_entry_find(cache, pathbuf);
+		__ni_suse_ifcfg_siblings(pathbuf, name, &siblings);
+		if (!ni_suse_ifcfg_cache_entry_valid(cache, entry, &siblings))
+			__ni_suse_ifcfg_name_add(&names, name);
+	}
+	ni_string_array_destroy(&siblings);
+
+	/* ... and of the removed files */
+	for (entry = cache->entries; entry; entry = entry->next) {
+		if (entry->stat && ni_string_array_index(&paths, entry->path) == -1)
+			__ni_suse_ifcfg_name_add(&names, entry->name);
+	}
+
+	/* discard the cached and parse the files related to them */
+	parsed = xcalloc(files->count + 1, sizeof(*parsed));
+	do {
+		changed = FALSE;
+
+		for (entry = cache->entries; entry; entry = entry->next) {
+			if (entry->stale)
+				continue;
+			if (ni_string_array_index(&names, entry->name) == -1 &&
+			    !__ni_suse_ifcfg_names_match(&names, &entry->depends))
+				continue;
+
+			entry->stale = TRUE;
+			changed = TRUE;
+			__ni_suse_ifcfg_name_add(&names, entry->name);
+			for (i = 0; i < entry->depends.count; ++i)
+				__ni_suse_ifcfg_name_add(&names, entry->depends.data[i]);
+		}
+
+		for (i = 0; i < files->count; ++i) {
+			name = files->data[i] + pfxlen;
+			if (parsed[i] || ni_string_array_index(&names, name) == -1)
+				continue;
+
+			parsed[i] = TRUE;
+			changed = TRUE;
+			nparsed++;
+			if (!(compat = __ni_suse_read_interface(paths.data[i], name)))
+				continue;
+
+			ni_compat_netdev_set_origin(compat, result->schema, paths.data[i]);
+			ni_compat_netdev_array_append(&result->netdevs, compat);
+			__ni_suse_ifcfg_relations(compat, &names);
+		}
+	} while (changed);
+	free(parsed);
+	ni_string_array_destroy(&names);
+
+	ni_debug_readwrite("Parsed %u of %u ifcfg files in %s", nparsed,
+			files->count, dirname);
+
+	__ni_suse_adjust_slaves(&result->netdevs);
+	if (nparsed == files->count)
+		__ni_suse_show_unapplied_routes();
+
+	ni_suse_ifcfg_cache_drop_stale(cache);
+	for (i = 0; i < result->netdevs.count; ++i) {
+		compat = result->netdevs.data[i];
+		__ni_suse_ifcfg_cache_store(cache, &paths, compat, result->schema);
+	}
+	ni_compat_netdev_array_destroy(&result->netdevs);
+
+	/* in the order of the files, followed by the generated ones */
+	for (i = 0; i < paths.count; ++i) {
+		if ((entry = ni_suse_ifcfg_cache_entry_find(cache, paths.data[i])))
+			__ni_suse_ifcfg_cache_output(entry, result);
+	}
+	for (entry = cache->entries; entry; entry = entry->next) {
+		if (ni_string_array_index(&paths, entry->path) == -1)
+			__ni_suse_ifcfg_cache_output(entry, result);
+	}
+
+	ni_suse_ifcfg_cache_save(cache);
+	ni_suse_ifcfg_cache_free(cache);
+	ni_string_array_destroy(&paths);
+}
+
 ni_bool_t
 __ni_suse_get_ifconfig(const char *root, const char *path, ni_compat_ifconfig_t *result)
 {
@@ -212,7 +521,6 @@ __ni_suse_get_ifconfig(const char *root, const char *path, ni_compat_ifconfig_t
 	char pathbuf[PATH_MAX];
 	char *pathname = NULL;
 	const char *_path = __NI_SUSE_SYSCONFIG_NETWORK_DIR;
-	unsigned int i;
 
 	if (!ni_string_empty(path))
 		_path = path;
@@ -241,18 +549,11 @@ __ni_suse_get_ifconfig(const char *root, const char *path, ni_compat_ifconfig_t
 			goto done;
 		}
 
-		for (i = 0; i < files.count; ++i) {
-			const char *filename = files.data[i];
-			const char *ifname = filename + (sizeof(__NI_SUSE_CONFIG_IFPREFIX)-1);
-			ni_compat_netdev_t *compat;
-
-			snprintf(pathbuf, sizeof(pathbuf), "%s/%s", pathname, filename);
-			if (!(compat = __ni_suse_read_interface(pathbuf, ifname)))
-				continue;
-
-			ni_compat_netdev_set_origin(compat, result->schema, pathbuf);
-			ni_compat_netdev_array_append(&result->netdevs, compat);
-		}
+		/* the cache is not used for configs in an alternate root */
+		if (ni_string_empty(root))
+			__ni_suse_read_interfaces_cached(pathname, &files, result);
+		else
+			__ni_suse_read_interfaces(pathname, &files, result);
 
 		if (__ni_suse_config_defaults) {
 			extern unsigned int ni_wait_for_interfaces;
@@ -267,9 +568,6 @@ __ni_suse_get_ifconfig(const char *root, const char *path, ni_compat_ifconfig_t
 		goto done;
 	}
 
-	__ni_suse_adjust_slaves(&result->netdevs);
-	__ni_suse_show_unapplied_routes();
-
 	success = TRUE;
 
 done:
@@ -296,6 +594,7 @@ __ni_suse_read_default_hostname(const char *root, char **hostname)
 
 	for (name = filenames; name && !ni_string_empty(*name); name++) {
 		snprintf(filename, sizeof(filename), "%s%s", root, *name);
+		ni_string_array_append(&__ni_suse_global_files, filename);
 
 		if (!ni_isreg(filename))
 			continue;
@@ -336,6 +635,7 @@ __ni_suse_read_global_ifsysctl(const char *root, const char *path)
 	if (uname(&u) == 0) {
 		snprintf(pathbuf, sizeof(pathbuf), "%s%s%s", root,
 				__NI_SUSE_SYSCTL_BOOT, u.release);
+		ni_string_array_append(&__ni_suse_global_files, pathbuf);
 		name = ni_realpath(pathbuf, &real);
 		if (name && ni_isreg(name))
 			ni_string_array_append(&files, name);
@@ -349,6 +649,7 @@ __ni_suse_read_global_ifsysctl(const char *root, const char *path)
 		ni_string_array_t names = NI_STRING_ARRAY_INIT;
 
 		snprintf(dirname, sizeof(dirname), "%s%s", root, *sysctld);
+		ni_string_array_append(&__ni_suse_global_files, dirname);
 		if (!ni_isdir(dirname))
 			continue;
 
@@ -369,6 +670,7 @@ __ni_suse_read_global_ifsysctl(const char *root, const char *path)
 	 * then the old /etc/sysctl.conf
 	 */
 	snprintf(pathbuf, sizeof(pathbuf), "%s%s", root, __NI_SUSE_SYSCTL_FILE);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
 	name = ni_realpath(pathbuf, &real);
 	if (name && ni_isreg(name)) {
 		if (ni_string_array_index(&files, name) == -1)
@@ -385,6 +687,7 @@ __ni_suse_read_global_ifsysctl(const char *root, const char *path)
 	else
 		snprintf(pathbuf, sizeof(pathbuf), "%s/%s/%s",
 				root, path, __NI_SUSE_IFSYSCTL_FILE);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
 
 	name = ni_realpath(pathbuf, &real);
 	if (name && ni_isreg(name)) {
@@ -396,7 +699,10 @@ __ni_suse_read_global_ifsysctl(const char *root, const char *path)
 	for (i = 0; i < files.count; ++i) {
 		name = files.data[i];
 		ni_ifsysctl_file_load(&__ni_suse_global_ifsysctl, name);
+		if (ni_string_array_index(&__ni_suse_global_files, name) == -1)
+			ni_string_array_append(&__ni_suse_global_files, name);
 	}
+	ni_string_array_destroy(&files);
 	return TRUE;
 }
 
@@ -419,6 +725,7 @@ __ni_suse_read_globals(const char *root, const char *path, const char *real)
 	__ni_suse_read_default_hostname(root, &__ni_suse_default_hostname);
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/%s", real, __NI_SUSE_CONFIG_GLOBAL);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
 	if (ni_file_exists(pathbuf)) {
 		__ni_suse_config_defaults = ni_sysconfig_read(pathbuf);
 		if (__ni_suse_config_defaults == NULL) {
@@ -430,6 +737,7 @@ __ni_suse_read_globals(const char *root, const char *path, const char *real)
 	}
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/%s", real, __NI_SUSE_CONFIG_DHCP);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
 	if (ni_file_exists(pathbuf)) {
 		__ni_suse_dhcp_defaults = ni_sysconfig_read(pathbuf);
 		if (__ni_suse_dhcp_defaults == NULL) {
@@ -441,6 +749,7 @@ __ni_suse_read_globals(const char *root, const char *path, const char *real)
 	}
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/%s", real, __NI_SUSE_ROUTES_GLOBAL);
+	ni_string_array_append(&__ni_suse_global_files, pathbuf);
 	if (ni_file_exists(pathbuf)) {
 		if (!__ni_suse_read_routes(&__ni_suse_global_routes, pathbuf, NULL))
 			return FALSE;
@@ -496,6 +805,7 @@ __ni_suse_free_globals(void)
 	ni_route_tables_destroy(&__ni_suse_global_routes);
 
 	ni_var_array_destroy(&__ni_suse_global_ifsysctl);
+	ni_string_array_destroy(&__ni_suse_global_files);
 }
 
 /*
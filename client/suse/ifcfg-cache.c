@@ -0,0 +1,498 @@
+/*
+ *	wicked client ifcfg parse result cache
+ *
+ *	Parsing thousands of ifcfg files and generating the interface
+ *	configs from them takes seconds on every ifup/ifreload/show-config.
+ *	The cache stores the generated configs (and their config UUIDs)
+ *	per ifcfg file in the state directory, keyed by the file path,
+ *	its stat signature (device, inode, size, mtime and ctime) and a
+ *	hash of the content, so only files which changed are parsed again.
+ *	A fingerprint of the global files (config, dhcp, routes, sysctl,
+ *	...) invalidates the whole cache when one of them changes.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#if defined(HAVE_CONFIG_H)
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include "util_priv.h"
+#include "client/suse/ifcfg-cache.h"
+
+#define NI_SUSE_IFCFG_CACHE_FILE	"ifcfg-cache.xml"
+#define NI_SUSE_IFCFG_CACHE_VERSION	"1"
+
+/*
+ * File signatures
+ */
+const char *
+ni_suse_ifcfg_stat_signature(const char *path, char **sig)
+{
+	struct stat st;
+
+	ni_string_free(sig);
+	if (ni_string_empty(path) || stat(path, &st) < 0)
+		return NULL;
+
+	return ni_string_printf(sig, "%lx:%lx:%llx:%lld.%09ld:%lld.%09ld",
+			(unsigned long)st.st_dev, (unsigned long)st.st_ino,
+			(unsigned long long)st.st_size,
+			(long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec,
+			(long long)st.st_ctim.tv_sec, (long)st.st_ctim.tv_nsec);
+}
+
+static const char *
+ni_suse_ifcfg_hash_format(ni_hashctx_t *ctx, char **hash)
+{
+	unsigned char md[64];
+	char hex[sizeof(md) * 2 + 1];
+	int len;
+
+	ni_hashctx_finish(ctx);
+	len = ni_hashctx_get_digest(ctx, md, sizeof(md));
+	if (len <= 0)
+		return NULL;
+
+	if (ni_format_hex_data(md, len, hex, sizeof(hex), "", FALSE))
+		return NULL;
+
+	ni_string_dup(hash, hex);
+	return *hash;
+}
+
+const char *
+ni_suse_ifcfg_content_hash(const char *path, char **hash)
+{
+	ni_hashctx_t *ctx;
+	char buf[4096];
+	size_t len;
+	FILE *fp;
+
+	ni_string_free(hash);
+	if (ni_string_empty(path) || !(fp = fopen(path, "re")))
+		return NULL;
+
+	if (!(ctx = ni_hashctx_new(NI_HASHCTX_SHA1))) {
+		fclose(fp);
+		return NULL;
+	}
+
+	while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		ni_hashctx_put(ctx, buf, len);
+
+	if (!ferror(fp))
+		ni_suse_ifcfg_hash_format(ctx, hash);
+
+	ni_hashctx_free(ctx);
+	fclose(fp);
+	return *hash;
+}
+
+/*
+ * Fingerprint of the global files; a missing file is a part of it.
+ */
+const char *
+ni_suse_ifcfg_fingerprint(const char *salt, const ni_string_array_t *files, char **fingerprint)
+{
+	char *sig = NULL;
+	ni_hashctx_t *ctx;
+	unsigned int i;
+
+	ni_string_free(fingerprint);
+	if (!files || !(ctx = ni_hashctx_new(NI_HASHCTX_SHA1)))
+		return NULL;
+
+	ni_hashctx_puts(ctx, NI_SUSE_IFCFG_CACHE_VERSION);
+	ni_hashctx_puts(ctx, PACKAGE_VERSION);
+	ni_hashctx_puts(ctx, salt);
+	for (i = 0; i < files->count; ++i) {
+		ni_hashctx_puts(ctx, files->data[i]);
+		ni_hashctx_put(ctx, "=", 1);
+		if (ni_suse_ifcfg_stat_signature(files->data[i], &sig))
+			ni_hashctx_puts(ctx, sig);
+		ni_hashctx_put(ctx, "\n", 1);
+	}
+	ni_string_free(&sig);
+
+	ni_suse_ifcfg_hash_format(ctx, fingerprint);
+	ni_hashctx_free(ctx);
+	return *fingerprint;
+}
+
+/*
+ * Copy a config without the locations in the cache file
+ */
+static xml_node_t *
+ni_suse_ifcfg_cache_node_copy(const xml_node_t *src, xml_node_t *parent)
+{
+	const xml_node_t *child;
+	const ni_var_t *attr;
+	xml_node_t *dst;
+	unsigned int i;
+
+	dst = xml_node_new(src->name, parent);
+	ni_string_dup(&dst->cdata, src->cdata);
+
+	for (i = 0, attr = src->attrs.data; i < src->attrs.count; ++i, ++attr)
+		xml_node_add_attr(dst, attr->name, attr->value);
+
+	for (child = src->children; child; child = child->next)
+		ni_suse_ifcfg_cache_node_copy(child, dst);
+
+	return dst;
+}
+
+/*
+ * Cache entries
+ */
+ni_suse_ifcfg_cache_entry_t *
+ni_suse_ifcfg_cache_entry_new(ni_suse_ifcfg_cache_t *cache, const char *path, const char *name)
+{
+	ni_suse_ifcfg_cache_entry_t *entry, **tail;
+
+	if (!cache || ni_string_empty(path) || ni_string_empty(name))
+		return NULL;
+
+	entry = xcalloc(1, sizeof(*entry));
+	ni_string_dup(&entry->path, path);
+	ni_string_dup(&entry->name, name);
+	entry->configs = xml_node_new(NULL, NULL);
+
+	for (tail = &cache->entries; *tail; tail = &(*tail)->next)
+		;
+	*tail = entry;
+	cache->modified = TRUE;
+	return entry;
+}
+
+static void
+ni_suse_ifcfg_cache_entry_free(ni_suse_ifcfg_cache_entry_t *entry)
+{
+	if (entry) {
+		ni_string_free(&entry->path);
+		ni_string_free(&entry->name);
+		ni_string_free(&entry->stat);
+		ni_string_free(&entry->hash);
+		ni_var_array_destroy(&entry->siblings);
+		ni_string_array_destroy(&entry->depends);
+		xml_node_free(entry->configs);
+		free(entry);
+	}
+}
+
+ni_suse_ifcfg_cache_entry_t *
+ni_suse_ifcfg_cache_entry_find(ni_suse_ifcfg_cache_t *cache, const char *path)
+{
+	ni_suse_ifcfg_cache_entry_t *entry;
+
+	for (entry = cache ? cache->entries : NULL; entry; entry = entry->next) {
+		if (ni_string_eq(entry->path, path))
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Check if the ifcfg file and its siblings are unchanged. When only the
+ * stat signature of the ifcfg file changed but not it's content, the
+ * entry is still valid and the new signature is remembered.
+ */
+ni_bool_t
+ni_suse_ifcfg_cache_entry_valid(ni_suse_ifcfg_cache_t *cache, ni_suse_ifcfg_cache_entry_t *entry,
+				const ni_string_array_t *siblings)
+{
+	char *sig = NULL, *hash = NULL;
+	ni_bool_t valid = FALSE;
+	const ni_var_t *var;
+	unsigned int i;
+
+	if (!cache || !entry || !entry->stat || !siblings)
+		return FALSE;
+
+	if (entry->siblings.count != siblings->count)
+		return FALSE;
+
+	for (i = 0; i < siblings->count; ++i) {
+		var = ni_var_array_get(&entry->siblings, siblings->data[i]);
+		ni_suse_ifcfg_stat_signature(siblings->data[i], &sig);
+		if (!var || !ni_string_eq(var->value, sig))
+			goto done;
+	}
+
+	if (!ni_suse_ifcfg_stat_signature(entry->path, &sig))
+		goto done;
+
+	if (ni_string_eq(entry->stat, sig)) {
+		valid = TRUE;
+	} else
+	if (ni_suse_ifcfg_content_hash(entry->path, &hash) &&
+	    ni_string_eq(entry->hash, hash)) {
+		ni_string_dup(&entry->stat, sig);
+		cache->modified = TRUE;
+		valid = TRUE;
+	}
+
+done:
+	ni_string_free(&hash);
+	ni_string_free(&sig);
+	return valid;
+}
+
+/*
+ * Remember the signatures of the ifcfg file and it's siblings
+ */
+ni_bool_t
+ni_suse_ifcfg_cache_entry_update(ni_suse_ifcfg_cache_entry_t *entry,
+				const ni_string_array_t *siblings)
+{
+	char *sig = NULL;
+	unsigned int i;
+
+	if (!entry || !siblings)
+		return FALSE;
+
+	if (!ni_suse_ifcfg_stat_signature(entry->path, &entry->stat) ||
+	    !ni_suse_ifcfg_content_hash(entry->path, &entry->hash)) {
+		ni_string_free(&entry->stat);
+		ni_string_free(&entry->hash);
+		return FALSE;
+	}
+
+	ni_var_array_destroy(&entry->siblings);
+	for (i = 0; i < siblings->count; ++i) {
+		ni_suse_ifcfg_stat_signature(siblings->data[i], &sig);
+		ni_var_array_set(&entry->siblings, siblings->data[i], sig);
+	}
+	ni_string_free(&sig);
+	return TRUE;
+}
+
+ni_bool_t
+ni_suse_ifcfg_cache_entry_add_config(ni_suse_ifcfg_cache_entry_t *entry, const xml_node_t *ifnode)
+{
+	if (!entry || !ifnode)
+		return FALSE;
+
+	return ni_suse_ifcfg_cache_node_copy(ifnode, entry->configs) != NULL;
+}
+
+void
+ni_suse_ifcfg_cache_drop_stale(ni_suse_ifcfg_cache_t *cache)
+{
+	ni_suse_ifcfg_cache_entry_t **pos, *entry;
+
+	for (pos = &cache->entries; (entry = *pos); ) {
+		if (entry->stale) {
+			*pos = entry->next;
+			ni_suse_ifcfg_cache_entry_free(entry);
+			cache->modified = TRUE;
+		} else {
+			pos = &entry->next;
+		}
+	}
+}
+
+/*
+ * Cache file handling
+ */
+static const char *
+ni_suse_ifcfg_cache_path(char **path)
+{
+	return ni_string_printf(path, "%s/%s", ni_config_statedir(),
+				NI_SUSE_IFCFG_CACHE_FILE);
+}
+
+static ni_suse_ifcfg_cache_entry_t *
+ni_suse_ifcfg_cache_entry_from_xml(ni_suse_ifcfg_cache_t *cache, xml_node_t *node)
+{
+	ni_suse_ifcfg_cache_entry_t *entry;
+	xml_node_t *child, *next;
+
+	entry = ni_suse_ifcfg_cache_entry_new(cache,
+			xml_node_get_attr(node, "path"),
+			xml_node_get_attr(node, "name"));
+	if (!entry)
+		return NULL;
+
+	ni_string_dup(&entry->stat, xml_node_get_attr(node, "stat"));
+	ni_string_dup(&entry->hash, xml_node_get_attr(node, "hash"));
+
+	for (child = node->children; child; child = next) {
+		next = child->next;
+
+		if (ni_string_eq(child->name, "sibling")) {
+			ni_var_array_set(&entry->siblings,
+					xml_node_get_attr(child, "path"),
+					xml_node_get_attr(child, "stat"));
+		} else
+		if (ni_string_eq(child->name, "depends")) {
+			if (!ni_string_empty(child->cdata))
+				ni_string_array_append(&entry->depends, child->cdata);
+		} else {
+			xml_node_reparent(entry->configs, child);
+		}
+	}
+	return entry;
+}
+
+ni_suse_ifcfg_cache_t *
+ni_suse_ifcfg_cache_load(const char *fingerprint)
+{
+	ni_suse_ifcfg_cache_t *cache;
+	xml_document_t *doc = NULL;
+	char *path = NULL;
+	xml_node_t *root, *node;
+
+	cache = xcalloc(1, sizeof(*cache));
+	ni_string_dup(&cache->fingerprint, fingerprint);
+
+	if (!ni_suse_ifcfg_cache_path(&path) || !ni_file_exists(path))
+		goto done;
+
+	if (!(doc = xml_document_read(path))) {
+		ni_debug_readwrite("Discarding unreadable ifcfg cache %s", path);
+		goto done;
+	}
+
+	root = xml_node_get_child(xml_document_root(doc), "ifcfg-cache");
+	if (!root || !fingerprint ||
+	    !ni_string_eq(xml_node_get_attr(root, "fingerprint"), fingerprint)) {
+		ni_debug_readwrite("Discarding outdated ifcfg cache %s", path);
+		goto done;
+	}
+
+	for (node = root->children; node; node = node->next) {
+		if (ni_string_eq(node->name, "file"))
+			ni_suse_ifcfg_cache_entry_from_xml(cache, node);
+	}
+	cache->modified = FALSE;
+
+done:
+	xml_document_free(doc);
+	ni_string_free(&path);
+	return cache;
+}
+
+static xml_document_t *
+ni_suse_ifcfg_cache_to_xml(const ni_suse_ifcfg_cache_t *cache)
+{
+	const ni_suse_ifcfg_cache_entry_t *entry;
+	xml_node_t *root, *node, *child;
+	xml_document_t *doc;
+	unsigned int i;
+
+	doc = xml_document_new();
+	root = xml_node_new("ifcfg-cache", xml_document_root(doc));
+	xml_node_add_attr(root, "fingerprint", cache->fingerprint);
+
+	for (entry = cache->entries; entry; entry = entry->next) {
+		node = xml_node_new("file", root);
+		xml_node_add_attr(node, "path", entry->path);
+		xml_node_add_attr(node, "name", entry->name);
+		if (entry->stat)
+			xml_node_add_attr(node, "stat", entry->stat);
+		if (entry->hash)
+			xml_node_add_attr(node, "hash", entry->hash);
+
+		for (i = 0; i < entry->siblings.count; ++i) {
+			child = xml_node_new("sibling", node);
+			xml_node_add_attr(child, "path", entry->siblings.data[i].name);
+			if (entry->siblings.data[i].value)
+				xml_node_add_attr(child, "stat", entry->siblings.data[i].value);
+		}
+		for (i = 0; i < entry->depends.count; ++i)
+			xml_node_new_element("depends", node, entry->depends.data[i]);
+
+		for (child = entry->configs->children; child; child = child->next)
+			ni_suse_ifcfg_cache_node_copy(child, node);
+	}
+	return doc;
+}
+
+ni_bool_t
+ni_suse_ifcfg_cache_save(ni_suse_ifcfg_cache_t *cache)
+{
+	char tempname[PATH_MAX];
+	xml_document_t *doc;
+	char *path = NULL;
+	ni_bool_t ret = FALSE;
+	FILE *fp;
+	int fd;
+
+	if (!cache || !cache->modified || !cache->fingerprint)
+		return TRUE;
+
+	if (!ni_suse_ifcfg_cache_path(&path))
+		return FALSE;
+
+	/* not being able to write the cache is not an error */
+	snprintf(tempname, sizeof(tempname), "%s.XXXXXX", path);
+	if ((fd = mkstemp(tempname)) < 0) {
+		ni_debug_readwrite("Cannot create ifcfg cache %s: %m", tempname);
+		ni_string_free(&path);
+		return FALSE;
+	}
+	if (!(fp = fdopen(fd, "we"))) {
+		close(fd);
+		unlink(tempname);
+		ni_string_free(&path);
+		return FALSE;
+	}
+
+	doc = ni_suse_ifcfg_cache_to_xml(cache);
+	if (xml_document_print(doc, fp) >= 0 && fflush(fp) == 0 && !ferror(fp))
+		ret = TRUE;
+	xml_document_free(doc);
+	fclose(fp);
+
+	if (ret && rename(tempname, path) == 0) {
+		ni_debug_readwrite("Updated ifcfg cache %s", path);
+		cache->modified = FALSE;
+	} else {
+		ni_debug_readwrite("Cannot write ifcfg cache %s: %m", path);
+		unlink(tempname);
+		ret = FALSE;
+	}
+	ni_string_free(&path);
+	return ret;
+}
+
+void
+ni_suse_ifcfg_cache_free(ni_suse_ifcfg_cache_t *cache)
+{
+	ni_suse_ifcfg_cache_entry_t *entry;
+
+	if (!cache)
+		return;
+
+	while ((entry = cache->entries)) {
+		cache->entries = entry->next;
+		ni_suse_ifcfg_cache_entry_free(entry);
+	}
+	ni_string_free(&cache->fingerprint);
+	free(cache);
+}
@@ -0,0 +1,77 @@
+/*
+ *	wicked client ifcfg parse result cache
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifndef   __WICKED_CLIENT_SUSE_IFCFG_CACHE_H__
+#define   __WICKED_CLIENT_SUSE_IFCFG_CACHE_H__
+
+#include <wicked/util.h>
+#include <wicked/xml.h>
+
+typedef struct ni_suse_ifcfg_cache		ni_suse_ifcfg_cache_t;
+typedef struct ni_suse_ifcfg_cache_entry	ni_suse_ifcfg_cache_entry_t;
+
+/*
+ * The configs generated from an ifcfg file, including the configs
+ * of the slaves without an own ifcfg file. Generated configs without
+ * any file, e.g. the ovs-system, are stored in an entry with a path
+ * of the file they would have and without a stat signature.
+ */
+struct ni_suse_ifcfg_cache_entry {
+	ni_suse_ifcfg_cache_entry_t *	next;
+
+	char *				path;
+	char *				name;
+	char *				stat;		/* file stat signature	*/
+	char *				hash;		/* file content hash	*/
+	ni_var_array_t			siblings;	/* ifroute-<name>, ...	*/
+	ni_string_array_t		depends;	/* related interfaces	*/
+	xml_node_t *			configs;	/* the <interface> nodes	*/
+
+	ni_bool_t			stale;
+};
+
+struct ni_suse_ifcfg_cache {
+	char *				fingerprint;	/* of the global files	*/
+	ni_suse_ifcfg_cache_entry_t *	entries;
+	ni_bool_t			modified;
+};
+
+extern ni_suse_ifcfg_cache_t *		ni_suse_ifcfg_cache_load(const char *);
+extern ni_bool_t			ni_suse_ifcfg_cache_save(ni_suse_ifcfg_cache_t *);
+extern void				ni_suse_ifcfg_cache_free(ni_suse_ifcfg_cache_t *);
+extern void				ni_suse_ifcfg_cache_drop_stale(ni_suse_ifcfg_cache_t *);
+
+extern ni_suse_ifcfg_cache_entry_t *	ni_suse_ifcfg_cache_entry_find(ni_suse_ifcfg_cache_t *,
+							const char *);
+extern ni_suse_ifcfg_cache_entry_t *	ni_suse_ifcfg_cache_entry_new(ni_suse_ifcfg_cache_t *,
+							const char *, const char *);
+extern ni_bool_t			ni_suse_ifcfg_cache_entry_valid(ni_suse_ifcfg_cache_t *,
+							ni_suse_ifcfg_cache_entry_t *,
+							const ni_string_array_t *);
+extern ni_bool_t			ni_suse_ifcfg_cache_entry_update(ni_suse_ifcfg_cache_entry_t *,
+							const ni_string_array_t *);
+extern ni_bool_t			ni_suse_ifcfg_cache_entry_add_config(ni_suse_ifcfg_cache_entry_t *,
+							const xml_node_t *);
+
+extern const char *			ni_suse_ifcfg_stat_signature(const char *, char **);
+extern const char *			ni_suse_ifcfg_content_hash(const char *, char **);
+extern const char *			ni_suse_ifcfg_fingerprint(const char *, const ni_string_array_t *,
+							char **);
+
+#endif /* __WICKED_CLIENT_SUSE_IFCFG_CACHE_H__ */
@@ -128,6 +128,7 @@ typedef struct ni_compat_ifconfig {
 	unsigned int		timeout;
 
 	ni_compat_netdev_array_t netdevs;
+	xml_document_array_t	docs;		/* already generated, e.g. cached */
 } ni_compat_ifconfig_t;
 
 extern ni_compat_netdev_t *	ni_compat_netdev_new(const char *);
@@ -142,6 +143,7 @@ extern void			ni_compat_netdev_array_destroy(ni_compat_netdev_array_t *);
 extern void			ni_compat_ifconfig_init(ni_compat_ifconfig_t *, const char *);
 extern void			ni_compat_ifconfig_destroy(ni_compat_ifconfig_t *);
 extern unsigned int		ni_compat_generate_interfaces(xml_document_array_t *, ni_compat_ifconfig_t *, ni_bool_t, ni_bool_t);
+extern xml_document_t *		ni_compat_generate_interface(ni_compat_netdev_t *, const char *);
 extern void			ni_compat_netdev_set_origin(ni_compat_netdev_t *, const char *, const char *);
 
 extern ni_bool_t		ni_ifconfig_read(xml_document_array_t *, const char *, const char *, ni_bool_t, ni_bool_t);
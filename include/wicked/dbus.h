@@ -114,8 +114,24 @@ struct ni_dbus_service {
 	const ni_dbus_property_t *	properties;
 
 	const ni_xs_service_t *		schema;
+
+	/* Properties flagged on-demand in the schema; these are
+	 * only serialized if the client explicitly asks for them. */
+	ni_string_array_t		on_demand;
 };
 
+/*
+ * Restricts which properties GetManagedObjects, GetManagedObjectsSince
+ * and GetAll return. On the wire, this is an a{sv} dict with the
+ * optional members "interfaces" and "on-demand" (both as).
+ */
+typedef struct ni_dbus_property_filter {
+	ni_string_array_t		interfaces;	/* empty: all interfaces */
+	ni_string_array_t		on_demand;	/* "<interface>.<property>" or "*" */
+} ni_dbus_property_filter_t;
+
+#define NI_DBUS_PROPERTY_FILTER_INIT	{ .interfaces = NI_STRING_ARRAY_INIT, .on_demand = NI_STRING_ARRAY_INIT }
+
 struct ni_dbus_class {
 	char *			name;
 	const ni_dbus_class_t *	superclass;
@@ -143,6 +159,8 @@ struct ni_dbus_object {
 	char *			path;		/* absolute path */
 	void *			handle;		/* local object */
 	ni_dbus_object_t *	children;
+	struct ni_dbus_object_hash *child_hash;	/* children by name */
+	ni_dbus_object_t *	hash_next;
 	const ni_dbus_service_t **interfaces;
 
 	ni_dbus_server_object_t *server_object;
@@ -209,6 +227,18 @@ extern dbus_bool_t		ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t
 					const ni_dbus_service_t *interface,
 					ni_dbus_variant_t *dict,
 					DBusError *error);
+extern dbus_bool_t		ni_dbus_object_get_filtered_properties_as_dict(const ni_dbus_object_t *object,
+					const ni_dbus_service_t *interface,
+					const ni_dbus_property_filter_t *filter,
+					ni_dbus_variant_t *dict,
+					DBusError *error);
+extern void			ni_dbus_property_filter_init(ni_dbus_property_filter_t *);
+extern void			ni_dbus_property_filter_destroy(ni_dbus_property_filter_t *);
+extern dbus_bool_t		ni_dbus_property_filter_to_dict(const ni_dbus_property_filter_t *, ni_dbus_variant_t *);
+extern dbus_bool_t		ni_dbus_property_filter_from_dict(ni_dbus_property_filter_t *, const ni_dbus_variant_t *);
+extern unsigned int		ni_dbus_property_filter_hash(const ni_dbus_property_filter_t *);
+extern ni_bool_t		ni_dbus_property_filter_match_service(const ni_dbus_property_filter_t *,
+					const ni_dbus_service_t *);
 extern int			ni_dbus_object_translate_error(ni_dbus_object_t *, const DBusError *);
 
 extern const ni_dbus_service_t *ni_dbus_get_standard_service(const char *);
@@ -360,6 +390,8 @@ extern ni_dbus_object_t *	ni_dbus_client_object_new_child(ni_dbus_object_t *pare
 					const char *interface,
 					void *local_data);
 extern dbus_bool_t		ni_dbus_object_refresh_children(ni_dbus_object_t *);
+extern dbus_bool_t		ni_dbus_object_refresh_children_filtered(ni_dbus_object_t *,
+					const ni_dbus_property_filter_t *);
 extern ni_dbus_object_t *	ni_dbus_object_find_child(ni_dbus_object_t *parent, const char *name);
 extern dbus_bool_t		ni_dbus_object_call_variant(const ni_dbus_object_t *,
 					const char *interface, const char *method,
@@ -372,12 +404,18 @@ extern int			ni_dbus_object_call_simple(const ni_dbus_object_t *,
 					int res_type, void *res_ptr);
 extern int			ni_dbus_object_call_async(ni_dbus_object_t *obj,
 					ni_dbus_async_callback_t *callback, const char *method, ...);
+extern int			ni_dbus_object_call_variant_async(ni_dbus_object_t *,
+					const char *interface, const char *method,
+					unsigned int nargs, const ni_dbus_variant_t *args,
+					ni_dbus_async_callback_t *callback);
 
 extern ni_dbus_message_t *	ni_dbus_object_call_new(const ni_dbus_object_t *, const char *method, ...);
 extern ni_dbus_message_t *	ni_dbus_object_call_new_va(const ni_dbus_object_t *obj,
 					const char *method, va_list *app);
 
 extern dbus_bool_t		ni_dbus_object_get_managed_objects(ni_dbus_object_t *, DBusError *, ni_bool_t purge);
+extern dbus_bool_t		ni_dbus_object_get_changed_objects(ni_dbus_object_t *,
+					const ni_dbus_property_filter_t *, DBusError *);
 extern dbus_bool_t		ni_dbus_object_refresh_properties(ni_dbus_object_t *, const ni_dbus_service_t *, DBusError *);
 extern dbus_bool_t		ni_dbus_object_send_property(ni_dbus_object_t *proxy,
 					const char *service_name,
@@ -152,6 +152,9 @@ struct ni_ethernet {
 	ni_ethtool_channels_t	channels;
 
 	unsigned int		identify_time;
+
+	/* wol, offload, eee, ring, coalesce and channels not read yet */
+	ni_bool_t		ondemand_pending;
 };
 
 extern ni_ethernet_t *	ni_ethernet_new(void);
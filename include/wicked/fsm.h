@@ -52,6 +52,8 @@ typedef struct ni_ifworker	ni_ifworker_t;
 typedef struct ni_fsm_require	ni_fsm_require_t;
 typedef struct ni_fsm_policy	ni_fsm_policy_t;
 typedef struct ni_fsm_event	ni_fsm_event_t;
+typedef struct ni_ifworker_index ni_ifworker_index_t;
+typedef struct ni_fsm_policy_index ni_fsm_policy_index_t;
 
 typedef struct ni_ifworker_array {
 	unsigned int		count;
@@ -139,7 +141,9 @@ struct ni_ifworker {
 				done		: 1,
 				kickstarted	: 1,
 				pending		: 1,
-				readonly	: 1;
+				readonly	: 1,
+				bound		: 1,	/* hierarchy built from config */
+				unresolved	: 1;	/* references to unknown workers */
 
 	ni_ifworker_control_t	control;
 
@@ -187,6 +191,12 @@ struct ni_ifworker {
 
 		ni_fsm_require_t *check_state_req_list;
 
+		struct {
+			ni_bool_t pending;	/* async call in flight */
+			ni_fsm_transition_t *action;
+			unsigned int binding;
+			unsigned int callbacks;
+		} call;
 	} fsm;
 	unsigned int		extra_waittime;
 
@@ -241,6 +251,8 @@ struct ni_fsm_event {
 struct ni_fsm {
 	ni_ifworker_array_t	pending;
 	ni_ifworker_array_t	workers;
+	ni_ifworker_index_t *	index;		/* lookup of workers */
+	ni_bool_t		workers_added;	/* rebind unresolved workers */
 	unsigned int		worker_timeout;
 	ni_bool_t		readonly;
 
@@ -249,12 +261,16 @@ struct ni_fsm {
 	unsigned int		last_event_seq[__NI_EVENT_MAX];
 	unsigned int		block_events;
 	ni_fsm_event_t *	events;
+
+	unsigned int		parallel_calls;
+	unsigned int		calls_in_flight;
 	struct {
 		void            (*callback)(ni_fsm_t *, ni_ifworker_t *, ni_fsm_event_t *);
 		void *          user_data;
 	} process_event;
 
 	ni_fsm_policy_t *	policies;
+	ni_fsm_policy_index_t *	policy_index;	/* lookup of policies */
 
 	ni_dbus_object_t *	client_root_object;
 };
@@ -286,6 +302,7 @@ extern void			ni_fsm_policy_free(ni_fsm_policy_t *);
 extern ni_bool_t		ni_fsm_policy_update(ni_fsm_policy_t *, xml_node_t *);
 extern ni_bool_t		ni_fsm_policy_remove(ni_fsm_t *, ni_fsm_policy_t *);
 extern ni_fsm_policy_t *	ni_fsm_policy_by_name(const ni_fsm_t *, const char *);
+extern void			ni_fsm_policy_index_free(ni_fsm_policy_index_t *);
 extern unsigned int		ni_fsm_policy_get_applicable_policies(const ni_fsm_t *, ni_ifworker_t *,
 						const ni_fsm_policy_t **, unsigned int);
 extern ni_bool_t		ni_fsm_exists_applicable_policy(const ni_fsm_t *, ni_fsm_policy_t *, ni_ifworker_t *);
@@ -320,6 +337,7 @@ extern ni_ifworker_t *		ni_fsm_recv_new_netif_path(ni_fsm_t *fsm, const char *pa
 extern ni_ifworker_t *		ni_fsm_recv_new_modem(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh);
 extern ni_ifworker_t *		ni_fsm_recv_new_modem_path(ni_fsm_t *fsm, const char *path);
 extern void			ni_fsm_destroy_worker(ni_fsm_t *fsm, ni_ifworker_t *w);
+extern ni_bool_t		ni_fsm_remove_worker(ni_fsm_t *fsm, ni_ifworker_t *w);
 extern void			ni_fsm_pull_in_children(ni_ifworker_array_t *, ni_fsm_t *);
 extern void			ni_fsm_wait_tentative_addrs(ni_fsm_t *);
 
@@ -60,7 +60,8 @@ struct ni_netdev {
 	unsigned int		seq;
 	unsigned int		modified : 1,
 				deleted : 1,
-				created : 1;
+				created : 1,
+				change_pending : 1;
 
 	char *			name;
 	ni_linkinfo_t		link;
@@ -166,7 +167,12 @@ extern void		ni_netconfig_free(ni_netconfig_t *);
 extern void		ni_netconfig_init(ni_netconfig_t *);
 extern void		ni_netconfig_destroy(ni_netconfig_t *);
 extern ni_netdev_t *	ni_netconfig_devlist(ni_netconfig_t *nic);
+
+typedef struct ni_netconfig_firmware	ni_netconfig_firmware_t;
+
 extern xml_document_t *	ni_netconfig_firmware_discovery(const char *, const char *);
+extern ni_netconfig_firmware_t *ni_netconfig_firmware_discovery_start(const char *, const char *);
+extern xml_document_t *	ni_netconfig_firmware_discovery_finish(ni_netconfig_firmware_t *);
 
 extern ni_modem_t *	ni_netconfig_modem_list(ni_netconfig_t *);
 
@@ -175,7 +181,6 @@ extern ni_netconfig_t *	ni_global_state_handle(int);
 
 extern ni_netdev_t *	ni_netdev_by_name(ni_netconfig_t *nic, const char *name);
 extern ni_netdev_t *	ni_netdev_by_index(ni_netconfig_t *nic, unsigned int index);
-extern ni_netdev_t *	ni_netdev_by_hwaddr(ni_netconfig_t *nic, const ni_hwaddr_t *lla);
 extern ni_netdev_t *	ni_netdev_by_vlan_name_and_tag(ni_netconfig_t *nc,
 				const char *physdev, uint16_t tag);
 extern unsigned int	ni_netdev_name_to_index(const char *);
@@ -95,11 +95,34 @@ struct ni_route_array {
 	ni_route_t **		data;
 };
 
+/*
+ * Open addressing hash of the routes in a table, keyed by
+ * family, prefix length and destination.  It is built once
+ * the table grows beyond a few routes and kept in sync by
+ * the ni_route_table(s) add/del functions, so the key of a
+ * route must not be modified while it is in a table.
+ * The slots record the order the routes have been added in,
+ * which is their order in the table array.
+ */
+typedef struct ni_route_index_slot {
+	ni_route_t *		route;
+	unsigned int		seq;
+} ni_route_index_slot_t;
+
+typedef struct ni_route_index {
+	unsigned int		count;
+	unsigned int		used;
+	unsigned int		size;
+	unsigned int		seq;
+	ni_route_index_slot_t *	slot;
+} ni_route_index_t;
+
 struct ni_route_table {
 	ni_route_table_t *	next;
 
 	unsigned int		tid;
 	ni_route_array_t	routes;
+	ni_route_index_t	index;
 };
 
 enum {
@@ -268,6 +291,12 @@ extern void			ni_route_array_sort_rev(ni_route_array_t *);
 extern ni_route_table_t *	ni_route_table_new(unsigned int);
 extern void			ni_route_table_free(ni_route_table_t *);
 extern void			ni_route_table_clear(ni_route_table_t *);
+extern ni_bool_t		ni_route_table_add_route(ni_route_table_t *, ni_route_t *);
+extern ni_bool_t		ni_route_table_del_route(ni_route_table_t *, ni_route_t *);
+extern ni_route_t *		ni_route_table_find_match(ni_route_table_t *, const ni_route_t *,
+					ni_bool_t (*match)(const ni_route_t *, const ni_route_t *));
+extern unsigned int		ni_route_table_remove_by_seq(ni_route_table_t *, unsigned int,
+					ni_route_array_t *);
 
 extern ni_bool_t		ni_route_tables_add_route(ni_route_table_t **, ni_route_t *);
 extern ni_bool_t		ni_route_tables_add_routes(ni_route_table_t **, ni_route_array_t *);
@@ -421,6 +421,10 @@ extern int		ni_hashctx_get_digest(ni_hashctx_t *, void *, size_t);
 extern void		ni_hashctx_put(ni_hashctx_t *, const void *, size_t);
 extern void		ni_hashctx_puts(ni_hashctx_t *, const char *);
 
+extern unsigned int	ni_hash_bytes(const void *, size_t);
+extern unsigned int	ni_hash_string(const char *);
+extern unsigned int	ni_hash_uint(unsigned int);
+
 
 /*
  * Sanity check functions
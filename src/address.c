@@ -25,6 +25,7 @@
 #include <wicked/logging.h>
 #include <wicked/netinfo.h>
 #include <wicked/socket.h>
+#include "netinfo_priv.h"
 #include "util_priv.h"
 
 #define	NI_ADDRESS_ARRAY_CHUNK		16
@@ -39,12 +40,20 @@ static const unsigned char *__ni_sockaddr_data(const ni_sockaddr_t *, unsigned i
 /*
  * ni_address functions
  */
+static ni_objpool_t		ni_address_pool = NI_OBJPOOL_INIT("address", ni_address_t, 256);
+
+void
+ni_address_pool_trace(void)
+{
+	ni_objpool_trace(&ni_address_pool);
+}
+
 static ni_address_t *
 do_address_new(void)
 {
 	ni_address_t *ap;
 
-	ap = xcalloc(1, sizeof(*ap));
+	ap = ni_objpool_alloc(&ni_address_pool);
 	if (ap) {
 		ap->refcount = 1;
 	}
@@ -129,7 +138,7 @@ ni_address_free(ni_address_t *ap)
 			return;
 
 		ni_string_free(&ap->label);
-		free(ap);
+		ni_objpool_free(&ni_address_pool, ap);
 	}
 }
 
@@ -72,8 +72,38 @@ typedef struct ni_config_rtnl_event {
 	 */
 	unsigned int	recv_buff_length;
 	unsigned int	mesg_buff_length;
+	unsigned int	coalesce_window;	/* msec, 0: per receive */
 } ni_config_rtnl_event_t;
 
+typedef enum {
+	NI_CONFIG_SOCKET_BACKEND_DEFAULT = 0,
+	NI_CONFIG_SOCKET_BACKEND_POLL,
+	NI_CONFIG_SOCKET_BACKEND_EPOLL,
+} ni_config_socket_backend_t;
+
+typedef enum {
+	NI_CONFIG_CAPTURE_BACKEND_DEFAULT = 0,
+	NI_CONFIG_CAPTURE_BACKEND_SOCKET,
+	NI_CONFIG_CAPTURE_BACKEND_RING,
+} ni_config_capture_backend_t;
+
+typedef enum {
+	NI_CONFIG_LEASE_STORE_DEFAULT = 0,
+	NI_CONFIG_LEASE_STORE_XML,
+	NI_CONFIG_LEASE_STORE_JOURNAL,
+} ni_config_lease_store_t;
+
+typedef struct ni_config_socket {
+	ni_config_socket_backend_t	backend;
+	ni_config_capture_backend_t	capture;
+} ni_config_socket_t;
+
+#define NI_CONFIG_SOURCES_PARALLEL_JOBS	4
+
+typedef struct ni_config_fsm {
+	unsigned int		parallel_calls;	/* 0,1: serial calls */
+} ni_config_fsm_t;
+
 typedef enum {
 	NI_CONFIG_BONDING_CTL_NETLINK = 0,
 	NI_CONFIG_BONDING_CTL_SYSFS,
@@ -167,6 +197,7 @@ typedef struct ni_config {
 
 	struct {
 	    unsigned int		default_allow_update;
+	    ni_config_lease_store_t	lease_store;
 
 	    ni_config_dhcp4_t		dhcp4;
 	    ni_config_dhcp6_t		dhcp6;
@@ -177,6 +208,7 @@ typedef struct ni_config {
 	} addrconf;
 
 	char *			dbus_xml_schema_file;
+	char *			dbus_xml_schema_cache;
 	ni_extension_t *	dbus_extensions;
 	ni_extension_t *	ns_extensions;
 	ni_extension_t *	fw_extensions;
@@ -184,12 +216,16 @@ typedef struct ni_config {
 
 	struct {
 	    ni_string_array_t	ifconfig;
+	    unsigned int	parallel_jobs;	/* 0,1: serial load */
 	} sources;
+	ni_string_array_t	files;		/* parsed incl. includes */
 
 	char *			dbus_name;
 	char *			dbus_type;
 
 	ni_config_rtnl_event_t	rtnl_event;
+	ni_config_socket_t	socket;
+	ni_config_fsm_t		fsm;
 
 	ni_config_bonding_t	bonding;
 	ni_config_teamd_t	teamd;
@@ -207,6 +243,17 @@ extern ni_bool_t	ni_config_use_nanny(void);
 extern const ni_config_dhcp4_t *	ni_config_dhcp4_find_device(const char *);
 extern const ni_config_dhcp6_t *	ni_config_dhcp6_find_device(const char *);
 
+extern ni_config_socket_backend_t	ni_config_socket_backend(void);
+extern const char *	ni_config_socket_backend_type_to_name(ni_config_socket_backend_t);
+extern ni_config_capture_backend_t	ni_config_capture_backend(void);
+extern const char *	ni_config_capture_backend_type_to_name(ni_config_capture_backend_t);
+
+extern ni_config_lease_store_t	ni_config_lease_store(void);
+extern const char *	ni_config_lease_store_type_to_name(ni_config_lease_store_t);
+
+extern unsigned int	ni_config_fsm_parallel_calls(void);
+extern unsigned int	ni_config_sources_parallel_jobs(void);
+
 extern ni_config_bonding_ctl_t	ni_config_bonding_ctl(void);
 
 extern ni_bool_t	ni_config_teamd_enable(ni_config_teamd_ctl_t);
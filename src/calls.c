@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <wicked/netinfo.h>
 #include <wicked/logging.h>
@@ -316,6 +317,30 @@ ni_call_device_new_xml(const ni_dbus_service_t *service,
 	return result;
 }
 
+/*
+ * Report an error returned by a device method call and map it to
+ * an error code, using the error context handler when there is one.
+ */
+static int
+ni_call_device_method_error(const ni_dbus_service_t *service, const ni_dbus_method_t *method,
+				const DBusError *error, ni_call_error_context_t *error_ctx)
+{
+	int rv;
+
+	if (error_ctx) {
+		rv = error_ctx->handler(error_ctx, error);
+		if (rv > 0) {
+			ni_warn("Whaaah. Error context handler returns positive code. "
+				"Assuming programmer mistake");
+			rv = -rv;
+		}
+	} else {
+		ni_dbus_print_error(error, "%s.%s() failed", service->name, method->name);
+		rv = ni_dbus_get_error(error, NULL);
+	}
+	return rv;
+}
+
 /*
  * Place a generic call to a device. This call will optionally return a
  * callback list.
@@ -335,18 +360,7 @@ ni_call_device_method_common(ni_dbus_object_t *object,
 				argc, argv,
 				1, &result,
 				&error)) {
-
-		if (error_ctx) {
-			rv = error_ctx->handler(error_ctx, &error);
-			if (rv > 0) {
-				ni_warn("Whaaah. Error context handler returns positive code. "
-					"Assuming programmer mistake");
-				rv = -rv;
-			}
-		} else {
-			ni_dbus_print_error(&error, "%s.%s() failed", service->name, method->name);
-			rv = ni_dbus_get_error(&error, NULL);
-		}
+		rv = ni_call_device_method_error(service, method, &error, error_ctx);
 	} else {
 		if (callback_list)
 			*callback_list = ni_objectmodel_callback_info_from_dict(&result);
@@ -408,6 +422,79 @@ out:
 	return rv;
 }
 
+/*
+ * Asynchronous variant of ni_call_common_xml: the call is sent out and
+ * the reply passed to the callback, which is expected to use
+ * ni_call_common_xml_reply to obtain the result.
+ *
+ * Errors in the reply are reported as ni_call_common_xml does, except
+ * for AuthInfoMissing, which is returned to the caller unhandled: the
+ * error handler prompts for the missing info, which takes the retry
+ * loop of ni_call_common_xml to resend the call with.
+ */
+int
+ni_call_common_xml_async(ni_dbus_object_t *object, const ni_dbus_service_t *service,
+			const ni_dbus_method_t *method, xml_node_t *config,
+			ni_dbus_async_callback_t *callback)
+{
+	ni_dbus_variant_t argv[1];
+	int rv, argc = 0;
+
+	memset(argv, 0, sizeof(argv));
+	if (ni_dbus_xml_method_num_args(method)) {
+		ni_dbus_variant_t *dict = &argv[argc++];
+
+		ni_dbus_variant_init_dict(dict);
+		if (config && !ni_dbus_xml_serialize_arg(method, 0, dict, config)) {
+			ni_error("%s.%s: error serializing argument", service->name, method->name);
+			rv = -NI_ERROR_CANNOT_MARSHAL;
+			goto out;
+		}
+	}
+
+	rv = ni_dbus_object_call_variant_async(object, service->name, method->name,
+						argc, argv, callback);
+
+out:
+	while (argc--)
+		ni_dbus_variant_destroy(&argv[argc]);
+	return rv;
+}
+
+int
+ni_call_common_xml_reply(const ni_dbus_service_t *service, const ni_dbus_method_t *method,
+			ni_dbus_message_t *reply, ni_objectmodel_callback_info_t **callback_list,
+			ni_call_error_handler_t *error_handler)
+{
+	ni_call_error_context_t error_context = NI_CALL_ERROR_CONTEXT_INIT(error_handler, NULL);
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	int rv = 0;
+
+	if (!reply) {
+		rv = -NI_ERROR_DBUS_CALL_FAILED;
+	} else
+	if (dbus_set_error_from_message(&error, reply)) {
+		rv = ni_dbus_get_error(&error, NULL);
+		if (!error_handler || rv != -NI_ERROR_AUTH_INFO_MISSING) {
+			rv = ni_call_device_method_error(service, method, &error,
+					error_handler ? &error_context : NULL);
+		}
+	} else
+	if (ni_dbus_message_get_args_variants(reply, &result, 1) < 0) {
+		ni_error("%s.%s: unable to parse response", service->name, method->name);
+		rv = -NI_ERROR_DBUS_CALL_FAILED;
+	} else
+	if (callback_list) {
+		*callback_list = ni_objectmodel_callback_info_from_dict(&result);
+	}
+
+	ni_call_error_context_destroy(&error_context);
+	ni_dbus_variant_destroy(&result);
+	dbus_error_free(&error);
+	return rv;
+}
+
 static int
 ni_get_device_method(ni_dbus_object_t *object, const char *method_name, const ni_dbus_service_t **service_ret, const ni_dbus_method_t **method_ret)
 {
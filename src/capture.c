@@ -24,10 +24,12 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -46,6 +48,7 @@
 #include "socket_priv.h"
 #include "modprobe.h"
 #include "buffer.h"
+#include "appconfig.h"
 
 #define MTU_MAX			1500
 #define DHCP_CLIENT_PORT	68
@@ -57,6 +60,22 @@
 #define	AFPACKET_MODULE_NAME	"af_packet"
 #define AFPACKET_MODULE_OPTS	NULL
 
+/*
+ * A TPACKET_V3 receive ring shared by the captures of all devices
+ * needs the block status flags and the ifindex BPF extension.
+ */
+#if defined(PACKET_RX_RING) && defined(TP_STATUS_BLK_TMO) && defined(SKF_AD_IFINDEX)
+# define NI_CAPTURE_RING	1
+#endif
+
+#define NI_CAPTURE_RING_BLOCK_SIZE	(1U << 16)
+#define NI_CAPTURE_RING_BLOCK_NR	8
+#define NI_CAPTURE_RING_FRAME_SIZE	(1U << 11)
+#define NI_CAPTURE_RING_RETIRE_TOV	10	/* msec */
+#define NI_CAPTURE_RING_CHUNK		16
+
+#define NI_CAPTURE_TXQ_BATCH		64
+
 /* in case we have old headers files */
 #if defined(PACKET_AUXDATA) && !defined(HAVE_STRUCT_TPACKET_AUXDATA)
 struct tpacket_auxdata {
@@ -113,8 +132,13 @@ typedef union ni_packetaddr {
 /*
  * Platform specific
  */
+typedef struct ni_capture_ring	ni_capture_ring_t;
+typedef struct ni_capture_txq	ni_capture_txq_t;
+
 struct ni_capture {
 	ni_socket_t *		sock;
+	ni_capture_ring_t *	ring;
+	ni_capture_txq_t *	txq;
 	ni_packetaddr_t		addr;
 	int			protocol;
 
@@ -132,6 +156,33 @@ struct ni_capture {
 	void *			user_data;
 };
 
+/*
+ * The shared receive ring: one packet socket bound to all devices,
+ * demultiplexing the frames to the captures by ifindex.
+ */
+struct ni_capture_ring {
+	unsigned int		refcount;
+	ni_socket_t *		sock;
+	uint8_t			ip_protocol;
+	uint16_t		ip_port;
+
+	unsigned char *		map;
+	unsigned int		block;
+
+	/* captures, sorted by ifindex */
+	unsigned int		count;
+	ni_capture_t **		data;
+
+	/* frame currently passed to a capture receive callback */
+	struct {
+		ni_capture_t *		capture;
+		void *			data;
+		size_t			len;
+		ni_bool_t		partial_csum;
+		const struct sockaddr_ll *from;
+	} frame;
+};
+
 static int		ni_capture_set_filter(ni_capture_t *, const ni_capture_protinfo_t *);
 static ssize_t		__ni_capture_send(const ni_capture_t *, const ni_buffer_t *);
 
@@ -492,16 +543,43 @@ ni_capture_from_hwaddr_print(const ni_sockaddr_t *from)
 	return ni_link_address_print(&hwaddr);
 }
 
+/*
+ * Pass the frame the shared ring is dispatching to the capture,
+ * without copying it out of the ring.
+ */
+static ssize_t
+__ni_capture_ring_recv(ni_capture_t *capture, void **data, ni_bool_t *partial_csum, ni_sockaddr_t *from)
+{
+	ni_capture_ring_t *ring = capture->ring;
+
+	if (ring->frame.capture != capture) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if (from) {
+		memset(from, 0, sizeof(*from));
+		memcpy(&from->ss, ring->frame.from, sizeof(*ring->frame.from));
+	}
+	*partial_csum = ring->frame.partial_csum;
+	*data = ring->frame.data;
+	return ring->frame.len;
+}
+
 int
 ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp, ni_sockaddr_t *from, const char *hint)
 {
+	void *data = capture->buffer;
 	void *payload;
 	size_t payload_len;
 	ssize_t bytes;
 	ni_bool_t partial_checksum = FALSE;
 	const char *lladdr;
 
-	bytes = __ni_capture_recv(capture->sock->__fd, capture->buffer,
+	if (capture->ring)
+		bytes = __ni_capture_ring_recv(capture, &data, &partial_checksum, from);
+	else
+		bytes = __ni_capture_recv(capture->sock->__fd, capture->buffer,
 				  capture->mtu, &partial_checksum, from);
 
 	if (bytes < 0) {
@@ -520,7 +598,7 @@ ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp, ni_sockaddr_t *from, con
 	switch (capture->protocol) {
 	case ETHERTYPE_IP:
 		/* Make sure IP and UDP header are sane */
-		payload = ni_capture_inspect_udp_header(capture->buffer, bytes,
+		payload = ni_capture_inspect_udp_header(data, bytes,
 						&payload_len, partial_checksum);
 		if (payload == NULL) {
 			ni_debug_socket("%s: bad IP/UDP %s%spacket header",
@@ -532,7 +610,7 @@ ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp, ni_sockaddr_t *from, con
 
 	case ETHERTYPE_ARP:
 	case ETHERTYPE_LLDP:
-		payload = capture->buffer;
+		payload = data;
 		payload_len = bytes;
 		break;
 
@@ -674,13 +752,606 @@ __ni_capture_init_once(void)
 	ni_modprobe(AFPACKET_MODULE_NAME, AFPACKET_MODULE_OPTS);
 }
 
+/*
+ * Transmit queue
+ *
+ * Packets sent in one main loop iteration, e.g. the ARP probes for all
+ * addresses of all devices after a link-up storm, are collected in the
+ * queue and flushed with sendmmsg on one unbound packet socket, using
+ * the capture link-layer address of each packet as its destination.
+ * The flush is triggered by POLLOUT on the queue socket, that is, by
+ * the next socket wait.
+ */
+typedef struct ni_capture_txq_packet {
+	ni_packetaddr_t		addr;
+	size_t			len;
+	unsigned char *		data;
+} ni_capture_txq_packet_t;
+
+struct ni_capture_txq {
+	ni_socket_t *		sock;
+
+	unsigned int		count;
+	unsigned int		size;
+	ni_capture_txq_packet_t *data;
+
+	ni_capture_txq_stats_t	stats;
+};
+
+static ni_capture_txq_t *	ni_capture_default_txq;
+
+static void
+ni_capture_txq_flush(ni_capture_txq_t *txq)
+{
+	struct mmsghdr msgs[NI_CAPTURE_TXQ_BATCH];
+	struct iovec iovs[NI_CAPTURE_TXQ_BATCH];
+	ni_capture_txq_packet_t *pkt;
+	unsigned int i, n, done;
+	int rv;
+
+	if (!txq->count)
+		return;
+
+	txq->stats.flushes++;
+	for (done = 0; done < txq->count; ) {
+		n = txq->count - done;
+		if (n > NI_CAPTURE_TXQ_BATCH)
+			n = NI_CAPTURE_TXQ_BATCH;
+
+		memset(msgs, 0, n * sizeof(msgs[0]));
+		for (i = 0; i < n; ++i) {
+			pkt = &txq->data[done + i];
+			iovs[i].iov_base = pkt->data;
+			iovs[i].iov_len = pkt->len;
+			msgs[i].msg_hdr.msg_name = &pkt->addr.sa;
+			msgs[i].msg_hdr.msg_namelen = sizeof(pkt->addr);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		txq->stats.syscalls++;
+		rv = sendmmsg(txq->sock->__fd, msgs, n, 0);
+		if (rv <= 0) {
+			if (rv < 0 && errno == EINTR)
+				continue;
+
+			/* Report and drop the packet the batch stopped at */
+			pkt = &txq->data[done];
+			ni_error("unable to send packet on ifindex %d: %m",
+					pkt->addr.sll.sll_ifindex);
+			txq->stats.failed++;
+			done++;
+			continue;
+		}
+
+		txq->stats.sent += rv;
+		done += rv;
+	}
+
+	if (txq->stats.max_batch < txq->count)
+		txq->stats.max_batch = txq->count;
+
+	ni_debug_socket("capture txq: flushed %u packets; total %lu queued, %lu sent, "
+			"%lu failed, %lu flushes, %lu syscalls, max batch %u",
+			txq->count, txq->stats.queued, txq->stats.sent,
+			txq->stats.failed, txq->stats.flushes, txq->stats.syscalls,
+			txq->stats.max_batch);
+
+	for (i = 0; i < txq->count; ++i)
+		free(txq->data[i].data);
+	txq->count = 0;
+
+	ni_socket_set_poll_flags(txq->sock, 0);
+}
+
+static void
+ni_capture_txq_transmit(ni_socket_t *sock)
+{
+	ni_capture_txq_flush(sock->user_data);
+}
+
+static ni_capture_txq_t *
+ni_capture_txq_get(void)
+{
+	ni_capture_txq_t *txq;
+	int fd;
+
+	if ((txq = ni_capture_default_txq) != NULL)
+		return txq->sock ? txq : NULL;
+
+	txq = xcalloc(1, sizeof(*txq));
+	ni_capture_default_txq = txq;
+
+	/* Protocol 0: the socket is used to send only */
+	if ((fd = socket(PF_PACKET, SOCK_DGRAM, 0)) < 0) {
+		ni_warn("unable to create capture transmit queue socket: %m");
+		return NULL;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	txq->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+	txq->sock->transmit = ni_capture_txq_transmit;
+	txq->sock->user_data = txq;
+	if (!ni_socket_activate(txq->sock)) {
+		ni_socket_close(txq->sock);
+		txq->sock = NULL;
+		return NULL;
+	}
+	ni_socket_set_poll_flags(txq->sock, 0);
+	return txq;
+}
+
+static ssize_t
+ni_capture_txq_send(ni_capture_txq_t *txq, const ni_capture_t *capture, const ni_buffer_t *buf)
+{
+	ni_capture_txq_packet_t *pkt;
+	size_t len = ni_buffer_count(buf);
+
+	if (txq->count == txq->size) {
+		txq->size += NI_CAPTURE_TXQ_BATCH;
+		txq->data = xrealloc(txq->data, txq->size * sizeof(txq->data[0]));
+	}
+
+	pkt = &txq->data[txq->count++];
+	pkt->addr = capture->addr;
+	pkt->len = len;
+	pkt->data = xmalloc(len ? len : 1);
+	memcpy(pkt->data, ni_buffer_head(buf), len);
+	txq->stats.queued++;
+
+	/* Without main loop, there's nobody to flush the queue later */
+	if (!txq->sock->active)
+		ni_capture_txq_flush(txq);
+	else
+		ni_socket_set_poll_flags(txq->sock, POLLOUT);
+	return len;
+}
+
+/*
+ * Statistics of the transmit queue of a capture, or of the
+ * default queue when no capture is given.
+ */
+const ni_capture_txq_stats_t *
+ni_capture_txq_stats(const ni_capture_t *capture)
+{
+	const ni_capture_txq_t *txq;
+
+	txq = capture ? capture->txq : ni_capture_default_txq;
+	return txq ? &txq->stats : NULL;
+}
+
+/*
+ * Open a packet socket bound to the device
+ */
+static ni_bool_t
+ni_capture_socket_open(ni_capture_t *capture, const ni_capture_devinfo_t *devinfo,
+			const ni_capture_protinfo_t *protinfo)
+{
+	ni_packetaddr_t	addr;
+	int fd;
+
+	if ((fd = socket (PF_PACKET, SOCK_DGRAM, htons(protinfo->eth_protocol))) < 0) {
+		ni_error("socket: %m");
+		return FALSE;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	capture->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+	if (ni_capture_set_filter(capture, protinfo) < 0)
+		return FALSE;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sll.sll_family = PF_PACKET;
+	addr.sll.sll_protocol = htons(protinfo->eth_protocol);
+	addr.sll.sll_ifindex = devinfo->ifindex;
+
+	if (bind(fd, &addr.sa, sizeof(addr)) == -1) {
+		ni_error("bind: %m");
+		return FALSE;
+	}
+
+	__ni_capture_enable_packet_auxdata(fd);
+
+	capture->buffer = xmalloc(capture->mtu);
+	return TRUE;
+}
+
+/*
+ * Shared receive ring
+ *
+ * Instead of a packet socket per device, the captures of all devices
+ * using the same IP protocol and port share one packet socket with a
+ * mmap'ed TPACKET_V3 receive ring. Its BPF filter combines the protocol
+ * check with a match on the ifindex of the attached devices. The frames
+ * are demultiplexed by ifindex and passed to the capture receive
+ * callbacks directly from the ring.
+ * When the ring cannot be set up, we fall back to a socket per device.
+ */
+#ifdef NI_CAPTURE_RING
+static ni_capture_ring_t *	ni_capture_shared_ring;
+
+static void			ni_capture_ring_release(ni_capture_ring_t *);
+
+static ni_capture_ring_t *
+ni_capture_ring_hold(ni_capture_ring_t *ring)
+{
+	ni_assert(ring && ring->refcount);
+	ring->refcount++;
+	return ring;
+}
+
+static unsigned int
+ni_capture_ring_index(const ni_capture_ring_t *ring, unsigned int ifindex)
+{
+	unsigned int lo = 0, hi = ring->count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ring->data[mid]->addr.sll.sll_ifindex < (int)ifindex)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static ni_capture_t *
+ni_capture_ring_find(const ni_capture_ring_t *ring, unsigned int ifindex)
+{
+	unsigned int i = ni_capture_ring_index(ring, ifindex);
+
+	if (i < ring->count && ring->data[i]->addr.sll.sll_ifindex == (int)ifindex)
+		return ring->data[i];
+	return NULL;
+}
+
+/*
+ * Build the DHCP filter, extended to accept the attached devices only.
+ * Above the BPF program size limit, the ifindex match is omitted and
+ * frames of other devices are dropped in the demultiplexer.
+ */
+static int
+ni_capture_ring_set_filter(ni_capture_ring_t *ring)
+{
+	struct sock_filter *insn, *filter;
+	struct sock_fprog pf;
+	unsigned int i, len, max = (BPF_MAXINSNS - 10) / 2;
+	int ret;
+
+	filter = xcalloc(10 + 2 * ring->count, sizeof(*filter));
+	insn = filter;
+
+	/* Make sure it's a UDP packet and not a fragment ... */
+	*insn++ = (struct sock_filter) BPF_STMT(BPF_LD + BPF_B + BPF_ABS, 9);
+	*insn++ = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ring->ip_protocol, 0, 5);
+	*insn++ = (struct sock_filter) BPF_STMT(BPF_LD + BPF_H + BPF_ABS, 6);
+	*insn++ = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JSET + BPF_K, 0x1fff, 3, 0);
+
+	/* ... to the right port ... */
+	*insn++ = (struct sock_filter) BPF_STMT(BPF_LDX + BPF_B + BPF_MSH, 0);
+	*insn++ = (struct sock_filter) BPF_STMT(BPF_LD + BPF_H + BPF_IND, 2);
+	*insn++ = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ring->ip_port, 1, 0);
+	*insn++ = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, 0);
+
+	/* ... and received on one of our devices */
+	if (ring->count <= max) {
+		*insn++ = (struct sock_filter) BPF_STMT(BPF_LD + BPF_W + BPF_ABS,
+						SKF_AD_OFF + SKF_AD_IFINDEX);
+		for (i = 0; i < ring->count; ++i) {
+			*insn++ = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K,
+						ring->data[i]->addr.sll.sll_ifindex, 0, 1);
+			*insn++ = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, ~0U);
+		}
+		*insn++ = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, 0);
+	} else {
+		*insn++ = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, ~0U);
+	}
+	len = insn - filter;
+
+	memset(&pf, 0, sizeof(pf));
+	pf.filter = filter;
+	pf.len = len;
+	ret = setsockopt(ring->sock->__fd, SOL_SOCKET, SO_ATTACH_FILTER, &pf, sizeof(pf));
+	if (ret < 0)
+		ni_error("shared capture ring: SO_ATTACH_FILTER: %m");
+
+	free(filter);
+	return ret;
+}
+
+/*
+ * Pass a frame to the capture of the device it has been received on
+ */
+static void
+ni_capture_ring_dispatch(ni_capture_ring_t *ring, struct tpacket3_hdr *hdr)
+{
+	const struct sockaddr_ll *sll;
+	ni_capture_t *capture;
+	ni_socket_t *sock;
+
+	sll = (const void *)((unsigned char *)hdr + TPACKET_ALIGN(sizeof(*hdr)));
+	if (!(capture = ni_capture_ring_find(ring, sll->sll_ifindex)))
+		return;
+
+	if (!(sock = capture->sock) || !sock->receive)
+		return;
+
+	ring->frame.capture = capture;
+	ring->frame.data = (unsigned char *)hdr + hdr->tp_net;
+	ring->frame.len = hdr->tp_snaplen;
+	ring->frame.partial_csum = !!(hdr->tp_status & TP_STATUS_CSUMNOTREADY);
+	ring->frame.from = sll;
+
+	/* The callback may free the capture, but not the socket or ring */
+	ni_socket_hold(sock);
+	sock->receive(sock);
+	ni_socket_release(sock);
+
+	memset(&ring->frame, 0, sizeof(ring->frame));
+}
+
+static void
+ni_capture_ring_recv(ni_socket_t *sock)
+{
+	ni_capture_ring_t *ring = sock->user_data;
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *hdr;
+	unsigned int i;
+
+	ni_capture_ring_hold(ring);
+	while (ring->map) {
+		bd = (void *)(ring->map + ring->block * NI_CAPTURE_RING_BLOCK_SIZE);
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+			break;
+		__sync_synchronize();
+
+		hdr = (void *)((unsigned char *)bd + bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < bd->hdr.bh1.num_pkts; ++i) {
+			ni_capture_ring_dispatch(ring, hdr);
+			hdr = (void *)((unsigned char *)hdr + hdr->tp_next_offset);
+		}
+
+		/* Hand the block back to the kernel */
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		ring->block = (ring->block + 1) % NI_CAPTURE_RING_BLOCK_NR;
+	}
+	ni_capture_ring_release(ring);
+}
+
+/*
+ * On socket errors, invalidate the captures, so they get reopened
+ * using a new ring.
+ */
+static void
+ni_capture_ring_error(ni_socket_t *sock)
+{
+	ni_capture_ring_t *ring = sock->user_data;
+	unsigned int i;
+
+	ni_error("shared capture ring: socket error, invalidating %u captures",
+			ring->count);
+
+	if (ni_capture_shared_ring == ring)
+		ni_capture_shared_ring = NULL;
+
+	sock->error = 1;
+	for (i = 0; i < ring->count; ++i) {
+		if (ring->data[i]->sock)
+			ring->data[i]->sock->error = 1;
+	}
+}
+
+static ni_capture_ring_t *
+ni_capture_ring_new(const ni_capture_protinfo_t *protinfo)
+{
+	struct tpacket_req3 req;
+	ni_packetaddr_t addr;
+	ni_capture_ring_t *ring;
+	int version = TPACKET_V3;
+	size_t size;
+	void *map;
+	int fd;
+
+	/* Bind to the protocol after the filter is set up, so
+	 * nothing is queued to the ring before */
+	if ((fd = socket(PF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
+		ni_debug_socket("shared capture ring: socket: %m");
+		return NULL;
+	}
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		ni_debug_socket("shared capture ring: TPACKET_V3 not supported: %m");
+		close(fd);
+		return NULL;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = NI_CAPTURE_RING_BLOCK_SIZE;
+	req.tp_block_nr = NI_CAPTURE_RING_BLOCK_NR;
+	req.tp_frame_size = NI_CAPTURE_RING_FRAME_SIZE;
+	req.tp_frame_nr = NI_CAPTURE_RING_BLOCK_SIZE / NI_CAPTURE_RING_FRAME_SIZE
+			* NI_CAPTURE_RING_BLOCK_NR;
+	req.tp_retire_blk_tov = NI_CAPTURE_RING_RETIRE_TOV;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		ni_debug_socket("shared capture ring: PACKET_RX_RING: %m");
+		close(fd);
+		return NULL;
+	}
+
+	size = (size_t)NI_CAPTURE_RING_BLOCK_SIZE * NI_CAPTURE_RING_BLOCK_NR;
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ni_debug_socket("shared capture ring: mmap: %m");
+		close(fd);
+		return NULL;
+	}
+
+	ring = xcalloc(1, sizeof(*ring));
+	ring->refcount = 1;
+	ring->map = map;
+	ring->ip_protocol = protinfo->ip_protocol;
+	ring->ip_port = protinfo->ip_port;
+	ring->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+
+	if (ni_capture_ring_set_filter(ring) < 0)
+		goto failed;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sll.sll_family = PF_PACKET;
+	addr.sll.sll_protocol = htons(protinfo->eth_protocol);
+	if (bind(fd, &addr.sa, sizeof(addr)) < 0) {
+		ni_error("shared capture ring: bind: %m");
+		goto failed;
+	}
+
+	ring->sock->receive = ni_capture_ring_recv;
+	ring->sock->handle_error = ni_capture_ring_error;
+	ring->sock->user_data = ring;
+	ni_socket_activate(ring->sock);
+
+	ni_debug_socket("shared capture ring: %u blocks of %u bytes",
+			NI_CAPTURE_RING_BLOCK_NR, NI_CAPTURE_RING_BLOCK_SIZE);
+	return ring;
+
+failed:
+	ni_capture_ring_release(ring);
+	return NULL;
+}
+
+static void
+ni_capture_ring_release(ni_capture_ring_t *ring)
+{
+	ni_assert(ring && ring->refcount);
+	if (--ring->refcount)
+		return;
+
+	if (ni_capture_shared_ring == ring)
+		ni_capture_shared_ring = NULL;
+
+	ni_assert(ring->count == 0);
+	free(ring->data);
+
+	if (ring->map) {
+		munmap(ring->map, (size_t)NI_CAPTURE_RING_BLOCK_SIZE * NI_CAPTURE_RING_BLOCK_NR);
+		ring->map = NULL;
+	}
+	if (ring->sock) {
+		ring->sock->user_data = NULL;
+		ni_socket_close(ring->sock);
+		ring->sock = NULL;
+	}
+	free(ring);
+}
+
+/*
+ * Attach a capture to the shared ring, creating it if needed
+ */
+static ni_bool_t
+ni_capture_ring_attach(ni_capture_t *capture, const ni_capture_protinfo_t *protinfo)
+{
+	ni_capture_ring_t *ring;
+	unsigned int i;
+
+	if (protinfo->eth_protocol != ETHERTYPE_IP
+	 || ni_config_capture_backend() != NI_CONFIG_CAPTURE_BACKEND_RING)
+		return FALSE;
+
+	if ((ring = ni_capture_shared_ring) != NULL) {
+		if (ring->ip_protocol != protinfo->ip_protocol
+		 || ring->ip_port != protinfo->ip_port)
+			return FALSE;
+		ni_capture_ring_hold(ring);
+	} else {
+		if (!(ring = ni_capture_ring_new(protinfo))) {
+			ni_debug_socket("%s: shared capture ring unavailable, using a socket",
+					capture->ifname);
+			return FALSE;
+		}
+		ni_capture_shared_ring = ring;
+	}
+
+	i = ni_capture_ring_index(ring, capture->addr.sll.sll_ifindex);
+	if (i < ring->count && ring->data[i]->addr.sll.sll_ifindex == capture->addr.sll.sll_ifindex) {
+		ni_debug_socket("%s: ifindex %d already attached to shared capture ring",
+				capture->ifname, capture->addr.sll.sll_ifindex);
+		ni_capture_ring_release(ring);
+		return FALSE;
+	}
+
+	if ((ring->count % NI_CAPTURE_RING_CHUNK) == 0)
+		ring->data = xrealloc(ring->data, (ring->count + NI_CAPTURE_RING_CHUNK) *
+					sizeof(ring->data[0]));
+	memmove(&ring->data[i + 1], &ring->data[i], (ring->count - i) * sizeof(ring->data[0]));
+	ring->data[i] = capture;
+	ring->count++;
+
+	if (ni_capture_ring_set_filter(ring) < 0) {
+		ring->count--;
+		memmove(&ring->data[i], &ring->data[i + 1], (ring->count - i) * sizeof(ring->data[0]));
+		ni_capture_ring_release(ring);
+		return FALSE;
+	}
+
+	/* The capture socket has no fd, it's just used for the
+	 * receive callback and the retransmit timeouts. */
+	capture->sock = ni_socket_wrap(-1, SOCK_DGRAM);
+	capture->ring = ring;
+	return TRUE;
+}
+
+static void
+ni_capture_ring_detach(ni_capture_t *capture)
+{
+	ni_capture_ring_t *ring;
+	unsigned int i;
+
+	if (!(ring = capture->ring))
+		return;
+	capture->ring = NULL;
+
+	if (ring->frame.capture == capture)
+		memset(&ring->frame, 0, sizeof(ring->frame));
+
+	i = ni_capture_ring_index(ring, capture->addr.sll.sll_ifindex);
+	if (i < ring->count && ring->data[i] == capture) {
+		ring->count--;
+		memmove(&ring->data[i], &ring->data[i + 1], (ring->count - i) * sizeof(ring->data[0]));
+		if (ring->count && !ring->sock->error)
+			ni_capture_ring_set_filter(ring);
+	}
+	ni_capture_ring_release(ring);
+}
+
+static inline int
+ni_capture_ring_fd(const ni_capture_t *capture)
+{
+	return capture->ring->sock->__fd;
+}
+#else
+static inline ni_bool_t
+ni_capture_ring_attach(ni_capture_t *capture, const ni_capture_protinfo_t *protinfo)
+{
+	return FALSE;
+}
+
+static inline void
+ni_capture_ring_detach(ni_capture_t *capture)
+{
+}
+
+static inline int
+ni_capture_ring_fd(const ni_capture_t *capture)
+{
+	return -1;
+}
+#endif
+
 ni_capture_t *
 ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
 {
-	ni_packetaddr_t	addr;
 	ni_capture_t *capture = NULL;
 	ni_hwaddr_t destaddr;
-	int fd = -1;
 
 	if (devinfo->ifindex == 0) {
 		ni_error("no ifindex for interface `%s'", devinfo->ifname);
@@ -702,17 +1373,10 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 
 	__ni_capture_init_once();
 
-	if ((fd = socket (PF_PACKET, SOCK_DGRAM, htons(protinfo->eth_protocol))) < 0) {
-		ni_error("socket: %m");
-		return NULL;
-	}
-	fcntl(fd, F_SETFD, FD_CLOEXEC);
-
 	capture = calloc(1, sizeof(*capture));
 	if (!capture)
 		goto failed;
 	ni_string_dup(&capture->ifname, devinfo->ifname);
-	capture->sock = ni_socket_wrap(fd, SOCK_DGRAM);
 	capture->protocol = protinfo->eth_protocol;
 
 	capture->addr.sll.sll_family = AF_PACKET;
@@ -722,25 +1386,15 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 	capture->addr.sll.sll_halen = destaddr.len;
 	memcpy(&capture->addr.sll.sll_addr, destaddr.data, destaddr.len);
 
-	if (ni_capture_set_filter(capture, protinfo) < 0)
-		goto failed;
-
-	memset(&addr, 0, sizeof(addr));
-	addr.sll.sll_family = PF_PACKET;
-	addr.sll.sll_protocol = htons(protinfo->eth_protocol);
-	addr.sll.sll_ifindex = devinfo->ifindex;
-
-	if (bind(fd, &addr.sa, sizeof(addr)) == -1) {
-		ni_error("bind: %m");
-		goto failed;
-	}
-
-	__ni_capture_enable_packet_auxdata(fd);
-
 	capture->mtu = devinfo->mtu;
 	if (capture->mtu == 0)
 		capture->mtu = MTU_MAX;
-	capture->buffer = xmalloc(capture->mtu);
+
+	if (!ni_capture_ring_attach(capture, protinfo)
+	 && !ni_capture_socket_open(capture, devinfo, protinfo))
+		goto failed;
+
+	capture->txq = ni_capture_txq_get();
 
 	capture->sock->receive = receive;
 	capture->sock->get_timeout = __ni_capture_socket_get_timeout;
@@ -751,8 +1405,6 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 
 failed:
 	ni_capture_free(capture);
-	if (fd >= 0)
-		close(fd);
 	return NULL;
 }
 
@@ -809,7 +1461,11 @@ __ni_capture_send(const ni_capture_t *capture, const ni_buffer_t *buf)
 		return -1;
 	}
 
-	rv = sendto(capture->sock->__fd, ni_buffer_head(buf), ni_buffer_count(buf), 0,
+	if (capture->txq)
+		return ni_capture_txq_send(capture->txq, capture, buf);
+
+	rv = sendto(capture->ring ? ni_capture_ring_fd(capture) : capture->sock->__fd,
+			ni_buffer_head(buf), ni_buffer_count(buf), 0,
 			&capture->addr.sa, sizeof(capture->addr));
 	if (rv < 0)
 		ni_error("unable to send dhcp packet: %m");
@@ -838,6 +1494,9 @@ ni_capture_free(ni_capture_t *capture)
 {
 	if (!capture)
 		return;
+	if (capture->txq)
+		ni_capture_txq_flush(capture->txq);
+	ni_capture_ring_detach(capture);
 	if (capture->sock)
 		ni_socket_close(capture->sock);
 	if (capture->buffer)
@@ -22,8 +22,10 @@
 #include <wicked/socket.h>	/* for ni_timer_get_time()  */
 #include <wicked/netinfo.h>	/* for ni_config_statedir() */
 #include <wicked/logging.h>
+#include <wicked/objectmodel.h>
 
 #include "client/client_state.h"
+#include "client/ifconfig.h"
 #include "util_priv.h"
 
 /*
@@ -557,6 +559,14 @@ ni_bool_t
 ni_client_state_drop(unsigned int ifindex)
 {
 	char path[PATH_MAX] = {'\0'};
+	ni_client_state_t *cs;
+
+	/* the applied config is referred to by this state only */
+	if ((cs = ni_client_state_new(0))) {
+		if (ni_client_state_load(cs, ifindex) && !ni_uuid_is_null(&cs->config.uuid))
+			ni_ifconfig_applied_remove(&cs->config.uuid);
+		ni_client_state_free(cs);
+	}
 
 	ni_client_state_filename(ifindex, path, sizeof(path));
 
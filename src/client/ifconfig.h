@@ -64,6 +64,7 @@ extern ni_bool_t		ni_ifpolicy_match_add_link_type(xml_node_t *, unsigned int);
 extern xml_node_t *		ni_ifpolicy_generate_match(const ni_string_array_t *, const char *);
 extern ni_bool_t		ni_ifpolicy_name_is_valid(const char *);
 extern char *			ni_ifpolicy_name_from_ifname(const char *);
+extern char *			ni_ifpolicy_name_to_ifname(const char *);
 
 extern xml_node_t *		ni_convert_cfg_into_policy_node(const xml_node_t *, xml_node_t *, const char *, const char*);
 extern xml_document_t *	ni_convert_cfg_into_policy_doc(xml_document_t *);
@@ -83,6 +84,45 @@ extern ni_bool_t		ni_nanny_call_recheck(const ni_string_array_t *);
 
 extern ni_bool_t		ni_ifconfig_generate_uuid(const xml_node_t *, ni_uuid_t *);
 
+/*
+ * Structural diff of an applied and a new interface config.
+ *
+ * The changes are reported per element path (e.g. ipv4:static/route)
+ * with the top level element as the changed subsystem.
+ */
+typedef enum {
+	NI_IFCONFIG_DIFF_ADDED,
+	NI_IFCONFIG_DIFF_REMOVED,
+	NI_IFCONFIG_DIFF_MODIFIED,
+} ni_ifconfig_diff_type_t;
+
+typedef enum {
+	NI_IFCONFIG_RELOAD_NONE = 0,		/* nothing to apply		*/
+	NI_IFCONFIG_RELOAD_IN_PLACE,		/* apply by an ifup run		*/
+	NI_IFCONFIG_RELOAD_FULL,		/* ifdown and ifup the device	*/
+} ni_ifconfig_reload_t;
+
+typedef struct ni_ifconfig_diff {
+	ni_ifconfig_diff_type_t	type;
+	const char *		subsystem;
+	const char *		path;
+	const xml_node_t *	old;
+	const xml_node_t *	new;
+} ni_ifconfig_diff_t;
+
+typedef ni_bool_t		ni_ifconfig_diff_fn_t(const ni_ifconfig_diff_t *, void *);
+
+extern ni_bool_t		ni_ifconfig_diff(const xml_node_t *, const xml_node_t *,
+						ni_ifconfig_diff_fn_t *, void *);
+extern const char *		ni_ifconfig_diff_type_to_name(ni_ifconfig_diff_type_t);
+extern ni_ifconfig_reload_t	ni_ifconfig_diff_reload(const ni_ifconfig_diff_t *);
+extern ni_ifconfig_reload_t	ni_ifconfig_reload_mode(const xml_node_t *, const xml_node_t *,
+						ni_string_array_t *);
+
+extern ni_bool_t		ni_ifconfig_applied_save(const ni_uuid_t *, const xml_node_t *);
+extern xml_node_t *		ni_ifconfig_applied_load(const ni_uuid_t *);
+extern void			ni_ifconfig_applied_remove(const ni_uuid_t *);
+
 static inline ni_bool_t
 ni_ifconfig_is_config(xml_node_t *ifnode)
 {
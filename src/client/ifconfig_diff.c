@@ -0,0 +1,516 @@
+/*
+ *	wicked client interface config diff and applied config store
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/objectmodel.h>
+#include <wicked/fsm.h>
+#include <wicked/xml.h>
+
+#include "client/ifconfig.h"
+#include "appconfig.h"
+#include "util_priv.h"
+
+#define NI_IFCONFIG_APPLIED_DIR		"ifconfig"
+#define NI_IFCONFIG_DIFF_MD_SIZE	20	/* sha1 */
+
+typedef struct ni_ifconfig_diff_walk {
+	ni_ifconfig_diff_fn_t *	func;
+	void *			user_data;
+
+	ni_stringbuf_t		path;
+	char *			subsystem;
+} ni_ifconfig_diff_walk_t;
+
+typedef struct ni_ifconfig_diff_entry {
+	const xml_node_t *	node;
+	unsigned char		md[NI_IFCONFIG_DIFF_MD_SIZE];
+	ni_bool_t		hashed;
+	ni_bool_t		matched;
+} ni_ifconfig_diff_entry_t;
+
+static ni_bool_t	ni_ifconfig_diff_children(ni_ifconfig_diff_walk_t *,
+						const xml_node_t *, const xml_node_t *);
+
+static const ni_intmap_t	ni_ifconfig_diff_type_names[] = {
+	{ "added",		NI_IFCONFIG_DIFF_ADDED		},
+	{ "removed",		NI_IFCONFIG_DIFF_REMOVED	},
+	{ "modified",		NI_IFCONFIG_DIFF_MODIFIED	},
+	{ NULL,			0				}
+};
+
+const char *
+ni_ifconfig_diff_type_to_name(ni_ifconfig_diff_type_t type)
+{
+	return ni_format_uint_mapped(type, ni_ifconfig_diff_type_names);
+}
+
+static ni_bool_t
+ni_ifconfig_diff_hash(ni_ifconfig_diff_entry_t *entry)
+{
+	if (!entry->hashed) {
+		entry->hashed = xml_node_hash(entry->node, NI_HASHCTX_SHA1,
+				entry->md, sizeof(entry->md)) == sizeof(entry->md);
+	}
+	return entry->hashed;
+}
+
+static ni_bool_t
+ni_ifconfig_diff_hash_equal(ni_ifconfig_diff_entry_t *a, ni_ifconfig_diff_entry_t *b)
+{
+	return ni_ifconfig_diff_hash(a) && ni_ifconfig_diff_hash(b) &&
+		!memcmp(a->md, b->md, sizeof(a->md));
+}
+
+static ni_bool_t
+ni_ifconfig_diff_attrs_equal(const xml_node_t *a, const xml_node_t *b)
+{
+	const ni_var_t *var, *other;
+	unsigned int i;
+
+	if (a->attrs.count != b->attrs.count)
+		return FALSE;
+
+	for (i = 0; i < a->attrs.count; ++i) {
+		var = &a->attrs.data[i];
+		other = xml_node_get_attr_var(b, var->name);
+		if (!other || !ni_string_eq(var->value, other->value))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static size_t
+ni_ifconfig_diff_push(ni_ifconfig_diff_walk_t *walk, const char *name)
+{
+	size_t len = walk->path.len;
+
+	if (len)
+		ni_stringbuf_putc(&walk->path, '/');
+	else
+		ni_string_dup(&walk->subsystem, name);
+	ni_stringbuf_puts(&walk->path, name);
+	return len;
+}
+
+static void
+ni_ifconfig_diff_pop(ni_ifconfig_diff_walk_t *walk, size_t len)
+{
+	ni_stringbuf_truncate(&walk->path, len);
+	if (!len)
+		ni_string_free(&walk->subsystem);
+}
+
+static ni_bool_t
+ni_ifconfig_diff_emit(ni_ifconfig_diff_walk_t *walk, ni_ifconfig_diff_type_t type,
+		const xml_node_t *old, const xml_node_t *new)
+{
+	ni_ifconfig_diff_t diff;
+	ni_bool_t ret;
+	size_t len;
+
+	len = ni_ifconfig_diff_push(walk, old ? old->name : new->name);
+
+	diff.type = type;
+	diff.subsystem = walk->subsystem;
+	diff.path = walk->path.string;
+	diff.old = old;
+	diff.new = new;
+	ret = walk->func(&diff, walk->user_data);
+
+	ni_ifconfig_diff_pop(walk, len);
+	return ret;
+}
+
+static ni_bool_t
+ni_ifconfig_diff_node(ni_ifconfig_diff_walk_t *walk,
+		ni_ifconfig_diff_entry_t *old, ni_ifconfig_diff_entry_t *new)
+{
+	const xml_node_t *o = old->node;
+	const xml_node_t *n = new->node;
+	ni_bool_t ret;
+	size_t len;
+
+	/* the cdata is compared directly, the hash covers the rest */
+	if (!ni_string_eq(o->cdata, n->cdata) || !ni_ifconfig_diff_attrs_equal(o, n))
+		return ni_ifconfig_diff_emit(walk, NI_IFCONFIG_DIFF_MODIFIED, o, n);
+
+	if (!o->children && !n->children)
+		return TRUE;
+
+	if (ni_ifconfig_diff_hash_equal(old, new))
+		return TRUE;
+
+	len = ni_ifconfig_diff_push(walk, o->name);
+	ret = ni_ifconfig_diff_children(walk, o, n);
+	ni_ifconfig_diff_pop(walk, len);
+	return ret;
+}
+
+static unsigned int
+ni_ifconfig_diff_collect(const xml_node_t *parent, const char *name,
+		ni_ifconfig_diff_entry_t **entries)
+{
+	const xml_node_t *child;
+	unsigned int count = 0;
+
+	*entries = NULL;
+	if (!parent)
+		return 0;
+
+	for (child = parent->children; child; child = child->next) {
+		if (ni_string_eq(child->name, name))
+			count++;
+	}
+	if (!count)
+		return 0;
+
+	*entries = xcalloc(count, sizeof(**entries));
+	count = 0;
+	for (child = parent->children; child; child = child->next) {
+		if (ni_string_eq(child->name, name))
+			(*entries)[count++].node = child;
+	}
+	return count;
+}
+
+/*
+ * Compare the children with the same name.
+ *
+ * Repeated elements (addresses, routes, slaves, ...) are compared as
+ * a set: equal nodes are matched regardless of their position and a
+ * single remaining pair is compared as modified node, otherwise the
+ * remaining nodes are reported as removed and added.
+ */
+static ni_bool_t
+ni_ifconfig_diff_named(ni_ifconfig_diff_walk_t *walk, const xml_node_t *old,
+		const xml_node_t *new, const char *name)
+{
+	ni_ifconfig_diff_entry_t *oents, *nents;
+	unsigned int ocnt, ncnt, i, j;
+	unsigned int orest, nrest;
+	ni_bool_t ret = TRUE;
+
+	ocnt = ni_ifconfig_diff_collect(old, name, &oents);
+	ncnt = ni_ifconfig_diff_collect(new, name, &nents);
+
+	if (ocnt == 1 && ncnt == 1) {
+		ret = ni_ifconfig_diff_node(walk, &oents[0], &nents[0]);
+		goto done;
+	}
+
+	orest = ocnt;
+	nrest = ncnt;
+	for (i = 0; i < ocnt; ++i) {
+		for (j = 0; j < ncnt; ++j) {
+			if (nents[j].matched)
+				continue;
+			if (!ni_ifconfig_diff_hash_equal(&oents[i], &nents[j]))
+				continue;
+
+			oents[i].matched = nents[j].matched = TRUE;
+			orest--;
+			nrest--;
+			break;
+		}
+	}
+
+	if (orest == 1 && nrest == 1) {
+		for (i = 0; oents[i].matched; ++i)
+			;
+		for (j = 0; nents[j].matched; ++j)
+			;
+		ret = ni_ifconfig_diff_node(walk, &oents[i], &nents[j]);
+		goto done;
+	}
+
+	for (i = 0; ret && i < ocnt; ++i) {
+		if (!oents[i].matched)
+			ret = ni_ifconfig_diff_emit(walk, NI_IFCONFIG_DIFF_REMOVED,
+					oents[i].node, NULL);
+	}
+	for (j = 0; ret && j < ncnt; ++j) {
+		if (!nents[j].matched)
+			ret = ni_ifconfig_diff_emit(walk, NI_IFCONFIG_DIFF_ADDED,
+					NULL, nents[j].node);
+	}
+
+done:
+	free(oents);
+	free(nents);
+	return ret;
+}
+
+static ni_bool_t
+ni_ifconfig_diff_children(ni_ifconfig_diff_walk_t *walk,
+		const xml_node_t *old, const xml_node_t *new)
+{
+	const xml_node_t *child;
+
+	/* the names in the old config order, then the new names */
+	for (child = old->children; child; child = child->next) {
+		if (xml_node_get_child(old, child->name) != child)
+			continue;
+
+		if (!ni_ifconfig_diff_named(walk, old, new, child->name))
+			return FALSE;
+	}
+	for (child = new->children; child; child = child->next) {
+		if (xml_node_get_child(new, child->name) != child)
+			continue;
+		if (xml_node_get_child(old, child->name))
+			continue;
+
+		if (!ni_ifconfig_diff_named(walk, old, new, child->name))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Walk the old and new interface config and report the changes to
+ * the callback, which may stop the walk by returning FALSE.
+ * The attributes of the <interface> nodes (origin, ...) are not part
+ * of the config as in the config uuid.
+ */
+ni_bool_t
+ni_ifconfig_diff(const xml_node_t *old, const xml_node_t *new,
+		ni_ifconfig_diff_fn_t *func, void *user_data)
+{
+	ni_ifconfig_diff_walk_t walk = {
+		.func = func,
+		.user_data = user_data,
+		.path = NI_STRINGBUF_INIT_DYNAMIC,
+		.subsystem = NULL,
+	};
+	ni_bool_t ret;
+
+	if (!old || !new || !func)
+		return FALSE;
+
+	ret = ni_ifconfig_diff_children(&walk, old, new);
+
+	ni_stringbuf_destroy(&walk.path);
+	ni_string_free(&walk.subsystem);
+	return ret;
+}
+
+/*
+ * How to apply a change: the first rule matching the changed path
+ * (or a parent path of it) decides. A rule has a separate mode used
+ * when the rule node itself is removed, e.g. a removed ipv4:dhcp
+ * needs to drop the lease by an ifdown. Changes of all other nodes
+ * (name, link, bond, bridge, vlan, ...) need a full ifdown and ifup.
+ */
+static const struct ni_ifconfig_reload_rule {
+	const char *		path;
+	ni_ifconfig_reload_t	change;
+	ni_ifconfig_reload_t	remove;
+} ni_ifconfig_reload_rules[] = {
+	{ "control/mode",	NI_IFCONFIG_RELOAD_FULL,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "control",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "description",	NI_IFCONFIG_RELOAD_NONE,	NI_IFCONFIG_RELOAD_NONE		},
+	{ "scripts",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "firewall",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "link/mtu",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "ethtool",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "ethernet",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "lldp",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv4",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "ipv6",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ "ipv4:static",	NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv4:dhcp",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv4:auto",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv6:static",	NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv6:dhcp",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ "ipv6:auto",		NI_IFCONFIG_RELOAD_IN_PLACE,	NI_IFCONFIG_RELOAD_FULL		},
+	{ NULL,			NI_IFCONFIG_RELOAD_FULL,	NI_IFCONFIG_RELOAD_FULL		}
+};
+
+ni_ifconfig_reload_t
+ni_ifconfig_diff_reload(const ni_ifconfig_diff_t *diff)
+{
+	const struct ni_ifconfig_reload_rule *rule;
+	size_t len;
+
+	if (!diff || ni_string_empty(diff->path))
+		return NI_IFCONFIG_RELOAD_FULL;
+
+	for (rule = ni_ifconfig_reload_rules; rule->path; ++rule) {
+		len = strlen(rule->path);
+		if (strncmp(diff->path, rule->path, len))
+			continue;
+		if (diff->path[len] != '\0' && diff->path[len] != '/')
+			continue;
+
+		if (diff->type == NI_IFCONFIG_DIFF_REMOVED && diff->path[len] == '\0')
+			return rule->remove;
+		return rule->change;
+	}
+	return rule->change;
+}
+
+typedef struct ni_ifconfig_reload_walk {
+	ni_ifconfig_reload_t	mode;
+	ni_string_array_t *	subsystems;
+} ni_ifconfig_reload_walk_t;
+
+static ni_bool_t
+ni_ifconfig_reload_walk(const ni_ifconfig_diff_t *diff, void *user_data)
+{
+	ni_ifconfig_reload_walk_t *walk = user_data;
+	ni_ifconfig_reload_t mode;
+
+	mode = ni_ifconfig_diff_reload(diff);
+	ni_debug_ifconfig("config %s %s: %s", diff->path,
+			ni_ifconfig_diff_type_to_name(diff->type),
+			mode == NI_IFCONFIG_RELOAD_FULL ? "full reload" :
+			mode == NI_IFCONFIG_RELOAD_IN_PLACE ? "in place" : "no action");
+
+	if (walk->mode < mode)
+		walk->mode = mode;
+
+	if (walk->subsystems && ni_string_array_index(walk->subsystems, diff->subsystem) < 0)
+		ni_string_array_append(walk->subsystems, diff->subsystem);
+
+	return TRUE;
+}
+
+/*
+ * Return how to apply the changes between the applied and the new
+ * config, optionally collecting the names of the changed subsystems.
+ */
+ni_ifconfig_reload_t
+ni_ifconfig_reload_mode(const xml_node_t *old, const xml_node_t *new,
+		ni_string_array_t *subsystems)
+{
+	ni_ifconfig_reload_walk_t walk = {
+		.mode = NI_IFCONFIG_RELOAD_NONE,
+		.subsystems = subsystems,
+	};
+
+	if (!ni_ifconfig_diff(old, new, ni_ifconfig_reload_walk, &walk))
+		return NI_IFCONFIG_RELOAD_FULL;
+
+	return walk.mode;
+}
+
+/*
+ * The applied interface configs, stored by their config uuid in the
+ * state directory, as the device client state refers the uuid only.
+ */
+static ni_bool_t
+ni_ifconfig_applied_filename(const ni_uuid_t *uuid, char *path, size_t size)
+{
+	if (!uuid || ni_uuid_is_null(uuid))
+		return FALSE;
+
+	snprintf(path, size, "%s/%s/%s.xml", ni_config_statedir(),
+			NI_IFCONFIG_APPLIED_DIR, ni_uuid_print(uuid));
+	return TRUE;
+}
+
+ni_bool_t
+ni_ifconfig_applied_save(const ni_uuid_t *uuid, const xml_node_t *config)
+{
+	char path[PATH_MAX] = {'\0'};
+	char temp[PATH_MAX] = {'\0'};
+	FILE *fp;
+	int fd;
+
+	if (xml_node_is_empty(config) ||
+	    !ni_ifconfig_applied_filename(uuid, path, sizeof(path)))
+		return FALSE;
+
+	if (ni_file_exists(path))
+		return TRUE;
+
+	snprintf(temp, sizeof(temp), "%s/%s", ni_config_statedir(),
+			NI_IFCONFIG_APPLIED_DIR);
+	if (ni_mkdir_maybe(temp, ni_global.config ?
+				ni_global.config->statedir.mode : 0700) < 0) {
+		ni_debug_ifconfig("Cannot create applied config directory %s: %m", temp);
+		return FALSE;
+	}
+
+	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+	if ((fd = mkstemp(temp)) < 0) {
+		ni_debug_ifconfig("Cannot create applied config temp file %s: %m", temp);
+		return FALSE;
+	}
+
+	if (!(fp = fdopen(fd, "we"))) {
+		close(fd);
+		unlink(temp);
+		return FALSE;
+	}
+
+	if (xml_node_print(config, fp) < 0 || fflush(fp) != 0 || rename(temp, path) < 0) {
+		ni_debug_ifconfig("Cannot write applied config %s: %m", path);
+		fclose(fp);
+		unlink(temp);
+		return FALSE;
+	}
+
+	fclose(fp);
+	return TRUE;
+}
+
+xml_node_t *
+ni_ifconfig_applied_load(const ni_uuid_t *uuid)
+{
+	char path[PATH_MAX] = {'\0'};
+	xml_document_t *doc;
+	xml_node_t *config;
+
+	if (!ni_ifconfig_applied_filename(uuid, path, sizeof(path)) ||
+	    !ni_file_exists(path))
+		return NULL;
+
+	if (!(doc = xml_document_read(path)))
+		return NULL;
+
+	config = xml_node_get_child(xml_document_root(doc), NI_CLIENT_IFCONFIG);
+	if (config)
+		config = xml_node_clone(config, NULL);
+
+	xml_document_free(doc);
+	return config;
+}
+
+void
+ni_ifconfig_applied_remove(const ni_uuid_t *uuid)
+{
+	char path[PATH_MAX] = {'\0'};
+
+	if (ni_ifconfig_applied_filename(uuid, path, sizeof(path)) &&
+	    unlink(path) < 0 && errno != ENOENT)
+		ni_debug_ifconfig("Cannot remove applied config %s: %m", path);
+}
@@ -23,6 +23,7 @@
  *
  */
 
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <ctype.h>
@@ -148,6 +149,49 @@ ni_ifpolicy_name_from_ifname(const char *ifname)
 	return buf.string;
 }
 
+/*
+ * Decode the interface name from a policy name generated by
+ * ni_ifpolicy_name_from_ifname, returns NULL when it isn't one.
+ */
+char *
+ni_ifpolicy_name_to_ifname(const char *name)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	static const char prefix[] = "policy__";
+	const char *ptr;
+
+	if (!name || strncmp(name, prefix, sizeof(prefix) - 1))
+		return NULL;
+
+	for (ptr = name + sizeof(prefix) - 1; *ptr; ++ptr) {
+		if (isalnum((unsigned char)*ptr)) {
+			ni_stringbuf_putc(&buf, *ptr);
+			continue;
+		}
+		if (*ptr != '_')
+			goto failure;
+
+		switch (*++ptr) {
+			case '_':
+				ni_stringbuf_putc(&buf, '_');
+				break;
+			case 'd':
+				ni_stringbuf_putc(&buf, '.');
+				break;
+			case 'm':
+				ni_stringbuf_putc(&buf, '-');
+				break;
+			default:
+				goto failure;
+		}
+	}
+	return buf.string;
+
+failure:
+	ni_stringbuf_destroy(&buf);
+	return NULL;
+}
+
 ni_bool_t
 ni_ifpolicy_name_is_valid(const char *name)
 {
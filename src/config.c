@@ -39,6 +39,7 @@ static const char *__ni_ifconfig_source_types[] = {
 static ni_bool_t	ni_config_parse_addrconf_dhcp4(ni_config_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_addrconf_dhcp6(ni_config_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_addrconf_auto6(ni_config_auto6_t *, xml_node_t *);
+static ni_bool_t	ni_config_parse_addrconf_lease_store(ni_config_lease_store_t *, const xml_node_t *);
 static void		ni_config_parse_update_targets(unsigned int *, const xml_node_t *);
 static void		ni_config_parse_update_dhcp4_routes(unsigned int *, const xml_node_t *);
 static void		ni_config_parse_fslocation(ni_config_fslocation_t *, xml_node_t *);
@@ -49,6 +50,8 @@ static ni_bool_t	ni_config_parse_system_updater(ni_extension_t **, xml_node_t *)
 static ni_bool_t	ni_config_parse_extension(ni_extension_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_sources(ni_config_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_rtnl_event(ni_config_rtnl_event_t *, xml_node_t *);
+static ni_bool_t	ni_config_parse_socket(ni_config_socket_t *, const xml_node_t *);
+static ni_bool_t	ni_config_parse_fsm(ni_config_fsm_t *, const xml_node_t *);
 static ni_bool_t	ni_config_parse_bonding(ni_config_bonding_t *, const xml_node_t *);
 static ni_bool_t	ni_config_parse_teamd(ni_config_teamd_t *, const xml_node_t *);
 static ni_c_binding_t *	ni_c_binding_new(ni_c_binding_t **, const char *name, const char *lib, const char *symbol);
@@ -87,6 +90,7 @@ ni_config_new()
 	ni_config_fslocation_init(&conf->storedir, WICKED_STOREDIR, 0755);
 
 	conf->use_nanny = FALSE;
+	conf->sources.parallel_jobs = NI_CONFIG_SOURCES_PARALLEL_JOBS;
 
 	conf->rtnl_event.recv_buff_length = 1024 * 1024;
 	conf->rtnl_event.mesg_buff_length = 0;
@@ -239,6 +243,7 @@ void
 ni_config_free(ni_config_t *conf)
 {
 	ni_string_array_destroy(&conf->sources.ifconfig);
+	ni_string_array_destroy(&conf->files);
 	ni_extension_list_destroy(&conf->dbus_extensions);
 	ni_extension_list_destroy(&conf->ns_extensions);
 	ni_extension_list_destroy(&conf->fw_extensions);
@@ -246,6 +251,7 @@ ni_config_free(ni_config_t *conf)
 	ni_string_free(&conf->dbus_name);
 	ni_string_free(&conf->dbus_type);
 	ni_string_free(&conf->dbus_xml_schema_file);
+	ni_string_free(&conf->dbus_xml_schema_cache);
 	ni_config_fslocation_destroy(&conf->piddir);
 	ni_config_fslocation_destroy(&conf->storedir);
 	ni_config_fslocation_destroy(&conf->statedir);
@@ -269,6 +275,7 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 		ni_error("%s: error parsing configuration file", filename);
 		goto failed;
 	}
+	ni_string_array_append(&conf->files, filename);
 
 	node = xml_node_get_child(doc->root, "config");
 	if (!node) {
@@ -334,7 +341,7 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 			/* New school:
 			 *  <dbus>
 			 *    <service name="org.opensuse.Network" />
-			 *    <schema name="/some/path/wicked.xml" />
+			 *    <schema name="/some/path/wicked.xml" cache="/some/path" />
 			 *  </dbus>
 			 */
 			for (gchild = child->children; gchild; gchild = gchild->next) {
@@ -347,6 +354,8 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				if (!strcmp(gchild->name, "schema")) {
 					if ((attrval = xml_node_get_attr(gchild, "name")) != NULL)
 						ni_string_dup(&conf->dbus_xml_schema_file, attrval);
+					if ((attrval = xml_node_get_attr(gchild, "cache")) != NULL)
+						ni_string_dup(&conf->dbus_xml_schema_cache, attrval);
 				}
 			}
 		} else 
@@ -356,6 +365,8 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 			/* old school */
 			if ((attrval = xml_node_get_attr(child, "name")) != NULL)
 				ni_string_dup(&conf->dbus_xml_schema_file, attrval);
+			if ((attrval = xml_node_get_attr(child, "cache")) != NULL)
+				ni_string_dup(&conf->dbus_xml_schema_cache, attrval);
 		} else
 		if (strcmp(child->name, "addrconf") == 0) {
 			xml_node_t *gchild;
@@ -364,6 +375,10 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				if (!strcmp(gchild->name, "default-allow-update"))
 					ni_config_parse_update_targets(&conf->addrconf.default_allow_update, gchild);
 
+				if (!strcmp(gchild->name, "lease-store")
+				 && !ni_config_parse_addrconf_lease_store(&conf->addrconf.lease_store, gchild))
+					goto failed;
+
 				if (!strcmp(gchild->name, "dhcp4")
 				 && !ni_config_parse_addrconf_dhcp4(conf, gchild))
 					goto failed;
@@ -405,6 +420,14 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 			if (!ni_config_parse_rtnl_event(&conf->rtnl_event, child))
 				goto failed;
 		} else
+		if (strcmp(child->name, "sockets") == 0) {
+			if (!ni_config_parse_socket(&conf->socket, child))
+				goto failed;
+		} else
+		if (strcmp(child->name, "fsm") == 0) {
+			if (!ni_config_parse_fsm(&conf->fsm, child))
+				goto failed;
+		} else
 		if (strcmp(child->name, "bonding") == 0) {
 			if (!ni_config_parse_bonding(&conf->bonding, child))
 				goto failed;
@@ -1426,6 +1449,7 @@ ni_config_parse_system_updater(ni_extension_t **list, xml_node_t *node)
  *   <ifconfig location="firmware:" />
  *   <ifconfig location="compat:" />
  *   <ifconfig location="wicked:" />
+ *   <parallel-jobs>4</parallel-jobs>
  * </sources>
  *
  */
@@ -1458,12 +1482,27 @@ ni_config_parse_sources(ni_config_t *conf, xml_node_t *sources)
 		if (!strcmp(child->name, "ifconfig")) {
 			 if (!__ni_config_parse_ifconfig_source(&conf->sources.ifconfig, child))
 				return FALSE;
+		} else
+		if (!strcmp(child->name, "parallel-jobs")) {
+			if (ni_parse_uint(child->cdata, &conf->sources.parallel_jobs, 10)) {
+				ni_error("%s: invalid <sources><parallel-jobs>%s</parallel-jobs></sources> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
 		}
 	}
 
 	return TRUE;
 }
 
+unsigned int
+ni_config_sources_parallel_jobs(void)
+{
+	if (ni_global.config)
+		return ni_global.config->sources.parallel_jobs;
+	return NI_CONFIG_SOURCES_PARALLEL_JOBS;
+}
+
 const ni_string_array_t *
 ni_config_sources(const char *type)
 {
@@ -1496,6 +1535,196 @@ ni_config_parse_rtnl_event(ni_config_rtnl_event_t *conf, xml_node_t *node)
 		if (ni_string_eq(child->name, "message-buffer-length")) {
 			if (ni_parse_uint(child->cdata, &conf->mesg_buff_length, 0))
 				return FALSE;
+		} else
+		if (ni_string_eq(child->name, "coalesce-window")) {
+			if (ni_parse_uint(child->cdata, &conf->coalesce_window, 0))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * socket event loop config options
+ */
+static const ni_intmap_t	config_socket_backend_names[] = {
+	{ "default",		NI_CONFIG_SOCKET_BACKEND_DEFAULT},
+	{ "poll",		NI_CONFIG_SOCKET_BACKEND_POLL	},
+	{ "epoll",		NI_CONFIG_SOCKET_BACKEND_EPOLL	},
+	{ NULL,			-1U				}
+};
+
+static const ni_intmap_t	config_capture_backend_names[] = {
+	{ "default",		NI_CONFIG_CAPTURE_BACKEND_DEFAULT},
+	{ "socket",		NI_CONFIG_CAPTURE_BACKEND_SOCKET},
+	{ "ring",		NI_CONFIG_CAPTURE_BACKEND_RING	},
+	{ NULL,			-1U				}
+};
+
+const char *
+ni_config_socket_backend_type_to_name(ni_config_socket_backend_t type)
+{
+	return ni_format_uint_mapped(type, config_socket_backend_names);
+}
+
+static ni_bool_t
+ni_config_socket_backend_name_to_type(const char *name, ni_config_socket_backend_t *type)
+{
+	unsigned int _type;
+
+	if (!name || !type)
+		return FALSE;
+
+	if (ni_parse_uint_mapped(name, config_socket_backend_names, &_type) != 0)
+		return FALSE;
+
+	*type = _type;
+	return TRUE;
+}
+
+ni_config_socket_backend_t
+ni_config_socket_backend(void)
+{
+	ni_config_socket_backend_t backend = NI_CONFIG_SOCKET_BACKEND_DEFAULT;
+
+	if (ni_global.config)
+		backend = ni_global.config->socket.backend;
+
+	if (backend == NI_CONFIG_SOCKET_BACKEND_DEFAULT)
+		backend = NI_CONFIG_SOCKET_BACKEND_EPOLL;
+	return backend;
+}
+
+const char *
+ni_config_capture_backend_type_to_name(ni_config_capture_backend_t type)
+{
+	return ni_format_uint_mapped(type, config_capture_backend_names);
+}
+
+static ni_bool_t
+ni_config_capture_backend_name_to_type(const char *name, ni_config_capture_backend_t *type)
+{
+	unsigned int _type;
+
+	if (!name || !type)
+		return FALSE;
+
+	if (ni_parse_uint_mapped(name, config_capture_backend_names, &_type) != 0)
+		return FALSE;
+
+	*type = _type;
+	return TRUE;
+}
+
+ni_config_capture_backend_t
+ni_config_capture_backend(void)
+{
+	ni_config_capture_backend_t backend = NI_CONFIG_CAPTURE_BACKEND_DEFAULT;
+
+	if (ni_global.config)
+		backend = ni_global.config->socket.capture;
+
+	if (backend == NI_CONFIG_CAPTURE_BACKEND_DEFAULT)
+		backend = NI_CONFIG_CAPTURE_BACKEND_RING;
+	return backend;
+}
+
+static ni_bool_t
+ni_config_parse_socket(ni_config_socket_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "backend")) {
+			if (!ni_config_socket_backend_name_to_type(child->cdata, &conf->backend)) {
+				ni_error("%s: invalid <sockets><backend>%s</backend></sockets> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "capture")) {
+			if (!ni_config_capture_backend_name_to_type(child->cdata, &conf->capture)) {
+				ni_error("%s: invalid <sockets><capture>%s</capture></sockets> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * addrconf lease store config options
+ */
+static const ni_intmap_t	config_lease_store_names[] = {
+	{ "default",		NI_CONFIG_LEASE_STORE_DEFAULT	},
+	{ "xml",		NI_CONFIG_LEASE_STORE_XML	},
+	{ "journal",		NI_CONFIG_LEASE_STORE_JOURNAL	},
+	{ NULL,			-1U				}
+};
+
+const char *
+ni_config_lease_store_type_to_name(ni_config_lease_store_t type)
+{
+	return ni_format_uint_mapped(type, config_lease_store_names);
+}
+
+ni_config_lease_store_t
+ni_config_lease_store(void)
+{
+	ni_config_lease_store_t store = NI_CONFIG_LEASE_STORE_DEFAULT;
+
+	if (ni_global.config)
+		store = ni_global.config->addrconf.lease_store;
+
+	if (store == NI_CONFIG_LEASE_STORE_DEFAULT)
+		store = NI_CONFIG_LEASE_STORE_XML;
+	return store;
+}
+
+static ni_bool_t
+ni_config_parse_addrconf_lease_store(ni_config_lease_store_t *store, const xml_node_t *node)
+{
+	unsigned int type;
+
+	if (ni_parse_uint_mapped(node->cdata, config_lease_store_names, &type) != 0) {
+		ni_error("%s: invalid <addrconf><lease-store>%s</lease-store></addrconf> option",
+				xml_node_location(node), node->cdata);
+		return FALSE;
+	}
+	*store = type;
+	return TRUE;
+}
+
+/*
+ * client fsm config options
+ */
+unsigned int
+ni_config_fsm_parallel_calls(void)
+{
+	if (ni_global.config)
+		return ni_global.config->fsm.parallel_calls;
+	return 0;
+}
+
+static ni_bool_t
+ni_config_parse_fsm(ni_config_fsm_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "parallel-calls")) {
+			if (ni_parse_uint(child->cdata, &conf->parallel_calls, 10)) {
+				ni_error("%s: invalid <fsm><parallel-calls>%s</parallel-calls></fsm> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
 		}
 	}
 	return TRUE;
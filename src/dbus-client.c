@@ -24,14 +24,23 @@ struct ni_dbus_client {
 	char *			bus_name;
 	unsigned int		call_timeout;
 	const ni_intmap_t *	error_map;
+	ni_bool_t		no_managed_objects_since;
 };
 
 struct ni_dbus_client_object {
 	ni_dbus_client_t *	client;
 	char *			default_interface;
+
+	/* snapshot of the subtree as of the last GetManagedObjectsSince */
+	struct {
+		uint32_t	epoch;
+		uint32_t	generation;
+		unsigned int	filter;		/* fingerprint of the property filter used */
+	} managed;
 };
 
 
+static dbus_bool_t	__ni_dbus_object_get_managed_objects_dict(ni_dbus_object_t *, DBusMessageIter *);
 static dbus_bool_t	__ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *, DBusMessageIter *);
 static dbus_bool_t	__ni_dbus_object_get_managed_object_properties(ni_dbus_object_t *proxy,
 					const ni_dbus_service_t *service,
@@ -470,38 +479,53 @@ ni_dbus_object_call_async(ni_dbus_object_t *proxy,
 	return rv;
 }
 
-/*
- * Use ObjectManager.GetManagedObjects to retrieve (part of)
- * the server's object hierarchy
- */
-dbus_bool_t
-ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+int
+ni_dbus_object_call_variant_async(ni_dbus_object_t *proxy,
+			const char *interface_name, const char *method,
+			unsigned int nargs, const ni_dbus_variant_t *args,
+			ni_dbus_async_callback_t *callback)
 {
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_message_t *call;
 	ni_dbus_client_t *client;
-	ni_dbus_object_t *objmgr;
-	ni_dbus_message_t *call = NULL, *reply = NULL;
-	DBusMessageIter iter, iter_dict;
-	dbus_bool_t rv = FALSE;
+	int rv;
 
-	if (!(client = ni_dbus_object_get_client(proxy))) {
-		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
-		return FALSE;
+	if (!proxy || !interface_name || !(client = ni_dbus_object_get_client(proxy)))
+		return -NI_ERROR_INVALID_ARGS;
+
+	ni_debug_dbus("%s(%s, %s.%s)", __FUNCTION__, proxy->path, interface_name, method);
+	call = dbus_message_new_method_call(client->bus_name, proxy->path, interface_name, method);
+	if (call == NULL) {
+		ni_error("%s: unable to build %s message", __FUNCTION__, method);
+		return -NI_ERROR_INVALID_ARGS;
 	}
 
-	if (purge)
-		__ni_dbus_object_mark_stale(proxy);
+	if (nargs && !ni_dbus_message_serialize_variants(call, nargs, args, &error)) {
+		ni_dbus_print_error(&error, "%s: unable to serialize %s arguments", __FUNCTION__, method);
+		dbus_error_free(&error);
+		rv = -NI_ERROR_CANNOT_MARSHAL;
+	} else {
+		rv = ni_dbus_connection_call_async(client->connection,
+			call, client->call_timeout,
+			callback, proxy);
+	}
 
-	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
-			NI_DBUS_INTERFACE ".ObjectManager",
-			NULL);
+	dbus_message_unref(call);
+	return rv;
+}
 
-	call = ni_dbus_object_call_new(objmgr, "GetManagedObjects", 0);
-	if ((reply = ni_dbus_client_call(client, call, error)) == NULL)
-		goto out;
+/*
+ * Process the object dict returned by GetManagedObjects and
+ * GetManagedObjectsSince, and update the proxy objects below @proxy
+ */
+static dbus_bool_t
+__ni_dbus_object_get_managed_objects_dict(ni_dbus_object_t *proxy, DBusMessageIter *iter)
+{
+	DBusMessageIter iter_dict;
+
+	if (!ni_dbus_message_open_dict_read(iter, &iter_dict))
+		return FALSE;
 
-	dbus_message_iter_init(reply, &iter);
-	if (!ni_dbus_message_open_dict_read(&iter, &iter_dict))
-		goto bad_reply;
 	while (dbus_message_iter_get_arg_type(&iter_dict) == DBUS_TYPE_DICT_ENTRY) {
 		DBusMessageIter iter_dict_entry;
 		ni_dbus_object_t *descendant;
@@ -511,11 +535,11 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		dbus_message_iter_next(&iter_dict);
 
 		if (dbus_message_iter_get_arg_type(&iter_dict_entry) != DBUS_TYPE_STRING)
-			goto bad_reply;
+			return FALSE;
 		dbus_message_iter_get_basic(&iter_dict_entry, &object_path);
 
 		if (!dbus_message_iter_next(&iter_dict_entry))
-			goto bad_reply;
+			return FALSE;
 
 		descendant = ni_dbus_object_create(proxy, object_path, NULL, NULL);
 
@@ -538,11 +562,47 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 			descendant->class->initialize(descendant);
 
 		if (!__ni_dbus_object_get_managed_object_interfaces(descendant, &iter_dict_entry))
-			goto bad_reply;
+			return FALSE;
 
 		descendant->stale = FALSE;
 	}
 
+	return TRUE;
+}
+
+/*
+ * Use ObjectManager.GetManagedObjects to retrieve (part of)
+ * the server's object hierarchy
+ */
+dbus_bool_t
+ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+{
+	ni_dbus_client_t *client;
+	ni_dbus_object_t *objmgr;
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	DBusMessageIter iter;
+	dbus_bool_t rv = FALSE;
+
+	if (!(client = ni_dbus_object_get_client(proxy))) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	if (purge)
+		__ni_dbus_object_mark_stale(proxy);
+
+	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
+			NI_DBUS_INTERFACE ".ObjectManager",
+			NULL);
+
+	call = ni_dbus_object_call_new(objmgr, "GetManagedObjects", 0);
+	if ((reply = ni_dbus_client_call(client, call, error)) == NULL)
+		goto out;
+
+	dbus_message_iter_init(reply, &iter);
+	if (!__ni_dbus_object_get_managed_objects_dict(proxy, &iter))
+		goto bad_reply;
+
 	if (purge)
 		__ni_dbus_object_purge_stale(proxy);
 
@@ -561,6 +621,158 @@ bad_reply:
 	goto out;
 }
 
+/*
+ * Use ObjectManager.GetManagedObjectsSince to update the proxy objects
+ * below @proxy, transferring only objects which changed since the last
+ * call. Objects which went away on the server are purged.
+ * If @filter is given, the server omits on-demand properties (and
+ * interfaces) the filter doesn't ask for.
+ * Falls back to a full GetManagedObjects if the server doesn't support
+ * the call.
+ */
+dbus_bool_t
+ni_dbus_object_get_changed_objects(ni_dbus_object_t *proxy, const ni_dbus_property_filter_t *filter,
+				DBusError *error)
+{
+	ni_dbus_client_object_t *cob = proxy->client_object;
+	ni_dbus_client_t *client;
+	ni_dbus_object_t *objmgr;
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	ni_dbus_variant_t args[3] = {
+		NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT
+	};
+	DBusMessageIter iter, iter_array;
+	uint32_t epoch, generation;
+	unsigned int filter_hash, nargs;
+	ni_bool_t missing = FALSE;
+	unsigned int attempt;
+	dbus_bool_t rv = FALSE;
+
+	if (!(client = ni_dbus_object_get_client(proxy)) || !cob) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	if (client->no_managed_objects_since)
+		return ni_dbus_object_get_managed_objects(proxy, error, TRUE);
+
+	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
+			NI_DBUS_INTERFACE ".ObjectManager",
+			NULL);
+
+	nargs = 2;
+	if (filter) {
+		if (!ni_dbus_property_filter_to_dict(filter, &args[2])) {
+			dbus_set_error(error, DBUS_ERROR_FAILED, "%s: cannot encode property filter",
+					__FUNCTION__);
+			goto out;
+		}
+		nargs++;
+	}
+
+	/* The snapshot we have is only good for the same property subset */
+	filter_hash = ni_dbus_property_filter_hash(filter);
+	if (cob->managed.filter != filter_hash) {
+		epoch = generation = 0;
+	} else {
+		epoch = cob->managed.epoch;
+		generation = cob->managed.generation;
+	}
+
+	for (attempt = 0; attempt < 2; ++attempt) {
+		ni_dbus_variant_set_uint32(&args[0], epoch);
+		ni_dbus_variant_set_uint32(&args[1], generation);
+
+		call = ni_dbus_object_call_new(objmgr, "GetManagedObjectsSince", 0);
+		if (!ni_dbus_message_serialize_variants(call, nargs, args, error))
+			goto out;
+
+		if ((reply = ni_dbus_client_call(client, call, error)) == NULL) {
+			if (dbus_error_has_name(error, DBUS_ERROR_UNKNOWN_METHOD)) {
+				ni_debug_dbus("%s: server does not support GetManagedObjectsSince",
+						proxy->path);
+				client->no_managed_objects_since = TRUE;
+				dbus_error_free(error);
+				dbus_message_unref(call);
+				ni_dbus_object_free(objmgr);
+				ni_dbus_variant_destroy(&args[2]);
+				return ni_dbus_object_get_managed_objects(proxy, error, TRUE);
+			}
+			goto out;
+		}
+
+		__ni_dbus_object_mark_stale(proxy);
+
+		dbus_message_iter_init(reply, &iter);
+		if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+			goto bad_reply;
+		dbus_message_iter_get_basic(&iter, &epoch);
+		if (!dbus_message_iter_next(&iter)
+		 || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+			goto bad_reply;
+		dbus_message_iter_get_basic(&iter, &generation);
+
+		if (!dbus_message_iter_next(&iter)
+		 || !__ni_dbus_object_get_managed_objects_dict(proxy, &iter))
+			goto bad_reply;
+
+		/* All objects the server still has. Unchanged ones are
+		 * not in the dict, but must not be purged either */
+		if (!dbus_message_iter_next(&iter)
+		 || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+			goto bad_reply;
+		dbus_message_iter_recurse(&iter, &iter_array);
+
+		missing = FALSE;
+		while (dbus_message_iter_get_arg_type(&iter_array) == DBUS_TYPE_STRING) {
+			ni_dbus_object_t *descendant;
+			const char *object_path;
+
+			dbus_message_iter_get_basic(&iter_array, &object_path);
+			dbus_message_iter_next(&iter_array);
+
+			if ((descendant = ni_dbus_object_lookup(proxy, object_path)) != NULL)
+				descendant->stale = FALSE;
+			else
+				missing = TRUE;
+		}
+
+		__ni_dbus_object_purge_stale(proxy);
+
+		dbus_message_unref(call);
+		dbus_message_unref(reply);
+		call = reply = NULL;
+
+		if (!missing)
+			break;
+
+		/* We do not have a proxy for an unchanged object (someone
+		 * freed it locally); fetch everything again. */
+		ni_debug_dbus("%s: incomplete object snapshot, retrieving all objects",
+				proxy->path);
+		epoch = generation = 0;
+	}
+
+	cob->managed.epoch = epoch;
+	cob->managed.generation = generation;
+	cob->managed.filter = filter_hash;
+	rv = TRUE;
+
+out:
+	if (call)
+		dbus_message_unref(call);
+	if (reply)
+		dbus_message_unref(reply);
+	ni_dbus_object_free(objmgr);
+	ni_dbus_variant_destroy(&args[2]);
+	return rv;
+
+bad_reply:
+	cob->managed.epoch = cob->managed.generation = 0;
+	dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
+	goto out;
+}
+
 static dbus_bool_t
 __ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMessageIter *iter)
 {
@@ -781,11 +993,21 @@ __ni_dbus_object_purge_stale(ni_dbus_object_t *proxy)
 
 dbus_bool_t
 ni_dbus_object_refresh_children(ni_dbus_object_t *proxy)
+{
+	return ni_dbus_object_refresh_children_filtered(proxy, NULL);
+}
+
+/*
+ * Like ni_dbus_object_refresh_children, but only retrieve the
+ * on-demand properties and the interfaces @filter asks for.
+ */
+dbus_bool_t
+ni_dbus_object_refresh_children_filtered(ni_dbus_object_t *proxy, const ni_dbus_property_filter_t *filter)
 {
 	DBusError error = DBUS_ERROR_INIT;
 	dbus_bool_t rv;
 
-	rv = ni_dbus_object_get_managed_objects(proxy, &error, TRUE);
+	rv = ni_dbus_object_get_changed_objects(proxy, filter, &error);
 	if (!rv)
 		ni_dbus_print_error(&error, "%s.getManagedObjects failed", proxy->path);
 	dbus_error_free(&error);
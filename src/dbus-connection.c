@@ -762,7 +762,7 @@ restart:
 		__ni_put_dbus_watch_data(wd);
 	}
 
-	sock->poll_flags = poll_flags;
+	ni_socket_set_poll_flags(sock, poll_flags);
 	if (!found)
 		ni_warn("%s: dead socket", func);
 }
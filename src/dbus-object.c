@@ -19,6 +19,37 @@
 
 static ni_dbus_object_t *	__ni_dbus_objects_trashcan;
 
+/*
+ * Children are indexed by name in a hash table of the parent,
+ * chained through child->hash_next.
+ */
+#define NI_DBUS_OBJECT_HASH_MIN		8
+
+struct ni_dbus_object_hash {
+	unsigned int		count;
+	unsigned int		size;
+	ni_dbus_object_t **	buckets;
+};
+
+/*
+ * Cache of recent path lookups, keyed on the root object and the
+ * path as passed by the caller. Objects are only ever added below
+ * an existing path, so the cache is invalidated as a whole on every
+ * object removal by bumping the generation.
+ */
+#define NI_DBUS_OBJECT_CACHE_SIZE	256
+
+typedef struct ni_dbus_object_cache_entry {
+	const ni_dbus_object_t *root;
+	unsigned int		generation;
+	unsigned int		hash;
+	char *			path;
+	ni_dbus_object_t *	object;
+} ni_dbus_object_cache_entry_t;
+
+static ni_dbus_object_cache_entry_t	__ni_dbus_object_cache[NI_DBUS_OBJECT_CACHE_SIZE];
+static unsigned int			__ni_dbus_object_cache_generation = 1;
+
 static dbus_bool_t		__ni_dbus_object_get_one_property(const ni_dbus_object_t *object,
 					const char *context,
 					const ni_dbus_property_t *property,
@@ -30,6 +61,123 @@ const ni_dbus_class_t		ni_dbus_anonymous_class = {
 	"<anonymous>"
 };
 
+/*
+ * Child hash table maintenance
+ */
+static void
+__ni_dbus_object_hash_resize(struct ni_dbus_object_hash *hash, unsigned int size)
+{
+	ni_dbus_object_t **buckets, *child, *next;
+	unsigned int i, slot;
+
+	buckets = xcalloc(size, sizeof(buckets[0]));
+	for (i = 0; i < hash->size; ++i) {
+		for (child = hash->buckets[i]; child; child = next) {
+			next = child->hash_next;
+			slot = ni_hash_string(child->name) & (size - 1);
+			child->hash_next = buckets[slot];
+			buckets[slot] = child;
+		}
+	}
+	free(hash->buckets);
+	hash->buckets = buckets;
+	hash->size = size;
+}
+
+static void
+__ni_dbus_object_hash_add(ni_dbus_object_t *parent, ni_dbus_object_t *child)
+{
+	struct ni_dbus_object_hash *hash;
+	unsigned int slot;
+
+	if (!(hash = parent->child_hash)) {
+		hash = parent->child_hash = xcalloc(1, sizeof(*hash));
+		__ni_dbus_object_hash_resize(hash, NI_DBUS_OBJECT_HASH_MIN);
+	} else if (hash->count >= hash->size) {
+		__ni_dbus_object_hash_resize(hash, hash->size * 2);
+	}
+
+	slot = ni_hash_string(child->name) & (hash->size - 1);
+	child->hash_next = hash->buckets[slot];
+	hash->buckets[slot] = child;
+	hash->count++;
+}
+
+static void
+__ni_dbus_object_hash_remove(ni_dbus_object_t *parent, ni_dbus_object_t *child)
+{
+	struct ni_dbus_object_hash *hash;
+	ni_dbus_object_t **pos;
+
+	if (!(hash = parent->child_hash) || !child->name)
+		return;
+
+	pos = &hash->buckets[ni_hash_string(child->name) & (hash->size - 1)];
+	for (; *pos; pos = &(*pos)->hash_next) {
+		if (*pos == child) {
+			*pos = child->hash_next;
+			child->hash_next = NULL;
+			hash->count--;
+			return;
+		}
+	}
+}
+
+/*
+ * Unlink an object from its parent (or the trashcan)
+ */
+static void
+__ni_dbus_object_detach(ni_dbus_object_t *object)
+{
+	if (object->parent) {
+		__ni_dbus_object_hash_remove(object->parent, object);
+		object->parent = NULL;
+	}
+	__ni_dbus_object_unlink(object);
+
+	/* The object or its descendants may be cached */
+	__ni_dbus_object_cache_generation++;
+}
+
+/*
+ * Path lookup cache
+ */
+static inline ni_dbus_object_cache_entry_t *
+__ni_dbus_object_cache_slot(const ni_dbus_object_t *root, const char *path, unsigned int *hash)
+{
+	*hash = ni_hash_string(path) ^ ni_hash_bytes(&root, sizeof(root));
+	return &__ni_dbus_object_cache[*hash % NI_DBUS_OBJECT_CACHE_SIZE];
+}
+
+static ni_dbus_object_t *
+__ni_dbus_object_cache_find(const ni_dbus_object_t *root, const char *path)
+{
+	ni_dbus_object_cache_entry_t *entry;
+	unsigned int hash;
+
+	entry = __ni_dbus_object_cache_slot(root, path, &hash);
+	if (entry->generation == __ni_dbus_object_cache_generation
+	 && entry->root == root && entry->hash == hash
+	 && ni_string_eq(entry->path, path))
+		return entry->object;
+	return NULL;
+}
+
+static void
+__ni_dbus_object_cache_store(const ni_dbus_object_t *root, const char *path, ni_dbus_object_t *object)
+{
+	ni_dbus_object_cache_entry_t *entry;
+	unsigned int hash;
+
+	entry = __ni_dbus_object_cache_slot(root, path, &hash);
+	if (!ni_string_eq(entry->path, path))
+		ni_string_dup(&entry->path, path);
+	entry->root = root;
+	entry->hash = hash;
+	entry->object = object;
+	entry->generation = __ni_dbus_object_cache_generation;
+}
+
 /*
  * Create a new dbus object
  */
@@ -71,6 +219,7 @@ __ni_dbus_object_new_child(ni_dbus_object_t *parent, const ni_dbus_class_t *obje
 	child->parent = parent;
 	__ni_dbus_object_insert(pos, child);
 	ni_string_dup(&child->name, name);
+	__ni_dbus_object_hash_add(parent, child);
 	if (parent->server_object)
 		__ni_dbus_server_object_inherit(child, parent);
 	if (parent->client_object)
@@ -105,8 +254,7 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 {
 	ni_dbus_object_t *child;
 
-	__ni_dbus_object_unlink(object);
-	object->parent = NULL;
+	__ni_dbus_object_detach(object);
 
 	if (object->server_object)
 		__ni_dbus_server_object_destroy(object);
@@ -119,6 +267,10 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 	while ((child = object->children) != NULL)
 		__ni_dbus_object_free(child);
 
+	if (object->child_hash) {
+		free(object->child_hash->buckets);
+		free(object->child_hash);
+	}
 	free(object->interfaces);
 	free(object);
 }
@@ -133,8 +285,7 @@ ni_dbus_object_free(ni_dbus_object_t *object)
 	if (object->pprev) {
 		ni_debug_dbus("%s: deferring deletion of active object %s",
 				__FUNCTION__, object->path);
-		__ni_dbus_object_unlink(object);
-		object->parent = NULL;
+		__ni_dbus_object_detach(object);
 		__ni_dbus_object_insert(&__ni_dbus_objects_trashcan, object);
 	} else {
 		__ni_dbus_object_free(object);
@@ -172,15 +323,26 @@ ni_dbus_object_translate_error(ni_dbus_object_t *obj, const DBusError *error)
  * Look up an object by its relative name
  */
 static ni_dbus_object_t *
-__ni_dbus_object_get_child(ni_dbus_object_t *parent, const char *name)
+__ni_dbus_object_get_child(ni_dbus_object_t *parent, const char *name, size_t len)
 {
 	ni_dbus_object_t *child;
 
-	if (*name == '\0')
+	if (len == 0)
 		return parent;
 
+	if (parent->child_hash) {
+		struct ni_dbus_object_hash *hash = parent->child_hash;
+
+		child = hash->buckets[ni_hash_bytes(name, len) & (hash->size - 1)];
+		for (; child; child = child->hash_next) {
+			if (!strncmp(child->name, name, len) && child->name[len] == '\0')
+				return child;
+		}
+		return NULL;
+	}
+
 	for (child = parent->children; child; child = child->next) {
-		if (!strcmp(child->name, name))
+		if (!strncmp(child->name, name, len) && child->name[len] == '\0')
 			return child;
 	}
 
@@ -192,12 +354,15 @@ __ni_dbus_object_lookup(ni_dbus_object_t *root_object, const char *path, int cre
 				const ni_dbus_class_t *object_class,
 				void *object_handle)
 {
-	char *path_copy = NULL, *name, *next_name;
+	const char *lookup_path = path, *name, *next;
 	ni_dbus_object_t *found;
 
 	if (path == NULL)
 		return root_object;
 
+	if ((found = __ni_dbus_object_cache_find(root_object, lookup_path)) != NULL)
+		return found;
+
 	/* If the path starts with a /, it's an absolute path.
 	 * Strip off the root node's path. */
 	if (*path == '/') {
@@ -213,27 +378,39 @@ __ni_dbus_object_lookup(ni_dbus_object_t *root_object, const char *path, int cre
 		path = relative_path;
 	}
 
-	ni_string_dup(&path_copy, path);
-
 	found = root_object;
-	for (name = strtok(path_copy, "/"); name && found; name = next_name) {
+	for (name = path; found && *name; name = next) {
 		ni_dbus_object_t *child;
+		size_t len;
 
-		next_name = strtok(NULL, "/");
-		child = __ni_dbus_object_get_child(found, name);
+		if (*name == '/') {
+			next = name + 1;
+			continue;
+		}
+
+		len = strcspn(name, "/");
+		next = name + len;
+
+		child = __ni_dbus_object_get_child(found, name, len);
 		if (child == NULL && create) {
-			if (next_name != NULL) {
+			char *copy = xmalloc(len + 1);
+
+			memcpy(copy, name, len);
+			copy[len] = '\0';
+			if (next[strspn(next, "/")] != '\0') {
 				/* Intermediate path component */
-				child = __ni_dbus_object_new_child(found, NULL, name, NULL);
+				child = __ni_dbus_object_new_child(found, NULL, copy, NULL);
 			} else {
 				/* Final path component consumes object handle and functions */
-				child = __ni_dbus_object_new_child(found, object_class, name, object_handle);
+				child = __ni_dbus_object_new_child(found, object_class, copy, object_handle);
 			}
+			free(copy);
 		}
 		found = child;
 	}
 
-	ni_string_free(&path_copy);
+	if (found)
+		__ni_dbus_object_cache_store(root_object, lookup_path, found);
 	return found;
 }
 
@@ -700,10 +877,11 @@ __ni_dbus_object_get_one_property(const ni_dbus_object_t *object,
 /*
  * Get all properties of an object, for a given dbus interface
  */
-dbus_bool_t
-__ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
+static dbus_bool_t
+__ni_dbus_object_get_filtered_properties(const ni_dbus_object_t *object,
 					const char *context,
 					const ni_dbus_property_t *properties,
+					const ni_string_array_t *skip,
 					ni_dbus_variant_t *dict,
 					DBusError *error)
 {
@@ -717,6 +895,9 @@ __ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 		if (property->signature == NULL)
 			continue;
 
+		if (skip && skip->count && ni_string_array_index(skip, property->name) >= 0)
+			continue;
+
 		/* We could just have a .get function for dicts that does what
 		 * the following if() statement does, except we'd lose the context
 		 * of the surrounding interface/property names in error messages.
@@ -731,7 +912,7 @@ __ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 			ni_dbus_variant_init_dict(&temp);
 
 			snprintf(subcontext, sizeof(subcontext), "%s.%s", context, property->name);
-			if (!__ni_dbus_object_get_properties_as_dict(object, subcontext, child_properties, &temp, error)) {
+			if (!__ni_dbus_object_get_filtered_properties(object, subcontext, child_properties, NULL, &temp, error)) {
 				ni_dbus_variant_destroy(&temp);
 				return FALSE;
 			}
@@ -800,6 +981,17 @@ __ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 	return TRUE;
 }
 
+dbus_bool_t
+__ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
+					const char *context,
+					const ni_dbus_property_t *properties,
+					ni_dbus_variant_t *dict,
+					DBusError *error)
+{
+	return __ni_dbus_object_get_filtered_properties(object, context,
+					properties, NULL, dict, error);
+}
+
 dbus_bool_t
 ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 					const ni_dbus_service_t *interface,
@@ -829,6 +1021,152 @@ ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 	return rv;
 }
 
+/*
+ * Get the properties of an object for a given interface, honoring
+ * a property filter. Properties that the schema flags as on-demand
+ * are omitted unless the filter asks for them. A NULL filter
+ * returns everything, just like ni_dbus_object_get_properties_as_dict.
+ */
+dbus_bool_t
+ni_dbus_object_get_filtered_properties_as_dict(const ni_dbus_object_t *object,
+					const ni_dbus_service_t *interface,
+					const ni_dbus_property_filter_t *filter,
+					ni_dbus_variant_t *dict,
+					DBusError *error)
+{
+	ni_string_array_t skip = NI_STRING_ARRAY_INIT;
+	DBusError local_error = DBUS_ERROR_INIT;
+	unsigned int i;
+	int rv;
+
+	if (filter == NULL || interface->on_demand.count == 0)
+		return ni_dbus_object_get_properties_as_dict(object, interface, dict, error);
+
+	if (!ni_dbus_property_filter_match_service(filter, interface))
+		return TRUE;
+
+	if (interface->properties == NULL)
+		return TRUE;
+
+	if (ni_string_array_index(&filter->on_demand, "*") < 0) {
+		for (i = 0; i < interface->on_demand.count; ++i) {
+			const char *name = interface->on_demand.data[i];
+			char qualified[256];
+
+			snprintf(qualified, sizeof(qualified), "%s.%s", interface->name, name);
+			if (ni_string_array_index(&filter->on_demand, qualified) < 0)
+				ni_string_array_append(&skip, name);
+		}
+	}
+
+	if (error == NULL)
+		error = &local_error;
+
+	rv = __ni_dbus_object_get_filtered_properties(object,
+					interface->name,
+					interface->properties,
+					&skip, dict, error);
+	dbus_error_free(&local_error);
+	ni_string_array_destroy(&skip);
+	return rv;
+}
+
+/*
+ * Property filters
+ */
+void
+ni_dbus_property_filter_init(ni_dbus_property_filter_t *filter)
+{
+	memset(filter, 0, sizeof(*filter));
+}
+
+void
+ni_dbus_property_filter_destroy(ni_dbus_property_filter_t *filter)
+{
+	ni_string_array_destroy(&filter->interfaces);
+	ni_string_array_destroy(&filter->on_demand);
+}
+
+ni_bool_t
+ni_dbus_property_filter_match_service(const ni_dbus_property_filter_t *filter,
+					const ni_dbus_service_t *service)
+{
+	if (filter == NULL || filter->interfaces.count == 0)
+		return TRUE;
+	return ni_string_array_index(&filter->interfaces, service->name) >= 0;
+}
+
+dbus_bool_t
+ni_dbus_property_filter_to_dict(const ni_dbus_property_filter_t *filter, ni_dbus_variant_t *dict)
+{
+	ni_dbus_variant_t *var;
+
+	ni_dbus_variant_init_dict(dict);
+	if (filter->interfaces.count) {
+		if (!(var = ni_dbus_dict_add(dict, "interfaces")))
+			return FALSE;
+		ni_dbus_variant_set_string_array(var, (const char **) filter->interfaces.data,
+						filter->interfaces.count);
+	}
+
+	/* Always send on-demand, even if empty - its presence is what
+	 * tells the server to omit on-demand properties. */
+	if (!(var = ni_dbus_dict_add(dict, "on-demand")))
+		return FALSE;
+	ni_dbus_variant_set_string_array(var, (const char **) filter->on_demand.data,
+					filter->on_demand.count);
+	return TRUE;
+}
+
+static dbus_bool_t
+__ni_dbus_property_filter_get_array(const ni_dbus_variant_t *dict, const char *name,
+					ni_string_array_t *array)
+{
+	const ni_dbus_variant_t *var;
+	unsigned int i;
+
+	if (!(var = ni_dbus_dict_get(dict, name)))
+		return TRUE;
+	if (!ni_dbus_variant_is_string_array(var))
+		return FALSE;
+	for (i = 0; i < var->array.len; ++i)
+		ni_string_array_append(array, var->string_array_value[i]);
+	return TRUE;
+}
+
+dbus_bool_t
+ni_dbus_property_filter_from_dict(ni_dbus_property_filter_t *filter, const ni_dbus_variant_t *dict)
+{
+	if (!ni_dbus_variant_is_dict(dict))
+		return FALSE;
+
+	return __ni_dbus_property_filter_get_array(dict, "interfaces", &filter->interfaces)
+	    && __ni_dbus_property_filter_get_array(dict, "on-demand", &filter->on_demand);
+}
+
+/*
+ * Fingerprint of a filter, used to tell apart the state
+ * snapshots clients with different filters have seen.
+ */
+unsigned int
+ni_dbus_property_filter_hash(const ni_dbus_property_filter_t *filter)
+{
+	unsigned int i, hash;
+
+	if (filter == NULL)
+		return 0;
+
+	hash = ni_hash_uint(filter->interfaces.count);
+	for (i = 0; i < filter->interfaces.count; ++i)
+		hash = ni_hash_uint(hash ^ ni_hash_string(filter->interfaces.data[i]));
+	hash = ni_hash_uint(hash ^ filter->on_demand.count);
+	for (i = 0; i < filter->on_demand.count; ++i)
+		hash = ni_hash_uint(hash ^ ni_hash_string(filter->on_demand.data[i]));
+
+	/* 0 is reserved for "no filter" */
+	return hash ? hash : 1;
+}
+
 /*
  * Helper function for setting all properties from a dict
  */
@@ -15,6 +15,7 @@
 #include <wicked/system.h>
 #include <wicked/dbus-errors.h>
 #include <wicked/dbus-service.h>
+#include "netinfo_priv.h"
 #include "dbus-common.h"
 #include "model.h"
 #include "misc.h"
@@ -141,6 +142,21 @@ __ni_objectmodel_ethernet_read_handle(const ni_dbus_object_t *object, DBusError
 	return __ni_objectmodel_ethernet_handle(object, FALSE, error);
 }
 
+/*
+ * Read the on-demand ethtool settings of a system device on first access
+ */
+static const ni_ethernet_t *
+__ni_objectmodel_ethernet_ondemand_handle(const ni_dbus_object_t *object, DBusError *error)
+{
+	ni_netdev_t *dev;
+
+	if (!(dev = ni_objectmodel_unwrap_netif(object, error)))
+		return NULL;
+
+	__ni_system_ethernet_refresh_ondemand(dev);
+	return dev->ethernet;
+}
+
 void *
 ni_objectmodel_get_ethernet(const ni_dbus_object_t *object, ni_bool_t write_access, DBusError *error)
 {
@@ -217,7 +233,7 @@ __ni_objectmodel_ethernet_get_wakeonlan(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (eth->wol.support == __NI_ETHERNET_WOL_DEFAULT ||
@@ -267,7 +283,7 @@ __ni_objectmodel_ethernet_get_offload(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 	
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (ni_tristate_is_set(eth->offload.rx_csum))
@@ -363,7 +379,7 @@ __ni_objectmodel_ethernet_get_coalesce(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (eth->coalesce.supported == NI_TRISTATE_DISABLE)
@@ -528,7 +544,7 @@ __ni_objectmodel_ethernet_get_eee(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (eth->eee.supported == NI_TRISTATE_DISABLE)
@@ -593,7 +609,7 @@ __ni_objectmodel_ethernet_get_channels(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (eth->channels.supported == NI_TRISTATE_DISABLE)
@@ -656,7 +672,7 @@ __ni_objectmodel_ethernet_get_ring(const ni_dbus_object_t *object,
 {
 	const ni_ethernet_t *eth;
 
-	if (!(eth = __ni_objectmodel_ethernet_read_handle(object, error)))
+	if (!(eth = __ni_objectmodel_ethernet_ondemand_handle(object, error)))
 		return FALSE;
 
 	if (eth->ring.supported == NI_TRISTATE_DISABLE)
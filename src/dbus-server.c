@@ -7,6 +7,9 @@
 #include "config.h"
 #endif
 
+#include <unistd.h>
+#include <time.h>
+
 #include <wicked/util.h>
 #include <wicked/logging.h>
 #include <wicked/dbus-service.h>
@@ -18,8 +21,24 @@
 #include "util_priv.h"
 
 
+/*
+ * Generation at which the object's properties last changed, as seen by
+ * GetManagedObjectsSince, and their checksum. Clients may ask for different
+ * property subsets, so we track a few of these per object, keyed by the
+ * fingerprint of the property filter.
+ */
+#define NI_DBUS_SERVER_OBJECT_STATES	4
+
+typedef struct ni_dbus_server_object_state {
+	unsigned int		filter;
+	uint32_t		generation;
+	uint64_t		state_hash;
+} ni_dbus_server_object_state_t;
+
 struct ni_dbus_server_object {
 	ni_dbus_server_t *	server;			/* back pointer at server */
+
+	ni_dbus_server_object_state_t state[NI_DBUS_SERVER_OBJECT_STATES];
 };
 
 static const ni_dbus_class_t	dbus_root_object_class = {
@@ -29,6 +48,9 @@ static const ni_dbus_class_t	dbus_root_object_class = {
 struct ni_dbus_server {
 	ni_dbus_connection_t *	connection;
 	ni_dbus_object_t *	root_object;
+
+	uint32_t		epoch;			/* identifies this server instance */
+	uint32_t		generation;		/* last object generation handed out */
 };
 
 static dbus_bool_t		ni_dbus_object_register_object_manager(ni_dbus_object_t *);
@@ -48,6 +70,7 @@ ni_dbus_server_open(const char *bus_type, const char *bus_name, void *root_objec
 	ni_debug_dbus("%s(%s)", __FUNCTION__, bus_name);
 
 	server = xcalloc(1, sizeof(*server));
+	server->epoch = ((uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16)) | 1;
 	server->connection = ni_dbus_connection_open(bus_type, bus_name);
 	if (server->connection == NULL) {
 		ni_dbus_server_free(server);
@@ -217,7 +240,12 @@ static const ni_dbus_service_t __ni_dbus_object_manager_interface;
 static const ni_dbus_service_t __ni_dbus_object_properties_interface;
 static const ni_dbus_service_t __ni_dbus_object_introspectable_interface;
 static dbus_bool_t		__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *,
+					const ni_dbus_property_filter_t *,
 					ni_dbus_variant_t *dict, DBusError *);
+static dbus_bool_t		__ni_dbus_object_manager_enumerate_changed(ni_dbus_object_t *,
+					const ni_dbus_property_filter_t *, uint32_t since,
+					ni_dbus_variant_t *dict, ni_dbus_variant_t *paths,
+					DBusError *);
 
 dbus_bool_t
 ni_dbus_object_register_object_manager(ni_dbus_object_t *object)
@@ -257,6 +285,39 @@ ni_dbus_get_standard_service(const char *name)
 	return NULL;
 }
 
+/*
+ * Parse the optional property filter argument of GetManagedObjects,
+ * GetManagedObjectsSince and GetAll. Returns NULL in @filter_p if the
+ * argument was not given.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_arg_filter(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+				unsigned int argc, const ni_dbus_variant_t *argv, unsigned int index,
+				ni_dbus_property_filter_t *filter, const ni_dbus_property_filter_t **filter_p,
+				DBusError *error)
+{
+	*filter_p = NULL;
+	if (argc <= index)
+		return TRUE;
+
+	if (argc > index + 1 || !ni_dbus_property_filter_from_dict(filter, &argv[index])) {
+		ni_dbus_property_filter_destroy(filter);
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s: bad property filter in call to %s", object->path, method->name);
+		return FALSE;
+	}
+
+	*filter_p = filter;
+	return TRUE;
+}
+
+/*
+ * GetManagedObjects([filter])
+ *
+ * The optional a{sv} filter argument restricts the reply to the listed
+ * "interfaces", and to the on-demand properties listed in "on-demand".
+ * Without it, all properties of all interfaces are returned.
+ */
 static dbus_bool_t
 __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 		const ni_dbus_method_t *method,
@@ -265,21 +326,85 @@ __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 		DBusError *error)
 {
 	ni_dbus_variant_t obj_dict = NI_DBUS_VARIANT_INIT;
+	ni_dbus_property_filter_t filter = NI_DBUS_PROPERTY_FILTER_INIT;
+	const ni_dbus_property_filter_t *fp;
 	int rv = TRUE;
 
 	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
 
+	if (!__ni_dbus_object_manager_arg_filter(object, method, argc, argv, 0, &filter, &fp, error))
+		return FALSE;
+
 	ni_dbus_variant_init_dict(&obj_dict);
-	rv = __ni_dbus_object_manager_enumerate_object(object, &obj_dict, error);
+	rv = __ni_dbus_object_manager_enumerate_object(object, fp, &obj_dict, error);
 	if (rv)
 		rv = ni_dbus_message_serialize_variants(reply, 1, &obj_dict, error);
 	ni_dbus_variant_destroy(&obj_dict);
+	ni_dbus_property_filter_destroy(&filter);
 
 	return rv;
 }
 
+/*
+ * GetManagedObjectsSince(epoch, generation[, filter])
+ *
+ * Differential variant of GetManagedObjects. Returns the server epoch, the
+ * current generation, the objects whose properties changed after the given
+ * generation, and the paths of all objects the call covers, so that the
+ * caller can purge objects that went away.
+ * If the epoch doesn't match (e.g. because the server has been restarted),
+ * all objects are returned. The filter is the same as for GetManagedObjects.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_get_managed_objects_since(ni_dbus_object_t *object,
+		const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply,
+		DBusError *error)
+{
+	ni_dbus_server_t *server = ni_dbus_object_get_server(object);
+	ni_dbus_variant_t result[4] = {
+		NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT,
+		NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT
+	};
+	ni_dbus_property_filter_t filter = NI_DBUS_PROPERTY_FILTER_INIT;
+	const ni_dbus_property_filter_t *fp;
+	uint32_t epoch, since;
+	unsigned int i;
+	int rv = TRUE;
+
+	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
+
+	if (server == NULL || argc < 2
+	 || !ni_dbus_variant_get_uint32(&argv[0], &epoch)
+	 || !ni_dbus_variant_get_uint32(&argv[1], &since)) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s: bad arguments in call to %s", object->path, method->name);
+		return FALSE;
+	}
+	if (!__ni_dbus_object_manager_arg_filter(object, method, argc, argv, 2, &filter, &fp, error))
+		return FALSE;
+	if (epoch != server->epoch)
+		since = 0;
+
+	ni_dbus_variant_init_dict(&result[2]);
+	ni_dbus_variant_init_string_array(&result[3]);
+	rv = __ni_dbus_object_manager_enumerate_changed(object, fp, since, &result[2], &result[3], error);
+	ni_dbus_property_filter_destroy(&filter);
+
+	ni_dbus_variant_set_uint32(&result[0], server->epoch);
+	ni_dbus_variant_set_uint32(&result[1], server->generation);
+	if (rv)
+		rv = ni_dbus_message_serialize_variants(reply, 4, result, error);
+
+	for (i = 0; i < 4; ++i)
+		ni_dbus_variant_destroy(&result[i]);
+	return rv;
+}
+
 static ni_dbus_method_t	__ni_dbus_object_manager_methods[] = {
 	{ "GetManagedObjects",		NULL,		__ni_dbus_object_manager_get_managed_objects },
+	{ "GetManagedObjectsSince",	NULL,		__ni_dbus_object_manager_get_managed_objects_since },
 	{ NULL }
 };
 
@@ -351,35 +476,51 @@ __ni_dbus_object_properties_arg_property(ni_dbus_object_t *object, const ni_dbus
 }
 
 /*
- * This method implements Properties.GetAll
+ * This method implements Properties.GetAll, with an optional
+ * property filter as second argument (see GetManagedObjects).
  */
 static dbus_bool_t
 __ni_dbus_object_properties_getall(ni_dbus_object_t *object, const ni_dbus_method_t *method,
 		unsigned int argc, const ni_dbus_variant_t *argv,
 		ni_dbus_message_t *reply, DBusError *error)
 {
+	ni_dbus_property_filter_t filter = NI_DBUS_PROPERTY_FILTER_INIT;
+	const ni_dbus_property_filter_t *fp;
 	const ni_dbus_service_t *service;
 	ni_dbus_variant_t dict = NI_DBUS_VARIANT_INIT;
 	int rv = TRUE;
 
+	if (argc < 1 || argv[0].type != DBUS_TYPE_STRING) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s: bad arguments in call to %s", object->path, method->name);
+		return FALSE;
+	}
+
 	if (!__ni_dbus_object_properties_arg_interface(object, method,
 				argv[0].string_value, error, &service))
 		return FALSE;
 
+	if (!__ni_dbus_object_manager_arg_filter(object, method, argc, argv, 1, &filter, &fp, error))
+		return FALSE;
+
 	ni_dbus_variant_init_dict(&dict);
 	if (service != NULL) {
-		rv = ni_dbus_object_get_properties_as_dict(object, service, &dict, error);
+		rv = ni_dbus_object_get_filtered_properties_as_dict(object, service, fp, &dict, error);
 	} else {
 		unsigned int i;
 
-		for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i)
-			rv = ni_dbus_object_get_properties_as_dict(object, service, &dict, error);
+		for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i) {
+			if (!ni_dbus_property_filter_match_service(fp, service))
+				continue;
+			rv = ni_dbus_object_get_filtered_properties_as_dict(object, service, fp, &dict, error);
+		}
 	}
 
 	if (rv)
 		rv = ni_dbus_message_serialize_variants(reply, 1, &dict, error);
 
 	ni_dbus_variant_destroy(&dict);
+	ni_dbus_property_filter_destroy(&filter);
 	return rv;
 }
 
@@ -467,7 +608,7 @@ __ni_dbus_object_properties_set(ni_dbus_object_t *object, const ni_dbus_method_t
 }
 
 static ni_dbus_method_t	__ni_dbus_object_properties_methods[] = {
-	{ "GetAll",		"s",		__ni_dbus_object_properties_getall },
+	{ "GetAll",		NULL,		__ni_dbus_object_properties_getall },
 	{ "Get",		"ss",		__ni_dbus_object_properties_get },
 	{ "Set",		"ssv",		__ni_dbus_object_properties_set },
 	{ NULL }
@@ -506,7 +647,8 @@ static const ni_dbus_service_t __ni_dbus_object_introspectable_interface = {
 };
 
 dbus_bool_t
-__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_variant_t *obj_dict, DBusError *error)
+__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, const ni_dbus_property_filter_t *filter,
+				ni_dbus_variant_t *obj_dict, DBusError *error)
 {
 	ni_dbus_object_t *child;
 	int rv = TRUE;
@@ -518,10 +660,14 @@ __ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_vari
 
 		ni_dbus_variant_init_dict(ifdict);
 		for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i) {
-			ni_dbus_variant_t *propdict = ni_dbus_dict_add(ifdict, service->name);
+			ni_dbus_variant_t *propdict;
 
+			if (!ni_dbus_property_filter_match_service(filter, service))
+				continue;
+
+			propdict = ni_dbus_dict_add(ifdict, service->name);
 			ni_dbus_variant_init_dict(propdict);
-			rv = ni_dbus_object_get_properties_as_dict(object, service, propdict, error);
+			rv = ni_dbus_object_get_filtered_properties_as_dict(object, service, filter, propdict, error);
 		}
 	}
 
@@ -537,7 +683,203 @@ __ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_vari
 			continue;
 		}
 
-		rv = __ni_dbus_object_manager_enumerate_object(child, obj_dict, error);
+		rv = __ni_dbus_object_manager_enumerate_object(child, filter, obj_dict, error);
+	}
+
+	return rv;
+}
+
+/*
+ * Checksum a property dict, so that we can tell whether an object
+ * changed since the last GetManagedObjectsSince call (64bit FNV-1a).
+ */
+static inline uint64_t
+__ni_dbus_hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static inline uint64_t
+__ni_dbus_hash_string(uint64_t hash, const char *string)
+{
+	/* include the NUL byte to tell NULL, "" and "a","b" vs "ab" apart */
+	return string ? __ni_dbus_hash_bytes(hash, string, strlen(string) + 1)
+		      : __ni_dbus_hash_bytes(hash, "\377", 1);
+}
+
+static uint64_t
+__ni_dbus_variant_hash(uint64_t hash, const ni_dbus_variant_t *var)
+{
+	unsigned int i;
+
+	hash = __ni_dbus_hash_bytes(hash, &var->type, sizeof(var->type));
+	switch (var->type) {
+	case DBUS_TYPE_STRING:
+	case DBUS_TYPE_OBJECT_PATH:
+		return __ni_dbus_hash_string(hash, var->string_value);
+
+	case DBUS_TYPE_BYTE:
+		return __ni_dbus_hash_bytes(hash, &var->byte_value, sizeof(var->byte_value));
+	case DBUS_TYPE_BOOLEAN:
+		return __ni_dbus_hash_bytes(hash, &var->bool_value, sizeof(var->bool_value));
+	case DBUS_TYPE_INT16:
+	case DBUS_TYPE_UINT16:
+		return __ni_dbus_hash_bytes(hash, &var->uint16_value, sizeof(var->uint16_value));
+	case DBUS_TYPE_INT32:
+	case DBUS_TYPE_UINT32:
+		return __ni_dbus_hash_bytes(hash, &var->uint32_value, sizeof(var->uint32_value));
+	case DBUS_TYPE_INT64:
+	case DBUS_TYPE_UINT64:
+		return __ni_dbus_hash_bytes(hash, &var->uint64_value, sizeof(var->uint64_value));
+	case DBUS_TYPE_DOUBLE:
+		return __ni_dbus_hash_bytes(hash, &var->double_value, sizeof(var->double_value));
+
+	case DBUS_TYPE_STRUCT:
+		hash = __ni_dbus_hash_bytes(hash, &var->array.len, sizeof(var->array.len));
+		for (i = 0; i < var->array.len; ++i)
+			hash = __ni_dbus_variant_hash(hash, &var->struct_value[i]);
+		return hash;
+
+	case DBUS_TYPE_ARRAY:
+		break;
+
+	default:
+		return hash;
+	}
+
+	hash = __ni_dbus_hash_bytes(hash, &var->array.element_type, sizeof(var->array.element_type));
+	hash = __ni_dbus_hash_string(hash, var->array.element_signature);
+	hash = __ni_dbus_hash_bytes(hash, &var->array.len, sizeof(var->array.len));
+
+	switch (var->array.element_type) {
+	case DBUS_TYPE_BYTE:
+		hash = __ni_dbus_hash_bytes(hash, var->byte_array_value, var->array.len);
+		break;
+	case DBUS_TYPE_STRING:
+	case DBUS_TYPE_OBJECT_PATH:
+		for (i = 0; i < var->array.len; ++i)
+			hash = __ni_dbus_hash_string(hash, var->string_array_value[i]);
+		break;
+	case DBUS_TYPE_DICT_ENTRY:
+		for (i = 0; i < var->array.len; ++i) {
+			hash = __ni_dbus_hash_string(hash, var->dict_array_value[i].key);
+			hash = __ni_dbus_variant_hash(hash, &var->dict_array_value[i].datum);
+		}
+		break;
+	case DBUS_TYPE_INVALID:
+		if (var->array.element_signature == NULL)
+			break;
+		/* fallthrough */
+	case DBUS_TYPE_VARIANT:
+		for (i = 0; i < var->array.len; ++i)
+			hash = __ni_dbus_variant_hash(hash, &var->variant_array_value[i]);
+		break;
+	case DBUS_TYPE_STRUCT:
+		for (i = 0; i < var->array.len; ++i)
+			hash = __ni_dbus_variant_hash(hash, &var->struct_value[i]);
+		break;
+	default:
+		break;
+	}
+	return hash;
+}
+
+/*
+ * Find the change tracking state for the given filter fingerprint.
+ * If there is none, recycle the least recently changed one; its
+ * generation is reset so the object is reported as changed.
+ */
+static ni_dbus_server_object_state_t *
+__ni_dbus_server_object_get_state(ni_dbus_server_object_t *sob, unsigned int filter)
+{
+	ni_dbus_server_object_state_t *state, *oldest = NULL;
+	unsigned int i;
+
+	for (i = 0; i < NI_DBUS_SERVER_OBJECT_STATES; ++i) {
+		state = &sob->state[i];
+		if (state->generation && state->filter == filter)
+			return state;
+		if (oldest == NULL || state->generation < oldest->generation)
+			oldest = state;
+	}
+
+	oldest->filter = filter;
+	oldest->generation = 0;
+	oldest->state_hash = 0;
+	return oldest;
+}
+
+/*
+ * Walk the object hierarchy like __ni_dbus_object_manager_enumerate_object,
+ * but only return the property dicts of objects which changed after
+ * generation @since. The paths of all objects are returned in @paths.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_enumerate_changed(ni_dbus_object_t *object,
+				const ni_dbus_property_filter_t *filter, uint32_t since,
+				ni_dbus_variant_t *obj_dict, ni_dbus_variant_t *paths,
+				DBusError *error)
+{
+	ni_dbus_server_object_t *sob = object->server_object;
+	ni_dbus_object_t *child;
+	int rv = TRUE;
+
+	if (object->interfaces && sob) {
+		ni_dbus_variant_t ifdict = NI_DBUS_VARIANT_INIT;
+		ni_dbus_server_object_state_t *state;
+		const ni_dbus_service_t *service;
+		uint64_t hash;
+		unsigned int i;
+
+		ni_dbus_variant_init_dict(&ifdict);
+		for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i) {
+			ni_dbus_variant_t *propdict;
+
+			if (!ni_dbus_property_filter_match_service(filter, service))
+				continue;
+
+			propdict = ni_dbus_dict_add(&ifdict, service->name);
+			ni_dbus_variant_init_dict(propdict);
+			rv = ni_dbus_object_get_filtered_properties_as_dict(object, service, filter, propdict, error);
+		}
+		if (!rv) {
+			ni_dbus_variant_destroy(&ifdict);
+			return rv;
+		}
+
+		hash = __ni_dbus_variant_hash(0xcbf29ce484222325ULL, &ifdict);
+		state = __ni_dbus_server_object_get_state(sob, ni_dbus_property_filter_hash(filter));
+		if (state->generation == 0 || state->state_hash != hash) {
+			state->generation = ++(sob->server->generation);
+			state->state_hash = hash;
+		}
+
+		ni_dbus_variant_append_string_array(paths, object->path);
+		if (state->generation > since) {
+			ni_dbus_variant_t *entry = ni_dbus_dict_add(obj_dict, object->path);
+
+			/* move the dict over */
+			*entry = ifdict;
+		} else {
+			ni_dbus_variant_destroy(&ifdict);
+		}
+	}
+
+	for (child = object->children; child && rv; child = child->next) {
+		/* Refresh children just like __ni_dbus_object_manager_enumerate_object */
+		if (child->class && child->class->refresh
+		 && !child->class->refresh(object)) {
+			rv = FALSE;
+			continue;
+		}
+
+		rv = __ni_dbus_object_manager_enumerate_changed(child, filter, since, obj_dict, paths, error);
 	}
 
 	return rv;
@@ -67,6 +67,35 @@ ni_dbus_xml_init(void)
 	return schema;
 }
 
+/*
+ * Record which members of the service's properties dict are
+ * flagged on-demand="true" in the schema.
+ */
+static void
+ni_dbus_xml_register_on_demand(const ni_xs_scope_t *scope, const ni_xs_service_t *xs_service,
+				ni_dbus_service_t *service)
+{
+	const ni_xs_name_type_array_t *children;
+	const ni_xs_type_t *type;
+	unsigned int i;
+
+	ni_string_array_destroy(&service->on_demand);
+
+	if (!(scope = ni_xs_scope_lookup_scope(scope, xs_service->name)))
+		return;
+	if (!(type = ni_xs_scope_lookup_local(scope, "properties")) || type->class != NI_XS_TYPE_DICT)
+		return;
+
+	children = &type->u.dict_info->children;
+	for (i = 0; i < children->count; ++i) {
+		if (children->data[i].on_demand)
+			ni_string_array_append(&service->on_demand, children->data[i].name);
+	}
+
+	if (service->on_demand.count)
+		ni_debug_dbus("%s: %u on-demand properties", service->name, service->on_demand.count);
+}
+
 /*
  * Register all services defined by the schema
  */
@@ -118,6 +147,7 @@ ni_dbus_xml_register_services(ni_xs_scope_t *scope)
 		}
 
 		service->schema = xs_service;
+		ni_dbus_xml_register_on_demand(scope, xs_service, service);
 
 		if (xs_service->methods)
 			service->methods = ni_dbus_xml_register_methods(xs_service, xs_service->methods, service->methods);
@@ -1766,35 +1796,23 @@ int
 ni_dbus_xml_expand_element_reference(xml_node_t *doc_node, const char *expr_string,
 			xml_node_t **ret_nodes, unsigned int max_nodes)
 {
-	xpath_enode_t *expression;
-	xpath_result_t *result;
-	unsigned int i, nret;
+	const xpath_enode_t *expression;
+	int nret;
 
 	if (xml_node_is_empty(doc_node))
 		return 0;
 
-	expression = xpath_expression_parse(expr_string);
+	expression = xpath_expression_get(expr_string);
 	if (expression == NULL)
 		return -NI_ERROR_DOCUMENT_ERROR;
 
-	result = xpath_expression_eval(expression, doc_node);
-	xpath_expression_free(expression);
-
-	if (result == NULL)
+	nret = xpath_expression_eval_elements(expression, doc_node, ret_nodes, max_nodes);
+	if (nret < 0) {
+		ni_error("%s: non-element result of xpath expression \"%s\"",
+				xml_node_location(doc_node), expr_string);
 		return -NI_ERROR_DOCUMENT_ERROR;
-
-	for (i = nret = 0; i < result->count; ++i) {
-		if (result->node[i].type != XPATH_ELEMENT) {
-			ni_error("%s: non-element result of xpath expression \"%s\"",
-					xml_node_location(doc_node), expr_string);
-			xpath_result_free(result);
-			return -NI_ERROR_DOCUMENT_ERROR;
-		}
-		if (nret < max_nodes)
-			ret_nodes[nret++] = result->node[i].value.node;
 	}
 
-	xpath_result_free(result);
 	return nret;
 }
 
@@ -9,6 +9,13 @@
 #include <net/if_arp.h>
 #include <linux/ethtool.h>
 #include <errno.h>
+#ifdef HAVE_LINUX_ETHTOOL_NETLINK_H
+#include <stddef.h>
+#include <linux/genetlink.h>
+#include <linux/ethtool_netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#endif
 
 #include <wicked/util.h>
 #include <wicked/ethernet.h>
@@ -52,9 +59,12 @@
 	 ADVERTISED_Backplane |			\
 	 ALL_ADVERTISED_MODES)
 
-static void	__ni_system_ethernet_get(const char *, ni_ethernet_t *);
-static void	__ni_system_ethernet_set(const char *, ni_ethernet_t *);
+static void	__ni_system_ethernet_get(const char *, unsigned int, ni_ethernet_t *);
+static void	__ni_system_ethernet_get_ondemand(const char *, unsigned int, ni_ethernet_t *);
+static void	__ni_system_ethernet_set(const char *, unsigned int, ni_ethernet_t *);
 static int	__ni_ethtool_get_gset(const char *, ni_ethernet_t *);
+static void	__ni_ethtool_gset_from_cmd(const char *, ni_ethernet_t *,
+					const struct ethtool_cmd *);
 static void	ni_ethtool_offload_init(ni_ethtool_offload_t *);
 static void	ni_ethtool_eee_init(ni_ethtool_eee_t *);
 static void	ni_ethtool_ring_init(ni_ethtool_ring_t *);
@@ -394,28 +404,20 @@ __ni_ethtool_set_tristate(const char *ifname, __ni_ioctl_info_t *ioc, int value)
 	return __ni_ethtool_set_value(ifname, ioc, kern_value);
 }
 
-static int
-__ni_ethtool_get_wol(const char *ifname, ni_ethernet_wol_t *wol)
+static void
+__ni_ethtool_wol_from_wolinfo(const char *ifname, ni_ethernet_wol_t *wol,
+				const struct ethtool_wolinfo *wolinfo)
 {
-	struct ethtool_wolinfo wolinfo;
-
-	memset(&wolinfo, 0, sizeof(wolinfo));
-	if (__ni_ethtool_do(ifname, &__ethtool_gwol, &wolinfo) < 0) {
-		wol->support = wol->options = __NI_ETHERNET_WOL_DISABLE;
-		wol->sopass.len = 0;
-		return -1;
-	}
-
 	wol->support = __ni_ethtool_to_wicked_bits(__ni_ethtool_wol_map,
-							wolinfo.supported);
+							wolinfo->supported);
 	wol->options  = __ni_ethtool_to_wicked_bits(__ni_ethtool_wol_map,
-							wolinfo.wolopts);
+							wolinfo->wolopts);
 
 	if (wol->options & (1<<NI_ETHERNET_WOL_SECUREON)
-	&&  NI_MAXHWADDRLEN > sizeof(wolinfo.sopass)) {
+	&&  NI_MAXHWADDRLEN > sizeof(wolinfo->sopass)) {
 		wol->sopass.type = ARPHRD_ETHER;
-		wol->sopass.len = sizeof(wolinfo.sopass);
-		memcpy(&wol->sopass.data, wolinfo.sopass, sizeof(wolinfo.sopass));
+		wol->sopass.len = sizeof(wolinfo->sopass);
+		memcpy(&wol->sopass.data, wolinfo->sopass, sizeof(wolinfo->sopass));
 	}
 
 	if (ni_debug_guard(NI_LOG_DEBUG3, NI_TRACE_IFCONFIG)) {
@@ -440,7 +442,21 @@ __ni_ethtool_get_wol(const char *ifname, ni_ethernet_wol_t *wol)
 		ni_trace("%s: %s() %s", ifname, __func__, buf.string);
 		ni_stringbuf_destroy(&buf);
 	}
+}
 
+static int
+__ni_ethtool_get_wol(const char *ifname, ni_ethernet_wol_t *wol)
+{
+	struct ethtool_wolinfo wolinfo;
+
+	memset(&wolinfo, 0, sizeof(wolinfo));
+	if (__ni_ethtool_do(ifname, &__ethtool_gwol, &wolinfo) < 0) {
+		wol->support = wol->options = __NI_ETHERNET_WOL_DISABLE;
+		wol->sopass.len = 0;
+		return -1;
+	}
+
+	__ni_ethtool_wol_from_wolinfo(ifname, wol, &wolinfo);
 	return 0;
 }
 
@@ -712,12 +728,31 @@ __ni_system_ethernet_refresh(ni_netdev_t *dev)
 	ether->permanent_address.type = dev->link.hwaddr.type;
 
 	/* "unset" defaults until it is ready (using it's final name) */
-	if (ni_netdev_device_is_ready(dev))
-		__ni_system_ethernet_get(dev->name, ether);
+	if (ni_netdev_device_is_ready(dev)) {
+		__ni_system_ethernet_get(dev->name, dev->link.ifindex, ether);
+		ether->ondemand_pending = TRUE;
+	}
 
 	ni_netdev_set_ethernet(dev, ether);
 }
 
+/*
+ * Get the ethtool settings behind the on-demand properties.
+ * They're read on first access after a refresh, not in it.
+ */
+void
+__ni_system_ethernet_refresh_ondemand(ni_netdev_t *dev)
+{
+	ni_ethernet_t *ether;
+
+	if (!dev || !(ether = dev->ethernet) || !ether->ondemand_pending)
+		return;
+
+	ether->ondemand_pending = FALSE;
+	if (ni_netdev_device_is_ready(dev))
+		__ni_system_ethernet_get_ondemand(dev->name, dev->link.ifindex, ether);
+}
+
 ni_bool_t
 ni_ethtool_validate_uint_param(unsigned int *curr, unsigned int wanted,
 		unsigned int max, const char *type, const char *rparam, const char *ifname)
@@ -1206,13 +1241,846 @@ ni_ethtool_set_channels(const char *ifname, ni_ethtool_channels_t *channels)
 
 	return 0;
 }
+#ifdef HAVE_LINUX_ETHTOOL_NETLINK_H
+/*
+ * ethtool netlink interface (linux 5.6+)
+ *
+ * Instead of issuing one SIOCETHTOOL ioctl per setting, we request all
+ * settings of a device in a single batch of generic netlink messages and
+ * apply ring, channels, coalesce and eee changes the same way. All the
+ * commands we use were added in the same kernel release, so we use the
+ * netlink interface when the "ethtool" family exists and the ioctls when
+ * it does not.
+ */
+#define NI_ETHTOOL_NL_ATTR_MAX		64
+
+static struct {
+	ni_bool_t		probed;
+	int			family;
+	ni_netlink_t *		nl;
+} __ni_ethtool_nl = { .probed = FALSE, .family = -1, .nl = NULL };
+
+/*
+ * Maps an ethtool netlink u8/u32 attribute to the corresponding member
+ * of the ioctl struct. Settable parameters also refer to the member of
+ * our struct and to the limit (a member of the ioctl struct or fixed).
+ */
+typedef struct __ni_ethtool_nl_param {
+	unsigned int		attr;
+	ni_bool_t		flag;
+	size_t			ioc;
+	const char *		name;
+	ssize_t			want;
+	ssize_t			max;
+	unsigned int		limit;
+} __ni_ethtool_nl_param_t;
+
+#define __NI_ETHTOOL_NL_MAX(attr, type, member) \
+	{ attr, FALSE, offsetof(type, member), NULL, -1, -1, 0 }
+#define __NI_ETHTOOL_NL_RO(attr, flag, type, member, ni_type, ni_member) \
+	{ attr, flag, offsetof(type, member), NULL, offsetof(ni_type, ni_member), -1, 0 }
+#define __NI_ETHTOOL_NL_RW(attr, flag, type, member, name, ni_type, ni_member, max_member) \
+	{ attr, flag, offsetof(type, member), name, offsetof(ni_type, ni_member), offsetof(type, max_member), 0 }
+#define __NI_ETHTOOL_NL_RW_LIMIT(attr, flag, type, member, name, ni_type, ni_member, limit) \
+	{ attr, flag, offsetof(type, member), name, offsetof(ni_type, ni_member), -1, limit }
+
+static const __ni_ethtool_nl_param_t	__ni_ethtool_nl_ring_params[] = {
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_RINGS_RX_MAX,	  struct ethtool_ringparam, rx_max_pending),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_RINGS_RX_MINI_MAX,  struct ethtool_ringparam, rx_mini_max_pending),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_RINGS_RX_JUMBO_MAX, struct ethtool_ringparam, rx_jumbo_max_pending),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_RINGS_TX_MAX,	  struct ethtool_ringparam, tx_max_pending),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_RINGS_TX, FALSE, struct ethtool_ringparam, tx_pending,
+			"tx", ni_ethtool_ring_t, tx, tx_max_pending),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_RINGS_RX, FALSE, struct ethtool_ringparam, rx_pending,
+			"rx", ni_ethtool_ring_t, rx, rx_max_pending),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_RINGS_RX_JUMBO, FALSE, struct ethtool_ringparam, rx_jumbo_pending,
+			"rx-jumbo", ni_ethtool_ring_t, rx_jumbo, rx_jumbo_max_pending),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_RINGS_RX_MINI, FALSE, struct ethtool_ringparam, rx_mini_pending,
+			"rx-mini", ni_ethtool_ring_t, rx_mini, rx_mini_max_pending),
+	{ 0 }
+};
+
+static const __ni_ethtool_nl_param_t	__ni_ethtool_nl_channels_params[] = {
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_CHANNELS_RX_MAX,	     struct ethtool_channels, max_rx),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_CHANNELS_TX_MAX,	     struct ethtool_channels, max_tx),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_CHANNELS_OTHER_MAX,    struct ethtool_channels, max_other),
+	__NI_ETHTOOL_NL_MAX(ETHTOOL_A_CHANNELS_COMBINED_MAX, struct ethtool_channels, max_combined),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_CHANNELS_TX_COUNT, FALSE, struct ethtool_channels, tx_count,
+			"tx", ni_ethtool_channels_t, tx, max_tx),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_CHANNELS_RX_COUNT, FALSE, struct ethtool_channels, rx_count,
+			"rx", ni_ethtool_channels_t, rx, max_rx),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_CHANNELS_OTHER_COUNT, FALSE, struct ethtool_channels, other_count,
+			"other", ni_ethtool_channels_t, other, max_other),
+	__NI_ETHTOOL_NL_RW(ETHTOOL_A_CHANNELS_COMBINED_COUNT, FALSE, struct ethtool_channels, combined_count,
+			"combined", ni_ethtool_channels_t, combined, max_combined),
+	{ 0 }
+};
+
+#define __NI_ETHTOOL_NL_COALESCE(attr, member, name, ni_member) \
+	__NI_ETHTOOL_NL_RW_LIMIT(attr, FALSE, struct ethtool_coalesce, member, \
+			name, ni_ethtool_coalesce_t, ni_member, NI_ETHTOOL_COALESCE_DEFAULT)
+
+static const __ni_ethtool_nl_param_t	__ni_ethtool_nl_coalesce_params[] = {
+	__NI_ETHTOOL_NL_RW_LIMIT(ETHTOOL_A_COALESCE_USE_ADAPTIVE_TX, TRUE, struct ethtool_coalesce,
+			use_adaptive_tx_coalesce, "adaptive_tx", ni_ethtool_coalesce_t,
+			adaptive_tx, NI_TRISTATE_ENABLE),
+	__NI_ETHTOOL_NL_RW_LIMIT(ETHTOOL_A_COALESCE_USE_ADAPTIVE_RX, TRUE, struct ethtool_coalesce,
+			use_adaptive_rx_coalesce, "adaptive_rx", ni_ethtool_coalesce_t,
+			adaptive_rx, NI_TRISTATE_ENABLE),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_PKT_RATE_LOW,	pkt_rate_low,
+			"pkt_rate_low", pkt_rate_low),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_PKT_RATE_HIGH,	pkt_rate_high,
+			"pkt_rate_high", pkt_rate_high),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RATE_SAMPLE_INTERVAL, rate_sample_interval,
+			"sample_interval", sample_interval),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_STATS_BLOCK_USECS, stats_block_coalesce_usecs,
+			"stats_block_usecs", stats_block_usecs),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_USECS,		rx_coalesce_usecs,
+			"rx_usecs", rx_usecs),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_USECS_IRQ,	rx_coalesce_usecs_irq,
+			"rx_usecs_irq", rx_usecs_irq),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_USECS_LOW,	rx_coalesce_usecs_low,
+			"rx_usecs_low", rx_usecs_low),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_USECS_HIGH,	rx_coalesce_usecs_high,
+			"rx_usecs_high", rx_usecs_high),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_MAX_FRAMES,	rx_max_coalesced_frames,
+			"rx_frames", rx_frames),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_MAX_FRAMES_IRQ,	rx_max_coalesced_frames_irq,
+			"rx_frames_irq", rx_frames_irq),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_MAX_FRAMES_LOW,	rx_max_coalesced_frames_low,
+			"rx_frames_low", rx_frames_low),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_RX_MAX_FRAMES_HIGH,	rx_max_coalesced_frames_high,
+			"rx_frames_high", rx_frames_high),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_USECS,		tx_coalesce_usecs,
+			"tx_usecs", tx_usecs),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_USECS_IRQ,	tx_coalesce_usecs_irq,
+			"tx_usecs_irq", tx_usecs_irq),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_USECS_LOW,	tx_coalesce_usecs_low,
+			"tx_usecs_low", tx_usecs_low),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_USECS_HIGH,	tx_coalesce_usecs_high,
+			"tx_usecs_high", tx_usecs_high),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_MAX_FRAMES,	tx_max_coalesced_frames,
+			"tx_frames", tx_frames),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_MAX_FRAMES_IRQ,	tx_max_coalesced_frames_irq,
+			"tx_frames_irq", tx_frames_irq),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_MAX_FRAMES_LOW,	tx_max_coalesced_frames_low,
+			"tx_frames_low", tx_frames_low),
+	__NI_ETHTOOL_NL_COALESCE(ETHTOOL_A_COALESCE_TX_MAX_FRAMES_HIGH,	tx_max_coalesced_frames_high,
+			"tx_frames_high", tx_frames_high),
+	{ 0 }
+};
+
+static const __ni_ethtool_nl_param_t	__ni_ethtool_nl_eee_params[] = {
+	__NI_ETHTOOL_NL_RO(ETHTOOL_A_EEE_ACTIVE, TRUE, struct ethtool_eee, eee_active,
+			ni_ethtool_eee_t, status.active),
+	__NI_ETHTOOL_NL_RW_LIMIT(ETHTOOL_A_EEE_ENABLED, TRUE, struct ethtool_eee, eee_enabled,
+			"enable", ni_ethtool_eee_t, status.enabled, NI_TRISTATE_ENABLE),
+	__NI_ETHTOOL_NL_RW_LIMIT(ETHTOOL_A_EEE_TX_LPI_ENABLED, TRUE, struct ethtool_eee, tx_lpi_enabled,
+			"tx-lpi", ni_ethtool_eee_t, tx_lpi.enabled, NI_TRISTATE_ENABLE),
+	__NI_ETHTOOL_NL_RW_LIMIT(ETHTOOL_A_EEE_TX_LPI_TIMER, FALSE, struct ethtool_eee, tx_lpi_timer,
+			"tx-timer", ni_ethtool_eee_t, tx_lpi.timer, NI_ETHTOOL_EEE_DEFAULT),
+	{ 0 }
+};
+
+/*
+ * The ioctl structs we convert the netlink replies to, so that both
+ * interfaces share the code translating them into our structs.
+ */
+typedef struct __ni_ethtool_nl_data {
+	struct ethtool_cmd		ecmd;
+	struct ethtool_wolinfo		wolinfo;
+	ni_ethtool_offload_t		offload;
+	struct ethtool_ringparam	ring;
+	struct ethtool_channels		channels;
+	struct ethtool_coalesce		coalesce;
+	struct ethtool_eee		eee;
+} __ni_ethtool_nl_data_t;
+
+enum {
+	NI_ETHTOOL_NL_LINKINFO,
+	NI_ETHTOOL_NL_LINKMODES,
+	NI_ETHTOOL_NL_WOL,
+	NI_ETHTOOL_NL_FEATURES,
+	NI_ETHTOOL_NL_RINGS,
+	NI_ETHTOOL_NL_CHANNELS,
+	NI_ETHTOOL_NL_COALESCE,
+	NI_ETHTOOL_NL_EEE,
+
+	NI_ETHTOOL_NL_GROUPS
+};
+
+typedef struct __ni_ethtool_nl_group {
+	const char *			name;
+	uint8_t				get;
+	uint8_t				set;
+	unsigned int			header;
+	unsigned int			maxattr;
+	unsigned int			flags;
+
+	/* table driven groups only */
+	const __ni_ethtool_nl_param_t *	params;
+	ssize_t				data;		/* ioctl struct in __ni_ethtool_nl_data_t */
+	ssize_t				ether;		/* our struct in ni_ethernet_t */
+} __ni_ethtool_nl_group_t;
+
+static const __ni_ethtool_nl_group_t	__ni_ethtool_nl_groups[NI_ETHTOOL_NL_GROUPS] = {
+	[NI_ETHTOOL_NL_LINKINFO] = {
+		"linkinfo", ETHTOOL_MSG_LINKINFO_GET, ETHTOOL_MSG_LINKINFO_SET,
+		ETHTOOL_A_LINKINFO_HEADER, ETHTOOL_A_LINKINFO_MAX, 0,
+		NULL, -1, -1
+	},
+	[NI_ETHTOOL_NL_LINKMODES] = {
+		"linkmodes", ETHTOOL_MSG_LINKMODES_GET, ETHTOOL_MSG_LINKMODES_SET,
+		ETHTOOL_A_LINKMODES_HEADER, ETHTOOL_A_LINKMODES_MAX, ETHTOOL_FLAG_COMPACT_BITSETS,
+		NULL, -1, -1
+	},
+	[NI_ETHTOOL_NL_WOL] = {
+		"wake-on-lan", ETHTOOL_MSG_WOL_GET, ETHTOOL_MSG_WOL_SET,
+		ETHTOOL_A_WOL_HEADER, ETHTOOL_A_WOL_MAX, ETHTOOL_FLAG_COMPACT_BITSETS,
+		NULL, -1, -1
+	},
+	[NI_ETHTOOL_NL_FEATURES] = {
+		/* feature bits are kernel internal, we need their names */
+		"offload", ETHTOOL_MSG_FEATURES_GET, ETHTOOL_MSG_FEATURES_SET,
+		ETHTOOL_A_FEATURES_HEADER, ETHTOOL_A_FEATURES_MAX, 0,
+		NULL, -1, -1
+	},
+	[NI_ETHTOOL_NL_RINGS] = {
+		"ring", ETHTOOL_MSG_RINGS_GET, ETHTOOL_MSG_RINGS_SET,
+		ETHTOOL_A_RINGS_HEADER, ETHTOOL_A_RINGS_MAX, 0,
+		__ni_ethtool_nl_ring_params,
+		offsetof(__ni_ethtool_nl_data_t, ring),
+		offsetof(ni_ethernet_t, ring)
+	},
+	[NI_ETHTOOL_NL_CHANNELS] = {
+		"channels", ETHTOOL_MSG_CHANNELS_GET, ETHTOOL_MSG_CHANNELS_SET,
+		ETHTOOL_A_CHANNELS_HEADER, ETHTOOL_A_CHANNELS_MAX, 0,
+		__ni_ethtool_nl_channels_params,
+		offsetof(__ni_ethtool_nl_data_t, channels),
+		offsetof(ni_ethernet_t, channels)
+	},
+	[NI_ETHTOOL_NL_COALESCE] = {
+		"coalesce", ETHTOOL_MSG_COALESCE_GET, ETHTOOL_MSG_COALESCE_SET,
+		ETHTOOL_A_COALESCE_HEADER, ETHTOOL_A_COALESCE_MAX, 0,
+		__ni_ethtool_nl_coalesce_params,
+		offsetof(__ni_ethtool_nl_data_t, coalesce),
+		offsetof(ni_ethernet_t, coalesce)
+	},
+	[NI_ETHTOOL_NL_EEE] = {
+		"eee", ETHTOOL_MSG_EEE_GET, ETHTOOL_MSG_EEE_SET,
+		ETHTOOL_A_EEE_HEADER, ETHTOOL_A_EEE_MAX, ETHTOOL_FLAG_COMPACT_BITSETS,
+		__ni_ethtool_nl_eee_params,
+		offsetof(__ni_ethtool_nl_data_t, eee),
+		offsetof(ni_ethernet_t, eee)
+	},
+};
+
+/*
+ * Map of feature names to the legacy offload settings; like the
+ * ioctls, a setting is on when any of its features is active.
+ */
+static const struct __ni_ethtool_nl_feature {
+	const char *		name;
+	size_t			offset;
+} __ni_ethtool_nl_features[] = {
+	{ "rx-checksum",			offsetof(ni_ethtool_offload_t, rx_csum)		},
+	{ "tx-checksum-ipv4",			offsetof(ni_ethtool_offload_t, tx_csum)		},
+	{ "tx-checksum-ip-generic",		offsetof(ni_ethtool_offload_t, tx_csum)		},
+	{ "tx-checksum-ipv6",			offsetof(ni_ethtool_offload_t, tx_csum)		},
+	{ "tx-scatter-gather",			offsetof(ni_ethtool_offload_t, scatter_gather)	},
+	{ "tx-tcp-segmentation",		offsetof(ni_ethtool_offload_t, tso)		},
+	{ "tx-tcp-ecn-segmentation",		offsetof(ni_ethtool_offload_t, tso)		},
+	{ "tx-tcp-mangleid-segmentation",	offsetof(ni_ethtool_offload_t, tso)		},
+	{ "tx-tcp6-segmentation",		offsetof(ni_ethtool_offload_t, tso)		},
+	{ "tx-udp-fragmentation",		offsetof(ni_ethtool_offload_t, ufo)		},
+	{ "tx-generic-segmentation",		offsetof(ni_ethtool_offload_t, gso)		},
+	{ "rx-gro",				offsetof(ni_ethtool_offload_t, gro)		},
+	{ "rx-lro",				offsetof(ni_ethtool_offload_t, lro)		},
+	{ "rx-vlan-hw-parse",			offsetof(ni_ethtool_offload_t, rxvlan)		},
+	{ "tx-vlan-hw-insert",			offsetof(ni_ethtool_offload_t, txvlan)		},
+	{ "rx-ntuple-filter",			offsetof(ni_ethtool_offload_t, ntuple)		},
+	{ "rx-hashing",				offsetof(ni_ethtool_offload_t, rxhash)		},
+	{ NULL,					0						}
+};
+
+static ni_netlink_t *
+__ni_ethtool_nl_handle(void)
+{
+	ni_netlink_t *nl;
+	int family;
+
+	if (__ni_ethtool_nl.probed)
+		return __ni_ethtool_nl.nl;
+
+	__ni_ethtool_nl.probed = TRUE;
+	if (!(nl = __ni_netlink_open(NETLINK_GENERIC)))
+		return NULL;
+
+	if ((family = __ni_genl_resolve_family(nl, ETHTOOL_GENL_NAME)) < 0) {
+		ni_debug_ifconfig("ethtool netlink interface not available, using ioctls");
+		__ni_netlink_close(nl);
+		return NULL;
+	}
+
+	__ni_ethtool_nl.family = family;
+	__ni_ethtool_nl.nl = nl;
+	return nl;
+}
+
+static struct nlattr *
+__ni_ethtool_nl_nest_start(struct nl_msg *msg, unsigned int attr)
+{
+	struct nlattr *nest;
+
+	/* ethtool checks nested attributes strictly */
+	if ((nest = nla_nest_start(msg, attr)) != NULL)
+		nest->nla_type |= NLA_F_NESTED;
+	return nest;
+}
+
+static struct nl_msg *
+__ni_ethtool_nl_msg(const __ni_ethtool_nl_group_t *group, ni_bool_t set, unsigned int ifindex)
+{
+	struct genlmsghdr hdr = {
+		.cmd = set ? group->set : group->get,
+		.version = ETHTOOL_GENL_VERSION
+	};
+	struct nlattr *nest;
+	struct nl_msg *msg;
+
+	if (!(msg = nlmsg_alloc_simple(__ni_ethtool_nl.family, 0)))
+		return NULL;
+
+	if (nlmsg_append(msg, &hdr, sizeof(hdr), NLMSG_ALIGNTO) < 0
+	 || !(nest = __ni_ethtool_nl_nest_start(msg, group->header))
+	 || nla_put_u32(msg, ETHTOOL_A_HEADER_DEV_INDEX, ifindex) < 0
+	 || (!set && group->flags && nla_put_u32(msg, ETHTOOL_A_HEADER_FLAGS, group->flags) < 0)) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+	nla_nest_end(msg, nest);
+	return msg;
+}
+
+static ni_bool_t
+__ni_ethtool_nl_get_uint(const struct nlattr *attr, ni_bool_t flag, uint32_t *value)
+{
+	if (!attr)
+		return FALSE;
+
+	if (flag && nla_len(attr) >= (int) sizeof(uint8_t))
+		*value = nla_get_u8((struct nlattr *) attr);
+	else if (!flag && nla_len(attr) >= (int) sizeof(uint32_t))
+		*value = nla_get_u32((struct nlattr *) attr);
+	else
+		return FALSE;
+	return TRUE;
+}
+
+/*
+ * Compact bitsets; we only need the first 32 bits, which correspond
+ * to the legacy ioctl bit masks.
+ */
+static void
+__ni_ethtool_nl_get_bitset32(const struct nlattr *attr, uint32_t *value, uint32_t *mask)
+{
+	struct nlattr *tb[ETHTOOL_A_BITSET_MAX + 1];
+
+	if (!attr || nla_parse_nested(tb, ETHTOOL_A_BITSET_MAX, (struct nlattr *) attr, NULL) < 0)
+		return;
+
+	if (value && tb[ETHTOOL_A_BITSET_VALUE] && nla_len(tb[ETHTOOL_A_BITSET_VALUE]) >= 4)
+		memcpy(value, nla_data(tb[ETHTOOL_A_BITSET_VALUE]), sizeof(*value));
+	if (mask && tb[ETHTOOL_A_BITSET_MASK] && nla_len(tb[ETHTOOL_A_BITSET_MASK]) >= 4)
+		memcpy(mask, nla_data(tb[ETHTOOL_A_BITSET_MASK]), sizeof(*mask));
+}
+
+static int
+__ni_ethtool_nl_put_bitset32(struct nl_msg *msg, unsigned int attr, uint32_t value, uint32_t mask)
+{
+	struct nlattr *nest;
+
+	if (!(nest = __ni_ethtool_nl_nest_start(msg, attr))
+	 || nla_put_u32(msg, ETHTOOL_A_BITSET_SIZE, 32) < 0
+	 || nla_put(msg, ETHTOOL_A_BITSET_VALUE, sizeof(value), &value) < 0
+	 || nla_put(msg, ETHTOOL_A_BITSET_MASK, sizeof(mask), &mask) < 0)
+		return -1;
+
+	nla_nest_end(msg, nest);
+	return 0;
+}
+
+static void
+__ni_ethtool_nl_get_features(const struct nlattr *attr, ni_ethtool_offload_t *offload)
+{
+	struct nlattr *tb[ETHTOOL_A_BITSET_MAX + 1];
+	const struct __ni_ethtool_nl_feature *f;
+	struct nlattr *bit;
+	ni_bool_t list;
+	int rem;
+
+	if (!attr || nla_parse_nested(tb, ETHTOOL_A_BITSET_MAX, (struct nlattr *) attr, NULL) < 0)
+		return;
+
+	for (f = __ni_ethtool_nl_features; f->name; ++f)
+		*(ni_tristate_t *)((char *) offload + f->offset) = NI_TRISTATE_DISABLE;
+
+	/* Without a mask, the kernel lists the bits which are set */
+	list = tb[ETHTOOL_A_BITSET_NOMASK] != NULL;
+	if (!tb[ETHTOOL_A_BITSET_BITS])
+		return;
+
+	nla_for_each_nested(bit, tb[ETHTOOL_A_BITSET_BITS], rem) {
+		struct nlattr *btb[ETHTOOL_A_BITSET_BIT_MAX + 1];
+		const char *name;
+
+		if (nla_type(bit) != ETHTOOL_A_BITSET_BITS_BIT
+		 || nla_parse_nested(btb, ETHTOOL_A_BITSET_BIT_MAX, bit, NULL) < 0
+		 || !btb[ETHTOOL_A_BITSET_BIT_NAME])
+			continue;
+
+		if (!list && !btb[ETHTOOL_A_BITSET_BIT_VALUE])
+			continue;
+
+		name = nla_get_string(btb[ETHTOOL_A_BITSET_BIT_NAME]);
+		for (f = __ni_ethtool_nl_features; f->name; ++f) {
+			if (ni_string_eq(f->name, name))
+				*(ni_tristate_t *)((char *) offload + f->offset) = NI_TRISTATE_ENABLE;
+		}
+	}
+}
+
+typedef struct __ni_ethtool_nl_batch {
+	__ni_ethtool_nl_data_t *	data;
+	unsigned int			count;
+	unsigned int			group[NI_ETHTOOL_NL_GROUPS];
+} __ni_ethtool_nl_batch_t;
+
+static int
+__ni_ethtool_nl_get_handler(unsigned int n, struct nlmsghdr *h, void *user_data)
+{
+	const __ni_ethtool_nl_group_t *group;
+	struct nlattr *tb[NI_ETHTOOL_NL_ATTR_MAX + 1];
+	__ni_ethtool_nl_batch_t *batch = user_data;
+	__ni_ethtool_nl_data_t *data = batch->data;
+	const __ni_ethtool_nl_param_t *p;
+	unsigned int index;
+	uint32_t value;
+
+	if (n >= batch->count)
+		return NL_SKIP;
+
+	index = batch->group[n];
+	group = &__ni_ethtool_nl_groups[index];
+	if (group->maxattr > NI_ETHTOOL_NL_ATTR_MAX
+	 || nlmsg_parse(h, GENL_HDRLEN, tb, group->maxattr, NULL) < 0)
+		return NL_SKIP;
+
+	switch (index) {
+	case NI_ETHTOOL_NL_LINKINFO:
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKINFO_PORT], TRUE, &value))
+			data->ecmd.port = value;
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKINFO_PHYADDR], TRUE, &value))
+			data->ecmd.phy_address = value;
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKINFO_TRANSCEIVER], TRUE, &value))
+			data->ecmd.transceiver = value;
+		break;
+
+	case NI_ETHTOOL_NL_LINKMODES:
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKMODES_AUTONEG], TRUE, &value))
+			data->ecmd.autoneg = value;
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKMODES_SPEED], FALSE, &value))
+			ethtool_cmd_speed_set(&data->ecmd, value);
+		if (__ni_ethtool_nl_get_uint(tb[ETHTOOL_A_LINKMODES_DUPLEX], TRUE, &value))
+			data->ecmd.duplex = value;
+		break;
+
+	case NI_ETHTOOL_NL_WOL:
+		__ni_ethtool_nl_get_bitset32(tb[ETHTOOL_A_WOL_MODES],
+				&data->wolinfo.wolopts, &data->wolinfo.supported);
+		if (tb[ETHTOOL_A_WOL_SOPASS]
+		 && nla_len(tb[ETHTOOL_A_WOL_SOPASS]) >= (int) sizeof(data->wolinfo.sopass))
+			memcpy(data->wolinfo.sopass, nla_data(tb[ETHTOOL_A_WOL_SOPASS]),
+					sizeof(data->wolinfo.sopass));
+		break;
+
+	case NI_ETHTOOL_NL_FEATURES:
+		__ni_ethtool_nl_get_features(tb[ETHTOOL_A_FEATURES_ACTIVE], &data->offload);
+		break;
+
+	case NI_ETHTOOL_NL_EEE:
+		__ni_ethtool_nl_get_bitset32(tb[ETHTOOL_A_EEE_MODES_OURS],
+				&data->eee.advertised, &data->eee.supported);
+		__ni_ethtool_nl_get_bitset32(tb[ETHTOOL_A_EEE_MODES_PEER],
+				&data->eee.lp_advertised, NULL);
+		/* fall through */
+	default:
+		for (p = group->params; p && p->attr; ++p) {
+			if (p->attr <= group->maxattr
+			 && __ni_ethtool_nl_get_uint(tb[p->attr], p->flag, &value))
+				*(uint32_t *)((char *) data + group->data + p->ioc) = value;
+		}
+		break;
+	}
+
+	return NL_OK;
+}
+
+/*
+ * Send the get requests for the groups in @mask as one batch
+ */
+static int
+__ni_ethtool_nl_request(unsigned int ifindex, unsigned int mask,
+			__ni_ethtool_nl_data_t *data, int *errors)
+{
+	struct nl_msg *msgs[NI_ETHTOOL_NL_GROUPS];
+	int errs[NI_ETHTOOL_NL_GROUPS];
+	__ni_ethtool_nl_batch_t batch;
+	unsigned int i;
+	int rv = -1;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.data = data;
+	for (i = 0; i < NI_ETHTOOL_NL_GROUPS; ++i) {
+		errors[i] = -1;
+		if (!(mask & (1U << i)))
+			continue;
+		if (!(msgs[batch.count] = __ni_ethtool_nl_msg(&__ni_ethtool_nl_groups[i],
+								FALSE, ifindex)))
+			goto done;
+		batch.group[batch.count++] = i;
+	}
+
+	rv = __ni_nl_talk_batch(__ni_ethtool_nl.nl, msgs, batch.count,
+				__ni_ethtool_nl_get_handler, &batch, errs);
+	if (rv < 0)
+		goto done;
+
+	for (i = 0; i < batch.count; ++i)
+		errors[batch.group[i]] = errs[i];
+
+done:
+	while (batch.count--)
+		nlmsg_free(msgs[batch.count]);
+	return rv;
+}
+
+static ni_tristate_t *
+__ni_ethtool_nl_supported(ni_ethernet_t *ether, const __ni_ethtool_nl_group_t *group)
+{
+	/* all our per-group structs start with the supported flag */
+	if (group->ether < 0)
+		return NULL;
+	return (ni_tristate_t *)((char *) ether + group->ether);
+}
+
+static void
+__ni_ethtool_nl_get_failed(const char *ifname, ni_ethernet_t *ether,
+			const __ni_ethtool_nl_group_t *group, int err)
+{
+	ni_tristate_t *supported;
+
+	if (err != EOPNOTSUPP && err != ENODEV)
+		ni_warn("%s: getting ethtool.%s options failed: %s",
+				ifname, group->name, strerror(err));
+	else
+		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+				"%s: getting ethtool.%s options failed: %s",
+				ifname, group->name, strerror(err));
+
+	if (err != EOPNOTSUPP && (supported = __ni_ethtool_nl_supported(ether, group)))
+		*supported = NI_TRISTATE_DISABLE;
+}
+
+/*
+ * Get the link settings, or with @ondemand the settings of all other groups
+ */
+#define NI_ETHTOOL_NL_LINK_MASK	((1U << NI_ETHTOOL_NL_LINKINFO) | \
+				 (1U << NI_ETHTOOL_NL_LINKMODES))
+
+static int
+__ni_ethtool_nl_get(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether,
+			ni_bool_t ondemand)
+{
+	const __ni_ethtool_nl_group_t *group;
+	const __ni_ethtool_nl_param_t *p;
+	int errors[NI_ETHTOOL_NL_GROUPS];
+	__ni_ethtool_nl_data_t data;
+	ni_tristate_t *supported;
+	unsigned int i, mask;
+
+	if (!ifindex || !__ni_ethtool_nl_handle())
+		return -1;
+
+	mask = NI_ETHTOOL_NL_LINK_MASK;
+	if (ondemand)
+		mask = ((1U << NI_ETHTOOL_NL_GROUPS) - 1) & ~mask;
+
+	/* do not probe the groups the device failed before, as the ioctls */
+	for (i = 0; i < NI_ETHTOOL_NL_GROUPS; ++i) {
+		supported = __ni_ethtool_nl_supported(ether, &__ni_ethtool_nl_groups[i]);
+		if (supported && *supported == NI_TRISTATE_DISABLE)
+			mask &= ~(1U << i);
+	}
+	if (!mask)
+		return 0;
+
+	memset(&data, 0, sizeof(data));
+	if (__ni_ethtool_nl_request(ifindex, mask, &data, errors) < 0)
+		return -1;
+
+	for (i = 0; i < NI_ETHTOOL_NL_GROUPS; ++i) {
+		if (!(mask & (1U << i)))
+			continue;
+
+		group = &__ni_ethtool_nl_groups[i];
+
+		if (errors[i] != 0) {
+			if (i == NI_ETHTOOL_NL_WOL) {
+				ether->wol.support = ether->wol.options = __NI_ETHERNET_WOL_DISABLE;
+				ether->wol.sopass.len = 0;
+			}
+			if (i == NI_ETHTOOL_NL_LINKMODES) {
+				/* the link settings are a single ioctl; skip linkinfo too */
+				errors[NI_ETHTOOL_NL_LINKINFO] = errors[i];
+			}
+			if (errors[i] > 0)
+				__ni_ethtool_nl_get_failed(ifname, ether, group, errors[i]);
+			continue;
+		}
+
+		switch (i) {
+		case NI_ETHTOOL_NL_LINKINFO:
+		case NI_ETHTOOL_NL_LINKMODES:
+			break;
+
+		case NI_ETHTOOL_NL_WOL:
+			__ni_ethtool_wol_from_wolinfo(ifname, &ether->wol, &data.wolinfo);
+			break;
+
+		case NI_ETHTOOL_NL_FEATURES:
+			ether->offload = data.offload;
+			break;
+
+		case NI_ETHTOOL_NL_EEE:
+			ether->eee.speed.supported = data.eee.supported;
+			ether->eee.speed.advertised = data.eee.advertised;
+			ether->eee.speed.lp_advertised = data.eee.lp_advertised;
+			/* fall through */
+		default:
+			for (p = group->params; p && p->attr; ++p) {
+				if (p->want < 0)
+					continue;
+				*(unsigned int *)((char *) ether + group->ether + p->want) =
+					*(uint32_t *)((char *) &data + group->data + p->ioc);
+			}
+			break;
+		}
+	}
+
+	if (!ondemand && errors[NI_ETHTOOL_NL_LINKINFO] == 0 &&
+	    errors[NI_ETHTOOL_NL_LINKMODES] == 0)
+		__ni_ethtool_gset_from_cmd(ifname, ether, &data.ecmd);
+
+	return 0;
+}
+
+/*
+ * Add the changed parameters of a group to its set request and return
+ * a mask of them; the eee advertise bitset uses the last bit.
+ */
+#define NI_ETHTOOL_NL_EEE_ADVERTISE	(1U << 31)
+
+static unsigned int
+__ni_ethtool_nl_set_params(const char *ifname, ni_ethernet_t *ether, unsigned int index,
+			__ni_ethtool_nl_data_t *data, struct nl_msg *msg)
+{
+	const __ni_ethtool_nl_group_t *group = &__ni_ethtool_nl_groups[index];
+	const __ni_ethtool_nl_param_t *p;
+	char *ioc = (char *) data + group->data;
+	unsigned int want, max, n, changed = 0;
+	uint32_t *curr;
+	int rv;
+
+	for (n = 0, p = group->params; p->attr; ++p, ++n) {
+		if (!p->name)
+			continue;
+
+		curr = (uint32_t *)(ioc + p->ioc);
+		want = *(unsigned int *)((char *) ether + group->ether + p->want);
+		max  = p->max >= 0 ? *(uint32_t *)(ioc + p->max) : p->limit;
+		if (!ni_ethtool_validate_uint_param(curr, want, max, group->name, p->name, ifname))
+			continue;
+
+		if (p->flag)
+			rv = nla_put_u8(msg, p->attr, want);
+		else
+			rv = nla_put_u32(msg, p->attr, want);
+		if (rv < 0)
+			return 0;
+		changed |= 1U << n;
+	}
+
+	if (index == NI_ETHTOOL_NL_EEE
+	 && ni_ethtool_validate_uint_param(&data->eee.advertised, ether->eee.speed.advertised,
+			NI_ETHTOOL_EEE_DEFAULT, group->name, "advertise", ifname)) {
+		if (__ni_ethtool_nl_put_bitset32(msg, ETHTOOL_A_EEE_MODES_OURS,
+					data->eee.advertised, -1U) < 0)
+			return 0;
+		changed |= NI_ETHTOOL_NL_EEE_ADVERTISE;
+	}
+
+	return changed;
+}
+
+static void
+__ni_ethtool_nl_set_log(const char *ifname, const char *group, const char *name,
+			unsigned int value, int err)
+{
+	if (err == 0)
+		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_IFCONFIG,
+				"%s: applied ethtool.%s.%s = %u",
+				ifname, group, name, value);
+	else if (err != EOPNOTSUPP && err != ENODEV)
+		ni_warn("%s: failed to set ethtool.%s.%s to %u: %s",
+				ifname, group, name, value, strerror(err));
+	else
+		ni_debug_verbose(NI_LOG_DEBUG, NI_TRACE_IFCONFIG,
+				"%s: failed to set ethtool.%s.%s to %u: %s",
+				ifname, group, name, value, strerror(err));
+}
+
+static void
+__ni_ethtool_nl_set_result(const char *ifname, unsigned int index, unsigned int changed,
+			const __ni_ethtool_nl_data_t *data, int err)
+{
+	const __ni_ethtool_nl_group_t *group = &__ni_ethtool_nl_groups[index];
+	const __ni_ethtool_nl_param_t *p;
+	const char *ioc = (const char *) data + group->data;
+	unsigned int n;
+
+	for (n = 0, p = group->params; p->attr; ++p, ++n) {
+		if (changed & (1U << n))
+			__ni_ethtool_nl_set_log(ifname, group->name, p->name,
+					*(const uint32_t *)(ioc + p->ioc), err);
+	}
+	if (changed & NI_ETHTOOL_NL_EEE_ADVERTISE)
+		__ni_ethtool_nl_set_log(ifname, group->name, "advertise",
+				data->eee.advertised, err);
+}
+
+/*
+ * Apply ring, channels, coalesce and eee settings: one batch to query
+ * the current values and one with a set request per changed group.
+ */
+static int
+__ni_ethtool_nl_set(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether)
+{
+	struct nl_msg *msgs[NI_ETHTOOL_NL_GROUPS];
+	int errors[NI_ETHTOOL_NL_GROUPS];
+	int errs[NI_ETHTOOL_NL_GROUPS];
+	unsigned int map[NI_ETHTOOL_NL_GROUPS];
+	unsigned int changed[NI_ETHTOOL_NL_GROUPS];
+	const __ni_ethtool_nl_group_t *group;
+	const __ni_ethtool_nl_param_t *p;
+	__ni_ethtool_nl_data_t data;
+	unsigned int i, mask = 0, count = 0;
+	ni_tristate_t *supported;
+	int rv;
+
+	if (!ifindex || !__ni_ethtool_nl_handle())
+		return -1;
+
+	for (i = 0; i < NI_ETHTOOL_NL_GROUPS; ++i) {
+		group = &__ni_ethtool_nl_groups[i];
+		if (!group->params)
+			continue;
+
+		supported = __ni_ethtool_nl_supported(ether, group);
+		if (*supported == NI_TRISTATE_DISABLE)
+			continue;
+
+		for (p = group->params; p->attr; ++p) {
+			if (p->name && *(unsigned int *)((char *) ether + group->ether + p->want)
+					!= NI_ETHTOOL_RING_DEFAULT)
+				mask |= 1U << i;
+		}
+	}
+	if (ether->eee.speed.advertised != NI_ETHTOOL_EEE_DEFAULT
+	 && ether->eee.supported != NI_TRISTATE_DISABLE)
+		mask |= 1U << NI_ETHTOOL_NL_EEE;
+
+	if (!mask)
+		return 0;
+
+	memset(&data, 0, sizeof(data));
+	if (__ni_ethtool_nl_request(ifindex, mask, &data, errors) < 0)
+		return 0;
+
+	for (i = 0; i < NI_ETHTOOL_NL_GROUPS; ++i) {
+		if (!(mask & (1U << i)))
+			continue;
+
+		group = &__ni_ethtool_nl_groups[i];
+		if (errors[i] != 0) {
+			if (errors[i] > 0)
+				__ni_ethtool_nl_get_failed(ifname, ether, group, errors[i]);
+			continue;
+		}
+
+		if (!(msgs[count] = __ni_ethtool_nl_msg(group, TRUE, ifindex)))
+			break;
+
+		if (!(changed[count] = __ni_ethtool_nl_set_params(ifname, ether, i,
+								&data, msgs[count]))) {
+			nlmsg_free(msgs[count]);
+			continue;
+		}
+		map[count++] = i;
+	}
+
+	rv = __ni_nl_talk_batch(__ni_ethtool_nl.nl, msgs, count, NULL, NULL, errs);
+	for (i = 0; i < count; ++i) {
+		__ni_ethtool_nl_set_result(ifname, map[i], changed[i], &data,
+				rv < 0 ? EIO : errs[i]);
+		nlmsg_free(msgs[i]);
+	}
+
+	return 0;
+}
+#else
+static int
+__ni_ethtool_nl_get(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether,
+			ni_bool_t ondemand)
+{
+	return -1;
+}
+
+static int
+__ni_ethtool_nl_set(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether)
+{
+	return -1;
+}
+#endif
+
 void
-__ni_system_ethernet_get(const char *ifname, ni_ethernet_t *ether)
+__ni_system_ethernet_get(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether)
 {
-	__ni_ethtool_get_wol(ifname, &ether->wol);
-	__ni_ethtool_get_offload(ifname, &ether->offload);
 	__ni_ethtool_get_permanent_address(ifname, &ether->permanent_address);
+	if (__ni_ethtool_nl_get(ifname, ifindex, ether, FALSE) == 0)
+		return;
+
 	__ni_ethtool_get_gset(ifname, ether);
+}
+
+static void
+__ni_system_ethernet_get_ondemand(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether)
+{
+	if (__ni_ethtool_nl_get(ifname, ifindex, ether, TRUE) == 0)
+		return;
+
+	__ni_ethtool_get_wol(ifname, &ether->wol);
+	__ni_ethtool_get_offload(ifname, &ether->offload);
 	ni_ethtool_get_eee(ifname, &ether->eee);
 	ni_ethtool_get_ring(ifname, &ether->ring);
 	ni_ethtool_get_coalesce(ifname, &ether->coalesce);
@@ -1229,51 +2097,57 @@ __ni_system_ethernet_update(ni_netdev_t *dev, ni_ethernet_t *ether)
 	if (!ni_netdev_device_is_ready(dev))
 		return;
 
-	__ni_system_ethernet_set(dev->name, ether);
+	__ni_system_ethernet_set(dev->name, dev->link.ifindex, ether);
 	__ni_system_ethernet_refresh(dev);
 }
 
-static int
-__ni_ethtool_get_gset(const char *ifname, ni_ethernet_t *ether)
+static void
+__ni_ethtool_gset_from_cmd(const char *ifname, ni_ethernet_t *ether, const struct ethtool_cmd *ecmd)
 {
-	struct ethtool_cmd ecmd;
 	int mapped;
 
-	memset(&ecmd, 0, sizeof(ecmd));
-	if (__ni_ethtool(ifname, ETHTOOL_GSET, &ecmd) < 0) {
-		if (errno != EOPNOTSUPP && errno != ENODEV)
-			ni_warn("%s: ETHTOOL_GSET failed: %m", ifname);
-		else
-			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
-				"%s: ETHTOOL_GSET failed: %m", ifname);
-		return -1;
-	}
-
-	mapped = __ni_ethtool_to_wicked(__ni_ethtool_speed_map, ethtool_cmd_speed(&ecmd));
+	mapped = __ni_ethtool_to_wicked(__ni_ethtool_speed_map, ethtool_cmd_speed(ecmd));
 	if (mapped >= 0)
 		ether->link_speed = mapped;
 	else
-		ether->link_speed = ethtool_cmd_speed(&ecmd);
+		ether->link_speed = ethtool_cmd_speed(ecmd);
 
-	mapped = __ni_ethtool_to_wicked(__ni_ethtool_duplex_map, ecmd.duplex);
+	mapped = __ni_ethtool_to_wicked(__ni_ethtool_duplex_map, ecmd->duplex);
 	if (mapped < 0)
-		ni_warn("%s: unknown duplex setting %d", ifname, ecmd.duplex);
+		ni_warn("%s: unknown duplex setting %d", ifname, ecmd->duplex);
 	else
 		ether->duplex = mapped;
 
-	mapped = __ni_ethtool_to_wicked(__ni_ethtool_port_map, ecmd.port);
+	mapped = __ni_ethtool_to_wicked(__ni_ethtool_port_map, ecmd->port);
 	if (mapped < 0)
-		ni_warn("%s: unknown port setting %d", ifname, ecmd.port);
+		ni_warn("%s: unknown port setting %d", ifname, ecmd->port);
 	else
 		ether->port_type = mapped;
 
-	ether->autoneg_enable = (ecmd.autoneg ? NI_TRISTATE_ENABLE : NI_TRISTATE_DISABLE);
+	ether->autoneg_enable = (ecmd->autoneg ? NI_TRISTATE_ENABLE : NI_TRISTATE_DISABLE);
 
 	/* Not used yet:
 	    phy_address
 	    transceiver
 	 */
+}
+
+static int
+__ni_ethtool_get_gset(const char *ifname, ni_ethernet_t *ether)
+{
+	struct ethtool_cmd ecmd;
+
+	memset(&ecmd, 0, sizeof(ecmd));
+	if (__ni_ethtool(ifname, ETHTOOL_GSET, &ecmd) < 0) {
+		if (errno != EOPNOTSUPP && errno != ENODEV)
+			ni_warn("%s: ETHTOOL_GSET failed: %m", ifname);
+		else
+			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+				"%s: ETHTOOL_GSET failed: %m", ifname);
+		return -1;
+	}
 
+	__ni_ethtool_gset_from_cmd(ifname, ether, &ecmd);
 	return 0;
 }
 
@@ -1403,11 +2277,14 @@ __ni_ethtool_set_sset(const char *ifname, const ni_ethernet_t *ether)
 }
 
 void
-__ni_system_ethernet_set(const char *ifname, ni_ethernet_t *ether)
+__ni_system_ethernet_set(const char *ifname, unsigned int ifindex, ni_ethernet_t *ether)
 {
 	__ni_ethtool_set_wol(ifname, &ether->wol);
 	__ni_ethtool_set_offload(ifname, &ether->offload);
 	__ni_ethtool_set_sset(ifname, ether);
+	if (__ni_ethtool_nl_set(ifname, ifindex, ether) == 0)
+		return;
+
 	ni_ethtool_set_eee(ifname, &ether->eee);
 	ni_ethtool_set_ring(ifname, &ether->ring);
 	ni_ethtool_set_coalesce(ifname, &ether->coalesce);
@@ -7,12 +7,45 @@
 #include "config.h"
 #endif
 
+#include <sys/time.h>
+
 #include <wicked/xml.h>
+#include <wicked/socket.h>
 #include "buffer.h"
 #include "appconfig.h"
+#include "socket_priv.h"
 #include "process.h"
 #include "debug.h"
 
+/*
+ * Create the process instance of a discovery script
+ */
+static ni_process_t *
+__ni_netconfig_firmware_process(const ni_script_action_t *script,
+				const char *root, const char *type, const char *path)
+{
+	ni_process_t *process;
+
+	ni_debug_ifconfig("trying to discover netif config via firmware service \"%s\"", script->name);
+
+	/* Create an instance of this command */
+	if (!(process = ni_process_new(script->process)))
+		return NULL;
+
+	/* Add root directory argument if given */
+	if (root) {
+		ni_string_array_append(&process->argv, "-r");
+		ni_string_array_append(&process->argv, root);
+	}
+
+	/* Add firmware type specific path argument if given */
+	if (type && path) {
+		ni_string_array_append(&process->argv, "-p");
+		ni_string_array_append(&process->argv, path);
+	}
+	return process;
+}
+
 /*
  * Run all the netif firmware discovery scripts and return their output
  * as one large buffer.
@@ -42,24 +75,10 @@ __ni_netconfig_firmware_discovery(const char *root, const char *type, const char
 			if (type && !ni_string_eq_nocase(type, script->name))
 				continue;
 
-			ni_debug_ifconfig("trying to discover netif config via firmware service \"%s\"", script->name);
-
-			/* Create an instance of this command */
-			process = ni_process_new(script->process);
-
-			/* Add root directory argument if given */
-			if (root) {
-				ni_string_array_append(&process->argv, "-r");
-				ni_string_array_append(&process->argv, root);
-			}
-
-			/* Add firmware type specific path argument if given */
-			if (type && path) {
-				ni_string_array_append(&process->argv, "-p");
-				ni_string_array_append(&process->argv, path);
-			}
-
-			rv = ni_process_run_and_capture_output(process, result);
+			if (!(process = __ni_netconfig_firmware_process(script, root, type, path)))
+				rv = NI_PROCESS_FAILURE;
+			else
+				rv = ni_process_run_and_capture_output(process, result);
 			ni_process_free(process);
 			if (rv) {
 				ni_error("unable to discover firmware (script \"%s\")",
@@ -73,6 +92,47 @@ __ni_netconfig_firmware_discovery(const char *root, const char *type, const char
 	return result;
 }
 
+/*
+ * Split the optional firmware type and path of a from parameter
+ */
+static const char *
+__ni_netconfig_firmware_from(const char **root, const char **from, char **type, char **path)
+{
+	/* sanity adjustments... */
+	if (ni_string_empty(*root))
+		*root = NULL;
+
+	*path = NULL;
+	if (ni_string_empty(*from))
+		*from = NULL;
+	else {
+		ni_string_dup(type, *from);
+
+		if ((*path = strchr(*type, ':')))
+			*(*path)++ = '\0';
+
+		if (ni_string_empty(*path))
+			*path = NULL;
+	}
+	return *type;
+}
+
+static xml_document_t *
+__ni_netconfig_firmware_document(ni_buffer_t *buffer, const char *from)
+{
+	xml_document_t *doc;
+
+	ni_debug_ifconfig("%s: %s%sbuffer has %u bytes", __func__,
+			(from ? from : ""), (from ? " ": ""),
+			ni_buffer_count(buffer));
+	doc = xml_document_from_buffer(buffer, from);
+
+	if (doc == NULL)
+		ni_error("%s: error processing document", __func__);
+
+	return doc;
+}
+
 /*
  * Run the netif firmware discovery scripts and return their output
  * as an XML document.
@@ -88,37 +148,287 @@ ni_netconfig_firmware_discovery(const char *root, const char *from)
 	char *path = NULL;
 	char *type = NULL;
 
-	/* sanity adjustments... */
-	if (ni_string_empty(root))
-		root = NULL;
+	__ni_netconfig_firmware_from(&root, &from, &type, &path);
 
-	if (ni_string_empty(from))
-		from = NULL;
-	else {
-		ni_string_dup(&type, from);
+	buffer = __ni_netconfig_firmware_discovery(root, type, path);
+	ni_string_free(&type);
+	if (buffer == NULL)
+		return NULL;
+
+	doc = __ni_netconfig_firmware_document(buffer, from);
+	ni_buffer_free(buffer);
+	return doc;
+}
+
+/*
+ * Asynchronous discovery: the scripts of all started discoveries
+ * share a queue and up to <sources><parallel-jobs> of them are run
+ * at the same time. The output of each script is kept separately
+ * and joined in the script order when the discovery is finished,
+ * so the result does not depend on which script exits first.
+ */
+typedef struct ni_netconfig_firmware_job	ni_netconfig_firmware_job_t;
+
+struct ni_netconfig_firmware_job {
+	ni_netconfig_firmware_job_t *	next;	/* in the discovery	*/
+	ni_netconfig_firmware_job_t *	qnext;	/* in the run queue	*/
+
+	char *				name;
+	ni_process_t *			process;
+	ni_buffer_t *			output;
+	ni_bool_t			done;
+	int				status;
+};
 
-		if ((path = strchr(type, ':')))
-			*path++ = '\0';
+struct ni_netconfig_firmware {
+	char *				from;
+	ni_netconfig_firmware_job_t *	jobs;
+};
 
-		if (ni_string_empty(path))
-			path = NULL;
+static struct {
+	ni_netconfig_firmware_job_t *	queue;
+	unsigned int			running;
+} __ni_netconfig_firmware_jobs;
+
+/* total time to wait for the scripts of a discovery */
+#define NI_NETCONFIG_FIRMWARE_DISCOVERY_TIMEOUT		60000	/* msec */
+
+static void			__ni_netconfig_firmware_jobs_schedule(void);
+
+static void
+__ni_netconfig_firmware_buffer_append(ni_buffer_t *dst, const ni_buffer_t *src)
+{
+	size_t len = ni_buffer_count(src);
+
+	if (len) {
+		ni_buffer_ensure_tailroom(dst, len);
+		ni_buffer_put(dst, ni_buffer_head(src), len);
 	}
+}
 
-	buffer = __ni_netconfig_firmware_discovery(root, type, path);
-	if (buffer == NULL) {
-		ni_string_free(&type);
-		return NULL;
+static void
+__ni_netconfig_firmware_job_notify(ni_process_t *pi)
+{
+	ni_netconfig_firmware_job_t *job = pi->user_data;
+
+	if (!job || job->process != pi)
+		return;
+
+	pi->user_data = NULL;
+	job->process = NULL;
+	job->status = ni_process_exit_status(pi);
+	job->done = TRUE;
+
+	if (pi->socket)
+		__ni_netconfig_firmware_buffer_append(job->output, &pi->socket->rbuf);
+
+	if (__ni_netconfig_firmware_jobs.running)
+		__ni_netconfig_firmware_jobs.running--;
+	__ni_netconfig_firmware_jobs_schedule();
+}
+
+static void
+__ni_netconfig_firmware_jobs_schedule(void)
+{
+	ni_netconfig_firmware_job_t *job;
+	unsigned int limit;
+	int rv;
+
+	limit = max_t(unsigned int, 1, ni_config_sources_parallel_jobs());
+	while (__ni_netconfig_firmware_jobs.running < limit &&
+	       (job = __ni_netconfig_firmware_jobs.queue)) {
+		__ni_netconfig_firmware_jobs.queue = job->qnext;
+		job->qnext = NULL;
+
+		rv = ni_process_run(job->process);
+		if (rv != NI_PROCESS_SUCCESS) {
+			ni_process_free(job->process);
+			job->process = NULL;
+			job->status = rv;
+			job->done = TRUE;
+			continue;
+		}
+
+		job->process->user_data = job;
+		job->process->notify_callback = __ni_netconfig_firmware_job_notify;
+		__ni_netconfig_firmware_jobs.running++;
 	}
+}
 
-	ni_debug_ifconfig("%s: %s%sbuffer has %u bytes", __func__,
-			(from ? from : ""), (from ? " ": ""),
-			ni_buffer_count(buffer));
-	doc = xml_document_from_buffer(buffer, from);
-	ni_buffer_free(buffer);
+static void
+__ni_netconfig_firmware_jobs_enqueue(ni_netconfig_firmware_job_t *job)
+{
+	ni_netconfig_firmware_job_t **tail;
+
+	for (tail = &__ni_netconfig_firmware_jobs.queue; *tail; tail = &(*tail)->qnext)
+		;
+	*tail = job;
+}
+
+/*
+ * Drop a job from the run queue or kill its script when running
+ */
+static void
+__ni_netconfig_firmware_job_cancel(ni_netconfig_firmware_job_t *job)
+{
+	ni_netconfig_firmware_job_t **pos;
+	ni_bool_t queued = FALSE;
+
+	if (job->done)
+		return;
+
+	for (pos = &__ni_netconfig_firmware_jobs.queue; *pos; pos = &(*pos)->qnext) {
+		if (*pos == job) {
+			*pos = job->qnext;
+			job->qnext = NULL;
+			queued = TRUE;
+			break;
+		}
+	}
+
+	if (job->process) {
+		if (!queued && __ni_netconfig_firmware_jobs.running)
+			__ni_netconfig_firmware_jobs.running--;
+		job->process->user_data = NULL;
+		ni_process_free(job->process);
+		job->process = NULL;
+	}
+	job->status = NI_PROCESS_FAILURE;
+	job->done = TRUE;
+}
+
+static void
+__ni_netconfig_firmware_free(ni_netconfig_firmware_t *fw)
+{
+	ni_netconfig_firmware_job_t *job;
+
+	while ((job = fw->jobs)) {
+		fw->jobs = job->next;
+
+		__ni_netconfig_firmware_job_cancel(job);
+
+		ni_string_free(&job->name);
+		if (job->output)
+			ni_buffer_free(job->output);
+		free(job);
+	}
+	ni_string_free(&fw->from);
+	free(fw);
+
+	/* let the scripts of other discoveries run */
+	__ni_netconfig_firmware_jobs_schedule();
+}
+
+ni_netconfig_firmware_t *
+ni_netconfig_firmware_discovery_start(const char *root, const char *from)
+{
+	ni_netconfig_firmware_job_t *job, **tail;
+	ni_config_t *config = ni_global.config;
+	ni_netconfig_firmware_t *fw;
+	ni_script_action_t *script;
+	ni_extension_t *ex;
+	char *path = NULL;
+	char *type = NULL;
+
+	ni_assert(config);
+
+	fw = xcalloc(1, sizeof(*fw));
+	__ni_netconfig_firmware_from(&root, &from, &type, &path);
+	ni_string_dup(&fw->from, from);
+
+	tail = &fw->jobs;
+	for (ex = config->fw_extensions; ex; ex = ex->next) {
+		if (ex->c_bindings)
+			ni_warn("builtins specified in a netif-firmware-discovery element: not supported");
+
+		for (script = ex->actions; script; script = script->next) {
+			/* Check if requested to use specific type/name only (e.g. "ibft") */
+			if (type && !ni_string_eq_nocase(type, script->name))
+				continue;
+
+			job = xcalloc(1, sizeof(*job));
+			ni_string_dup(&job->name, script->name);
+			job->output = ni_buffer_new_dynamic(1024);
+			*tail = job;
+			tail = &job->next;
+
+			job->process = __ni_netconfig_firmware_process(script, root, type, path);
+			if (job->process) {
+				__ni_netconfig_firmware_jobs_enqueue(job);
+			} else {
+				job->status = NI_PROCESS_FAILURE;
+				job->done = TRUE;
+			}
+		}
+	}
 	ni_string_free(&type);
 
-	if (doc == NULL)
-		ni_error("%s: error processing document", __func__);
+	__ni_netconfig_firmware_jobs_schedule();
+	return fw;
+}
+
+xml_document_t *
+ni_netconfig_firmware_discovery_finish(ni_netconfig_firmware_t *fw)
+{
+	ni_netconfig_firmware_job_t *job;
+	struct timeval deadline, now, delta;
+	xml_document_t *doc = NULL;
+	ni_buffer_t *buffer;
+	long timeout;
+
+	if (!fw)
+		return NULL;
+
+	ni_timer_get_time(&deadline);
+	deadline.tv_sec  += NI_NETCONFIG_FIRMWARE_DISCOVERY_TIMEOUT / 1000;
+	deadline.tv_usec += (NI_NETCONFIG_FIRMWARE_DISCOVERY_TIMEOUT % 1000) * 1000;
+	if (deadline.tv_usec >= 1000000) {
+		deadline.tv_sec++;
+		deadline.tv_usec -= 1000000;
+	}
+
+	for (job = fw->jobs; job; ) {
+		if (job->done) {
+			job = job->next;
+			continue;
+		}
+
+		ni_timer_get_time(&now);
+		if (!timercmp(&now, &deadline, <)) {
+			for ( ; job; job = job->next) {
+				if (job->done)
+					continue;
+				ni_error("firmware discovery script \"%s\" timed out after %ums",
+						job->name, NI_NETCONFIG_FIRMWARE_DISCOVERY_TIMEOUT);
+				__ni_netconfig_firmware_job_cancel(job);
+			}
+			goto failure;
+		}
+
+		timersub(&deadline, &now, &delta);
+		timeout = delta.tv_sec * 1000 + delta.tv_usec / 1000;
+		if (ni_socket_wait(min_t(long, timeout, 1000)) != 0) {
+			ni_error("unable to discover firmware (script \"%s\")",
+					job->name);
+			goto failure;
+		}
+	}
+
+	buffer = ni_buffer_new_dynamic(1024);
+	for (job = fw->jobs; job; job = job->next) {
+		if (job->status) {
+			ni_error("unable to discover firmware (script \"%s\")",
+					job->name);
+			ni_buffer_free(buffer);
+			goto failure;
+		}
+		__ni_netconfig_firmware_buffer_append(buffer, job->output);
+	}
+
+	doc = __ni_netconfig_firmware_document(buffer, fw->from);
+	ni_buffer_free(buffer);
 
+failure:
+	__ni_netconfig_firmware_free(fw);
 	return doc;
 }
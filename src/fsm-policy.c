@@ -131,12 +131,50 @@ static ni_bool_t		ni_fsm_template_bind_devices(ni_fsm_policy_t *, ni_fsm_policy_
 static ni_fsm_template_input_t *ni_fsm_template_input_new(const char *id, ni_fsm_template_input_t ***tailp);
 static void			ni_fsm_template_input_free(ni_fsm_template_input_t *);
 
+/*
+ * Policy lookup index by name.
+ *
+ * A policy applies to the worker its name has been generated from
+ * (see ni_fsm_policy_applicable), so the name discriminates the
+ * candidate policies of a worker. The index refers to the policies
+ * of a name in the order they're applied in: by weight, then by
+ * sequence number. Any policy list change or policy update bumps
+ * the generation, causing a rebuild on the next lookup.
+ */
+typedef struct ni_fsm_policy_index_entry	ni_fsm_policy_index_entry_t;
+struct ni_fsm_policy_index_entry {
+	ni_fsm_policy_index_entry_t *	next;
+
+	const char *			name;
+	ni_fsm_policy_t *		first;		/* in fsm policy list order */
+	unsigned int			count;
+	ni_fsm_policy_t **		applicable;	/* valid configs by weight */
+};
+
+struct ni_fsm_policy_index {
+	unsigned int			generation;
+	unsigned int			size;
+	ni_fsm_policy_index_entry_t **	table;
+};
+
+#define NI_FSM_POLICY_INDEX_MIN_SIZE	64
+
+static unsigned int			ni_fsm_policy_generation = 1;
+
+static inline void
+ni_fsm_policy_index_invalidate(void)
+{
+	if (!++ni_fsm_policy_generation)
+		ni_fsm_policy_generation = 1;
+}
+
 /*
  * fsm policy list primitives
  */
 static inline void
 __ni_fsm_policy_list_insert(ni_fsm_policy_t **list, ni_fsm_policy_t *policy)
 {
+	ni_fsm_policy_index_invalidate();
 	policy->pprev = list;
 	policy->next = *list;
 	if (policy->next)
@@ -149,6 +187,9 @@ __ni_fsm_policy_list_unlink(ni_fsm_policy_t *policy)
 {
 	ni_fsm_policy_t **pprev, *next;
 
+	if (policy->pprev)
+		ni_fsm_policy_index_invalidate();
+
 	pprev = policy->pprev;
 	next = policy->next;
 	if (pprev)
@@ -321,6 +362,9 @@ ni_fsm_policy_new(ni_fsm_t *fsm, const char *name, xml_node_t *node)
 		return NULL;
 	}
 
+	if (!fsm->policy_index)
+		fsm->policy_index = xcalloc(1, sizeof(*fsm->policy_index));
+
 	__ni_fsm_policy_list_insert(&fsm->policies, policy);
 	return policy;
 }
@@ -360,6 +404,8 @@ ni_fsm_policy_update(ni_fsm_policy_t *policy, xml_node_t *node)
 
 	xml_node_free(policy->node);
 	policy->node = temp.node;
+
+	ni_fsm_policy_index_invalidate();
 	return TRUE;
 }
 
@@ -401,16 +447,149 @@ ni_fsm_policies_changed_since(const ni_fsm_t *fsm, unsigned int *tstamp)
 	return rv;
 }
 
-ni_fsm_policy_t *
-ni_fsm_policy_by_name(const ni_fsm_t *fsm, const char *name)
+static void
+ni_fsm_policy_index_clear(ni_fsm_policy_index_t *index)
+{
+	ni_fsm_policy_index_entry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < index->size; ++i) {
+		while ((entry = index->table[i])) {
+			index->table[i] = entry->next;
+			free(entry->applicable);
+			free(entry);
+		}
+	}
+	index->generation = 0;
+}
+
+void
+ni_fsm_policy_index_free(ni_fsm_policy_index_t *index)
+{
+	if (index) {
+		ni_fsm_policy_index_clear(index);
+		free(index->table);
+		free(index);
+	}
+}
+
+static ni_fsm_policy_index_entry_t *
+ni_fsm_policy_index_find(const ni_fsm_policy_index_t *index, const char *name)
+{
+	ni_fsm_policy_index_entry_t *entry;
+
+	if (!index->size || ni_string_empty(name))
+		return NULL;
+
+	entry = index->table[ni_hash_string(name) & (index->size - 1)];
+	for ( ; entry; entry = entry->next) {
+		if (ni_string_eq(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static ni_bool_t
+ni_fsm_policy_index_valid_config(const ni_fsm_policy_t *policy)
+{
+	if (!ni_ifpolicy_name_is_valid(policy->name)) {
+		ni_error("policy with invalid name %s", policy->name);
+		return FALSE;
+	}
+
+	if (policy->type != NI_IFPOLICY_TYPE_CONFIG) {
+		ni_error("policy %s: wrong type %d", policy->name, policy->type);
+		return FALSE;
+	}
+
+	if (!policy->match) {
+		ni_error("policy %s: no valid <match>", policy->name);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static inline ni_bool_t
+ni_fsm_policy_applies_before(const ni_fsm_policy_t *a, const ni_fsm_policy_t *b)
+{
+	return a->weight < b->weight || (a->weight == b->weight && a->seq < b->seq);
+}
+
+static void
+ni_fsm_policy_index_add(ni_fsm_policy_index_t *index, ni_fsm_policy_t *policy)
+{
+	ni_fsm_policy_index_entry_t *entry, **bucket;
+	unsigned int i;
+
+	if (!(entry = ni_fsm_policy_index_find(index, policy->name))) {
+		bucket = &index->table[ni_hash_string(policy->name) & (index->size - 1)];
+		entry = xcalloc(1, sizeof(*entry));
+		entry->name = policy->name;
+		entry->first = policy;
+		entry->next = *bucket;
+		*bucket = entry;
+	}
+
+	if (!ni_fsm_policy_index_valid_config(policy))
+		return;
+
+	/* insert sorted, there are usually one or two per name */
+	entry->applicable = xrealloc(entry->applicable,
+			(entry->count + 1) * sizeof(entry->applicable[0]));
+	for (i = entry->count; i > 0; --i) {
+		if (ni_fsm_policy_applies_before(entry->applicable[i - 1], policy))
+			break;
+		entry->applicable[i] = entry->applicable[i - 1];
+	}
+	entry->applicable[i] = policy;
+	entry->count++;
+}
+
+static ni_fsm_policy_index_t *
+ni_fsm_policy_index_get(const ni_fsm_t *fsm)
 {
+	ni_fsm_policy_index_t *index = fsm->policy_index;
 	ni_fsm_policy_t *policy;
+	unsigned int count = 0, size;
+
+	if (!index)
+		return NULL;
+
+	if (index->generation == ni_fsm_policy_generation)
+		return index;
+
+	ni_fsm_policy_index_clear(index);
+	for (policy = fsm->policies; policy; policy = policy->next)
+		count++;
+
+	for (size = NI_FSM_POLICY_INDEX_MIN_SIZE; size < count; size <<= 1)
+		;
+	if (index->size != size) {
+		free(index->table);
+		index->table = xcalloc(size, sizeof(index->table[0]));
+		index->size = size;
+	}
 
 	for (policy = fsm->policies; policy; policy = policy->next) {
-		if (policy->name && ni_string_eq(policy->name, name))
-			return policy;
+		if (!ni_string_empty(policy->name))
+			ni_fsm_policy_index_add(index, policy);
 	}
-	return NULL;
+
+	index->generation = ni_fsm_policy_generation;
+	return index;
+}
+
+ni_fsm_policy_t *
+ni_fsm_policy_by_name(const ni_fsm_t *fsm, const char *name)
+{
+	ni_fsm_policy_index_entry_t *entry;
+	ni_fsm_policy_index_t *index;
+
+	if (!(index = ni_fsm_policy_index_get(fsm)))
+		return NULL;
+
+	entry = ni_fsm_policy_index_find(index, name);
+	return entry ? entry->first : NULL;
 }
 
 /*
@@ -447,21 +626,9 @@ ni_fsm_policy_location(const ni_fsm_policy_t *policy)
  * Check whether policy applies to this ifworker
  */
 static ni_bool_t
-ni_fsm_policy_applicable(const ni_fsm_t *fsm, ni_fsm_policy_t *policy, ni_ifworker_t *w)
+__ni_fsm_policy_applicable(const ni_fsm_t *fsm, ni_fsm_policy_t *policy, ni_ifworker_t *w)
 {
 	xml_node_t *node;
-	char *pname;
-
-	if (!policy || !w)
-		return FALSE;
-
-	/* 1st match check -ifworker to policy name comparison */
-	pname = ni_ifpolicy_name_from_ifname(w->name);
-	if (!ni_string_eq(policy->name, pname)) {
-		ni_string_free(&pname);
-		return FALSE;
-	}
-	ni_string_free(&pname);
 
 	/* 2nd match check - ifworker  to config name comparison */
 	if (!xml_node_is_empty(w->config.node) &&
@@ -493,6 +660,23 @@ ni_fsm_policy_applicable(const ni_fsm_t *fsm, ni_fsm_policy_t *policy, ni_ifwork
 	return TRUE;
 }
 
+static ni_bool_t
+ni_fsm_policy_applicable(const ni_fsm_t *fsm, ni_fsm_policy_t *policy, ni_ifworker_t *w)
+{
+	ni_bool_t ret;
+	char *pname;
+
+	if (!policy || !w)
+		return FALSE;
+
+	/* 1st match check -ifworker to policy name comparison */
+	pname = ni_ifpolicy_name_from_ifname(w->name);
+	ret = ni_string_eq(policy->name, pname);
+	ni_string_free(&pname);
+
+	return ret && __ni_fsm_policy_applicable(fsm, policy, w);
+}
+
 /*
  * Retrieve policy origin
  */
@@ -506,56 +690,37 @@ ni_fsm_policy_get_origin(const ni_fsm_policy_t *policy)
 }
 
 /*
- * Compare the weight of two policies.
- * Returns < 0 if a's weight is smaller than that of b, etc.
- */
-static int
-__ni_fsm_policy_compare(const void *a, const void *b)
-{
-	const ni_fsm_policy_t *pa = a;
-	const ni_fsm_policy_t *pb = b;
-
-	return ((int) pa->weight) - ((int) pb->weight);
-}
-
-/*
- * Obtain the list of applicable policies
+ * Obtain the list of applicable policies, ordered by weight
  */
 unsigned int
 ni_fsm_policy_get_applicable_policies(const ni_fsm_t *fsm, ni_ifworker_t *w,
 			const ni_fsm_policy_t **result, unsigned int max)
 {
-	unsigned int count = 0;
+	ni_fsm_policy_index_entry_t *entry;
+	ni_fsm_policy_index_t *index;
 	ni_fsm_policy_t *policy;
+	unsigned int count = 0, i;
+	char *pname;
 
 	if (!w) {
 		ni_error("unable to get applicable policy for non-existing device");
 		return 0;
 	}
 
-	for (policy = fsm->policies; policy; policy = policy->next) {
-		if (!ni_ifpolicy_name_is_valid(policy->name)) {
-			ni_error("policy with invalid name %s", policy->name);
-			continue;
-		}
+	if (!(index = ni_fsm_policy_index_get(fsm)))
+		return 0;
 
-		if (policy->type != NI_IFPOLICY_TYPE_CONFIG) {
-			ni_error("policy %s: wrong type %d", policy->name, policy->type);
-			continue;
-		}
+	/* 1st match check -ifworker to policy name comparison */
+	pname = ni_ifpolicy_name_from_ifname(w->name);
+	entry = ni_fsm_policy_index_find(index, pname);
+	ni_string_free(&pname);
 
-		if (!policy->match) {
-			ni_error("policy %s: no valid <match>", policy->name);
-			continue;
-		}
+	for (i = 0; entry && i < entry->count && count < max; ++i) {
+		policy = entry->applicable[i];
 
-		if (ni_fsm_policy_applicable(fsm, policy, w)) {
-			if (count < max)
-				result[count++] = policy;
-		}
+		if (__ni_fsm_policy_applicable(fsm, policy, w))
+			result[count++] = policy;
 	}
-
-	qsort(result, count, sizeof(result[0]), __ni_fsm_policy_compare);
 	return count;
 }
 
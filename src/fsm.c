@@ -72,6 +72,23 @@ static inline void		ni_fsm_events_block(ni_fsm_t *);
 static inline void		ni_fsm_events_unblock(ni_fsm_t *);
 static void			ni_fsm_process_event(ni_fsm_t *, ni_fsm_event_t *);
 static void			ni_fsm_process_events(ni_fsm_t *);
+static void			ni_fsm_calls_detach(ni_fsm_t *);
+static void			ni_ifworker_index_free(ni_ifworker_index_t *);
+
+/*
+ * Transition calls sent asynchronously when <fsm><parallel-calls>
+ * permits more than one call in flight. The reply callback does
+ * not provide any user data, so we look up the call by its proxy.
+ */
+typedef struct ni_fsm_call	ni_fsm_call_t;
+struct ni_fsm_call {
+	ni_fsm_call_t *		next;
+	ni_fsm_t *		fsm;
+	ni_ifworker_t *		worker;
+	ni_dbus_object_t *	proxy;
+};
+
+static ni_fsm_call_t *		ni_fsm_calls;
 
 
 ni_fsm_t *
@@ -81,6 +98,7 @@ ni_fsm_new(void)
 
 	fsm = calloc(1, sizeof(*fsm));
 	fsm->readonly = FALSE;
+	fsm->parallel_calls = ni_config_fsm_parallel_calls();
 
 	ni_fsm_user_prompt_fn = ni_fsm_user_prompt_default;
 	return fsm;
@@ -89,9 +107,12 @@ ni_fsm_new(void)
 void
 ni_fsm_free(ni_fsm_t *fsm)
 {
+	ni_fsm_calls_detach(fsm);
 	ni_fsm_events_destroy(&fsm->events);
 	ni_ifworker_array_destroy(&fsm->pending);
 	ni_ifworker_array_destroy(&fsm->workers);
+	ni_ifworker_index_free(fsm->index);
+	ni_fsm_policy_index_free(fsm->policy_index);
 	free(fsm);
 }
 
@@ -178,19 +199,43 @@ ni_fsm_events_unblock(ni_fsm_t *fsm)
 	fsm->block_events--;
 }
 
+/*
+ * Events of a worker waiting for the reply of an async call are kept
+ * in the queue until the reply (and the callbacks it announces) has
+ * been processed, just as all events are while a call is done sync.
+ */
+static ni_bool_t
+ni_fsm_event_deferred(ni_fsm_t *fsm, const ni_fsm_event_t *ev)
+{
+	ni_ifworker_t *w;
+
+	if (!fsm->calls_in_flight)
+		return FALSE;
+
+	w = ni_fsm_ifworker_by_object_path(fsm, ev->object_path);
+	return w && w->fsm.call.pending;
+}
+
 static void
 ni_fsm_process_events(ni_fsm_t *fsm)
 {
-	ni_fsm_event_t *ev;
+	ni_fsm_event_t *ev, **pos = &fsm->events;
 
-	while ((ev = fsm->events)) {
-		fsm->events = ev->next;
+	while ((ev = *pos)) {
+		if (ni_fsm_event_deferred(fsm, ev)) {
+			pos = &ev->next;
+			continue;
+		}
+		*pos = ev->next;
 
 		ni_fsm_events_block(fsm);
 		ni_fsm_process_event(fsm, ev);
 		ni_fsm_events_unblock(fsm);
 
 		ni_fsm_event_free(ev);
+
+		/* processing may have changed the queue */
+		pos = &fsm->events;
 	}
 }
 
@@ -320,7 +365,9 @@ __ni_ifworker_reset_action_table(ni_ifworker_t *w)
 		ni_ifworker_cancel_callbacks(w, &action->callbacks);
 	}
 	w->fsm.wait_for = NULL;
+	w->fsm.call.action = NULL;
 	w->fsm.next_action = w->fsm.action_table;
+	w->bound = FALSE;
 }
 
 static void
@@ -837,23 +884,6 @@ ni_ifworker_array_find_by_objectpath(ni_ifworker_array_t *array, const char *obj
 	return NULL;
 }
 
-static ni_ifworker_t *
-ni_ifworker_array_find_by_name(const ni_ifworker_array_t *array, ni_ifworker_type_t type, const char *name)
-{
-	unsigned int i;
-
-	if (ni_string_empty(name))
-		return NULL;
-
-	for (i = 0; i < array->count; ++i) {
-		ni_ifworker_t *worker = array->data[i];
-
-		if (worker->type == type && ni_string_eq(worker->name, name))
-			return worker;
-	}
-	return NULL;
-}
-
 ni_ifworker_array_t *
 ni_ifworker_array_clone(ni_ifworker_array_t *array)
 {
@@ -919,76 +949,400 @@ ni_ifworker_array_remove_with_children(ni_ifworker_array_t *array, ni_ifworker_t
 	}
 }
 
+/*
+ * Worker lookup index by name, ifindex and object path.
+ *
+ * Each entry records the keys the worker has been indexed with and
+ * the sequence it has been added in; lookups return the oldest match
+ * like a walk over the fsm->workers array would. Lookups also verify
+ * the current keys, so a worker losing a key (e.g. the object path
+ * on device deletion) does not need to be reindexed.
+ */
+enum {
+	NI_IFWORKER_INDEX_WORKER,
+	NI_IFWORKER_INDEX_NAME,
+	NI_IFWORKER_INDEX_IFINDEX,
+	NI_IFWORKER_INDEX_OBJECT_PATH,
+
+	NI_IFWORKER_INDEX_MAX
+};
+
+#define NI_IFWORKER_INDEX_CHUNK	64
+
+typedef struct ni_ifworker_index_entry	ni_ifworker_index_entry_t;
+struct ni_ifworker_index_entry {
+	ni_ifworker_index_entry_t *	next[NI_IFWORKER_INDEX_MAX];
+
+	ni_ifworker_t *			worker;
+	unsigned int			seq;
+	ni_ifworker_type_t		type;
+	char *				name;
+	unsigned int			ifindex;
+	char *				object_path;
+};
+
+struct ni_ifworker_index {
+	unsigned int			seq;
+	unsigned int			count;
+	unsigned int			size;
+	ni_ifworker_index_entry_t **	table[NI_IFWORKER_INDEX_MAX];
+};
+
+static inline unsigned int
+ni_ifworker_index_hash_worker(const ni_ifworker_t *w)
+{
+	return ni_hash_bytes(&w, sizeof(w));
+}
+
+static ni_ifworker_index_entry_t **
+ni_ifworker_index_bucket(ni_ifworker_index_t *index, unsigned int type,
+			const ni_ifworker_index_entry_t *entry)
+{
+	unsigned int hash;
+
+	switch (type) {
+	case NI_IFWORKER_INDEX_WORKER:
+		hash = ni_ifworker_index_hash_worker(entry->worker);
+		break;
+	case NI_IFWORKER_INDEX_NAME:
+		hash = ni_hash_string(entry->name);
+		break;
+	case NI_IFWORKER_INDEX_IFINDEX:
+		hash = ni_hash_uint(entry->ifindex);
+		break;
+	case NI_IFWORKER_INDEX_OBJECT_PATH:
+		hash = ni_hash_string(entry->object_path);
+		break;
+	default:
+		return NULL;
+	}
+	return &index->table[type][hash & (index->size - 1)];
+}
+
+static inline ni_bool_t
+ni_ifworker_index_has_key(const ni_ifworker_index_entry_t *entry, unsigned int type)
+{
+	switch (type) {
+	case NI_IFWORKER_INDEX_NAME:
+		return !ni_string_empty(entry->name);
+	case NI_IFWORKER_INDEX_IFINDEX:
+		return entry->ifindex != 0;
+	case NI_IFWORKER_INDEX_OBJECT_PATH:
+		return !ni_string_empty(entry->object_path);
+	default:
+		return TRUE;
+	}
+}
+
+static void
+ni_ifworker_index_link(ni_ifworker_index_t *index, ni_ifworker_index_entry_t *entry)
+{
+	ni_ifworker_index_entry_t **bucket;
+	unsigned int type;
+
+	for (type = 0; type < NI_IFWORKER_INDEX_MAX; ++type) {
+		entry->next[type] = NULL;
+		if (!ni_ifworker_index_has_key(entry, type))
+			continue;
+
+		bucket = ni_ifworker_index_bucket(index, type, entry);
+		entry->next[type] = *bucket;
+		*bucket = entry;
+	}
+}
+
+static void
+ni_ifworker_index_unlink(ni_ifworker_index_t *index, ni_ifworker_index_entry_t *entry)
+{
+	ni_ifworker_index_entry_t **pos, *cur;
+	unsigned int type;
+
+	for (type = 0; type < NI_IFWORKER_INDEX_MAX; ++type) {
+		if (!ni_ifworker_index_has_key(entry, type))
+			continue;
+
+		pos = ni_ifworker_index_bucket(index, type, entry);
+		for ( ; (cur = *pos) != NULL; pos = &cur->next[type]) {
+			if (cur == entry) {
+				*pos = entry->next[type];
+				break;
+			}
+		}
+		entry->next[type] = NULL;
+	}
+}
+
+static void
+ni_ifworker_index_resize(ni_ifworker_index_t *index, unsigned int size)
+{
+	ni_ifworker_index_entry_t **old, *entry, *next;
+	unsigned int type, oldsize, i;
+
+	old = index->table[NI_IFWORKER_INDEX_WORKER];
+	oldsize = index->size;
+
+	index->size = size;
+	for (type = 0; type < NI_IFWORKER_INDEX_MAX; ++type) {
+		if (type != NI_IFWORKER_INDEX_WORKER)
+			free(index->table[type]);
+		index->table[type] = xcalloc(size, sizeof(ni_ifworker_index_entry_t *));
+	}
+
+	for (i = 0; i < oldsize; ++i) {
+		for (entry = old[i]; entry; entry = next) {
+			next = entry->next[NI_IFWORKER_INDEX_WORKER];
+			ni_ifworker_index_link(index, entry);
+		}
+	}
+	free(old);
+}
+
+static ni_ifworker_index_entry_t *
+ni_ifworker_index_find(const ni_ifworker_index_t *index, const ni_ifworker_t *w)
+{
+	ni_ifworker_index_entry_t *entry;
+	unsigned int hash;
+
+	if (!index || !index->size)
+		return NULL;
+
+	hash = ni_ifworker_index_hash_worker(w);
+	entry = index->table[NI_IFWORKER_INDEX_WORKER][hash & (index->size - 1)];
+	for ( ; entry; entry = entry->next[NI_IFWORKER_INDEX_WORKER]) {
+		if (entry->worker == w)
+			return entry;
+	}
+	return NULL;
+}
+
+static inline ni_bool_t
+ni_ifworker_index_uptodate(const ni_ifworker_index_entry_t *entry, const ni_ifworker_t *w)
+{
+	return	entry->type == w->type &&
+		entry->ifindex == w->ifindex &&
+		ni_string_eq(entry->name, w->name) &&
+		ni_string_eq(entry->object_path, w->object_path);
+}
+
+static void
+ni_ifworker_index_entry_free(ni_ifworker_index_entry_t *entry)
+{
+	ni_string_free(&entry->name);
+	ni_string_free(&entry->object_path);
+	free(entry);
+}
+
+static void
+ni_ifworker_index_free(ni_ifworker_index_t *index)
+{
+	ni_ifworker_index_entry_t *entry, *next;
+	unsigned int type, i;
+
+	if (!index)
+		return;
+
+	for (i = 0; i < index->size; ++i) {
+		for (entry = index->table[NI_IFWORKER_INDEX_WORKER][i]; entry; entry = next) {
+			next = entry->next[NI_IFWORKER_INDEX_WORKER];
+			ni_ifworker_index_entry_free(entry);
+		}
+	}
+	for (type = 0; type < NI_IFWORKER_INDEX_MAX; ++type)
+		free(index->table[type]);
+	free(index);
+}
+
+/*
+ * (Re)index a worker in fsm->workers after it has been added
+ * or its name, ifindex or object path has been changed.
+ */
+static void
+ni_fsm_ifworker_index(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_ifworker_index_t *index;
+	ni_ifworker_index_entry_t *entry;
+
+	if (!fsm || !w)
+		return;
+
+	if (!(index = fsm->index))
+		index = fsm->index = xcalloc(1, sizeof(*index));
+
+	if ((entry = ni_ifworker_index_find(index, w))) {
+		if (ni_ifworker_index_uptodate(entry, w))
+			return;
+
+		if (!ni_string_eq(entry->name, w->name))
+			fsm->workers_added = TRUE;
+		ni_ifworker_index_unlink(index, entry);
+	} else {
+		if (index->count >= index->size)
+			ni_ifworker_index_resize(index, index->size ?
+					index->size * 2 : NI_IFWORKER_INDEX_CHUNK);
+
+		entry = xcalloc(1, sizeof(*entry));
+		entry->worker = w;
+		entry->seq = index->seq++;
+		index->count++;
+		fsm->workers_added = TRUE;
+	}
+
+	entry->type = w->type;
+	entry->ifindex = w->ifindex;
+	ni_string_dup(&entry->name, w->name);
+	ni_string_dup(&entry->object_path, w->object_path);
+	ni_ifworker_index_link(index, entry);
+}
+
+/*
+ * Update the index after the name, ifindex or object path of a worker
+ * has been changed. Workers not in fsm->workers (pending) are skipped.
+ */
+static void
+ni_fsm_ifworker_reindex(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	if (fsm && ni_ifworker_index_find(fsm->index, w))
+		ni_fsm_ifworker_index(fsm, w);
+}
+
+static void
+ni_fsm_ifworker_unindex(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_ifworker_index_t *index = fsm ? fsm->index : NULL;
+	ni_ifworker_index_entry_t *entry;
+
+	if (!(entry = ni_ifworker_index_find(index, w)))
+		return;
+
+	ni_ifworker_index_unlink(index, entry);
+	ni_ifworker_index_entry_free(entry);
+	index->count--;
+}
+
+static ni_ifworker_t *
+ni_fsm_ifworker_index_lookup(const ni_fsm_t *fsm, unsigned int type, ni_ifworker_type_t wtype,
+				const char *name, unsigned int ifindex)
+{
+	ni_ifworker_index_t *index = fsm->index;
+	ni_ifworker_index_entry_t *entry, *best = NULL;
+	unsigned int hash;
+
+	if (!index || !index->size)
+		return NULL;
+
+	hash = type == NI_IFWORKER_INDEX_IFINDEX ? ni_hash_uint(ifindex) : ni_hash_string(name);
+	entry = index->table[type][hash & (index->size - 1)];
+	for ( ; entry; entry = entry->next[type]) {
+		const ni_ifworker_t *w = entry->worker;
+
+		if (best && best->seq < entry->seq)
+			continue;
+
+		switch (type) {
+		case NI_IFWORKER_INDEX_NAME:
+			if (w->type != wtype || !ni_string_eq(entry->name, name) ||
+			    !ni_string_eq(w->name, name))
+				continue;
+			break;
+		case NI_IFWORKER_INDEX_IFINDEX:
+			if (entry->ifindex != ifindex || w->ifindex != ifindex)
+				continue;
+			break;
+		case NI_IFWORKER_INDEX_OBJECT_PATH:
+			if (!ni_string_eq(entry->object_path, name) ||
+			    !ni_string_eq(w->object_path, name))
+				continue;
+			break;
+		default:
+			return NULL;
+		}
+		best = entry;
+	}
+	return best ? best->worker : NULL;
+}
+
+/*
+ * Add a new worker to fsm->workers or remove it.
+ */
+static ni_ifworker_t *
+ni_fsm_ifworker_new(ni_fsm_t *fsm, ni_ifworker_type_t type, const char *name)
+{
+	ni_ifworker_t *w;
+
+	w = ni_ifworker_new(&fsm->workers, type, name);
+	ni_fsm_ifworker_index(fsm, w);
+	return w;
+}
+
+ni_bool_t
+ni_fsm_remove_worker(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_fsm_ifworker_unindex(fsm, w);
+	return ni_ifworker_array_remove(&fsm->workers, w);
+}
+
 ni_ifworker_t *
 ni_fsm_ifworker_by_name(const ni_fsm_t *fsm, ni_ifworker_type_t type, const char *name)
 {
-	return ni_ifworker_array_find_by_name(&fsm->workers, type, name);
+	if (ni_string_empty(name))
+		return NULL;
+
+	return ni_fsm_ifworker_index_lookup(fsm, NI_IFWORKER_INDEX_NAME, type, name, 0);
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_policy_name(ni_fsm_t *fsm, ni_ifworker_type_t type, const char *policy_name)
 {
-	unsigned int i;
 	ni_ifworker_t *w;
-	char *n;
+	char *ifname;
 
 	if (!fsm || !policy_name)
 		return NULL;
 
-	for (i = 0; i < fsm->workers.count ; ++i) {
-		w = fsm->workers.data[i];
-		if (w && w->type == type) {
-			n = ni_ifpolicy_name_from_ifname(w->name);
-			if (n && ni_string_eq(n, policy_name)) {
-				ni_string_free(&n);
-				return w;
-			}
-			ni_string_free(&n);
-		}
-	}
-
-	return NULL;
+	/* the policy name encodes the worker name */
+	ifname = ni_ifpolicy_name_to_ifname(policy_name);
+	w = ni_fsm_ifworker_by_name(fsm, type, ifname);
+	ni_string_free(&ifname);
+	return w;
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_object_path(ni_fsm_t *fsm, const char *object_path)
 {
-	return ni_ifworker_array_find_by_objectpath(&fsm->workers, object_path);
+	if (ni_string_empty(object_path))
+		return NULL;
+
+	return ni_fsm_ifworker_index_lookup(fsm, NI_IFWORKER_INDEX_OBJECT_PATH,
+						NI_IFWORKER_TYPE_NONE, object_path, 0);
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_ifindex(ni_fsm_t *fsm, unsigned int ifindex)
 {
-	unsigned int i;
-
 	if (0 == ifindex)
 		return NULL;
 
-	for (i = 0; i < fsm->workers.count; ++i) {
-		ni_ifworker_t *w = fsm->workers.data[i];
-
-		if (w->ifindex && w->ifindex == ifindex)
-			return w;
-	}
-
-	return NULL;
+	return ni_fsm_ifworker_index_lookup(fsm, NI_IFWORKER_INDEX_IFINDEX,
+						NI_IFWORKER_TYPE_NONE, NULL, ifindex);
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_netdev(ni_fsm_t *fsm, const ni_netdev_t *dev)
 {
+	ni_ifworker_t *w;
 	unsigned int i;
 
 	if (dev == NULL)
 		return NULL;
 
+	if ((w = ni_fsm_ifworker_by_ifindex(fsm, dev->link.ifindex)))
+		return w;
+
 	for (i = 0; i < fsm->workers.count; ++i) {
-		ni_ifworker_t *w = fsm->workers.data[i];
+		w = fsm->workers.data[i];
 
 		if (w->device == dev)
 			return w;
-		if (w->ifindex && w->ifindex == dev->link.ifindex)
-			return w;
 	}
 
 	return NULL;
@@ -1366,6 +1720,10 @@ ni_ifworker_add_child_master(xml_node_t *config, const char *name)
 			"there is already one <master>%s</master>", name, master->cdata);
 		return FALSE;
 	}
+	else {
+		/* already there, config (uuid) unchanged */
+		return FALSE;
+	}
 
 	return TRUE;
 }
@@ -1419,9 +1777,13 @@ ni_ifworker_set_lower_device(ni_ifworker_t *child, ni_ifworker_t *lower, xml_nod
 		ni_debug_application("%s (%s): setting lower device to %s",
 				child->name, xml_node_location(devnode), lower->name);
 
-		child->lowerdev = lower;
-		if (ni_ifworker_array_index(&lower->lowerdev_for, child) < 0)
+		/* lowerdev_for contains child when child->lowerdev is lower */
+		if (child->lowerdev != lower) {
+			if (child->lowerdev)
+				ni_ifworker_array_remove(&child->lowerdev->lowerdev_for, child);
+			child->lowerdev = lower;
 			ni_ifworker_array_append(&lower->lowerdev_for, child);
+		}
 		return TRUE;
 	}
 
@@ -1577,12 +1939,44 @@ ni_ifworker_update_client_state_control(ni_ifworker_t *w)
 	}
 }
 
+/*
+ * Keep the applied config for ifreload to diff against it,
+ * the client state refers to it by the config uuid only.
+ */
+static void
+ni_ifworker_update_applied_config(ni_ifworker_t *w)
+{
+	ni_client_state_t *cs = w->device ? w->device->client_state : NULL;
+
+	if (cs && !ni_uuid_is_null(&cs->config.uuid) &&
+	    !ni_uuid_equal(&cs->config.uuid, &w->config.meta.uuid))
+		ni_ifconfig_applied_remove(&cs->config.uuid);
+
+	if (!ni_uuid_is_null(&w->config.meta.uuid) && !xml_node_is_empty(w->config.node))
+		ni_ifconfig_applied_save(&w->config.meta.uuid, w->config.node);
+}
+
+/*
+ * Drop the applied config when the client state config is cleared.
+ */
+static void
+ni_ifworker_remove_applied_config(ni_ifworker_t *w)
+{
+	ni_client_state_t *cs = w->device ? w->device->client_state : NULL;
+
+	if (cs && !ni_uuid_is_null(&cs->config.uuid))
+		ni_ifconfig_applied_remove(&cs->config.uuid);
+	if (!ni_uuid_is_null(&w->config.meta.uuid))
+		ni_ifconfig_applied_remove(&w->config.meta.uuid);
+}
+
 static inline void
 ni_ifworker_update_client_state_config(ni_ifworker_t *w)
 {
 	if (w && w->object && !w->readonly) {
 		ni_call_set_client_state_config(w->object, &w->config.meta);
 		ni_client_state_config_debug(w->name, &w->config.meta, "update");
+		ni_ifworker_update_applied_config(w);
 	}
 }
 
@@ -2066,6 +2460,7 @@ ni_ifworker_set_config(ni_ifworker_t *w, xml_node_t *ifnode, const char *config_
 
 	xml_node_free(w->config.node);
 	ni_client_state_config_reset(&w->config.meta);
+	w->bound = FALSE;
 	if (!(w->config.node = xml_node_clone_ref(ifnode)))
 		return;
 
@@ -2127,7 +2522,7 @@ ni_fsm_workers_from_xml(ni_fsm_t *fsm, xml_node_t *ifnode, const char *origin)
 		} else {
 			ifname = node->cdata;
 			if (ifname && (w = ni_fsm_ifworker_by_name(fsm, type, ifname)) == NULL)
-				w = ni_ifworker_new(&fsm->workers, type, ifname);
+				w = ni_fsm_ifworker_new(fsm, type, ifname);
 		}
 	}
 
@@ -2372,6 +2767,7 @@ ni_ifworker_require_netif_resolve(ni_fsm_t *fsm, ni_ifworker_t *w, ni_ifworker_t
 		ni_debug_application("%s: cannot resolve reference %s to subordinate device yet",
 					w->name, path.string);
 		ni_stringbuf_destroy(&path);
+		w->unresolved = TRUE;
 		return NULL;
 	}
 
@@ -3076,21 +3472,6 @@ ni_ifworker_break_loops(ni_ifworker_array_t *guard, ni_ifworker_t *w, unsigned i
 	return TRUE;
 }
 
-static ni_bool_t
-ni_ifworkers_break_loops(ni_fsm_t *fsm)
-{
-	ni_ifworker_array_t guard = NI_IFWORKER_ARRAY_INIT;
-	ni_ifworker_t *w;
-	unsigned int i;
-
-	for (i = 0; i < fsm->workers.count; ++i) {
-		w = fsm->workers.data[i];
-		ni_ifworker_break_loops(&guard, w, 0);
-		ni_ifworker_array_destroy(&guard);
-	}
-	return TRUE;
-}
-
 static void
 __ni_fsm_pull_in_children(ni_ifworker_t *w, ni_ifworker_array_t *array)
 {
@@ -3180,8 +3561,10 @@ ni_fsm_mark_matching_workers(ni_fsm_t *fsm, ni_ifworker_array_t *marked, const n
 		w->target_range = marker->target_range;
 
 		/* Clean client-info origin and UUID on ifdown */
-		if (marker->target_range.max < NI_FSM_STATE_DEVICE_SETUP)
+		if (marker->target_range.max < NI_FSM_STATE_DEVICE_SETUP) {
+			ni_ifworker_remove_applied_config(w);
 			ni_client_state_config_init(&w->config.meta);
+		}
 
 		if (marker->persistent)
 			ni_ifworker_control_set_persistent(w, TRUE);
@@ -3264,22 +3647,32 @@ ni_fsm_clear_hierarchy(ni_ifworker_t *w)
 {
 	unsigned int i;
 
-	if (w->masterdev)
+	/* the workers losing an edge need to be bound again */
+	w->bound = FALSE;
+
+	if (w->masterdev) {
 		ni_ifworker_array_remove(&w->masterdev->children, w);
+		w->masterdev->bound = FALSE;
+	}
 
-	if (w->lowerdev)
+	if (w->lowerdev) {
 		ni_ifworker_array_remove(&w->lowerdev->lowerdev_for, w);
+		w->lowerdev->bound = FALSE;
+		w->lowerdev = NULL;
+	}
 
 	for (i = 0; i < w->lowerdev_for.count; i++) {
 		ni_ifworker_t *ldev_usr = w->lowerdev_for.data[i];
 
 		ni_ifworker_array_remove(&ldev_usr->children, w);
 		ldev_usr->lowerdev = NULL;
+		ldev_usr->bound = FALSE;
 	}
 
 	for (i = 0; i < w->children.count; i++) {
 		ni_ifworker_t *child = w->children.data[i];
 
+		child->bound = FALSE;
 		if (child->masterdev == w) {
 			child->masterdev = NULL;
 			ni_ifworker_del_child_master(child->config.node);
@@ -3296,7 +3689,7 @@ ni_fsm_clear_hierarchy(ni_ifworker_t *w)
 }
 
 static void
-ni_ifworker_device_delete(ni_ifworker_t *w)
+ni_ifworker_device_delete(ni_fsm_t *fsm, ni_ifworker_t *w)
 {
 	ni_ifworker_get(w);
 	ni_debug_application("%s(%s)", __func__, w->name);
@@ -3312,6 +3705,7 @@ ni_ifworker_device_delete(ni_ifworker_t *w)
 	}
 	ni_string_free(&w->object_path);
 	w->object_path = NULL;
+	ni_fsm_ifworker_reindex(fsm, w);
 
 	ni_ifworker_cancel_secondary_timeout(w);
 	ni_ifworker_cancel_timeout(w);
@@ -3336,12 +3730,12 @@ ni_fsm_destroy_worker(ni_fsm_t *fsm, ni_ifworker_t *w)
 	ni_ifworker_get(w);
 
 	ni_debug_application("%s(%s)", __func__, w->name);
-	if (!ni_ifworker_array_remove(&fsm->workers, w)) {
+	if (!ni_fsm_remove_worker(fsm, w)) {
 		ni_ifworker_release(w);
 		return;
 	}
 
-	ni_ifworker_device_delete(w);
+	ni_ifworker_device_delete(fsm, w);
 
 	ni_ifworker_release(w);
 }
@@ -3621,12 +4015,29 @@ ni_fsm_print_hierarchy(ni_fsm_t *fsm)
 	}
 }
 
+/*
+ * The hierarchy is built incrementally: only workers, which are not
+ * bound yet (new, changed config or lost an edge) are bound again.
+ * Workers with unresolved references are retried after new workers
+ * have been added or renamed.
+ */
+static void
+ni_fsm_update_child_master(ni_ifworker_t *w)
+{
+	if (w->masterdev && ni_ifworker_add_child_master(w->config.node, w->masterdev->name))
+		ni_ifworker_generate_uuid(w);
+}
+
 int
 ni_fsm_build_hierarchy(ni_fsm_t *fsm, ni_bool_t destructive)
 {
-	unsigned int i;
+	ni_ifworker_array_t rebound = NI_IFWORKER_ARRAY_INIT;
+	ni_ifworker_array_t guard = NI_IFWORKER_ARRAY_INIT;
+	ni_bool_t added = fsm->workers_added;
+	unsigned int i, j;
 
 	ni_fsm_events_block(fsm);
+	fsm->workers_added = FALSE;
 	for (i = 0; i < fsm->workers.count; ++i) {
 		ni_ifworker_t *w = fsm->workers.data[i];
 		int rv;
@@ -3636,27 +4047,39 @@ ni_fsm_build_hierarchy(ni_fsm_t *fsm, ni_bool_t destructive)
 		if (!w->config.node)
 			continue;
 
+		if (w->bound && !(w->unresolved && added))
+			continue;
+
+		w->unresolved = FALSE;
 		if ((rv = ni_ifworker_bind_early(w, fsm, FALSE)) < 0) {
 			if (destructive) {
 				if (-NI_ERROR_DOCUMENT_ERROR == rv)
 					ni_debug_application("%s: configuration failed", w->name);
 				ni_fsm_destroy_worker(fsm, w);
 				i--;
+				continue;
 			}
+		} else {
+			w->bound = TRUE;
 		}
+		ni_ifworker_array_append(&rebound, w);
 	}
 
-	for (i = 0; i < fsm->workers.count; ++i) {
-		ni_ifworker_t *w = fsm->workers.data[i];
+	/* binding a master also sets the master of its slaves */
+	for (i = 0; i < rebound.count; ++i) {
+		ni_ifworker_t *w = rebound.data[i];
 
-		if (w->masterdev) {
-			if (!ni_ifworker_add_child_master(w->config.node, w->masterdev->name))
-				continue;
-			ni_ifworker_generate_uuid(w);
-		}
+		ni_fsm_update_child_master(w);
+		for (j = 0; j < w->children.count; ++j)
+			ni_fsm_update_child_master(w->children.data[j]);
 	}
 
-	ni_ifworkers_break_loops(fsm);
+	/* a new loop contains at least one of the new edges */
+	for (i = 0; i < rebound.count; ++i) {
+		ni_ifworker_break_loops(&guard, rebound.data[i], 0);
+		ni_ifworker_array_destroy(&guard);
+	}
+	ni_ifworker_array_destroy(&rebound);
 	ni_fsm_events_unblock(fsm);
 
 	if (ni_log_facility(NI_TRACE_APPLICATION))
@@ -3829,8 +4252,10 @@ ni_fsm_refresh_master_dev(ni_fsm_t *fsm, ni_ifworker_t *w)
 	if (w->masterdev) {
 		ni_ifworker_array_t *children = &w->masterdev->children;
 
-		if (ni_ifworker_array_index(children, w) < 0)
+		if (ni_ifworker_array_index(children, w) < 0) {
 			ni_ifworker_array_append(children, w);
+			w->bound = FALSE;
+		}
 	}
 }
 
@@ -3852,9 +4277,13 @@ ni_fsm_refresh_lower_dev(ni_fsm_t *fsm, ni_ifworker_t *w)
 	if (!lower)
 		return;
 
-	w->lowerdev = lower;
-	if (ni_ifworker_array_index(&lower->lowerdev_for, w) < 0)
+	if (w->lowerdev != lower) {
+		if (w->lowerdev)
+			ni_ifworker_array_remove(&w->lowerdev->lowerdev_for, w);
+		w->lowerdev = lower;
 		ni_ifworker_array_append(&lower->lowerdev_for, w);
+		w->bound = FALSE;
+	}
 
 	if (ni_ifworker_array_index(&w->children, lower) < 0)
 		ni_ifworker_array_append(&w->children, lower);
@@ -3936,6 +4365,12 @@ ni_fsm_refresh_state(ni_fsm_t *fsm)
 	return TRUE;
 }
 
+/*
+ * The fsm doesn't need the properties flagged on-demand in the
+ * schema (such as the ethtool settings), so don't ask for them.
+ */
+static const ni_dbus_property_filter_t	ni_fsm_netdev_property_filter = NI_DBUS_PROPERTY_FILTER_INIT;
+
 static ni_bool_t
 __ni_ifworker_refresh_netdevs(ni_fsm_t *fsm)
 {
@@ -3948,7 +4383,7 @@ __ni_ifworker_refresh_netdevs(ni_fsm_t *fsm)
 	}
 
 	/* Call ObjectManager.GetManagedObjects to get list of objects and their properties */
-	if (!ni_dbus_object_refresh_children(list_object)) {
+	if (!ni_dbus_object_refresh_children_filtered(list_object, &ni_fsm_netdev_property_filter)) {
 		ni_error("Couldn't refresh list of active network interfaces");
 		return FALSE;
 	}
@@ -3966,7 +4401,7 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 	ni_bool_t renamed = FALSE;
 
 	if (dev == NULL || dev->name == NULL || refresh) {
-		if (!ni_dbus_object_refresh_children(object)) {
+		if (!ni_dbus_object_refresh_children_filtered(object, &ni_fsm_netdev_property_filter)) {
 			ni_error("%s: failed to refresh netdev object", object->path);
 			return NULL;
 		}
@@ -3987,13 +4422,13 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 			ni_ifworker_array_remove(&fsm->pending, found);
 
 		/* lookup worker by object path (ifindex) first, then by name */
-		found = ni_ifworker_array_find_by_objectpath(&fsm->workers, object->path);
+		found = ni_fsm_ifworker_by_object_path(fsm, object->path);
 		if (!found)
 			found = ni_fsm_ifworker_by_name(fsm, NI_IFWORKER_TYPE_NETDEV, dev->name);
 		if (!found) {
 			ni_debug_application("received new ready device %s (%s)",
 						dev->name, object->path);
-			found = ni_ifworker_new(&fsm->workers, NI_IFWORKER_TYPE_NETDEV, dev->name);
+			found = ni_fsm_ifworker_new(fsm, NI_IFWORKER_TYPE_NETDEV, dev->name);
 			found->readonly = fsm->readonly;
 		} else {
 			renamed = !ni_string_eq(found->name, dev->name);
@@ -4045,6 +4480,7 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 
 	found->ifindex = dev->link.ifindex;
 	found->object = object;
+	ni_fsm_ifworker_reindex(fsm, found);
 
 	return found;
 }
@@ -4116,11 +4552,12 @@ ni_fsm_recv_new_modem(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 		found = ni_fsm_ifworker_by_object_path(fsm, object->path);
 	if (!found) {
 		ni_debug_application("received new modem %s (%s)", modem->device, object->path);
-		found = ni_ifworker_new(&fsm->workers, NI_IFWORKER_TYPE_MODEM, modem->device);
+		found = ni_fsm_ifworker_new(fsm, NI_IFWORKER_TYPE_MODEM, modem->device);
 	}
 
 	if (!found->object_path)
 		ni_string_dup(&found->object_path, object->path);
+	ni_fsm_ifworker_reindex(fsm, found);
 	if (!found->modem)
 		found->modem = ni_modem_hold(modem);
 	found->object = object;
@@ -4661,6 +5098,50 @@ ni_ifworker_update_from_request(ni_ifworker_t *w, const char *service, const cha
 	}
 }
 
+/*
+ * Process the result of a transition binding call.
+ * Returns 0 to continue with the next binding, 1 when the
+ * (may-fail) transition is finished and < 0 on failure.
+ */
+static int
+ni_ifworker_common_call_result(ni_ifworker_t *w, ni_fsm_transition_t *action,
+				const char *service, const char *method, int rv,
+				ni_objectmodel_callback_info_t *callback_list,
+				unsigned int *count)
+{
+	ni_ifworker_update_from_request(w, service, method, rv, callback_list);
+	if (rv < 0) {
+		if (action->common.may_fail) {
+			ni_error("[ignored] %s: call to %s.%s() failed: %s", w->name,
+					service, method, ni_strerror(rv));
+			ni_ifworker_set_state(w, action->next_state);
+			return 1;
+		}
+		ni_ifworker_fail(w, "call to %s.%s() failed: %s", service, method, ni_strerror(rv));
+		return rv;
+	}
+
+	if (callback_list) {
+		ni_debug_application("%s: adding callback for %s.%s()", w->name, service, method);
+		ni_ifworker_add_callbacks(action, callback_list, w->name);
+		(*count)++;
+	}
+	return 0;
+}
+
+static void
+ni_ifworker_common_call_done(ni_ifworker_t *w, ni_fsm_transition_t *action, unsigned int count)
+{
+	/* Reset wait_for if there are no callbacks ... */
+	if (count == 0) {
+		/* ... unless this action requires ACK via event */
+		if (action->next_state != NI_FSM_STATE_DEVICE_DOWN) {
+			ni_ifworker_set_state(w, action->next_state);
+			w->fsm.wait_for = NULL;
+		}
+	}
+}
+
 static int
 ni_ifworker_do_common_call(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
 {
@@ -4689,44 +5170,193 @@ ni_ifworker_do_common_call(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t
 
 		rv = ni_call_common_xml(w->object, bind->service, bind->method, bind->config,
 				&callback_list, ni_ifworker_error_handler);
-		ni_ifworker_update_from_request(w, service, method, rv, callback_list);
-		if (rv < 0) {
-			if (action->common.may_fail) {
-				ni_error("[ignored] %s: call to %s.%s() failed: %s", w->name,
-						service, method, ni_strerror(rv));
-				ni_ifworker_set_state(w, action->next_state);
-				ni_string_free(&service);
-				ni_string_free(&method);
-				return 0;
-			}
-			ni_ifworker_fail(w, "call to %s.%s() failed: %s", service, method, ni_strerror(rv));
-			ni_string_free(&service);
-			ni_string_free(&method);
-			return rv;
-		}
-
-		if (callback_list) {
-			ni_debug_application("%s: adding callback for %s.%s()", w->name, service, method);
-			ni_ifworker_add_callbacks(action, callback_list, w->name);
-			count++;
-		}
+		rv = ni_ifworker_common_call_result(w, action, service, method, rv,
+				callback_list, &count);
 
 		ni_string_free(&service);
 		ni_string_free(&method);
+		if (rv)
+			return rv < 0 ? rv : 0;
 	}
 
-	/* Reset wait_for if there are no callbacks ... */
-	if (count == 0) {
-		/* ... unless this action requires ACK via event */
-		if (action->next_state != NI_FSM_STATE_DEVICE_DOWN) {
-			ni_ifworker_set_state(w, action->next_state);
-			w->fsm.wait_for = NULL;
+	ni_ifworker_common_call_done(w, action, count);
+	return 0;
+}
+
+/*
+ * Async variant of ni_ifworker_do_common_call: the binding calls of a
+ * transition are sent one after the other, each from the reply handler
+ * of the previous one. The worker keeps waiting for the action until
+ * the last reply (or the event ACK) arrives.
+ */
+static void			ni_ifworker_common_call_reply(ni_dbus_object_t *, ni_dbus_message_t *);
+
+static int
+ni_ifworker_common_call_next(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_fsm_transition_t *action = w->fsm.call.action;
+	ni_fsm_call_t *call;
+	int rv;
+
+	for ( ; w->fsm.call.binding < action->num_bindings; w->fsm.call.binding++) {
+		ni_fsm_transition_bind_t *bind = &action->binding[w->fsm.call.binding];
+
+		if (!bind->method || !bind->service || bind->skip_call)
+			continue;
+
+		ni_debug_application("%s: calling %s.%s() async", w->name,
+				bind->service->name, bind->method->name);
+
+		rv = ni_call_common_xml_async(w->object, bind->service, bind->method,
+				bind->config, ni_ifworker_common_call_reply);
+		if (rv < 0) {
+			w->fsm.call.action = NULL;
+			rv = ni_ifworker_common_call_result(w, action, bind->service->name,
+					bind->method->name, rv, NULL, &w->fsm.call.callbacks);
+			return rv < 0 ? rv : 0;
 		}
+
+		call = xcalloc(1, sizeof(*call));
+		call->fsm = fsm;
+		call->worker = ni_ifworker_get(w);
+		call->proxy = w->object;
+		call->next = ni_fsm_calls;
+		ni_fsm_calls = call;
+
+		w->fsm.call.pending = TRUE;
+		fsm->calls_in_flight++;
+		return 0;
 	}
 
+	w->fsm.call.action = NULL;
+	ni_ifworker_common_call_done(w, action, w->fsm.call.callbacks);
 	return 0;
 }
 
+static int
+ni_ifworker_do_common_call_async(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+{
+	/* Initially, enable waiting for this action */
+	w->fsm.wait_for = action;
+
+	w->fsm.call.action = action;
+	w->fsm.call.binding = 0;
+	w->fsm.call.callbacks = 0;
+	return ni_ifworker_common_call_next(fsm, w);
+}
+
+static void
+ni_ifworker_common_call_reply(ni_dbus_object_t *proxy, ni_dbus_message_t *reply)
+{
+	ni_objectmodel_callback_info_t *callback_list = NULL;
+	ni_fsm_transition_bind_t *bind;
+	ni_fsm_transition_t *action;
+	ni_fsm_call_t *call, **pos;
+	ni_ifworker_t *w;
+	ni_fsm_t *fsm;
+	int rv;
+
+	for (pos = &ni_fsm_calls; (call = *pos); pos = &call->next) {
+		if (call->proxy == proxy)
+			break;
+	}
+	if (!call)
+		return;
+
+	*pos = call->next;
+	fsm = call->fsm;
+	w = call->worker;
+	free(call);
+
+	w->fsm.call.pending = FALSE;
+	action = w->fsm.call.action;
+	if (!fsm || !action || w->failed || w->fsm.wait_for != action) {
+		ni_debug_application("%s: discarding stale call reply", w->name);
+		w->fsm.call.action = NULL;
+		goto release;
+	}
+
+	ni_fsm_events_block(fsm);
+
+	bind = &action->binding[w->fsm.call.binding];
+	rv = ni_call_common_xml_reply(bind->service, bind->method, reply, &callback_list,
+			ni_ifworker_error_handler);
+	if (rv == -NI_ERROR_AUTH_INFO_MISSING) {
+		/* prompting for auth info is interactive anyway */
+		rv = ni_call_common_xml(w->object, bind->service, bind->method, bind->config,
+				&callback_list, ni_ifworker_error_handler);
+	}
+	rv = ni_ifworker_common_call_result(w, action, bind->service->name, bind->method->name,
+			rv, callback_list, &w->fsm.call.callbacks);
+	if (rv == 0) {
+		w->fsm.call.binding++;
+		ni_ifworker_common_call_next(fsm, w);
+	} else {
+		w->fsm.call.action = NULL;
+	}
+
+	ni_fsm_process_events(fsm);
+	ni_fsm_events_unblock(fsm);
+
+release:
+	if (fsm) {
+		fsm->calls_in_flight--;
+		if (!fsm->block_events)
+			ni_fsm_process_events(fsm);
+	}
+	ni_ifworker_release(w);
+}
+
+static void
+ni_fsm_calls_detach(ni_fsm_t *fsm)
+{
+	ni_fsm_call_t *call;
+
+	for (call = ni_fsm_calls; call; call = call->next) {
+		if (call->fsm == fsm)
+			call->fsm = NULL;
+	}
+}
+
+/*
+ * Do not send a call while a related worker has one in flight
+ * or when the number of calls in flight reached the limit.
+ */
+static ni_bool_t
+ni_ifworker_call_pending(const ni_ifworker_t *w)
+{
+	unsigned int i;
+
+	if (w->fsm.call.pending)
+		return TRUE;
+	if (w->masterdev && w->masterdev->fsm.call.pending)
+		return TRUE;
+	if (w->lowerdev && w->lowerdev->fsm.call.pending)
+		return TRUE;
+	for (i = 0; i < w->children.count; ++i) {
+		if (w->children.data[i]->fsm.call.pending)
+			return TRUE;
+	}
+	for (i = 0; i < w->lowerdev_for.count; ++i) {
+		if (w->lowerdev_for.data[i]->fsm.call.pending)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static ni_bool_t
+ni_fsm_schedule_call_deferred(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+{
+	if (!fsm->calls_in_flight)
+		return FALSE;
+
+	if (ni_ifworker_call_pending(w))
+		return TRUE;
+
+	return action->call_func == ni_ifworker_do_common_call &&
+		fsm->calls_in_flight >= fsm->parallel_calls;
+}
+
 static int
 ni_ifworker_do_wait_device_ready_call(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
 {
@@ -4836,6 +5466,7 @@ ni_ifworker_call_device_factory(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transiti
 		ni_debug_application("created device %s (path=%s)", w->name, object_path);
 		ni_string_free(&w->object_path);
 		w->object_path = object_path;
+		ni_fsm_ifworker_reindex(fsm, w);
 
 		/* Lookup the object corresponding to this path. If it doesn't
 		 * exist, create it on the fly (with a generic class of "netif" -
@@ -4846,7 +5477,8 @@ ni_ifworker_call_device_factory(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transiti
 					NULL,
 					NULL);
 
-		if (!w->object || !ni_dbus_object_refresh_children(w->object)) {
+		if (!w->object || !ni_dbus_object_refresh_children_filtered(w->object,
+						&ni_fsm_netdev_property_filter)) {
 			ni_ifworker_fail(w, "unable to refresh new device");
 			return -1;
 		}
@@ -5152,12 +5784,21 @@ ni_fsm_schedule(ni_fsm_t *fsm)
 				goto release;
 			}
 
+			if (ni_fsm_schedule_call_deferred(fsm, w, action)) {
+				ni_debug_application("%s: defer action (%u calls in flight)",
+						w->name, fsm->calls_in_flight);
+				goto release;
+			}
+
 			ni_ifworker_cancel_secondary_timeout(w);
 
 			prev_state = w->fsm.state;
 			ni_fsm_events_block(fsm);
 
-			rv = action->call_func(fsm, w, action);
+			if (fsm->parallel_calls > 1 && action->call_func == ni_ifworker_do_common_call)
+				rv = ni_ifworker_do_common_call_async(fsm, w, action);
+			else
+				rv = action->call_func(fsm, w, action);
 			if (w->fsm.next_action)
 				w->fsm.next_action++;
 
@@ -5516,7 +6157,7 @@ ni_fsm_process_worker_event(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_event_t *ev)
 
 	if (event_type == NI_EVENT_DEVICE_DELETE) {
 		if (ni_config_use_nanny() && ni_ifworker_is_factory_device(w))
-			ni_ifworker_device_delete(w);
+			ni_ifworker_device_delete(fsm, w);
 		else
 			ni_fsm_destroy_worker(fsm, w);
 
@@ -5566,6 +6207,7 @@ ni_fsm_process_rename_event(ni_fsm_t *fsm, ni_fsm_event_t *ev)
 	c->object = w->object;
 	c->ifindex = w->ifindex;
 	ni_string_dup(&c->object_path, w->object_path);
+	ni_fsm_ifworker_reindex(fsm, c);
 
 	/* reset moved device on renamed worker */
 	ni_netdev_put(w->device);
@@ -5573,16 +6215,18 @@ ni_fsm_process_rename_event(ni_fsm_t *fsm, ni_fsm_event_t *ev)
 	w->object = NULL;
 	w->ifindex = 0;
 	ni_string_free(&w->object_path);
+	ni_fsm_ifworker_reindex(fsm, w);
 
 	if (ni_ifworker_active(w)) {
 		/* when the worker is in use, fail */
 		ni_ifworker_reset(w);
 		ni_string_dup(&w->name, w->old_name ? w->old_name : "renamed");
+		ni_fsm_ifworker_reindex(fsm, w);
 		ni_ifworker_fail(w, "active device has been renamed to %s", c->name);
 	} else {
 		/* otherwise reset it and remove   */
 		ni_ifworker_reset(w);
-		ni_ifworker_array_remove(&fsm->workers, w);
+		ni_fsm_remove_worker(fsm, w);
 	}
 
 	ni_fsm_build_hierarchy(fsm, FALSE);
@@ -139,3 +139,41 @@ ni_hashctx_puts(ni_hashctx_t *ctx, const char *string)
 		gcry_md_write(ctx->handle, string, strlen(string));
 }
 
+
+/*
+ * Simple FNV-1a hash functions for in-memory lookup tables.
+ */
+#define NI_HASH_FNV_OFFSET	2166136261U
+#define NI_HASH_FNV_PRIME	16777619U
+
+unsigned int
+ni_hash_bytes(const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	unsigned int hash = NI_HASH_FNV_OFFSET;
+
+	while (ptr && len--) {
+		hash ^= *ptr++;
+		hash *= NI_HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+unsigned int
+ni_hash_string(const char *string)
+{
+	const unsigned char *ptr = (const unsigned char *)string;
+	unsigned int hash = NI_HASH_FNV_OFFSET;
+
+	while (ptr && *ptr) {
+		hash ^= *ptr++;
+		hash *= NI_HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+unsigned int
+ni_hash_uint(unsigned int num)
+{
+	return ni_hash_bytes(&num, sizeof(num));
+}
@@ -61,10 +61,25 @@ typedef struct ni_rtevent_handle
 	ni_uint_array_t	groups;
 } ni_rtevent_handle_t;
 
+/*
+ * Device change events triggered while draining the event socket are
+ * coalesced into one change event per device, emitted after the read
+ * buffer is drained or when the configured coalesce window expired.
+ */
+typedef struct ni_rtevent_coalesce {
+	ni_bool_t		active;
+	ni_uint_array_t		pending;
+	const ni_timer_t *	timer;
+
+	unsigned long		received;
+	unsigned long		collapsed;
+} ni_rtevent_coalesce_t;
+
 /*
  * TODO: Move the socket somewhere else & add cleanup...
  */
 static ni_socket_t *	__ni_rtevent_sock;
+static ni_rtevent_coalesce_t	__ni_rtevent_coalesce;
 
 static int	__ni_rtevent_process(ni_netconfig_t *, const struct sockaddr_nl *, struct nlmsghdr *);
 static int	__ni_rtevent_newlink(ni_netconfig_t *, const struct sockaddr_nl *, struct nlmsghdr *);
@@ -91,6 +106,68 @@ __ni_netdev_event(ni_netconfig_t *nc, ni_netdev_t *dev, ni_event_t ev)
 		ni_global.interface_event(dev, ev);
 }
 
+static void
+__ni_netdev_change_event(ni_netconfig_t *nc, ni_netdev_t *dev)
+{
+	ni_rtevent_coalesce_t *co = &__ni_rtevent_coalesce;
+
+	if (!co->active) {
+		__ni_netdev_event(nc, dev, NI_EVENT_DEVICE_CHANGE);
+		return;
+	}
+
+	co->received++;
+	if (dev->change_pending) {
+		co->collapsed++;
+		return;
+	}
+	dev->change_pending = 1;
+	ni_uint_array_append(&co->pending, dev->link.ifindex);
+}
+
+static void
+__ni_rtevent_coalesce_flush(ni_netconfig_t *nc)
+{
+	ni_rtevent_coalesce_t *co = &__ni_rtevent_coalesce;
+	ni_uint_array_t pending = co->pending;
+	ni_netdev_t *dev;
+	unsigned int i;
+
+	if (co->timer) {
+		ni_timer_cancel(co->timer);
+		co->timer = NULL;
+	}
+
+	ni_uint_array_init(&co->pending);
+	for (i = 0; nc && i < pending.count; ++i) {
+		if (!(dev = ni_netdev_by_index(nc, pending.data[i])))
+			continue;
+		if (!dev->change_pending)
+			continue;
+
+		dev->change_pending = 0;
+		__ni_netdev_event(nc, dev, NI_EVENT_DEVICE_CHANGE);
+	}
+
+	if (pending.count) {
+		ni_debug_events("emitted %u coalesced device change events "
+				"(%lu of %lu change events collapsed)",
+				pending.count, co->collapsed, co->received);
+	}
+	ni_uint_array_destroy(&pending);
+}
+
+static void
+__ni_rtevent_coalesce_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_rtevent_coalesce_t *co = &__ni_rtevent_coalesce;
+
+	if (co->timer == timer) {
+		co->timer = NULL;
+		__ni_rtevent_coalesce_flush(ni_global_state_handle(0));
+	}
+}
+
 static inline void
 __ni_netdev_addr_event(ni_netdev_t *dev, ni_event_t ev, const ni_address_t *ap)
 {
@@ -250,7 +327,7 @@ __ni_netdev_process_events(ni_netconfig_t *nc, ni_netdev_t *dev, unsigned int ol
 		ni_uint_array_append(&events, NI_EVENT_DEVICE_DELETE);
 	} else
 	if (events.count == 0) {
-		__ni_netdev_event(nc, dev, NI_EVENT_DEVICE_CHANGE);
+		__ni_netdev_change_event(nc, dev);
 	}
 
 	for (i = 0; i < events.count; ++i) {
@@ -281,6 +358,8 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 
 	old = ni_netdev_by_index(nc, ifi->ifi_index);
 	ifname = if_indextoname(ifi->ifi_index, namebuf);
+	if (!old || !ni_string_eq(old->name, ifname))
+		ni_sysfs_dir_cache_expire();
 	if (!ifname) {
 		/*
 		 * device (index) does not exists any more;
@@ -302,7 +381,7 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		if (!ni_string_eq(old->name, ifname)) {
 			ni_debug_events("%s[%u]: device renamed to %s",
 					old->name, old->link.ifindex, ifname);
-			ni_string_dup(&old->name, ifname);
+			ni_netconfig_device_rename(nc, old, ifname);
 			__ni_netdev_event(nc, old, NI_EVENT_DEVICE_RENAME);
 		}
 		dev = old;
@@ -321,6 +400,7 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		ni_error("Problem parsing RTM_NEWLINK message for %s", ifname);
 		return -1;
 	}
+	ni_netconfig_device_reindex(nc, dev);
 
 	if ((ifname = dev->name)) {
 		ni_netdev_t *conflict;
@@ -342,7 +422,7 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 			 */
 			char *current = if_indextoname(conflict->link.ifindex, namebuf);
 			if (current) {
-				ni_string_dup(&conflict->name, current);
+				ni_netconfig_device_rename(nc, conflict, current);
 				__ni_netdev_event(nc, conflict, NI_EVENT_DEVICE_RENAME);
 			} else {
 				unsigned int ifflags = conflict->link.ifflags;
@@ -378,6 +458,8 @@ __ni_rtevent_dellink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 	if (!(ifi = ni_rtnl_ifinfomsg(h, RTM_DELLINK)))
 		return -1;
 
+	ni_sysfs_dir_cache_expire();
+
 	if ((nla = nlmsg_find_attr(h, sizeof(*ifi), IFLA_IFNAME)) != NULL) {
 		ifname = (char *) nla_data(nla);
 	}
@@ -918,6 +1000,7 @@ __ni_rtevent_process_cb(struct nl_msg *msg, void *ptr)
 }
 
 static ni_bool_t	__ni_rtevent_restart(ni_socket_t *sock);
+static unsigned int	__ni_rtevent_config_coalesce_window(void);
 
 
 /*
@@ -927,12 +1010,23 @@ static void
 __ni_rtevent_receive(ni_socket_t *sock)
 {
 	ni_rtevent_handle_t *handle = sock->user_data;
+	ni_rtevent_coalesce_t *co = &__ni_rtevent_coalesce;
+	unsigned int window;
 	int ret;
 
 	if (handle && handle->nlsock) {
+		co->active = TRUE;
 		do {
 			ret = nl_recvmsgs_default(handle->nlsock);
 		} while (ret == NLE_SUCCESS || ret == -NLE_INTR);
+		co->active = FALSE;
+
+		if (!(window = __ni_rtevent_config_coalesce_window()))
+			__ni_rtevent_coalesce_flush(ni_global_state_handle(0));
+		else
+		if (co->pending.count && !co->timer)
+			co->timer = ni_timer_register(window,
+					__ni_rtevent_coalesce_timeout, NULL);
 
 		switch (ret) {
 		case NLE_SUCCESS:
@@ -1040,6 +1134,12 @@ __ni_rtevent_config_mesg_buff_len(void)
 	return ni_global.config ? ni_global.config->rtnl_event.mesg_buff_length : 0;
 }
 
+static unsigned int
+__ni_rtevent_config_coalesce_window(void)
+{
+	return ni_global.config ? ni_global.config->rtnl_event.coalesce_window : 0;
+}
+
 static ni_socket_t *
 __ni_rtevent_sock_open(void)
 {
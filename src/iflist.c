@@ -102,13 +102,13 @@ struct ni_rtnl_query {
  * Query netlink for all relevant information
  */
 static inline int
-__ni_rtnl_query(struct ni_rtnl_info *qr, int af, int type)
+__ni_rtnl_query(struct ni_rtnl_info *qr, int af, int type, unsigned int ifindex)
 {
 	int rv;
 
 	ni_nlmsg_list_init(&qr->nlmsg_list);
 retry:
-	rv = ni_nl_dump_store(af, type, &qr->nlmsg_list);
+	rv = ni_nl_dump_store_ifindex(af, type, ifindex, &qr->nlmsg_list);
 	switch (rv) {
 	case NLE_SUCCESS:
 		qr->entry = qr->nlmsg_list.head;
@@ -152,10 +152,10 @@ ni_rtnl_query(struct ni_rtnl_query *q, unsigned int ifindex, unsigned int family
 	memset(q, 0, sizeof(*q));
 	q->ifindex = ifindex;
 
-	if (__ni_rtnl_query(&q->link_info, AF_UNSPEC, RTM_GETLINK) < 0
-	 || (family != AF_INET && __ni_rtnl_query(&q->ipv6_info, AF_INET6, RTM_GETLINK) < 0)
-	 || __ni_rtnl_query(&q->addr_info, family, RTM_GETADDR) < 0
-	 || __ni_rtnl_query(&q->route_info, family, RTM_GETROUTE) < 0) {
+	if (__ni_rtnl_query(&q->link_info, AF_UNSPEC, RTM_GETLINK, ifindex) < 0
+	 || (family != AF_INET && __ni_rtnl_query(&q->ipv6_info, AF_INET6, RTM_GETLINK, ifindex) < 0)
+	 || __ni_rtnl_query(&q->addr_info, family, RTM_GETADDR, ifindex) < 0
+	 || __ni_rtnl_query(&q->route_info, family, RTM_GETROUTE, ifindex) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -169,7 +169,7 @@ ni_rtnl_query_link(struct ni_rtnl_query *q, unsigned int ifindex)
 	memset(q, 0, sizeof(*q));
 	q->ifindex = ifindex;
 
-	if (__ni_rtnl_query(&q->link_info, AF_UNSPEC, RTM_GETLINK) < 0) {
+	if (__ni_rtnl_query(&q->link_info, AF_UNSPEC, RTM_GETLINK, ifindex) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -183,7 +183,7 @@ ni_rtnl_query_ipv6_link(struct ni_rtnl_query *q, unsigned int ifindex)
 	memset(q, 0, sizeof(*q));
 	q->ifindex = ifindex;
 
-	if (__ni_rtnl_query(&q->ipv6_info, AF_INET6, RTM_GETLINK) < 0) {
+	if (__ni_rtnl_query(&q->ipv6_info, AF_INET6, RTM_GETLINK, ifindex) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -235,7 +235,7 @@ ni_rtnl_query_addr_info(struct ni_rtnl_query *q, unsigned int ifindex, unsigned
 	memset(q, 0, sizeof(*q));
 	q->ifindex = ifindex;
 
-	if (__ni_rtnl_query(&q->addr_info, family, RTM_GETADDR) < 0) {
+	if (__ni_rtnl_query(&q->addr_info, family, RTM_GETADDR, ifindex) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -262,11 +262,12 @@ ni_rtnl_query_next_addr_info(struct ni_rtnl_query *q, struct nlmsghdr **hp)
 }
 
 static int
-ni_rtnl_query_route_info(struct ni_rtnl_query *q, unsigned int family)
+ni_rtnl_query_route_info(struct ni_rtnl_query *q, unsigned int ifindex, unsigned int family)
 {
 	memset(q, 0, sizeof(*q));
+	q->ifindex = ifindex;
 
-	if (__ni_rtnl_query(&q->route_info, family, RTM_GETROUTE) < 0) {
+	if (__ni_rtnl_query(&q->route_info, family, RTM_GETROUTE, ifindex) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -296,7 +297,7 @@ ni_rtnl_query_rule_info(struct ni_rtnl_query *q, unsigned int family)
 {
 	memset(q, 0, sizeof(*q));
 
-	if (__ni_rtnl_query(&q->rule_info, family, RTM_GETRULE) < 0) {
+	if (__ni_rtnl_query(&q->rule_info, family, RTM_GETRULE, 0) < 0) {
 		ni_rtnl_query_destroy(q);
 		return -1;
 	}
@@ -345,49 +346,25 @@ ni_address_list_drop_by_seq(ni_address_t **tail, unsigned int seq)
 	}
 }
 
+/*
+ * Routes do not need a reset pass: every refresh uses a new, non-zero
+ * sequence number and a route dump refreshes known routes in place.
+ */
 static void
-ni_route_array_reset_seq(ni_route_array_t *routes)
+ni_route_tables_drop_by_seq(ni_netconfig_t *nc, ni_route_table_t *tab, unsigned int seq)
 {
+	ni_route_array_t dropped = NI_ROUTE_ARRAY_INIT;
 	unsigned int i;
 	ni_route_t *rp;
 
-	for (i = 0; i < routes->count; ++i) {
-		if ((rp = routes->data[i]))
-			rp->seq = 0;
-	}
-}
-
-static void
-ni_route_tables_reset_seq(ni_route_table_t *tab)
-{
 	for ( ; tab; tab = tab->next)
-		ni_route_array_reset_seq(&tab->routes);
-}
+		ni_route_table_remove_by_seq(tab, seq, &dropped);
 
-static void
-ni_route_array_drop_by_seq(ni_netconfig_t *nc, ni_route_array_t *routes, unsigned int seq)
-{
-	unsigned int i;
-	ni_route_t *rp;
-
-	for (i = 0; i < routes->count; ) {
-		rp = routes->data[i];
-		if (rp->seq != seq) {
-			if (ni_route_array_remove(routes, i) == rp) {
-				ni_netconfig_route_del(nc, rp, NULL);
-				ni_route_free(rp);
-				continue;
-			}
-		}
-		i++;
+	for (i = 0; i < dropped.count; ++i) {
+		rp = dropped.data[i];
+		ni_netconfig_route_del(nc, rp, NULL);
 	}
-}
-
-static void
-ni_route_tables_drop_by_seq(ni_netconfig_t *nc, ni_route_table_t *tab, unsigned int seq)
-{
-	for ( ; tab; tab = tab->next)
-		ni_route_array_drop_by_seq(nc, &tab->routes, seq);
+	ni_route_array_destroy(&dropped);
 }
 
 static void
@@ -531,6 +508,7 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 	do {
 		seqno = ++__ni_global_seqno;
 	} while (!seqno);
+	ni_sysfs_dir_cache_expire();
 
 	if (!refresh) {
 		refresh = 1;
@@ -577,19 +555,20 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 			/* FIXME: use ni_netconfig_device_append() */
 			*tail = dev;
 			tail = &dev->next;
+			ni_netconfig_device_reindex(nc, dev);
 		} else {
-			if (!ni_string_eq(dev->name, ifname))
-				ni_string_dup(&dev->name, ifname);
+			ni_netconfig_device_rename(nc, dev, ifname);
 
-			/* Clear out addresses and routes */
+			/* Clear out addresses */
 			ni_address_list_reset_seq(dev->addrs);
-			ni_route_tables_reset_seq(dev->routes);
 		}
 
 		dev->seq = seqno;
 
 		if (__ni_netdev_process_newlink(dev, h, ifi, nc) < 0)
 			ni_error("Problem parsing RTM_NEWLINK message for %s", ifname);
+
+		ni_netconfig_device_reindex(nc, dev);
 	}
 
 	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
@@ -640,6 +619,7 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 		ni_route_tables_drop_by_seq(nc, dev->routes, seqno);
 		if (dev->seq != seqno) {
 			*tail = dev->next;
+			ni_netconfig_device_unindex(nc, dev);
 			if (del_list == NULL) {
 				__ni_refresh_unbind_master(nc, dev);
 				ni_client_state_drop(dev->link.ifindex);
@@ -660,6 +640,8 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 	if (!ni_netconfig_discover_filtered(nc, NI_NETCONFIG_DISCOVER_ROUTE_RULES))
 		(void)__ni_system_refresh_rules(nc);
 
+	ni_address_pool_trace();
+	ni_route_pool_trace();
 	res = 0;
 
 failed:
@@ -684,6 +666,7 @@ __ni_system_refresh_interface(ni_netconfig_t *nc, ni_netdev_t *dev)
 	do {
 		__ni_global_seqno++;
 	} while (!__ni_global_seqno);
+	ni_sysfs_dir_cache_expire();
 
 	if (ni_rtnl_query(&query, dev->link.ifindex, ni_netconfig_get_family_filter(nc)) < 0)
 		goto failed;
@@ -703,16 +686,16 @@ __ni_system_refresh_interface(ni_netconfig_t *nc, ni_netdev_t *dev)
 		}
 
 		ifname = nla_get_string(nla);
-		if (!ni_string_eq(dev->name, ifname))
-			ni_string_dup(&dev->name, ifname);
+		ni_netconfig_device_rename(nc, dev, ifname);
 
-		/* Clear out addresses and routes */
+		/* Clear out addresses */
 		dev->seq = __ni_global_seqno;
 		ni_address_list_reset_seq(dev->addrs);
-		ni_route_tables_reset_seq(dev->routes);
 
 		if (__ni_netdev_process_newlink(dev, h, ifi, nc) < 0)
 			ni_error("Problem parsing RTM_NEWLINK message for %s", dev->name);
+
+		ni_netconfig_device_reindex(nc, dev);
 	}
 
 	while (1) {
@@ -890,12 +873,9 @@ __ni_system_refresh_routes(ni_netconfig_t *nc)
 		seqno = ++__ni_global_seqno;
 	} while (!seqno);
 
-	if (ni_rtnl_query_route_info(&query, ni_netconfig_get_family_filter(nc)) < 0)
+	if (ni_rtnl_query_route_info(&query, 0, ni_netconfig_get_family_filter(nc)) < 0)
 		goto failed;
 
-	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next)
-		ni_route_tables_reset_seq(dev->routes);
-
 	while (1) {
 		struct rtmsg *rtm;
 
@@ -931,10 +911,9 @@ __ni_system_refresh_interface_routes(ni_netconfig_t *nc, ni_netdev_t *dev)
 		dev->seq = ++__ni_global_seqno;
 	} while (!dev->seq);
 
-	if (ni_rtnl_query_route_info(&query, ni_netconfig_get_family_filter(nc)) < 0)
+	if (ni_rtnl_query_route_info(&query, dev->link.ifindex, ni_netconfig_get_family_filter(nc)) < 0)
 		goto failed;
 
-	ni_route_tables_reset_seq(dev->routes);
 	while (1) {
 		struct rtmsg *rtm;
 
@@ -1845,7 +1824,7 @@ __ni_netdev_process_newlink(ni_netdev_t *dev, struct nlmsghdr *h,
 					dev->name, dev->link.ifindex);
 			return -1;
 		}
-		ni_string_dup(&dev->name, nla_get_string(tb[IFLA_IFNAME]));
+		ni_netconfig_device_rename(nc, dev, nla_get_string(tb[IFLA_IFNAME]));
 	}
 
 	rv = __ni_process_ifinfomsg_linkinfo(&dev->link, dev->name, tb, h, ifi, nc);
@@ -3189,6 +3168,34 @@ ni_rtnl_route_parse_msg(struct nlmsghdr *h, struct rtmsg *rtm, ni_route_t *rp)
 	return 0;
 }
 
+/*
+ * Refresh a known route in place when the dumped one does not differ
+ * in anything but the refresh sequence and cache info, instead of
+ * replacing it on every route table dump.
+ */
+static ni_bool_t
+__ni_netdev_refresh_route(ni_route_t *r, const ni_route_t *rp)
+{
+	const ni_route_nexthop_t *nh1, *nh2;
+
+	if (r->type != rp->type || r->flags != rp->flags ||
+	    r->priority != rp->priority || r->tos != rp->tos)
+		return FALSE;
+
+	if (!ni_route_equal_gateways(r, rp))
+		return FALSE;
+
+	for (nh1 = &r->nh, nh2 = &rp->nh; nh1 && nh2; nh1 = nh1->next, nh2 = nh2->next) {
+		if (nh1->weight != nh2->weight || nh1->flags != nh2->flags ||
+		    nh1->realm  != nh2->realm)
+			return FALSE;
+	}
+
+	r->seq = rp->seq;
+	r->ipv6_cache_info = rp->ipv6_cache_info;
+	return TRUE;
+}
+
 int
 __ni_netdev_process_newroute(ni_netdev_t *dev, struct nlmsghdr *h,
 				struct rtmsg *rtm, ni_netconfig_t *nc)
@@ -3228,6 +3235,9 @@ __ni_netdev_process_newroute(ni_netdev_t *dev, struct nlmsghdr *h,
 	/* apply lease owner info from equal old route if any */
 	if (dev && (r = ni_route_tables_find_match(dev->routes, rp, ni_route_equal))) {
 		if (rp->seq != r->seq) {
+			if (__ni_netdev_refresh_route(r, rp))
+				goto failure;
+
 			rp->owner = r->owner;
 			ni_netconfig_route_del(nc, r, dev);
 		}
@@ -3243,6 +3253,9 @@ __ni_netdev_process_newroute(ni_netdev_t *dev, struct nlmsghdr *h,
 				continue;
 
 			if (rp->seq != r->seq) {
+				if (__ni_netdev_refresh_route(r, rp))
+					goto failure;
+
 				rp->owner = r->owner;
 				ni_netconfig_route_del(nc, r, d);
 				break;
@@ -45,6 +45,12 @@
 #ifndef SIOCETHTOOL
 # define SIOCETHTOOL	0x8946
 #endif
+#ifndef SOL_NETLINK
+# define SOL_NETLINK	270
+#endif
+#ifndef NETLINK_GET_STRICT_CHK
+# define NETLINK_GET_STRICT_CHK	12
+#endif
 
 ni_netlink_t *		__ni_global_netlink;
 int			__ni_global_iocfd = -1;
@@ -531,31 +537,18 @@ __ni_nl_dump_valid(struct nl_msg *msg, void *p)
 }
 
 /*
- * Issue a DUMP request and store all replies in list
+ * Receive the replies to a DUMP request and store them in list
  */
-int
-ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list)
+static int
+__ni_nl_dump_recv(struct nl_sock *nl_sock, const char *name, struct ni_nlmsg_list *list)
 {
-	struct nl_sock *nl_sock;
 	struct __ni_nl_dump_state data = {
 		.msg_type = -1,
 		.list = list,
 	};
 	struct nl_cb *cb;
-	const char *name;
 	int rv;
 
-	name = ni_rtnl_msg_type_to_name(type, __func__);
-	if (!__ni_global_netlink || !(nl_sock = __ni_global_netlink->nl_sock)) {
-		ni_error("%s: no netlink socket", name);
-		return -NLE_BAD_SOCK;
-	}
-
-	if ((rv = nl_rtgen_request(nl_sock, type, af, NLM_F_DUMP)) < 0) {
-		ni_error("%s: failed to send request", name);
-		return rv;
-	}
-
 	if (!(cb = __ni_nl_cb_clone(__ni_global_netlink)))
 		return -NLE_NOMEM;
 
@@ -585,6 +578,179 @@ retry:
 	return rv;
 }
 
+/*
+ * Issue a DUMP request and store all replies in list
+ */
+int
+ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list)
+{
+	struct nl_sock *nl_sock;
+	const char *name;
+	int rv;
+
+	name = ni_rtnl_msg_type_to_name(type, __func__);
+	if (!__ni_global_netlink || !(nl_sock = __ni_global_netlink->nl_sock)) {
+		ni_error("%s: no netlink socket", name);
+		return -NLE_BAD_SOCK;
+	}
+
+	if ((rv = nl_rtgen_request(nl_sock, type, af, NLM_F_DUMP)) < 0) {
+		ni_error("%s: failed to send request", name);
+		return rv;
+	}
+
+	return __ni_nl_dump_recv(nl_sock, name, list);
+}
+
+/*
+ * Kernel side filtering of address and route dumps by interface index
+ * requires NETLINK_GET_STRICT_CHK (linux 4.20+). It is enabled on the
+ * socket only while the filtered request is sent, as the unfiltered
+ * requests are using the short rtgenmsg header strict checking rejects.
+ */
+static int	__ni_nl_strict_chk = -1;
+
+static ni_bool_t
+__ni_nl_set_strict_chk(struct nl_sock *nl_sock, int enable)
+{
+	if (setsockopt(nl_socket_get_fd(nl_sock), SOL_NETLINK, NETLINK_GET_STRICT_CHK,
+				&enable, sizeof(enable)) < 0) {
+		if (enable && (errno == ENOPROTOOPT || errno == EINVAL)) {
+			ni_debug_socket("netlink strict dump checking unsupported, "
+					"filtering dumps in userspace");
+			__ni_nl_strict_chk = 0;
+		}
+		return FALSE;
+	}
+	if (enable)
+		__ni_nl_strict_chk = 1;
+	return TRUE;
+}
+
+static int
+__ni_nl_get_link_store(unsigned int ifindex, struct ni_nlmsg_list *list)
+{
+	struct ifinfomsg ifi;
+	struct nl_msg *msg;
+	int rv;
+
+	memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_index = ifindex;
+
+	if (!(msg = nlmsg_alloc_simple(RTM_GETLINK, NLM_F_REQUEST)))
+		return -NLE_NOMEM;
+
+	if ((rv = nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO)) < 0) {
+		nlmsg_free(msg);
+		return rv;
+	}
+
+	rv = ni_nl_talk(msg, list);
+	nlmsg_free(msg);
+
+	/* device is gone -- an empty result, as in a full dump */
+	if (rv == -NLE_OBJ_NOTFOUND || rv == -NLE_NODEV)
+		rv = NLE_SUCCESS;
+	return rv;
+}
+
+static struct nl_msg *
+__ni_nl_dump_ifindex_msg(int af, int type, unsigned int ifindex)
+{
+	struct nl_msg *msg;
+	struct ifaddrmsg ifa;
+	struct rtmsg rtm;
+
+	if (!(msg = nlmsg_alloc_simple(type, NLM_F_DUMP)))
+		return NULL;
+
+	switch (type) {
+	case RTM_GETADDR:
+		memset(&ifa, 0, sizeof(ifa));
+		ifa.ifa_family = af;
+		ifa.ifa_index = ifindex;
+		if (nlmsg_append(msg, &ifa, sizeof(ifa), NLMSG_ALIGNTO) < 0)
+			goto failure;
+		break;
+
+	case RTM_GETROUTE:
+		memset(&rtm, 0, sizeof(rtm));
+		rtm.rtm_family = af;
+		if (nlmsg_append(msg, &rtm, sizeof(rtm), NLMSG_ALIGNTO) < 0)
+			goto failure;
+		if (nla_put_u32(msg, RTA_OIF, ifindex) < 0)
+			goto failure;
+		break;
+
+	default:
+		goto failure;
+	}
+	return msg;
+
+failure:
+	nlmsg_free(msg);
+	return NULL;
+}
+
+/*
+ * Query the links, addresses or routes of a single interface and store
+ * all replies in list. Link info is requested directly, address and
+ * route dumps are filtered by the kernel when it supports it. Callers
+ * still have to filter the replies, as the request falls back to a
+ * full dump in all other cases.
+ */
+int
+ni_nl_dump_store_ifindex(int af, int type, unsigned int ifindex, struct ni_nlmsg_list *list)
+{
+	struct nl_sock *nl_sock;
+	struct nl_msg *msg;
+	const char *name;
+	int rv;
+
+	if (!ifindex)
+		return ni_nl_dump_store(af, type, list);
+
+	if (type == RTM_GETLINK && af == AF_UNSPEC)
+		return __ni_nl_get_link_store(ifindex, list);
+
+	if (!__ni_nl_strict_chk || (type != RTM_GETADDR && type != RTM_GETROUTE))
+		return ni_nl_dump_store(af, type, list);
+
+	name = ni_rtnl_msg_type_to_name(type, __func__);
+	if (!__ni_global_netlink || !(nl_sock = __ni_global_netlink->nl_sock)) {
+		ni_error("%s: no netlink socket", name);
+		return -NLE_BAD_SOCK;
+	}
+
+	if (!(msg = __ni_nl_dump_ifindex_msg(af, type, ifindex)))
+		return -NLE_NOMEM;
+
+	if (!__ni_nl_set_strict_chk(nl_sock, 1)) {
+		nlmsg_free(msg);
+		return ni_nl_dump_store(af, type, list);
+	}
+	rv = nl_send_auto(nl_sock, msg);
+	__ni_nl_set_strict_chk(nl_sock, 0);
+	nlmsg_free(msg);
+
+	if (rv < 0) {
+		ni_error("%s: failed to send request", name);
+		return rv;
+	}
+
+	rv = __ni_nl_dump_recv(nl_sock, name, list);
+	if (rv < 0 && rv != -NLE_DUMP_INTR) {
+		/* kernel does not like the filter -- don't ask again */
+		ni_debug_socket("%s: filtered dump failed, filtering in userspace",
+				name);
+		__ni_nl_strict_chk = 0;
+		ni_nlmsg_list_destroy(list);
+		return ni_nl_dump_store(af, type, list);
+	}
+	return rv;
+}
+
 /*
  * Send a message and capture the response message(s)
  */
@@ -609,6 +775,140 @@ ni_nl_talk(struct nl_msg *msg, struct ni_nlmsg_list *list)
 	}
 }
 
+/*
+ * Send a batch of requests in a single sendmsg call and collect the replies.
+ * The kernel processes all messages of the datagram in order; every request
+ * is acked, so we know when we're done. @handler is called for each reply
+ * message with the index of the request it belongs to; the (positive) errno
+ * of each request ends up in @errors.
+ */
+int
+__ni_nl_talk_batch(ni_netlink_t *nl, struct nl_msg **msgs, unsigned int count,
+			int (*handler)(unsigned int, struct nlmsghdr *, void *),
+			void *user_data, int *errors)
+{
+	struct nl_sock *nl_sock;
+	unsigned char *buf, *pos;
+	unsigned int i, pending, seq;
+	size_t len = 0;
+	int rv;
+
+	if (!nl || !(nl_sock = nl->nl_sock)) {
+		ni_error("%s: no netlink socket", __func__);
+		return -NLE_BAD_SOCK;
+	}
+	if (count == 0)
+		return 0;
+
+	for (i = 0; i < count; ++i)
+		len += NLMSG_ALIGN(nlmsg_hdr(msgs[i])->nlmsg_len);
+
+	pos = buf = xcalloc(1, len);
+	seq = nl_socket_use_seq(nl_sock);
+	for (i = 0; i < count; ++i) {
+		struct nlmsghdr *h = nlmsg_hdr(msgs[i]);
+
+		h->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+		h->nlmsg_seq = seq + i;
+		h->nlmsg_pid = nl_socket_get_local_port(nl_sock);
+		memcpy(pos, h, h->nlmsg_len);
+		pos += NLMSG_ALIGN(h->nlmsg_len);
+		errors[i] = -1;
+	}
+	/* reserve the sequence numbers we've used */
+	for (i = 1; i < count; ++i)
+		nl_socket_use_seq(nl_sock);
+
+	rv = nl_sendto(nl_sock, buf, len);
+	free(buf);
+	if (rv < 0) {
+		ni_error("%s: unable to send: %s", __func__, nl_geterror(rv));
+		return rv;
+	}
+
+	for (pending = count; pending; ) {
+		struct sockaddr_nl peer;
+		unsigned char *data = NULL;
+		struct nlmsghdr *h;
+		int n;
+
+		if ((n = nl_recv(nl_sock, &peer, &data, NULL)) <= 0) {
+			if (n == -NLE_AGAIN || n == -NLE_INTR)
+				continue;
+			ni_debug_socket("%s: recv failed: %s", __func__, nl_geterror(n));
+			free(data);
+			return n ? n : -NLE_MSG_TRUNC;
+		}
+
+		if (peer.nl_pid) {
+			ni_warn("received netlink message from %d - spoof", peer.nl_pid);
+			free(data);
+			continue;
+		}
+
+		for (h = (struct nlmsghdr *) data; nlmsg_ok(h, n); h = nlmsg_next(h, &n)) {
+			unsigned int index = h->nlmsg_seq - seq;
+
+			if (index >= count || errors[index] >= 0)
+				continue;
+
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = nlmsg_data(h);
+
+				errors[index] = e->error < 0 ? -e->error : e->error;
+				pending--;
+			} else
+			if (h->nlmsg_type != NLMSG_DONE && handler) {
+				handler(index, h, user_data);
+			}
+		}
+		free(data);
+	}
+
+	return 0;
+}
+
+/*
+ * Resolve a generic netlink family id
+ */
+static int
+__ni_genl_family_handler(unsigned int index, struct nlmsghdr *h, void *user_data)
+{
+	struct nlattr *tb[CTRL_ATTR_MAX + 1];
+	int *family = user_data;
+
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, CTRL_ATTR_MAX, NULL) < 0)
+		return NL_SKIP;
+	if (tb[CTRL_ATTR_FAMILY_ID])
+		*family = nla_get_u16(tb[CTRL_ATTR_FAMILY_ID]);
+	return NL_OK;
+}
+
+int
+__ni_genl_resolve_family(ni_netlink_t *nl, const char *name)
+{
+	struct genlmsghdr hdr = { .cmd = CTRL_CMD_GETFAMILY, .version = 1 };
+	struct nl_msg *msg;
+	int family = -1, err = 0;
+
+	if (!(msg = nlmsg_alloc_simple(GENL_ID_CTRL, 0)))
+		return -ENOMEM;
+
+	if (nlmsg_append(msg, &hdr, sizeof(hdr), NLMSG_ALIGNTO) < 0
+	 || nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, name) < 0) {
+		nlmsg_free(msg);
+		return -ENOMEM;
+	}
+
+	if (__ni_nl_talk_batch(nl, &msg, 1, __ni_genl_family_handler, &family, &err) < 0)
+		err = EIO;
+	nlmsg_free(msg);
+
+	if (err)
+		return -err;
+	return family >= 0 ? family : -ENOENT;
+}
+
 #define ni_t2n(x)	[x] = #x
 static const char *	ni_rtnl_msg_type_names[RTM_MAX] = {
 #ifdef	RTM_NEWLINK
@@ -85,7 +85,13 @@ struct ni_nlmsg_list {
 };
 
 extern int	ni_nl_talk(struct nl_msg *, struct ni_nlmsg_list *);
+extern int	__ni_nl_talk_batch(struct __ni_netlink *, struct nl_msg **, unsigned int,
+				int (*)(unsigned int, struct nlmsghdr *, void *),
+				void *, int *);
+extern int	__ni_genl_resolve_family(struct __ni_netlink *, const char *);
 extern int	ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list);
+extern int	ni_nl_dump_store_ifindex(int af, int type, unsigned int ifindex,
+					struct ni_nlmsg_list *list);
 
 extern void	ni_nlmsg_list_init(struct ni_nlmsg_list *);
 extern void	ni_nlmsg_list_destroy(struct ni_nlmsg_list *);
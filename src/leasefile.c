@@ -45,6 +45,7 @@
 
 #include "appconfig.h"
 #include "leasefile.h"
+#include "leasejournal.h"
 #include "dhcp.h"
 #include "dhcp4/lease.h"
 #include "dhcp6/lease.h"
@@ -1275,6 +1276,20 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 		goto failed;
 	}
 
+	if (ni_config_lease_store() == NI_CONFIG_LEASE_STORE_JOURNAL) {
+		if (ni_lease_journal_write(ni_config_storedir(), ifname,
+					lease->type, lease->family, xml) == 0) {
+			__ni_addrconf_lease_file_remove(ni_config_statedir(),
+					ifname, lease->type, lease->family);
+			__ni_addrconf_lease_file_remove(ni_config_storedir(),
+					ifname, lease->type, lease->family);
+			xml_node_free(xml);
+			ni_string_free(&filename);
+			return 0;
+		}
+		ni_debug_dhcp("Falling back to write lease to file '%s'", filename);
+	}
+
 	snprintf(tempname, sizeof(tempname), "%s.XXXXXX", filename);
 	if ((fd = mkstemp(tempname)) < 0) {
 		if (errno == EROFS && __ni_addrconf_lease_file_path(&filename,
@@ -1333,11 +1348,51 @@ failed:
 /*
  * Read a lease from a file
  */
+static ni_addrconf_lease_t *
+__ni_addrconf_lease_xml_read(xml_node_t *xml, const char *origin, const char *ifname)
+{
+	ni_addrconf_lease_t *lease = NULL;
+	xml_node_t *lnode;
+
+	/* find the lease node already here, so we can report it */
+	if (!ni_string_eq(xml->name, NI_ADDRCONF_LEASE_XML_NODE))
+		lnode = xml_node_get_child(xml, NI_ADDRCONF_LEASE_XML_NODE);
+	else
+		lnode = xml;
+	if (!lnode) {
+		ni_error("File '%s' does not contain a valid lease", origin);
+		return NULL;
+	}
+
+	if (ni_addrconf_lease_from_xml(&lease, xml, ifname) < 0) {
+		ni_error("Unable to parse xml lease file '%s'", origin);
+		return NULL;
+	}
+	return lease;
+}
+
+static ni_addrconf_lease_t *
+__ni_addrconf_lease_journal_read(const char *ifname, int type, int family)
+{
+	ni_addrconf_lease_t *lease;
+	xml_node_t *xml;
+
+	if (!(xml = ni_lease_journal_read(ni_config_storedir(), ifname, type, family)))
+		return NULL;
+
+	ni_debug_dhcp("Reading %s:%s lease of %s from journal",
+			ni_addrfamily_type_to_name(family),
+			ni_addrconf_type_to_name(type), ifname);
+	lease = __ni_addrconf_lease_xml_read(xml, "lease journal", ifname);
+	xml_node_free(xml);
+	return lease;
+}
+
 ni_addrconf_lease_t *
 ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 {
 	ni_addrconf_lease_t *lease = NULL;
-	xml_node_t *xml = NULL, *lnode;
+	xml_node_t *xml = NULL;
 	char *filename = NULL;
 	FILE *fp;
 
@@ -1348,6 +1403,10 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 		return NULL;
 	}
 
+	/*
+	 * With a journal, a lease file is either a leftover from the
+	 * xml store or was written on a journal failure; it's newer.
+	 */
 	if ((fp = fopen(filename, "re")) == NULL) {
 		if (errno == ENOENT) {
 			if (__ni_addrconf_lease_file_path(&filename,
@@ -1361,6 +1420,8 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 						filename);
 			}
 			ni_string_free(&filename);
+			if (ni_config_lease_store() == NI_CONFIG_LEASE_STORE_JOURNAL)
+				return __ni_addrconf_lease_journal_read(ifname, type, family);
 			return NULL;
 		}
 	}
@@ -1375,25 +1436,7 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 		return NULL;
 	}
 
-	/* find the lease node already here, so we can report it */
-	if (!ni_string_eq(xml->name, NI_ADDRCONF_LEASE_XML_NODE))
-		lnode = xml_node_get_child(xml, NI_ADDRCONF_LEASE_XML_NODE);
-	else
-		lnode = xml;
-	if (!lnode) {
-		ni_error("File '%s' does not contain a valid lease", filename);
-		ni_string_free(&filename);
-		xml_node_free(xml);
-		return NULL;
-	}
-
-	if (ni_addrconf_lease_from_xml(&lease, xml, ifname) < 0) {
-		ni_error("Unable to parse xml lease file '%s'", filename);
-		ni_string_free(&filename);
-		xml_node_free(xml);
-		return NULL;
-	}
-
+	lease = __ni_addrconf_lease_xml_read(xml, filename, ifname);
 	ni_string_free(&filename);
 	xml_node_free(xml);
 	return lease;
@@ -1421,6 +1464,8 @@ ni_addrconf_lease_file_remove(const char *ifname, int type, int family)
 {
 	__ni_addrconf_lease_file_remove(ni_config_statedir(), ifname, type, family);
 	__ni_addrconf_lease_file_remove(ni_config_storedir(), ifname, type, family);
+	if (ni_config_lease_store() == NI_CONFIG_LEASE_STORE_JOURNAL)
+		ni_lease_journal_remove(ni_config_storedir(), ifname, type, family);
 }
 
 static const char *
@@ -1453,6 +1498,8 @@ ni_addrconf_lease_file_exists(const char *ifname, int type, int family)
 		}
 	}
 	ni_string_free(&filename);
+	if (ni_config_lease_store() == NI_CONFIG_LEASE_STORE_JOURNAL)
+		return ni_lease_journal_exists(ni_config_storedir(), ifname, type, family);
 	return FALSE;
 }
 
@@ -0,0 +1,714 @@
+/*
+ * Append-only journal for addrconf leases.
+ *
+ * Instead of rewriting one XML file per interface, type and family on
+ * every lease update, the leases are appended as records to a single
+ * journal file in the store directory. A record carries the lease key
+ * and the lease XML tree in a compact binary encoding, protected by a
+ * CRC; a DELETE record drops a lease. The last record of a key wins.
+ *
+ * A crash in the middle of an append leaves a truncated or damaged
+ * record at the end of the journal, which is cut off on the next open.
+ * When most of the journal consists of superseded records, the live
+ * ones are copied into a new file which replaces the journal.
+ *
+ * The wickedd, dhcp4 and dhcp6 daemons share the journal; a lock file
+ * serializes access and each process catches up with the records the
+ * others appended, or re-opens the journal after a compaction.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <wicked/logging.h>
+#include <wicked/xml.h>
+#include "leasejournal.h"
+#include "buffer.h"
+#include "util_priv.h"
+
+#define NI_LEASE_JOURNAL_NAME		"leases.journal"
+#define NI_LEASE_JOURNAL_LOCK		"leases.journal.lock"
+#define NI_LEASE_JOURNAL_MAGIC		"WLEASEJ"
+#define NI_LEASE_JOURNAL_VERSION	1
+#define NI_LEASE_JOURNAL_RECORD_MAGIC	0x4c524543	/* LREC */
+#define NI_LEASE_JOURNAL_RECORD_MAX	(1024 * 1024)
+#define NI_LEASE_JOURNAL_COMPACT_MIN	(64 * 1024)
+#define NI_LEASE_JOURNAL_NOSTR		0xffffU
+
+enum {
+	NI_LEASE_JOURNAL_PUT		= 1,
+	NI_LEASE_JOURNAL_DELETE		= 2,
+};
+
+typedef struct ni_lease_journal_header {
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		byteorder;
+} ni_lease_journal_header_t;
+
+typedef struct ni_lease_journal_record {
+	uint32_t		magic;
+	uint32_t		length;		/* of the payload */
+	uint32_t		crc;		/* of record and payload */
+	uint16_t		op;
+	uint16_t		family;
+	uint32_t		type;
+} ni_lease_journal_record_t;
+
+typedef struct ni_lease_journal_entry	ni_lease_journal_entry_t;
+struct ni_lease_journal_entry {
+	ni_lease_journal_entry_t *next;
+	char *			ifname;
+	unsigned int		type;
+	unsigned int		family;
+	off_t			offset;		/* of the put record */
+	size_t			size;		/* incl. record header */
+};
+
+static struct {
+	char *			path;
+	int			fd;
+	int			lock;
+	dev_t			dev;
+	ino_t			ino;
+	off_t			end;		/* of the valid records */
+	size_t			live;		/* bytes in live records */
+	ni_lease_journal_entry_t *entries;
+} ni_lease_journal = { .fd = -1, .lock = -1 };
+
+static inline uint32_t
+ni_lease_journal_byteorder(void)
+{
+	return 0x01020304;
+}
+
+static uint32_t
+ni_lease_journal_crc(uint32_t crc, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	unsigned int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; ++i)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static uint32_t
+ni_lease_journal_record_crc(const ni_lease_journal_record_t *rec, const void *payload)
+{
+	ni_lease_journal_record_t tmp = *rec;
+
+	tmp.crc = 0;
+	return ni_lease_journal_crc(ni_lease_journal_crc(0, &tmp, sizeof(tmp)),
+					payload, rec->length);
+}
+
+/*
+ * Binary encoding of the lease xml tree
+ */
+static void
+ni_lease_journal_put(ni_buffer_t *bp, const void *data, size_t len)
+{
+	ni_buffer_ensure_tailroom(bp, len);
+	ni_buffer_put(bp, data, len);
+}
+
+static void
+ni_lease_journal_put_string(ni_buffer_t *bp, const char *string)
+{
+	uint16_t len = NI_LEASE_JOURNAL_NOSTR;
+
+	if (string && strlen(string) < NI_LEASE_JOURNAL_NOSTR)
+		len = strlen(string);
+
+	ni_lease_journal_put(bp, &len, sizeof(len));
+	if (len != NI_LEASE_JOURNAL_NOSTR)
+		ni_lease_journal_put(bp, string, len);
+}
+
+static void
+ni_lease_journal_put_node(ni_buffer_t *bp, const xml_node_t *node)
+{
+	const xml_node_t *child;
+	const ni_var_t *var;
+	uint32_t count;
+	unsigned int i;
+
+	ni_lease_journal_put_string(bp, node->name);
+	ni_lease_journal_put_string(bp, node->cdata);
+
+	count = node->attrs.count;
+	ni_lease_journal_put(bp, &count, sizeof(count));
+	for (i = 0, var = node->attrs.data; i < node->attrs.count; ++i, ++var) {
+		ni_lease_journal_put_string(bp, var->name);
+		ni_lease_journal_put_string(bp, var->value);
+	}
+
+	for (count = 0, child = node->children; child; child = child->next)
+		count++;
+	ni_lease_journal_put(bp, &count, sizeof(count));
+	for (child = node->children; child; child = child->next)
+		ni_lease_journal_put_node(bp, child);
+}
+
+static ni_bool_t
+ni_lease_journal_get_string(ni_buffer_t *bp, char **string)
+{
+	uint16_t len;
+	char *data;
+
+	if (ni_buffer_get(bp, &len, sizeof(len)) < 0)
+		return FALSE;
+
+	if (len == NI_LEASE_JOURNAL_NOSTR) {
+		*string = NULL;
+		return TRUE;
+	}
+
+	if (len == 0) {
+		*string = xstrdup("");
+		return TRUE;
+	}
+
+	if (!(data = ni_buffer_pull_head(bp, len)))
+		return FALSE;
+
+	*string = NULL;
+	return ni_string_set(string, data, len);
+}
+
+static xml_node_t *
+ni_lease_journal_get_node(ni_buffer_t *bp, xml_node_t *parent, unsigned int depth)
+{
+	char *name = NULL, *value = NULL;
+	xml_node_t *node;
+	uint32_t count;
+
+	if (depth > 64 || !ni_lease_journal_get_string(bp, &name))
+		return NULL;
+
+	node = xml_node_new(name, parent);
+	ni_string_free(&name);
+
+	if (!ni_lease_journal_get_string(bp, &node->cdata))
+		goto failed;
+
+	if (ni_buffer_get(bp, &count, sizeof(count)) < 0)
+		goto failed;
+	while (count--) {
+		if (!ni_lease_journal_get_string(bp, &name)
+		 || !ni_lease_journal_get_string(bp, &value) || !name)
+			goto failed;
+		xml_node_add_attr(node, name, value);
+		ni_string_free(&name);
+		ni_string_free(&value);
+	}
+
+	if (ni_buffer_get(bp, &count, sizeof(count)) < 0)
+		goto failed;
+	while (count--) {
+		if (!ni_lease_journal_get_node(bp, node, depth + 1))
+			goto failed;
+	}
+	return node;
+
+failed:
+	ni_string_free(&name);
+	ni_string_free(&value);
+	if (!parent)
+		xml_node_free(node);
+	return NULL;
+}
+
+/*
+ * In-memory index of the live records
+ */
+static ni_lease_journal_entry_t **
+ni_lease_journal_entry_find(const char *ifname, unsigned int type, unsigned int family)
+{
+	ni_lease_journal_entry_t **pos, *entry;
+
+	for (pos = &ni_lease_journal.entries; (entry = *pos); pos = &entry->next) {
+		if (entry->type == type && entry->family == family
+		 && ni_string_eq(entry->ifname, ifname))
+			return pos;
+	}
+	return NULL;
+}
+
+static void
+ni_lease_journal_entry_drop(ni_lease_journal_entry_t **pos)
+{
+	ni_lease_journal_entry_t *entry = *pos;
+
+	*pos = entry->next;
+	ni_lease_journal.live -= entry->size;
+	ni_string_free(&entry->ifname);
+	free(entry);
+}
+
+static void
+ni_lease_journal_index(const ni_lease_journal_record_t *rec, const char *ifname,
+			off_t offset)
+{
+	ni_lease_journal_entry_t **pos, *entry;
+
+	if ((pos = ni_lease_journal_entry_find(ifname, rec->type, rec->family)))
+		ni_lease_journal_entry_drop(pos);
+
+	if (rec->op != NI_LEASE_JOURNAL_PUT)
+		return;
+
+	entry = xcalloc(1, sizeof(*entry));
+	ni_string_dup(&entry->ifname, ifname);
+	entry->type = rec->type;
+	entry->family = rec->family;
+	entry->offset = offset;
+	entry->size = sizeof(*rec) + rec->length;
+	entry->next = ni_lease_journal.entries;
+	ni_lease_journal.entries = entry;
+	ni_lease_journal.live += entry->size;
+}
+
+static void
+ni_lease_journal_reset(void)
+{
+	while (ni_lease_journal.entries)
+		ni_lease_journal_entry_drop(&ni_lease_journal.entries);
+
+	if (ni_lease_journal.fd >= 0)
+		close(ni_lease_journal.fd);
+	ni_lease_journal.fd = -1;
+	ni_lease_journal.end = 0;
+	ni_lease_journal.live = 0;
+}
+
+/*
+ * Read a record at offset; returns its payload or NULL when the
+ * record is incomplete or damaged.
+ */
+static void *
+ni_lease_journal_read_record(int fd, off_t offset, ni_lease_journal_record_t *rec)
+{
+	void *payload;
+
+	if (pread(fd, rec, sizeof(*rec), offset) != sizeof(*rec))
+		return NULL;
+
+	if (rec->magic != NI_LEASE_JOURNAL_RECORD_MAGIC
+	 || rec->length == 0 || rec->length > NI_LEASE_JOURNAL_RECORD_MAX)
+		return NULL;
+
+	payload = xmalloc(rec->length);
+	if (pread(fd, payload, rec->length, offset + sizeof(*rec)) != (ssize_t) rec->length
+	 || ni_lease_journal_record_crc(rec, payload) != rec->crc
+	 || !memchr(payload, '\0', rec->length)) {
+		free(payload);
+		return NULL;
+	}
+	return payload;
+}
+
+/*
+ * Index the records appended since the last scan and cut off
+ * a damaged tail left behind by a crash.
+ */
+static void
+ni_lease_journal_scan(off_t size)
+{
+	ni_lease_journal_record_t rec;
+	off_t offset = ni_lease_journal.end;
+	char *payload;
+
+	while (offset < size) {
+		if (!(payload = ni_lease_journal_read_record(ni_lease_journal.fd, offset, &rec)))
+			break;
+
+		ni_lease_journal_index(&rec, payload, offset);
+		offset += sizeof(rec) + rec.length;
+		free(payload);
+	}
+	ni_lease_journal.end = offset;
+
+	if (offset < size) {
+		ni_warn("%s: discarding %lu bytes of incomplete records at offset %lu",
+				ni_lease_journal.path, (unsigned long)(size - offset),
+				(unsigned long)offset);
+		if (ftruncate(ni_lease_journal.fd, offset) < 0)
+			ni_error("%s: unable to truncate: %m", ni_lease_journal.path);
+	}
+}
+
+static ni_bool_t
+ni_lease_journal_check_header(int fd)
+{
+	ni_lease_journal_header_t hdr;
+
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		return FALSE;
+
+	return !memcmp(hdr.magic, NI_LEASE_JOURNAL_MAGIC, sizeof(NI_LEASE_JOURNAL_MAGIC))
+		&& hdr.version == NI_LEASE_JOURNAL_VERSION
+		&& hdr.byteorder == ni_lease_journal_byteorder();
+}
+
+static ni_bool_t
+ni_lease_journal_put_header(int fd)
+{
+	ni_lease_journal_header_t hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, NI_LEASE_JOURNAL_MAGIC, sizeof(NI_LEASE_JOURNAL_MAGIC));
+	hdr.version = NI_LEASE_JOURNAL_VERSION;
+	hdr.byteorder = ni_lease_journal_byteorder();
+
+	return ftruncate(fd, 0) == 0 && pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr);
+}
+
+static void
+ni_lease_journal_unlock(void)
+{
+	if (ni_lease_journal.lock >= 0)
+		flock(ni_lease_journal.lock, LOCK_UN);
+}
+
+/*
+ * Make a new or renamed journal file entry durable
+ */
+static int
+ni_lease_journal_sync_dir(void)
+{
+	const char *dir;
+	int fd, ret;
+
+	if (!(dir = ni_dirname(ni_lease_journal.path)))
+		return -1;
+
+	if ((fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+		return -1;
+
+	ret = fsync(fd);
+	close(fd);
+	return ret;
+}
+
+/*
+ * Lock the journal in @dir and bring the index up to date with it.
+ * Unless @create is set, a missing journal is not an error, but
+ * leaves the journal closed.
+ */
+static ni_bool_t
+ni_lease_journal_lock(const char *dir, ni_bool_t create)
+{
+	char *lockfile = NULL;
+	struct stat stb;
+	int flags = O_RDWR | O_CLOEXEC;
+
+	if (ni_string_empty(dir))
+		return FALSE;
+
+	if (!ni_string_eq(ni_lease_journal.path, dir) || ni_lease_journal.lock < 0) {
+		ni_lease_journal_reset();
+		if (ni_lease_journal.lock >= 0)
+			close(ni_lease_journal.lock);
+		ni_lease_journal.lock = -1;
+		ni_string_free(&ni_lease_journal.path);
+
+		if (!ni_string_printf(&lockfile, "%s/%s", dir, NI_LEASE_JOURNAL_LOCK))
+			return FALSE;
+		ni_lease_journal.lock = open(lockfile, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		ni_string_free(&lockfile);
+		if (ni_lease_journal.lock < 0)
+			return FALSE;
+		ni_string_printf(&ni_lease_journal.path, "%s/%s", dir, NI_LEASE_JOURNAL_NAME);
+	}
+
+	if (flock(ni_lease_journal.lock, LOCK_EX) < 0)
+		return FALSE;
+
+	if (stat(ni_lease_journal.path, &stb) < 0) {
+		ni_lease_journal_reset();
+		if (errno != ENOENT || !create)
+			goto failed;
+		flags |= O_CREAT;
+	} else
+	if (ni_lease_journal.fd >= 0 && (stb.st_dev != ni_lease_journal.dev
+				|| stb.st_ino != ni_lease_journal.ino
+				|| stb.st_size < ni_lease_journal.end)) {
+		/* replaced by a compaction in another process */
+		ni_lease_journal_reset();
+	}
+
+	if (ni_lease_journal.fd < 0) {
+		ni_lease_journal.fd = open(ni_lease_journal.path, flags, 0600);
+		if (ni_lease_journal.fd < 0 || fstat(ni_lease_journal.fd, &stb) < 0)
+			goto failed;
+
+		if (!ni_lease_journal_check_header(ni_lease_journal.fd)) {
+			if (stb.st_size)
+				ni_warn("%s: not a valid lease journal, discarding it",
+						ni_lease_journal.path);
+			if (!ni_lease_journal_put_header(ni_lease_journal.fd))
+				goto failed;
+			stb.st_size = sizeof(ni_lease_journal_header_t);
+		}
+		if ((flags & O_CREAT) && ni_lease_journal_sync_dir() < 0)
+			ni_warn("Unable to sync directory of lease journal '%s': %m",
+					ni_lease_journal.path);
+		ni_lease_journal.dev = stb.st_dev;
+		ni_lease_journal.ino = stb.st_ino;
+		ni_lease_journal.end = sizeof(ni_lease_journal_header_t);
+	}
+
+	if (stb.st_size > ni_lease_journal.end)
+		ni_lease_journal_scan(stb.st_size);
+	return TRUE;
+
+failed:
+	ni_lease_journal_reset();
+	ni_lease_journal_unlock();
+	return FALSE;
+}
+
+/*
+ * Copy the live records into a new journal and replace the old one
+ */
+static void
+ni_lease_journal_compact(void)
+{
+	char tempname[PATH_MAX];
+	ni_lease_journal_entry_t *entry;
+	ni_lease_journal_record_t rec;
+	off_t offset;
+	void *payload;
+	int fd;
+
+	snprintf(tempname, sizeof(tempname), "%s.XXXXXX", ni_lease_journal.path);
+	if ((fd = mkstemp(tempname)) < 0) {
+		ni_error("Cannot create temporary lease journal '%s': %m", tempname);
+		return;
+	}
+
+	if (!ni_lease_journal_put_header(fd))
+		goto failed;
+
+	offset = sizeof(ni_lease_journal_header_t);
+	for (entry = ni_lease_journal.entries; entry; entry = entry->next) {
+		if (!(payload = ni_lease_journal_read_record(ni_lease_journal.fd,
+							entry->offset, &rec)))
+			goto failed;
+
+		if (pwrite(fd, &rec, sizeof(rec), offset) != sizeof(rec)
+		 || pwrite(fd, payload, rec.length, offset + sizeof(rec)) != (ssize_t) rec.length) {
+			free(payload);
+			goto failed;
+		}
+		free(payload);
+		entry->offset = offset;
+		offset += entry->size;
+	}
+
+	if (fsync(fd) < 0 || rename(tempname, ni_lease_journal.path) < 0)
+		goto failed;
+
+	if (ni_lease_journal_sync_dir() < 0)
+		ni_warn("Unable to sync directory of lease journal '%s': %m",
+				ni_lease_journal.path);
+
+	ni_debug_dhcp("Compacted lease journal '%s' from %lu to %lu bytes",
+			ni_lease_journal.path, (unsigned long)ni_lease_journal.end,
+			(unsigned long)offset);
+
+	close(ni_lease_journal.fd);
+	ni_lease_journal.fd = fd;
+	ni_lease_journal.end = offset;
+	{
+		struct stat stb;
+
+		if (fstat(fd, &stb) == 0) {
+			ni_lease_journal.dev = stb.st_dev;
+			ni_lease_journal.ino = stb.st_ino;
+		}
+	}
+	return;
+
+failed:
+	ni_error("Unable to compact lease journal '%s': %m", ni_lease_journal.path);
+	close(fd);
+	unlink(tempname);
+
+	/* the index refers to the old journal */
+	ni_lease_journal_reset();
+}
+
+static int
+ni_lease_journal_append(unsigned int op, const char *ifname, unsigned int type,
+			unsigned int family, const xml_node_t *xml)
+{
+	ni_lease_journal_record_t rec;
+	ni_buffer_t buf;
+	int ret = -1;
+
+	ni_buffer_init_dynamic(&buf, 1024);
+	ni_lease_journal_put(&buf, &rec, sizeof(rec));
+	ni_lease_journal_put(&buf, ifname, strlen(ifname) + 1);
+	if (xml)
+		ni_lease_journal_put_node(&buf, xml);
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = NI_LEASE_JOURNAL_RECORD_MAGIC;
+	rec.length = ni_buffer_count(&buf) - sizeof(rec);
+	rec.op = op;
+	rec.type = type;
+	rec.family = family;
+	if (rec.length > NI_LEASE_JOURNAL_RECORD_MAX) {
+		errno = EFBIG;
+		goto done;
+	}
+	rec.crc = ni_lease_journal_record_crc(&rec, ni_buffer_head(&buf) + sizeof(rec));
+	memcpy(ni_buffer_head(&buf), &rec, sizeof(rec));
+
+	/* a single write, so a crash can only leave a damaged tail */
+	if (pwrite(ni_lease_journal.fd, ni_buffer_head(&buf), ni_buffer_count(&buf),
+				ni_lease_journal.end) != (ssize_t) ni_buffer_count(&buf)) {
+		if (ftruncate(ni_lease_journal.fd, ni_lease_journal.end) < 0)
+			ni_error("%s: unable to truncate: %m", ni_lease_journal.path);
+		goto done;
+	}
+
+	/* every append is a commit point: the lease is on disk now */
+	if (fdatasync(ni_lease_journal.fd) < 0) {
+		ni_error("%s: unable to sync: %m", ni_lease_journal.path);
+		if (ftruncate(ni_lease_journal.fd, ni_lease_journal.end) < 0)
+			ni_error("%s: unable to truncate: %m", ni_lease_journal.path);
+		goto done;
+	}
+
+	ni_lease_journal_index(&rec, ifname, ni_lease_journal.end);
+	ni_lease_journal.end += ni_buffer_count(&buf);
+	ret = 0;
+
+	if (ni_lease_journal.end > NI_LEASE_JOURNAL_COMPACT_MIN
+	 && ni_lease_journal.live < (size_t)ni_lease_journal.end / 2)
+		ni_lease_journal_compact();
+
+done:
+	ni_buffer_destroy(&buf);
+	return ret;
+}
+
+/*
+ * Store a lease xml tree in the journal
+ */
+int
+ni_lease_journal_write(const char *dir, const char *ifname, unsigned int type,
+			unsigned int family, const xml_node_t *xml)
+{
+	int ret;
+
+	if (ni_string_empty(ifname) || !xml)
+		return -1;
+
+	if (!ni_lease_journal_lock(dir, TRUE)) {
+		ni_error("Unable to open lease journal in '%s': %m", dir);
+		return -1;
+	}
+
+	if ((ret = ni_lease_journal_append(NI_LEASE_JOURNAL_PUT, ifname, type, family, xml)) < 0)
+		ni_error("Unable to append lease to journal '%s': %m", ni_lease_journal.path);
+	else
+		ni_debug_dhcp("Lease appended to journal '%s'", ni_lease_journal.path);
+
+	ni_lease_journal_unlock();
+	return ret;
+}
+
+/*
+ * Read a lease xml tree from the journal
+ */
+xml_node_t *
+ni_lease_journal_read(const char *dir, const char *ifname, unsigned int type,
+			unsigned int family)
+{
+	ni_lease_journal_entry_t **pos;
+	ni_lease_journal_record_t rec;
+	xml_node_t *xml = NULL;
+	char *payload = NULL;
+	ni_buffer_t buf;
+	size_t len;
+
+	if (ni_string_empty(ifname) || !ni_lease_journal_lock(dir, FALSE))
+		return NULL;
+
+	if (!(pos = ni_lease_journal_entry_find(ifname, type, family)))
+		goto done;
+
+	if (!(payload = ni_lease_journal_read_record(ni_lease_journal.fd, (*pos)->offset, &rec))) {
+		ni_error("%s: unable to read lease record at offset %lu",
+				ni_lease_journal.path, (unsigned long)(*pos)->offset);
+		goto done;
+	}
+
+	len = strlen(payload) + 1;
+	ni_buffer_init_reader(&buf, payload + len, rec.length - len);
+	if (!(xml = ni_lease_journal_get_node(&buf, NULL, 0)))
+		ni_error("%s: unable to decode lease record at offset %lu",
+				ni_lease_journal.path, (unsigned long)(*pos)->offset);
+
+done:
+	free(payload);
+	ni_lease_journal_unlock();
+	return xml;
+}
+
+/*
+ * Drop a lease from the journal
+ */
+int
+ni_lease_journal_remove(const char *dir, const char *ifname, unsigned int type,
+			unsigned int family)
+{
+	int ret = 0;
+
+	if (ni_string_empty(ifname) || !ni_lease_journal_lock(dir, FALSE))
+		return 0;
+
+	if (ni_lease_journal_entry_find(ifname, type, family)) {
+		ret = ni_lease_journal_append(NI_LEASE_JOURNAL_DELETE, ifname, type, family, NULL);
+		if (ret < 0)
+			ni_error("Unable to remove lease from journal '%s': %m", ni_lease_journal.path);
+		else
+			ni_debug_dhcp("Lease removed from journal '%s'", ni_lease_journal.path);
+	}
+
+	ni_lease_journal_unlock();
+	return ret;
+}
+
+ni_bool_t
+ni_lease_journal_exists(const char *dir, const char *ifname, unsigned int type,
+			unsigned int family)
+{
+	ni_bool_t ret;
+
+	if (ni_string_empty(ifname) || !ni_lease_journal_lock(dir, FALSE))
+		return FALSE;
+
+	ret = ni_lease_journal_entry_find(ifname, type, family) != NULL;
+	ni_lease_journal_unlock();
+	return ret;
+}
@@ -0,0 +1,33 @@
+/*
+ *	wicked addrconf lease journal
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifndef   __WICKED_ADDRCONF_LEASEJOURNAL_H__
+#define   __WICKED_ADDRCONF_LEASEJOURNAL_H__
+
+#include <wicked/types.h>
+
+extern int		ni_lease_journal_write(const char *, const char *, unsigned int,
+					unsigned int, const xml_node_t *);
+extern xml_node_t *	ni_lease_journal_read(const char *, const char *, unsigned int,
+					unsigned int);
+extern int		ni_lease_journal_remove(const char *, const char *, unsigned int,
+					unsigned int);
+extern ni_bool_t	ni_lease_journal_exists(const char *, const char *, unsigned int,
+					unsigned int);
+
+#endif /* __WICKED_ADDRCONF_LEASEJOURNAL_H__ */
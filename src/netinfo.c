@@ -42,10 +42,46 @@ typedef struct ni_netconfig_filter {
 	unsigned int		discover;
 } ni_netconfig_filter_t;
 
+/*
+ * Device lookup indexes by ifindex and name.
+ * Each entry records the keys the device has been indexed
+ * with, so it can be relinked when the device keys change,
+ * and the sequence it has been appended to the device list
+ * in, so lookups of duplicate keys return the first device
+ * in the list as the former list walks did.
+ */
+enum {
+	NI_NETDEV_INDEX_DEV,
+	NI_NETDEV_INDEX_IFINDEX,
+	NI_NETDEV_INDEX_NAME,
+
+	NI_NETDEV_INDEX_MAX
+};
+
+#define NI_NETDEV_INDEX_CHUNK	64
+
+typedef struct ni_netdev_index_entry	ni_netdev_index_entry_t;
+struct ni_netdev_index_entry {
+	ni_netdev_index_entry_t *	next[NI_NETDEV_INDEX_MAX];
+
+	ni_netdev_t *			dev;
+	unsigned int			seq;
+	unsigned int			ifindex;
+	char *				name;
+};
+
+typedef struct ni_netdev_index {
+	unsigned int			count;
+	unsigned int			size;
+	unsigned int			seq;
+	ni_netdev_index_entry_t **	table[NI_NETDEV_INDEX_MAX];
+} ni_netdev_index_t;
+
 struct ni_netconfig {
 	ni_netconfig_filter_t	filter;
 
 	ni_netdev_t *		interfaces;
+	ni_netdev_index_t	index;
 	ni_modem_t *		modems;
 
 	struct {
@@ -431,6 +467,8 @@ ni_xs_scope_t *
 ni_server_dbus_xml_schema(void)
 {
 	const char *filename = ni_global.config->dbus_xml_schema_file;
+	const char *cachefile = ni_global.config->dbus_xml_schema_cache;
+	char pathbuf[PATH_MAX];
 	ni_xs_scope_t *scope;
 
 	if (filename == NULL) {
@@ -438,8 +476,17 @@ ni_server_dbus_xml_schema(void)
 		return NULL;
 	}
 
+	/* By default, the precompiled schema is cached in the state dir.
+	 * We do not create the directory here, as clients may run without
+	 * the privileges to do so; the cache is just not written then. */
+	if (cachefile == NULL) {
+		snprintf(pathbuf, sizeof(pathbuf), "%s/schema.cache",
+				ni_global.config->statedir.path);
+		cachefile = pathbuf;
+	}
+
 	scope = ni_dbus_xml_init();
-	if (ni_xs_process_schema_file(filename, scope) < 0) {
+	if (ni_xs_process_schema_cache(filename, cachefile, scope) < 0) {
 		ni_error("Cannot create dbus xml schema: error in schema definition");
 		ni_xs_scope_free(scope);
 		return NULL;
@@ -516,9 +563,12 @@ ni_netconfig_init(ni_netconfig_t *nc)
 	memset(nc, 0, sizeof(*nc));
 }
 
+static void		ni_netdev_index_destroy(ni_netdev_index_t *);
+
 void
 ni_netconfig_destroy(ni_netconfig_t *nc)
 {
+	ni_netdev_index_destroy(&nc->index);
 	__ni_netdev_list_destroy(&nc->interfaces);
 	ni_rule_array_destroy(&nc->route.rules);
 	memset(nc, 0, sizeof(*nc));
@@ -579,6 +629,8 @@ void
 ni_netconfig_device_append(ni_netconfig_t *nc, ni_netdev_t *dev)
 {
 	__ni_netdev_list_append(&nc->interfaces, dev);
+	ni_netconfig_device_reindex(nc, dev);
+	ni_sysfs_dir_cache_reserve(nc->index.count);
 }
 
 static inline void
@@ -600,6 +652,7 @@ ni_netconfig_device_remove(ni_netconfig_t *nc, ni_netdev_t *dev)
 	for (pos = &nc->interfaces; (cur = *pos) != NULL; pos = &cur->next) {
 		if (cur == dev) {
 			*pos = cur->next;
+			ni_netconfig_device_unindex(nc, cur);
 			ni_netconfig_device_unbind_slave_index(nc, cur->link.ifindex);
 			ni_netdev_put(cur);
 			return;
@@ -672,7 +725,8 @@ ni_netconfig_route_add(ni_netconfig_t *nc, ni_route_t *rp, ni_netdev_t *dev)
 				nh->device.index);
 			ret = -1;
 		} else {
-			ni_string_dup(&nh->device.name, dev->name);
+			if (!ni_string_eq(nh->device.name, dev->name))
+				ni_string_dup(&nh->device.name, dev->name);
 			ret = 0;
 
 			if (ni_log_level_at(NI_LOG_DEBUG2)) {
@@ -809,54 +863,264 @@ ni_netconfig_rule_find(ni_netconfig_t *nc, const ni_rule_t *rule)
 
 
 /*
- * Find interface by name
+ * Device lookup indexes
  */
-ni_netdev_t *
-ni_netdev_by_name(ni_netconfig_t *nc, const char *name)
+static inline unsigned int
+ni_netdev_index_hash_dev(const ni_netdev_t *dev)
 {
-	ni_netdev_t *dev;
+	return ni_hash_bytes(&dev, sizeof(dev));
+}
 
-	for (dev = nc->interfaces; dev; dev = dev->next) {
-		if (dev->name && ni_string_eq(dev->name, name))
-			return dev;
+static ni_netdev_index_entry_t **
+ni_netdev_index_bucket(ni_netdev_index_t *index, unsigned int type,
+			const ni_netdev_index_entry_t *entry)
+{
+	unsigned int hash;
+
+	switch (type) {
+	case NI_NETDEV_INDEX_DEV:
+		hash = ni_netdev_index_hash_dev(entry->dev);
+		break;
+	case NI_NETDEV_INDEX_IFINDEX:
+		hash = ni_hash_uint(entry->ifindex);
+		break;
+	case NI_NETDEV_INDEX_NAME:
+		hash = ni_hash_string(entry->name);
+		break;
+	default:
+		return NULL;
 	}
+	return &index->table[type][hash & (index->size - 1)];
+}
 
+static inline ni_bool_t
+ni_netdev_index_has_key(const ni_netdev_index_entry_t *entry, unsigned int type)
+{
+	switch (type) {
+	case NI_NETDEV_INDEX_NAME:
+		return entry->name != NULL;
+	default:
+		return TRUE;
+	}
+}
+
+static void
+ni_netdev_index_link(ni_netdev_index_t *index, ni_netdev_index_entry_t *entry)
+{
+	ni_netdev_index_entry_t **bucket;
+	unsigned int type;
+
+	for (type = 0; type < NI_NETDEV_INDEX_MAX; ++type) {
+		entry->next[type] = NULL;
+		if (!ni_netdev_index_has_key(entry, type))
+			continue;
+
+		bucket = ni_netdev_index_bucket(index, type, entry);
+		entry->next[type] = *bucket;
+		*bucket = entry;
+	}
+}
+
+static void
+ni_netdev_index_unlink(ni_netdev_index_t *index, ni_netdev_index_entry_t *entry)
+{
+	ni_netdev_index_entry_t **pos, *cur;
+	unsigned int type;
+
+	for (type = 0; type < NI_NETDEV_INDEX_MAX; ++type) {
+		if (!ni_netdev_index_has_key(entry, type))
+			continue;
+
+		pos = ni_netdev_index_bucket(index, type, entry);
+		for ( ; (cur = *pos) != NULL; pos = &cur->next[type]) {
+			if (cur == entry) {
+				*pos = entry->next[type];
+				break;
+			}
+		}
+		entry->next[type] = NULL;
+	}
+}
+
+static void
+ni_netdev_index_resize(ni_netdev_index_t *index, unsigned int size)
+{
+	ni_netdev_index_entry_t **old, *entry, *next;
+	unsigned int type, oldsize, i;
+
+	old = index->table[NI_NETDEV_INDEX_DEV];
+	oldsize = index->size;
+
+	index->size = size;
+	for (type = 0; type < NI_NETDEV_INDEX_MAX; ++type) {
+		if (type != NI_NETDEV_INDEX_DEV)
+			free(index->table[type]);
+		index->table[type] = xcalloc(size, sizeof(ni_netdev_index_entry_t *));
+	}
+
+	for (i = 0; i < oldsize; ++i) {
+		for (entry = old[i]; entry; entry = next) {
+			next = entry->next[NI_NETDEV_INDEX_DEV];
+			ni_netdev_index_link(index, entry);
+		}
+	}
+	free(old);
+}
+
+static ni_netdev_index_entry_t *
+ni_netdev_index_find(ni_netdev_index_t *index, const ni_netdev_t *dev)
+{
+	ni_netdev_index_entry_t *entry;
+	unsigned int hash;
+
+	if (!index->size)
+		return NULL;
+
+	hash = ni_netdev_index_hash_dev(dev);
+	entry = index->table[NI_NETDEV_INDEX_DEV][hash & (index->size - 1)];
+	for ( ; entry; entry = entry->next[NI_NETDEV_INDEX_DEV]) {
+		if (entry->dev == dev)
+			return entry;
+	}
 	return NULL;
 }
 
+static inline ni_bool_t
+ni_netdev_index_uptodate(const ni_netdev_index_entry_t *entry, const ni_netdev_t *dev)
+{
+	return	entry->ifindex == dev->link.ifindex &&
+		ni_string_eq(entry->name, dev->name);
+}
+
+static void
+ni_netdev_index_destroy(ni_netdev_index_t *index)
+{
+	ni_netdev_index_entry_t *entry, *next;
+	unsigned int type, i;
+
+	for (i = 0; i < index->size; ++i) {
+		for (entry = index->table[NI_NETDEV_INDEX_DEV][i]; entry; entry = next) {
+			next = entry->next[NI_NETDEV_INDEX_DEV];
+			ni_string_free(&entry->name);
+			free(entry);
+		}
+	}
+	for (type = 0; type < NI_NETDEV_INDEX_MAX; ++type)
+		free(index->table[type]);
+	memset(index, 0, sizeof(*index));
+}
+
 /*
- * Find interface by its ifindex
+ * (Re-)index a device in the netconfig lookup indexes.
+ * Has to be called after a device has been added to the
+ * device list and when its name or ifindex has changed.
+ */
+void
+ni_netconfig_device_reindex(ni_netconfig_t *nc, ni_netdev_t *dev)
+{
+	ni_netdev_index_t *index;
+	ni_netdev_index_entry_t *entry;
+
+	if (!nc || !dev)
+		return;
+
+	index = &nc->index;
+	if ((entry = ni_netdev_index_find(index, dev))) {
+		if (ni_netdev_index_uptodate(entry, dev))
+			return;
+		ni_netdev_index_unlink(index, entry);
+	} else {
+		if (index->count >= index->size)
+			ni_netdev_index_resize(index, index->size ?
+					index->size * 2 : NI_NETDEV_INDEX_CHUNK);
+		entry = xcalloc(1, sizeof(*entry));
+		entry->dev = dev;
+		entry->seq = index->seq++;
+		index->count++;
+	}
+
+	entry->ifindex = dev->link.ifindex;
+	ni_string_dup(&entry->name, dev->name);
+	ni_netdev_index_link(index, entry);
+}
+
+/*
+ * Rename a device and update the lookup indexes when the
+ * device is already indexed in the netconfig handle.
+ */
+void
+ni_netconfig_device_rename(ni_netconfig_t *nc, ni_netdev_t *dev, const char *ifname)
+{
+	if (!dev || ni_string_empty(ifname) || ni_string_eq(dev->name, ifname))
+		return;
+
+	ni_string_dup(&dev->name, ifname);
+	if (nc && ni_netdev_index_find(&nc->index, dev))
+		ni_netconfig_device_reindex(nc, dev);
+}
+
+void
+ni_netconfig_device_unindex(ni_netconfig_t *nc, ni_netdev_t *dev)
+{
+	ni_netdev_index_entry_t *entry;
+
+	if (!nc || !dev)
+		return;
+
+	if ((entry = ni_netdev_index_find(&nc->index, dev))) {
+		ni_netdev_index_unlink(&nc->index, entry);
+		nc->index.count--;
+		ni_string_free(&entry->name);
+		free(entry);
+	}
+}
+
+/*
+ * Find interface by name
  */
 ni_netdev_t *
-ni_netdev_by_index(ni_netconfig_t *nc, unsigned int ifindex)
+ni_netdev_by_name(ni_netconfig_t *nc, const char *name)
 {
-	ni_netdev_t *dev;
+	ni_netdev_index_entry_t *entry, *first = NULL;
+	unsigned int hash;
 
-	for (dev = nc->interfaces; dev; dev = dev->next) {
-		if (dev->link.ifindex == ifindex)
-			return dev;
+	if (!nc || !name || !nc->index.size)
+		return NULL;
+
+	hash = ni_hash_string(name);
+	entry = nc->index.table[NI_NETDEV_INDEX_NAME][hash & (nc->index.size - 1)];
+	for ( ; entry; entry = entry->next[NI_NETDEV_INDEX_NAME]) {
+		if (!ni_string_eq(entry->dev->name, name))
+			continue;
+		if (!first || entry->seq < first->seq)
+			first = entry;
 	}
 
-	return NULL;
+	return first ? first->dev : NULL;
 }
 
 /*
- * Find interface by its LL address
+ * Find interface by its ifindex
  */
 ni_netdev_t *
-ni_netdev_by_hwaddr(ni_netconfig_t *nc, const ni_hwaddr_t *lla)
+ni_netdev_by_index(ni_netconfig_t *nc, unsigned int ifindex)
 {
-	ni_netdev_t *dev;
+	ni_netdev_index_entry_t *entry, *first = NULL;
+	unsigned int hash;
 
-	if (!lla || !lla->len)
+	if (!nc || !nc->index.size)
 		return NULL;
 
-	for (dev = nc->interfaces; dev; dev = dev->next) {
-		if (ni_link_address_equal(&dev->link.hwaddr, lla))
-			return dev;
+	hash = ni_hash_uint(ifindex);
+	entry = nc->index.table[NI_NETDEV_INDEX_IFINDEX][hash & (nc->index.size - 1)];
+	for ( ; entry; entry = entry->next[NI_NETDEV_INDEX_IFINDEX]) {
+		if (entry->dev->link.ifindex != ifindex)
+			continue;
+		if (!first || entry->seq < first->seq)
+			first = entry;
 	}
 
-	return NULL;
+	return first ? first->dev : NULL;
 }
 
 /*
@@ -41,11 +41,17 @@ enum {
  */
 extern unsigned int	__ni_global_seqno;
 
+extern void		ni_address_pool_trace(void);
+extern void		ni_route_pool_trace(void);
+
 extern ni_netlink_t *	__ni_netlink_open(int);
 extern void		__ni_netlink_close(ni_netlink_t *);
 
 extern void		ni_netconfig_device_append(ni_netconfig_t *, ni_netdev_t *);
 extern void		ni_netconfig_device_remove(ni_netconfig_t *, ni_netdev_t *);
+extern void		ni_netconfig_device_reindex(ni_netconfig_t *, ni_netdev_t *);
+extern void		ni_netconfig_device_unindex(ni_netconfig_t *, ni_netdev_t *);
+extern void		ni_netconfig_device_rename(ni_netconfig_t *, ni_netdev_t *, const char *);
 extern ni_netdev_t **	ni_netconfig_device_list_head(ni_netconfig_t *);
 extern void		ni_netconfig_modem_append(ni_netconfig_t *, ni_modem_t *);
 extern int		ni_netconfig_route_add(ni_netconfig_t *, ni_route_t *, ni_netdev_t *);
@@ -95,6 +101,7 @@ extern int		__ni_system_interface_stats_refresh(ni_netconfig_t *, ni_netdev_t *)
 extern int		__ni_system_interface_flush_addrs(ni_netconfig_t *, ni_netdev_t *);
 extern int		__ni_system_interface_flush_routes(ni_netconfig_t *, ni_netdev_t *);
 extern void		__ni_system_ethernet_refresh(ni_netdev_t *);
+extern void		__ni_system_ethernet_refresh_ondemand(ni_netdev_t *);
 extern void		__ni_system_ethernet_update(ni_netdev_t *, ni_ethernet_t *);
 
 /* FIXME: These should go elsewhere, maybe runtime.h */
@@ -148,6 +155,15 @@ typedef struct ni_capture_protinfo {
 	uint16_t		ip_port;
 } ni_capture_protinfo_t;
 
+typedef struct ni_capture_txq_stats {
+	unsigned long		queued;
+	unsigned long		sent;
+	unsigned long		failed;
+	unsigned long		flushes;
+	unsigned long		syscalls;
+	unsigned int		max_batch;
+} ni_capture_txq_stats_t;
+
 extern int		ni_capture_devinfo_init(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern int		ni_capture_devinfo_refresh(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern ni_capture_t *	ni_capture_open(const ni_capture_devinfo_t *, const ni_capture_protinfo_t *, void (*)(ni_socket_t *));
@@ -165,6 +181,7 @@ extern int		ni_capture_build_udp_header(ni_buffer_t *,
 extern void		ni_capture_set_user_data(ni_capture_t *, void *);
 extern void *		ni_capture_get_user_data(const ni_capture_t *);
 extern int		ni_capture_is_valid(const ni_capture_t *, int protocol);
+extern const ni_capture_txq_stats_t *ni_capture_txq_stats(const ni_capture_t *);
 
 typedef struct ni_arp_socket ni_arp_socket_t;
 
@@ -30,6 +30,7 @@
 #include <wicked/util.h>
 #include <wicked/netinfo.h>
 #include "ovs.h"
+#include "ovsdb.h"
 #include "buffer.h"
 #include "process.h"
 #include "util_priv.h"
@@ -221,6 +222,9 @@ ni_ovs_vsctl_bridge_exists(const char *brname)
 	if (ni_string_empty(brname))
 		return rv;
 
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_exists(brname);
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -263,6 +267,9 @@ ni_ovs_vsctl_bridge_to_vlan(const char *brname, uint16_t *vlan)
 	if (ni_string_empty(brname) || !vlan)
 		return rv;
 
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_to_vlan(brname, vlan);
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -325,6 +332,9 @@ ni_ovs_vsctl_bridge_to_parent(const char *brname, char **parent)
 	if (ni_string_empty(brname) || !parent)
 		return rv;
 
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_to_parent(brname, parent);
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -381,6 +391,9 @@ ni_ovs_vsctl_bridge_ports(const char *brname, ni_ovs_bridge_port_array_t *ports)
 	if (ni_string_empty(brname) || !ports)
 		return rv;
 
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_ports(brname, ports);
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -445,6 +458,17 @@ ni_ovs_vsctl_bridge_add(const ni_netdev_t *cfg, ni_bool_t may_exist)
 	if (!cfg || ni_string_empty(cfg->name) || !cfg->ovsbr)
 		return rv;
 
+	if (ni_ovsdb_available()) {
+		ni_ovsdb_txn_t *txn = ni_ovsdb_txn_new();
+
+		if (ni_ovsdb_txn_bridge_add(txn, cfg->name,
+					cfg->ovsbr->config.vlan.parent.name,
+					cfg->ovsbr->config.vlan.tag, may_exist))
+			rv = ni_ovsdb_txn_commit(txn);
+		ni_ovsdb_txn_free(txn);
+		return rv;
+	}
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -495,6 +519,15 @@ ni_ovs_vsctl_bridge_del(const char *brname)
 	if (ni_string_empty(brname))
 		return rv;
 
+	if (ni_ovsdb_available()) {
+		ni_ovsdb_txn_t *txn = ni_ovsdb_txn_new();
+
+		if (ni_ovsdb_txn_bridge_del(txn, brname))
+			rv = ni_ovsdb_txn_commit(txn);
+		ni_ovsdb_txn_free(txn);
+		return rv;
+	}
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -534,6 +567,15 @@ ni_ovs_vsctl_bridge_port_add(const char *pname, const ni_ovs_bridge_port_config_
 	if (ni_string_empty(pname) || !pconf || ni_string_empty(pconf->bridge.name))
 		return rv;
 
+	if (ni_ovsdb_available()) {
+		ni_ovsdb_txn_t *txn = ni_ovsdb_txn_new();
+
+		if (ni_ovsdb_txn_port_add(txn, pconf->bridge.name, pname, may_exist))
+			rv = ni_ovsdb_txn_commit(txn);
+		ni_ovsdb_txn_free(txn);
+		return rv;
+	}
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -580,6 +622,15 @@ ni_ovs_vsctl_bridge_port_del(const char *brname, const char *pname)
 	if (ni_string_empty(brname) || ni_string_empty(pname))
 		return rv;
 
+	if (ni_ovsdb_available()) {
+		ni_ovsdb_txn_t *txn = ni_ovsdb_txn_new();
+
+		if (ni_ovsdb_txn_port_del(txn, brname, pname))
+			rv = ni_ovsdb_txn_commit(txn);
+		ni_ovsdb_txn_free(txn);
+		return rv;
+	}
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
@@ -624,6 +675,9 @@ ni_ovs_vsctl_bridge_port_to_bridge(const char *pname, char **brname)
 	if (ni_string_empty(pname) || !brname)
 		return rv;
 
+	if (ni_ovsdb_available())
+		return ni_ovsdb_port_to_bridge(pname, brname);
+
 	if (!(ovs_vsctl = ni_ovs_vsctl_tool_path()))
 		return rv;
 
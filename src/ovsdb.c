@@ -0,0 +1,1201 @@
+/*
+ *	OVSDB JSON-RPC client for OVS bridge support
+ *
+ *	Talks the OVSDB management protocol (RFC 7047) on the local
+ *	ovsdb-server socket instead of running ovs-vsctl for every query
+ *	and change.
+ *
+ *	The Bridge and Port tables are mirrored in memory using a monitor;
+ *	the queries are answered from this copy, which is kept up to date
+ *	from the update notifications the server sends on each change.
+ *	The changes are collected in a transaction, which is committed
+ *	to the server in a single request.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include "ovsdb.h"
+#include "json.h"
+#include "buffer.h"
+#include "util_priv.h"
+
+#define NI_OVSDB_DATABASE		"Open_vSwitch"
+#define NI_OVSDB_CALL_TIMEOUT		10000	/* msec */
+#define NI_OVSDB_RECV_CHUNK		4096
+
+static const char *	ni_ovsdb_socket_paths[] = {
+	"/run/openvswitch/db.sock",
+	"/var/run/openvswitch/db.sock",
+	NULL
+};
+
+typedef struct ni_ovsdb_row	ni_ovsdb_row_t;
+struct ni_ovsdb_row {
+	ni_ovsdb_row_t *	next;
+	char *			uuid;
+	char *			name;
+	ni_string_array_t	refs;		/* Bridge ports, Port interfaces */
+	int			tag;		/* Port vlan tag, -1 if none */
+	ni_bool_t		fake_bridge;	/* Port of a vlan bridge */
+};
+
+static struct ni_ovsdb_client {
+	int			fd;
+	unsigned int		seqno;
+	ni_buffer_t		rbuf;
+
+	ni_ovsdb_row_t *	bridges;
+	ni_ovsdb_row_t *	ports;
+} ni_ovsdb = { .fd = -1 };
+
+typedef struct ni_ovsdb_txn_bridge	ni_ovsdb_txn_bridge_t;
+struct ni_ovsdb_txn_bridge {
+	ni_ovsdb_txn_bridge_t *	next;
+	char *			name;
+	ni_json_t *		ports;		/* port set of the insert op */
+};
+
+struct ni_ovsdb_txn {
+	ni_json_t *		ops;
+	unsigned int		rows;
+	ni_ovsdb_txn_bridge_t *	bridges;	/* inserted by this transaction */
+	ni_string_array_t	ports;		/* inserted by this transaction */
+};
+
+/*
+ * The mirrored table rows
+ */
+static ni_ovsdb_row_t *
+ni_ovsdb_row_new(ni_ovsdb_row_t **list, const char *uuid)
+{
+	ni_ovsdb_row_t *row;
+
+	row = xcalloc(1, sizeof(*row));
+	ni_string_dup(&row->uuid, uuid);
+	row->tag = -1;
+	row->next = *list;
+	*list = row;
+	return row;
+}
+
+static void
+ni_ovsdb_row_free(ni_ovsdb_row_t *row)
+{
+	ni_string_free(&row->uuid);
+	ni_string_free(&row->name);
+	ni_string_array_destroy(&row->refs);
+	free(row);
+}
+
+static void
+ni_ovsdb_rows_destroy(ni_ovsdb_row_t **list)
+{
+	ni_ovsdb_row_t *row;
+
+	while ((row = *list)) {
+		*list = row->next;
+		ni_ovsdb_row_free(row);
+	}
+}
+
+static ni_ovsdb_row_t **
+ni_ovsdb_row_find_uuid(ni_ovsdb_row_t **list, const char *uuid)
+{
+	ni_ovsdb_row_t **pos;
+
+	for (pos = list; *pos; pos = &(*pos)->next) {
+		if (ni_string_eq((*pos)->uuid, uuid))
+			return pos;
+	}
+	return NULL;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_row_find_name(ni_ovsdb_row_t *list, const char *name)
+{
+	ni_ovsdb_row_t *row;
+
+	for (row = list; row; row = row->next) {
+		if (ni_string_eq(row->name, name))
+			return row;
+	}
+	return NULL;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_port_bridge(const ni_ovsdb_row_t *port)
+{
+	ni_ovsdb_row_t *br;
+
+	for (br = ni_ovsdb.bridges; br; br = br->next) {
+		if (ni_string_array_index(&br->refs, port->uuid) >= 0)
+			return br;
+	}
+	return NULL;
+}
+
+/*
+ * A vlan ("fake") bridge is a tagged internal port of its parent bridge
+ */
+static ni_ovsdb_row_t *
+ni_ovsdb_fake_bridge_find(const char *name)
+{
+	ni_ovsdb_row_t *port;
+
+	port = ni_ovsdb_row_find_name(ni_ovsdb.ports, name);
+	return port && port->fake_bridge ? port : NULL;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_fake_bridge_by_tag(const ni_ovsdb_row_t *br, int tag)
+{
+	ni_ovsdb_row_t **pos, *port;
+	unsigned int i;
+
+	for (i = 0; tag >= 0 && i < br->refs.count; ++i) {
+		if (!(pos = ni_ovsdb_row_find_uuid(&ni_ovsdb.ports, br->refs.data[i])))
+			continue;
+		port = *pos;
+		if (port->fake_bridge && port->tag == tag)
+			return port;
+	}
+	return NULL;
+}
+
+/*
+ * Decoding of the OVSDB data representation
+ */
+static ni_bool_t
+ni_ovsdb_json_is_pair(ni_json_t *value, const char *kind)
+{
+	char *str = NULL;
+	ni_bool_t ret;
+
+	if (ni_json_array_entries(value) != 2)
+		return FALSE;
+	if (!ni_json_string_get(ni_json_array_get(value, 0), &str))
+		return FALSE;
+	ret = ni_string_eq(str, kind);
+	ni_string_free(&str);
+	return ret;
+}
+
+static ni_bool_t
+ni_ovsdb_json_uuid(ni_json_t *atom, char **uuid)
+{
+	if (!ni_ovsdb_json_is_pair(atom, "uuid"))
+		return FALSE;
+	return ni_json_string_get(ni_json_array_get(atom, 1), uuid);
+}
+
+/* a set is either represented by its single atom or as ["set", [...]] */
+static unsigned int
+ni_ovsdb_json_set_count(ni_json_t *value)
+{
+	if (ni_ovsdb_json_is_pair(value, "set"))
+		return ni_json_array_entries(ni_json_array_get(value, 1));
+	return value ? 1 : 0;
+}
+
+static ni_json_t *
+ni_ovsdb_json_set_get(ni_json_t *value, unsigned int i)
+{
+	if (ni_ovsdb_json_is_pair(value, "set"))
+		return ni_json_array_get(ni_json_array_get(value, 1), i);
+	return i == 0 ? value : NULL;
+}
+
+static void
+ni_ovsdb_json_uuid_set(ni_json_t *value, ni_string_array_t *uuids)
+{
+	unsigned int i, count;
+	char *uuid = NULL;
+
+	ni_string_array_destroy(uuids);
+	count = ni_ovsdb_json_set_count(value);
+	for (i = 0; i < count; ++i) {
+		if (ni_ovsdb_json_uuid(ni_ovsdb_json_set_get(value, i), &uuid))
+			ni_string_array_append(uuids, uuid);
+		ni_string_free(&uuid);
+	}
+}
+
+/*
+ * Encoding of the OVSDB data representation
+ */
+static ni_json_t *
+ni_ovsdb_json_new_pair(const char *kind, ni_json_t *value)
+{
+	ni_json_t *pair = ni_json_new_array();
+
+	ni_json_array_append(pair, ni_json_new_string(kind));
+	ni_json_array_append(pair, value);
+	return pair;
+}
+
+static ni_json_t *
+ni_ovsdb_json_new_uuid(const char *kind, const char *uuid)
+{
+	return ni_ovsdb_json_new_pair(kind, ni_json_new_string(uuid));
+}
+
+static ni_json_t *
+ni_ovsdb_json_new_set(ni_json_t **elements)
+{
+	*elements = ni_json_new_array();
+	return ni_ovsdb_json_new_pair("set", *elements);
+}
+
+static ni_json_t *
+ni_ovsdb_json_new_where_uuid(const char *uuid)
+{
+	ni_json_t *where = ni_json_new_array();
+	ni_json_t *cond = ni_json_new_array();
+
+	ni_json_array_append(cond, ni_json_new_string("_uuid"));
+	ni_json_array_append(cond, ni_json_new_string("=="));
+	ni_json_array_append(cond, ni_ovsdb_json_new_uuid("uuid", uuid));
+	ni_json_array_append(where, cond);
+	return where;
+}
+
+/*
+ * Apply the initial monitor reply and the update notifications
+ */
+static void
+ni_ovsdb_row_update(ni_ovsdb_row_t *row, ni_json_t *columns)
+{
+	ni_json_t *value;
+	int64_t tag;
+
+	if ((value = ni_json_object_get_value(columns, "name"))) {
+		ni_string_free(&row->name);
+		ni_json_string_get(value, &row->name);
+	}
+	if ((value = ni_json_object_get_value(columns, "ports")))
+		ni_ovsdb_json_uuid_set(value, &row->refs);
+	if ((value = ni_json_object_get_value(columns, "interfaces")))
+		ni_ovsdb_json_uuid_set(value, &row->refs);
+	if ((value = ni_json_object_get_value(columns, "tag"))) {
+		row->tag = -1;
+		if (ni_ovsdb_json_set_count(value) == 1 &&
+		    ni_json_int64_get(ni_ovsdb_json_set_get(value, 0), &tag))
+			row->tag = tag;
+	}
+	if ((value = ni_json_object_get_value(columns, "fake_bridge")))
+		ni_json_bool_get(value, &row->fake_bridge);
+}
+
+static void
+ni_ovsdb_table_update(ni_ovsdb_row_t **list, ni_json_t *rows)
+{
+	ni_ovsdb_row_t **pos, *row;
+	ni_json_pair_t *pair;
+	ni_json_t *columns;
+	const char *uuid;
+	unsigned int i;
+
+	for (i = 0; i < ni_json_object_entries(rows); ++i) {
+		if (!(pair = ni_json_object_get_pair_at(rows, i)))
+			continue;
+
+		uuid = ni_json_pair_get_name(pair);
+		columns = ni_json_object_get_value(ni_json_pair_get_value(pair), "new");
+		pos = ni_ovsdb_row_find_uuid(list, uuid);
+
+		if (!columns || ni_json_is_null(columns)) {
+			if (pos) {
+				row = *pos;
+				*pos = row->next;
+				ni_ovsdb_row_free(row);
+			}
+			continue;
+		}
+
+		row = pos ? *pos : ni_ovsdb_row_new(list, uuid);
+		ni_ovsdb_row_update(row, columns);
+	}
+}
+
+static void
+ni_ovsdb_tables_update(ni_json_t *updates)
+{
+	ni_json_t *rows;
+
+	if ((rows = ni_json_object_get_value(updates, "Bridge")))
+		ni_ovsdb_table_update(&ni_ovsdb.bridges, rows);
+	if ((rows = ni_json_object_get_value(updates, "Port")))
+		ni_ovsdb_table_update(&ni_ovsdb.ports, rows);
+}
+
+/*
+ * JSON-RPC messaging
+ */
+void
+ni_ovsdb_disconnect(void)
+{
+	if (ni_ovsdb.fd >= 0)
+		close(ni_ovsdb.fd);
+	ni_ovsdb.fd = -1;
+	ni_buffer_destroy(&ni_ovsdb.rbuf);
+	ni_ovsdb_rows_destroy(&ni_ovsdb.bridges);
+	ni_ovsdb_rows_destroy(&ni_ovsdb.ports);
+}
+
+static ni_bool_t
+ni_ovsdb_send(ni_json_t *msg)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	size_t done = 0;
+	ssize_t len;
+
+	if (!ni_json_format_string(&buf, msg, NULL)) {
+		ni_stringbuf_destroy(&buf);
+		return FALSE;
+	}
+
+	while (done < buf.len) {
+		len = send(ni_ovsdb.fd, buf.string + done, buf.len - done, MSG_NOSIGNAL);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			ni_error("ovsdb: unable to send request: %m");
+			ni_stringbuf_destroy(&buf);
+			return FALSE;
+		}
+		done += len;
+	}
+	ni_stringbuf_destroy(&buf);
+	return TRUE;
+}
+
+/*
+ * The server sends JSON objects back to back, so we need to find
+ * where a message ends, before we can parse it.
+ */
+static size_t
+ni_ovsdb_message_length(const char *data, size_t len)
+{
+	ni_bool_t string = FALSE, escape = FALSE;
+	unsigned int depth = 0;
+	size_t i;
+
+	for (i = 0; i < len; ++i) {
+		if (string) {
+			if (escape)
+				escape = FALSE;
+			else if (data[i] == '\\')
+				escape = TRUE;
+			else if (data[i] == '"')
+				string = FALSE;
+			continue;
+		}
+
+		switch (data[i]) {
+		case '"':
+			string = TRUE;
+			break;
+		case '{':
+		case '[':
+			depth++;
+			break;
+		case '}':
+		case ']':
+			if (depth && --depth == 0)
+				return i + 1;
+			break;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Receive the next message, waiting up to timeout msec for it.
+ * Returns 1 and the message, 0 on timeout or -1 on error.
+ */
+static int
+ni_ovsdb_recv(ni_json_t **msg, int timeout)
+{
+	ni_buffer_t *bp = &ni_ovsdb.rbuf;
+	struct pollfd pfd;
+	ni_buffer_t rd;
+	ssize_t len;
+	size_t mlen;
+
+	*msg = NULL;
+	while (!(mlen = ni_ovsdb_message_length(ni_buffer_head(bp), ni_buffer_count(bp)))) {
+		pfd.fd = ni_ovsdb.fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		len = poll(&pfd, 1, timeout);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			ni_error("ovsdb: poll failed: %m");
+			return -1;
+		}
+		if (len == 0)
+			return 0;
+
+		if (bp->head == bp->tail)
+			ni_buffer_clear(bp);
+		ni_buffer_ensure_tailroom(bp, NI_OVSDB_RECV_CHUNK);
+
+		len = recv(ni_ovsdb.fd, ni_buffer_tail(bp), ni_buffer_tailroom(bp), 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0) {
+			if (len < 0)
+				ni_error("ovsdb: unable to receive: %m");
+			else
+				ni_error("ovsdb: connection closed by server");
+			return -1;
+		}
+		ni_buffer_push_tail(bp, len);
+	}
+
+	ni_buffer_init_reader(&rd, ni_buffer_head(bp), mlen);
+	*msg = ni_json_parse_buffer(&rd);
+	ni_buffer_pull_head(bp, mlen);
+	if (bp->head == bp->tail)
+		ni_buffer_clear(bp);
+
+	if (!ni_json_is_object(*msg)) {
+		ni_error("ovsdb: unable to parse message");
+		ni_json_free(*msg);
+		*msg = NULL;
+		return -1;
+	}
+	return 1;
+}
+
+/*
+ * Handle a notification or a request of the server;
+ * returns FALSE if the message is a reply.
+ */
+static ni_bool_t
+ni_ovsdb_handle_notify(ni_json_t *msg)
+{
+	ni_json_t *method, *params, *reply;
+	char *name = NULL;
+
+	if (!(method = ni_json_object_get_value(msg, "method")))
+		return FALSE;
+
+	ni_json_string_get(method, &name);
+	params = ni_json_object_get_value(msg, "params");
+
+	if (ni_string_eq(name, "update")) {
+		ni_ovsdb_tables_update(ni_json_array_get(params, 1));
+	} else
+	if (ni_string_eq(name, "echo")) {
+		reply = ni_json_new_object();
+		ni_json_object_set(reply, "id", ni_json_object_ref_value(msg, "id"));
+		ni_json_object_set(reply, "result", params ? ni_json_ref(params) : ni_json_new_array());
+		ni_json_object_set(reply, "error", ni_json_new_null());
+		ni_ovsdb_send(reply);
+		ni_json_free(reply);
+	}
+	ni_string_free(&name);
+	return TRUE;
+}
+
+/*
+ * Process the pending update notifications without waiting
+ */
+static ni_bool_t
+ni_ovsdb_process_pending(void)
+{
+	ni_json_t *msg;
+	int ret;
+
+	while ((ret = ni_ovsdb_recv(&msg, 0)) > 0) {
+		ni_ovsdb_handle_notify(msg);
+		ni_json_free(msg);
+	}
+	return ret == 0;
+}
+
+/*
+ * Call a method and wait for its result
+ */
+static ni_json_t *
+ni_ovsdb_call(const char *method, ni_json_t *params)
+{
+	ni_json_t *req, *msg, *result = NULL, *error;
+	int64_t id;
+	int ret;
+
+	req = ni_json_new_object();
+	ni_json_object_set(req, "method", ni_json_new_string(method));
+	ni_json_object_set(req, "params", params);
+	ni_json_object_set(req, "id", ni_json_new_int64(++ni_ovsdb.seqno));
+	if (!ni_ovsdb_send(req)) {
+		ni_json_free(req);
+		goto failure;
+	}
+	ni_json_free(req);
+
+	while ((ret = ni_ovsdb_recv(&msg, NI_OVSDB_CALL_TIMEOUT)) > 0) {
+		if (ni_ovsdb_handle_notify(msg)) {
+			ni_json_free(msg);
+			continue;
+		}
+
+		if (!ni_json_int64_get(ni_json_object_get_value(msg, "id"), &id) ||
+		    id != ni_ovsdb.seqno) {
+			ni_json_free(msg);
+			continue;
+		}
+
+		error = ni_json_object_get_value(msg, "error");
+		if (error && !ni_json_is_null(error)) {
+			ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+			ni_error("ovsdb: %s call failed: %s", method,
+					ni_json_format_string(&buf, error, NULL));
+			ni_stringbuf_destroy(&buf);
+		} else {
+			result = ni_json_object_ref_value(msg, "result");
+		}
+		ni_json_free(msg);
+		return result;
+	}
+
+	if (ret == 0)
+		ni_error("ovsdb: %s call timed out", method);
+failure:
+	/* the connection is out of sync now */
+	ni_ovsdb_disconnect();
+	return NULL;
+}
+
+static ni_bool_t
+ni_ovsdb_monitor(void)
+{
+	ni_json_t *params, *requests, *request, *columns, *result;
+
+	requests = ni_json_new_object();
+
+	request = ni_json_new_object();
+	columns = ni_json_new_array();
+	ni_json_array_append(columns, ni_json_new_string("name"));
+	ni_json_array_append(columns, ni_json_new_string("ports"));
+	ni_json_object_set(request, "columns", columns);
+	ni_json_object_set(requests, "Bridge", request);
+
+	request = ni_json_new_object();
+	columns = ni_json_new_array();
+	ni_json_array_append(columns, ni_json_new_string("name"));
+	ni_json_array_append(columns, ni_json_new_string("interfaces"));
+	ni_json_array_append(columns, ni_json_new_string("tag"));
+	ni_json_array_append(columns, ni_json_new_string("fake_bridge"));
+	ni_json_object_set(request, "columns", columns);
+	ni_json_object_set(requests, "Port", request);
+
+	params = ni_json_new_array();
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_DATABASE));
+	ni_json_array_append(params, ni_json_new_null());
+	ni_json_array_append(params, requests);
+
+	if (!(result = ni_ovsdb_call("monitor", params)))
+		return FALSE;
+
+	ni_ovsdb_tables_update(result);
+	ni_json_free(result);
+	return TRUE;
+}
+
+/*
+ * Use an already connected stream socket to the database server,
+ * e.g. a socketpair to a server run by the caller; takes over the fd.
+ */
+ni_bool_t
+ni_ovsdb_connect_fd(int fd)
+{
+	if (fd < 0)
+		return FALSE;
+
+	ni_ovsdb_disconnect();
+	ni_ovsdb.fd = fd;
+	ni_buffer_init_dynamic(&ni_ovsdb.rbuf, NI_OVSDB_RECV_CHUNK);
+	if (!ni_ovsdb_monitor()) {
+		ni_ovsdb_disconnect();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_ovsdb_connect(void)
+{
+	struct sockaddr_un sun;
+	const char **path;
+	int fd;
+
+	for (path = ni_ovsdb_socket_paths; *path; ++path) {
+		if (!ni_file_exists(*path))
+			continue;
+
+		if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+			return FALSE;
+
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strncpy(sun.sun_path, *path, sizeof(sun.sun_path) - 1);
+		if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+			ni_debug_ifconfig("ovsdb: unable to connect to %s: %m", *path);
+			close(fd);
+			continue;
+		}
+
+		if (!ni_ovsdb_connect_fd(fd))
+			return FALSE;
+		ni_debug_ifconfig("ovsdb: connected to %s", *path);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Connect to the database server when needed and bring the tables
+ * up to date. When the server is not reachable, the callers fall
+ * back to run ovs-vsctl.
+ */
+ni_bool_t
+ni_ovsdb_available(void)
+{
+	if (ni_ovsdb.fd >= 0 && ni_ovsdb_process_pending())
+		return TRUE;
+
+	ni_ovsdb_disconnect();
+	return ni_ovsdb_connect();
+}
+
+/*
+ * Queries, answered from the monitored tables
+ */
+int
+ni_ovsdb_bridge_exists(const char *brname)
+{
+	if (ni_string_empty(brname))
+		return -1;
+
+	if (ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname) ||
+	    ni_ovsdb_fake_bridge_find(brname))
+		return 0;
+	return 1;
+}
+
+int
+ni_ovsdb_bridge_to_vlan(const char *brname, uint16_t *vlan)
+{
+	ni_ovsdb_row_t *port;
+
+	if (ni_string_empty(brname) || !vlan)
+		return -1;
+
+	if (ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname)) {
+		*vlan = 0;
+		return 0;
+	}
+	if ((port = ni_ovsdb_fake_bridge_find(brname)) && port->tag >= 0) {
+		*vlan = port->tag;
+		return 0;
+	}
+
+	ni_error("%s: unable to query bridge vlan: no such bridge", brname);
+	return -1;
+}
+
+int
+ni_ovsdb_bridge_to_parent(const char *brname, char **parent)
+{
+	ni_ovsdb_row_t *port, *br;
+
+	if (ni_string_empty(brname) || !parent)
+		return -1;
+
+	if (ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname))
+		return 0;
+	if ((port = ni_ovsdb_fake_bridge_find(brname)) && (br = ni_ovsdb_port_bridge(port))) {
+		ni_string_dup(parent, br->name);
+		return 0;
+	}
+
+	ni_error("%s: unable to query bridge parent: no such bridge", brname);
+	return -1;
+}
+
+static int
+ni_ovsdb_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+int
+ni_ovsdb_bridge_ports(const char *brname, ni_ovs_bridge_port_array_t *ports)
+{
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t **pos, *port, *br, *fake;
+	unsigned int i;
+	int tag = -1;
+
+	if (ni_string_empty(brname) || !ports)
+		return -1;
+
+	if (!(br = ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname))) {
+		if (!(fake = ni_ovsdb_fake_bridge_find(brname)) ||
+		    !(br = ni_ovsdb_port_bridge(fake))) {
+			ni_error("%s: unable to query bridge ports: no such bridge", brname);
+			return -1;
+		}
+		tag = fake->tag;
+	}
+
+	/* like ovs-vsctl, list the ports of a vlan bridge in the vlan
+	 * bridge only and skip the bridge's own internal port */
+	for (i = 0; i < br->refs.count; ++i) {
+		if (!(pos = ni_ovsdb_row_find_uuid(&ni_ovsdb.ports, br->refs.data[i])))
+			continue;
+		port = *pos;
+
+		if (port->fake_bridge || ni_string_eq(port->name, brname))
+			continue;
+		if (tag >= 0 ? port->tag != tag : !!ni_ovsdb_fake_bridge_by_tag(br, port->tag))
+			continue;
+		ni_string_array_append(&names, port->name);
+	}
+
+	if (names.count)
+		qsort(names.data, names.count, sizeof(names.data[0]), ni_ovsdb_name_cmp);
+	for (i = 0; i < names.count; ++i)
+		ni_ovs_bridge_port_array_add_new(ports, names.data[i]);
+	ni_string_array_destroy(&names);
+	return 0;
+}
+
+int
+ni_ovsdb_port_to_bridge(const char *pname, char **brname)
+{
+	ni_ovsdb_row_t *port, *br, *fake;
+
+	if (ni_string_empty(pname) || !brname)
+		return -1;
+
+	if (!(port = ni_ovsdb_row_find_name(ni_ovsdb.ports, pname)) || port->fake_bridge ||
+	    !(br = ni_ovsdb_port_bridge(port))) {
+		ni_error("%s: unable to query port bridge: no such port", pname);
+		return -1;
+	}
+
+	if ((fake = ni_ovsdb_fake_bridge_by_tag(br, port->tag)))
+		ni_string_dup(brname, fake->name);
+	else
+		ni_string_dup(brname, br->name);
+	return 0;
+}
+
+/*
+ * Transactions
+ */
+ni_ovsdb_txn_t *
+ni_ovsdb_txn_new(void)
+{
+	ni_ovsdb_txn_t *txn;
+
+	txn = xcalloc(1, sizeof(*txn));
+	txn->ops = ni_json_new_array();
+	ni_json_array_append(txn->ops, ni_json_new_string(NI_OVSDB_DATABASE));
+	return txn;
+}
+
+void
+ni_ovsdb_txn_free(ni_ovsdb_txn_t *txn)
+{
+	ni_ovsdb_txn_bridge_t *br;
+
+	if (!txn)
+		return;
+
+	while ((br = txn->bridges)) {
+		txn->bridges = br->next;
+		ni_string_free(&br->name);
+		free(br);
+	}
+	ni_string_array_destroy(&txn->ports);
+	ni_json_free(txn->ops);
+	free(txn);
+}
+
+static const char *
+ni_ovsdb_txn_row_name(ni_ovsdb_txn_t *txn, char *buf, size_t size)
+{
+	snprintf(buf, size, "row%u", ++txn->rows);
+	return buf;
+}
+
+static ni_ovsdb_txn_bridge_t *
+ni_ovsdb_txn_bridge_find(ni_ovsdb_txn_t *txn, const char *name)
+{
+	ni_ovsdb_txn_bridge_t *br;
+
+	for (br = txn->bridges; br; br = br->next) {
+		if (ni_string_eq(br->name, name))
+			return br;
+	}
+	return NULL;
+}
+
+static ni_json_t *
+ni_ovsdb_txn_op(ni_ovsdb_txn_t *txn, const char *op, const char *table)
+{
+	ni_json_t *obj = ni_json_new_object();
+
+	ni_json_object_set(obj, "op", ni_json_new_string(op));
+	ni_json_object_set(obj, "table", ni_json_new_string(table));
+	ni_json_array_append(txn->ops, obj);
+	return obj;
+}
+
+static void
+ni_ovsdb_txn_delete(ni_ovsdb_txn_t *txn, const char *table, const char *uuid)
+{
+	ni_json_t *op;
+
+	op = ni_ovsdb_txn_op(txn, "delete", table);
+	ni_json_object_set(op, "where", ni_ovsdb_json_new_where_uuid(uuid));
+}
+
+/*
+ * Mutate a set column: insert or delete the uuids of kind in the row
+ * with the given uuid or in all rows of the table.
+ */
+static void
+ni_ovsdb_txn_mutate(ni_ovsdb_txn_t *txn, const char *table, const char *uuid,
+		const char *column, const char *mutator, const char *kind,
+		const ni_string_array_t *uuids)
+{
+	ni_json_t *op, *mutations, *mutation, *set, *elements;
+	unsigned int i;
+
+	op = ni_ovsdb_txn_op(txn, "mutate", table);
+	ni_json_object_set(op, "where", uuid ? ni_ovsdb_json_new_where_uuid(uuid)
+					     : ni_json_new_array());
+
+	set = ni_ovsdb_json_new_set(&elements);
+	for (i = 0; i < uuids->count; ++i)
+		ni_json_array_append(elements, ni_ovsdb_json_new_uuid(kind, uuids->data[i]));
+
+	mutation = ni_json_new_array();
+	ni_json_array_append(mutation, ni_json_new_string(column));
+	ni_json_array_append(mutation, ni_json_new_string(mutator));
+	ni_json_array_append(mutation, set);
+
+	mutations = ni_json_new_array();
+	ni_json_array_append(mutations, mutation);
+	ni_json_object_set(op, "mutations", mutations);
+}
+
+/*
+ * Insert an interface and its port; returns the port's uuid-name
+ */
+static const char *
+ni_ovsdb_txn_insert_port(ni_ovsdb_txn_t *txn, const char *name, const char *type,
+		int tag, ni_bool_t fake_bridge, char *buf, size_t size)
+{
+	ni_json_t *op, *row, *set, *elements;
+	char iface[32];
+
+	op = ni_ovsdb_txn_op(txn, "insert", "Interface");
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(name));
+	if (type)
+		ni_json_object_set(row, "type", ni_json_new_string(type));
+	ni_json_object_set(op, "row", row);
+	ni_json_object_set(op, "uuid-name", ni_json_new_string(
+				ni_ovsdb_txn_row_name(txn, iface, sizeof(iface))));
+
+	op = ni_ovsdb_txn_op(txn, "insert", "Port");
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(name));
+	set = ni_ovsdb_json_new_set(&elements);
+	ni_json_array_append(elements, ni_ovsdb_json_new_uuid("named-uuid", iface));
+	ni_json_object_set(row, "interfaces", set);
+	if (tag >= 0)
+		ni_json_object_set(row, "tag", ni_json_new_int64(tag));
+	if (fake_bridge)
+		ni_json_object_set(row, "fake_bridge", ni_json_new_bool(TRUE));
+	ni_json_object_set(op, "row", row);
+	ni_json_object_set(op, "uuid-name", ni_json_new_string(
+				ni_ovsdb_txn_row_name(txn, buf, size)));
+
+	ni_string_array_append(&txn->ports, name);
+	return buf;
+}
+
+/*
+ * Add the port (uuid-name) to the bridge or vlan bridge brname
+ */
+static ni_bool_t
+ni_ovsdb_txn_attach_port(ni_ovsdb_txn_t *txn, const char *brname, const char *port)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_txn_bridge_t *tbr;
+	ni_ovsdb_row_t *br;
+
+	if ((tbr = ni_ovsdb_txn_bridge_find(txn, brname))) {
+		ni_json_array_append(tbr->ports, ni_ovsdb_json_new_uuid("named-uuid", port));
+		return TRUE;
+	}
+
+	if (!(br = ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname)))
+		return FALSE;
+
+	ni_string_array_append(&uuids, port);
+	ni_ovsdb_txn_mutate(txn, "Bridge", br->uuid, "ports", "insert", "named-uuid", &uuids);
+	ni_string_array_destroy(&uuids);
+	return TRUE;
+}
+
+/*
+ * Delete the ports and their interfaces, detaching them from bridge br
+ */
+static void
+ni_ovsdb_txn_delete_ports(ni_ovsdb_txn_t *txn, const ni_ovsdb_row_t *br,
+		const ni_string_array_t *uuids)
+{
+	ni_ovsdb_row_t **pos;
+	unsigned int i, j;
+
+	if (br)
+		ni_ovsdb_txn_mutate(txn, "Bridge", br->uuid, "ports", "delete", "uuid", uuids);
+
+	for (i = 0; i < uuids->count; ++i) {
+		if ((pos = ni_ovsdb_row_find_uuid(&ni_ovsdb.ports, uuids->data[i]))) {
+			for (j = 0; j < (*pos)->refs.count; ++j)
+				ni_ovsdb_txn_delete(txn, "Interface", (*pos)->refs.data[j]);
+		}
+		ni_ovsdb_txn_delete(txn, "Port", uuids->data[i]);
+	}
+}
+
+ni_bool_t
+ni_ovsdb_txn_bridge_add(ni_ovsdb_txn_t *txn, const char *brname,
+		const char *parent, uint16_t tag, ni_bool_t may_exist)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_txn_bridge_t *tbr;
+	ni_json_t *op, *row;
+	char port[32], bridge[32];
+
+	if (!txn || ni_string_empty(brname))
+		return FALSE;
+
+	if (ni_ovsdb_bridge_exists(brname) == 0 || ni_ovsdb_txn_bridge_find(txn, brname)) {
+		if (may_exist)
+			return TRUE;
+		ni_error("%s: ovs bridge already exists", brname);
+		return FALSE;
+	}
+
+	if (!ni_string_empty(parent)) {
+		if (!ni_ovsdb_row_find_name(ni_ovsdb.bridges, parent) &&
+		    !ni_ovsdb_txn_bridge_find(txn, parent)) {
+			ni_error("%s: ovs parent bridge %s does not exist", brname, parent);
+			return FALSE;
+		}
+		ni_ovsdb_txn_insert_port(txn, brname, "internal", tag, TRUE, port, sizeof(port));
+		return ni_ovsdb_txn_attach_port(txn, parent, port);
+	}
+
+	ni_ovsdb_txn_insert_port(txn, brname, "internal", -1, FALSE, port, sizeof(port));
+
+	tbr = xcalloc(1, sizeof(*tbr));
+	ni_string_dup(&tbr->name, brname);
+
+	op = ni_ovsdb_txn_op(txn, "insert", "Bridge");
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(brname));
+	ni_json_object_set(row, "ports", ni_ovsdb_json_new_set(&tbr->ports));
+	ni_json_array_append(tbr->ports, ni_ovsdb_json_new_uuid("named-uuid", port));
+	ni_json_object_set(op, "row", row);
+	ni_json_object_set(op, "uuid-name", ni_json_new_string(
+				ni_ovsdb_txn_row_name(txn, bridge, sizeof(bridge))));
+
+	tbr->next = txn->bridges;
+	txn->bridges = tbr;
+
+	ni_string_array_append(&uuids, bridge);
+	ni_ovsdb_txn_mutate(txn, NI_OVSDB_DATABASE, NULL, "bridges", "insert", "named-uuid", &uuids);
+	ni_string_array_destroy(&uuids);
+	return TRUE;
+}
+
+ni_bool_t
+ni_ovsdb_txn_bridge_del(ni_ovsdb_txn_t *txn, const char *brname)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t **pos, *br, *fake;
+	unsigned int i;
+
+	if (!txn || ni_string_empty(brname))
+		return FALSE;
+
+	if ((br = ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname))) {
+		ni_ovsdb_txn_delete_ports(txn, NULL, &br->refs);
+		ni_ovsdb_txn_delete(txn, "Bridge", br->uuid);
+
+		ni_string_array_append(&uuids, br->uuid);
+		ni_ovsdb_txn_mutate(txn, NI_OVSDB_DATABASE, NULL, "bridges", "delete", "uuid", &uuids);
+		ni_string_array_destroy(&uuids);
+		return TRUE;
+	}
+
+	if ((fake = ni_ovsdb_fake_bridge_find(brname)) && (br = ni_ovsdb_port_bridge(fake))) {
+		/* a vlan bridge goes away with all its ports */
+		for (i = 0; i < br->refs.count; ++i) {
+			pos = ni_ovsdb_row_find_uuid(&ni_ovsdb.ports, br->refs.data[i]);
+			if (pos && (*pos)->tag == fake->tag)
+				ni_string_array_append(&uuids, (*pos)->uuid);
+		}
+		ni_ovsdb_txn_delete_ports(txn, br, &uuids);
+		ni_string_array_destroy(&uuids);
+		return TRUE;
+	}
+
+	ni_error("%s: no ovs bridge with this name", brname);
+	return FALSE;
+}
+
+ni_bool_t
+ni_ovsdb_txn_port_add(ni_ovsdb_txn_t *txn, const char *brname, const char *pname,
+		ni_bool_t may_exist)
+{
+	ni_ovsdb_row_t *br, *fake = NULL;
+	char *current = NULL;
+	char port[32];
+
+	if (!txn || ni_string_empty(brname) || ni_string_empty(pname))
+		return FALSE;
+
+	if (ni_ovsdb_row_find_name(ni_ovsdb.ports, pname) ||
+	    ni_string_array_index(&txn->ports, pname) >= 0) {
+		if (may_exist && ni_ovsdb_port_to_bridge(pname, &current) == 0 &&
+		    ni_string_eq(current, brname)) {
+			ni_string_free(&current);
+			return TRUE;
+		}
+		ni_error("%s: ovs port already exists%s%s", pname,
+				current ? " on bridge " : "", current ? current : "");
+		ni_string_free(&current);
+		return FALSE;
+	}
+
+	if (!ni_ovsdb_txn_bridge_find(txn, brname) &&
+	    !ni_ovsdb_row_find_name(ni_ovsdb.bridges, brname) &&
+	    (!(fake = ni_ovsdb_fake_bridge_find(brname)) || !(br = ni_ovsdb_port_bridge(fake)))) {
+		ni_error("%s: ovs bridge %s does not exist", pname, brname);
+		return FALSE;
+	}
+
+	ni_ovsdb_txn_insert_port(txn, pname, NULL, fake ? fake->tag : -1, FALSE, port, sizeof(port));
+	return ni_ovsdb_txn_attach_port(txn, fake ? br->name : brname, port);
+}
+
+ni_bool_t
+ni_ovsdb_txn_port_del(ni_ovsdb_txn_t *txn, const char *brname, const char *pname)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t *port, *br;
+	char *current = NULL;
+
+	if (!txn || ni_string_empty(brname) || ni_string_empty(pname))
+		return FALSE;
+
+	if (!(port = ni_ovsdb_row_find_name(ni_ovsdb.ports, pname)) ||
+	    ni_ovsdb_port_to_bridge(pname, &current) != 0 || !ni_string_eq(current, brname) ||
+	    !(br = ni_ovsdb_port_bridge(port))) {
+		ni_error("%s: no ovs port with this name in bridge %s", pname, brname);
+		ni_string_free(&current);
+		return FALSE;
+	}
+	ni_string_free(&current);
+
+	ni_string_array_append(&uuids, port->uuid);
+	ni_ovsdb_txn_delete_ports(txn, br, &uuids);
+	ni_string_array_destroy(&uuids);
+	return TRUE;
+}
+
+/*
+ * Commit the transaction in a single request
+ */
+int
+ni_ovsdb_txn_commit(ni_ovsdb_txn_t *txn)
+{
+	ni_json_t *result, *error;
+	unsigned int i;
+	int ret = 0;
+
+	if (!txn)
+		return -1;
+
+	/* nothing to do, e.g. a bridge or port that may exist exists */
+	if (ni_json_array_entries(txn->ops) <= 1)
+		return 0;
+
+	if (ni_ovsdb.fd < 0)
+		return -1;
+
+	if (!(result = ni_ovsdb_call("transact", ni_json_ref(txn->ops))))
+		return -1;
+
+	for (i = 0; i < ni_json_array_entries(result); ++i) {
+		error = ni_json_object_get_value(ni_json_array_get(result, i), "error");
+		if (error && !ni_json_is_null(error)) {
+			ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+			ni_json_format_string(&buf, ni_json_array_get(result, i), NULL);
+			ni_error("ovsdb: transaction failed: %s", buf.string);
+			ni_stringbuf_destroy(&buf);
+			ret = -1;
+			break;
+		}
+	}
+	ni_json_free(result);
+
+	/* the server sent the updates of the commit before the echo reply */
+	if (ret == 0 && (result = ni_ovsdb_call("echo", ni_json_new_array())))
+		ni_json_free(result);
+	return ret;
+}
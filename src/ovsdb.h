@@ -0,0 +1,48 @@
+/*
+ *	OVSDB JSON-RPC client for OVS bridge support
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifndef NI_WICKED_OVSDB_H
+#define NI_WICKED_OVSDB_H
+
+#include <wicked/types.h>
+#include <wicked/ovs.h>
+
+typedef struct ni_ovsdb_txn	ni_ovsdb_txn_t;
+
+extern ni_bool_t		ni_ovsdb_available(void);
+extern ni_bool_t		ni_ovsdb_connect_fd(int);
+extern void			ni_ovsdb_disconnect(void);
+
+extern int			ni_ovsdb_bridge_exists(const char *);
+extern int			ni_ovsdb_bridge_to_vlan(const char *, uint16_t *);
+extern int			ni_ovsdb_bridge_to_parent(const char *, char **);
+extern int			ni_ovsdb_bridge_ports(const char *, ni_ovs_bridge_port_array_t *);
+extern int			ni_ovsdb_port_to_bridge(const char *, char **);
+
+extern ni_ovsdb_txn_t *		ni_ovsdb_txn_new(void);
+extern void			ni_ovsdb_txn_free(ni_ovsdb_txn_t *);
+extern ni_bool_t		ni_ovsdb_txn_bridge_add(ni_ovsdb_txn_t *, const char *,
+						const char *, uint16_t, ni_bool_t);
+extern ni_bool_t		ni_ovsdb_txn_bridge_del(ni_ovsdb_txn_t *, const char *);
+extern ni_bool_t		ni_ovsdb_txn_port_add(ni_ovsdb_txn_t *, const char *,
+						const char *, ni_bool_t);
+extern ni_bool_t		ni_ovsdb_txn_port_del(ni_ovsdb_txn_t *, const char *,
+						const char *);
+extern int			ni_ovsdb_txn_commit(ni_ovsdb_txn_t *);
+
+#endif /* NI_WICKED_OVSDB_H */
@@ -577,9 +577,9 @@ ni_process_reap(ni_process_t *pi)
 
 	rv = waitpid(pi->pid, &pi->status, WNOHANG);
 	if (rv == 0) {
-		/* This is an ugly workaround. Sometimes, we seem to get a hangup on the socket even
-		 * though the script (provably) still has its end of the socket pair open for writing. */
-		ni_error("%s: process %u has not exited yet; now doing a blocking waitpid()",
+		/* The hangup on the socket is seen when the child closes its end of
+		 * the socket pair, which happens in exit() just before it terminates. */
+		ni_debug_extension("%s: process %u has not exited yet; now doing a blocking waitpid()",
 				__func__, pi->pid);
 		rv = waitpid(pi->pid, &pi->status, 0);
 	}
@@ -603,15 +603,12 @@ ni_process_reap(ni_process_t *pi)
 /*
  * Connect the subprocess output to our I/O handling loop
  */
-static void
-__ni_process_output_recv(ni_socket_t *sock)
+static int
+__ni_process_output_read(ni_socket_t *sock)
 {
-	ni_process_t *pi = sock->user_data;
 	ni_buffer_t *rbuf = &sock->rbuf;
 	int cnt;
 
-	ni_assert(pi);
-
 	/* Grow socket input buffer as needed.
 	 * NB: we may put an upper limit on how much process output we capture.
 	 * Anything beyond a few MB is insane...
@@ -626,6 +623,15 @@ __ni_process_output_recv(ni_socket_t *sock)
 		ni_error("read error on subprocess pipe: %m");
 		ni_socket_deactivate(sock);
 	}
+	return cnt;
+}
+
+static void
+__ni_process_output_recv(ni_socket_t *sock)
+{
+	ni_assert(sock->user_data);
+
+	__ni_process_output_read(sock);
 }
 
 static void
@@ -634,6 +640,10 @@ __ni_process_output_hangup(ni_socket_t *sock)
 	ni_process_t *pi = sock->user_data;
 
 	if (pi && pi->socket == sock) {
+		/* the receive callback reads only once per wakeup,
+		 * fetch the rest of the output the child has sent */
+		while (__ni_process_output_read(sock) > 0)
+			;
 		if (ni_process_reap(pi) < 0)
 			ni_error("pipe closed by child process, but child did not exit");
 		ni_socket_close(pi->socket);
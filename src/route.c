@@ -35,6 +35,7 @@
 #include <wicked/logging.h>
 #include <wicked/netinfo.h>
 #include <wicked/route.h>
+#include "netinfo_priv.h"
 #include "util_priv.h"
 #include "debug.h"
 
@@ -154,12 +155,23 @@ static const ni_intmap_t	ni_route_mxlock_bits[] = {
 /*
  * ni_route functions
  */
+static ni_objpool_t		ni_route_pool = NI_OBJPOOL_INIT("route", ni_route_t, 1024);
+static ni_objpool_t		ni_route_nexthop_pool = NI_OBJPOOL_INIT("route nexthop",
+							ni_route_nexthop_t, 1024);
+
+void
+ni_route_pool_trace(void)
+{
+	ni_objpool_trace(&ni_route_pool);
+	ni_objpool_trace(&ni_route_nexthop_pool);
+}
+
 ni_route_t *
 ni_route_new(void)
 {
 	ni_route_t *rp;
 
-	rp = xcalloc(1, sizeof(ni_route_t));
+	rp = ni_objpool_alloc(&ni_route_pool);
 	if (rp)
 		rp->users = 1;
 	return rp;
@@ -314,7 +326,7 @@ do_route_free(ni_route_t *rp)
 	ni_route_nexthop_list_destroy(&rp->nh.next);
 	ni_route_nexthop_destroy(&rp->nh);
 
-	free(rp);
+	ni_objpool_free(&ni_route_pool, rp);
 }
 
 void
@@ -1284,7 +1296,7 @@ ni_route_via_gateway(const ni_route_t *rp)
 ni_route_nexthop_t *
 ni_route_nexthop_new(void)
 {
-	return xcalloc(1, sizeof(ni_route_nexthop_t));
+	return ni_objpool_alloc(&ni_route_nexthop_pool);
 }
 
 void
@@ -1301,7 +1313,7 @@ ni_route_nexthop_free(ni_route_nexthop_t *hop)
 {
 	if (hop) {
 		ni_route_nexthop_destroy(hop);
-		free(hop);
+		ni_objpool_free(&ni_route_nexthop_pool, hop);
 	}
 }
 
@@ -1699,6 +1711,209 @@ ni_route_array_sort_rev(ni_route_array_t *nra)
 }
 
 
+/*
+ * ni_route_index functions
+ */
+#define NI_ROUTE_INDEX_MIN	16U	/* routes needed to build an index */
+
+static char			ni_route_index_deleted;
+#define NI_ROUTE_INDEX_DELETED	((ni_route_t *)&ni_route_index_deleted)
+
+static unsigned int
+ni_route_index_hash(const ni_route_t *rp)
+{
+	struct {
+		unsigned int	family;
+		unsigned int	prefixlen;
+		unsigned char	addr[16];
+	} key;
+
+	/* must not hash more than ni_route_equal_destination compares */
+	memset(&key, 0, sizeof(key));
+	key.family = rp->family;
+	key.prefixlen = rp->prefixlen;
+	if (rp->prefixlen) {
+		switch (rp->destination.ss_family) {
+		case AF_INET:
+			memcpy(key.addr, &rp->destination.sin.sin_addr, 4);
+			break;
+		case AF_INET6:
+			memcpy(key.addr, &rp->destination.six.sin6_addr, 16);
+			break;
+		default:
+			break;
+		}
+	}
+	return ni_hash_bytes(&key, sizeof(key));
+}
+
+static inline ni_bool_t
+ni_route_index_usable(const ni_route_index_t *idx,
+		ni_bool_t (*match)(const ni_route_t *, const ni_route_t *))
+{
+	/* only matches implying an equal destination can use the index */
+	return idx->size && (match == ni_route_equal ||
+			match == ni_route_equal_destination ||
+			match == ni_route_equal_ref);
+}
+
+static void
+ni_route_index_destroy(ni_route_index_t *idx)
+{
+	free(idx->slot);
+	memset(idx, 0, sizeof(*idx));
+}
+
+static void
+ni_route_index_insert(ni_route_index_t *idx, ni_route_t *rp)
+{
+	unsigned int mask = idx->size - 1;
+	unsigned int pos;
+
+	for (pos = ni_route_index_hash(rp) & mask; idx->slot[pos].route; pos = (pos + 1) & mask) {
+		if (idx->slot[pos].route == NI_ROUTE_INDEX_DELETED) {
+			idx->used--;
+			break;
+		}
+	}
+	idx->slot[pos].route = rp;
+	idx->slot[pos].seq = idx->seq++;
+	idx->count++;
+	idx->used++;
+}
+
+static ni_bool_t
+ni_route_index_rehash(ni_route_index_t *idx, const ni_route_array_t *routes)
+{
+	ni_route_index_t tmp;
+	unsigned int i;
+	ni_route_t *rp;
+
+	memset(&tmp, 0, sizeof(tmp));
+	for (tmp.size = NI_ROUTE_INDEX_MIN * 2; tmp.size < routes->count * 2; )
+		tmp.size <<= 1;
+
+	if (!(tmp.slot = calloc(tmp.size, sizeof(ni_route_index_slot_t))))
+		return FALSE;
+
+	for (i = 0; i < routes->count; ++i) {
+		if ((rp = routes->data[i]))
+			ni_route_index_insert(&tmp, rp);
+	}
+
+	free(idx->slot);
+	*idx = tmp;
+	return TRUE;
+}
+
+static void
+ni_route_index_add(ni_route_index_t *idx, const ni_route_array_t *routes, ni_route_t *rp)
+{
+	/*
+	 * routes is the table array already containing rp; when the
+	 * index has to be (re)built from it, rp is inserted as well.
+	 * A failure to grow just leaves the table unindexed.
+	 */
+	if (idx->size && (idx->used + 1) * 4 <= idx->size * 3) {
+		ni_route_index_insert(idx, rp);
+		return;
+	}
+
+	if (routes->count < NI_ROUTE_INDEX_MIN || !ni_route_index_rehash(idx, routes))
+		ni_route_index_destroy(idx);
+}
+
+static ni_bool_t
+ni_route_index_del(ni_route_index_t *idx, const ni_route_t *rp)
+{
+	unsigned int mask = idx->size - 1;
+	unsigned int pos;
+	ni_route_t *r;
+
+	if (!idx->size)
+		return FALSE;
+
+	for (pos = ni_route_index_hash(rp) & mask; (r = idx->slot[pos].route); pos = (pos + 1) & mask) {
+		if (r == rp) {
+			idx->slot[pos].route = NI_ROUTE_INDEX_DELETED;
+			idx->count--;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * The probe order of the hits is arbitrary; return them in the
+ * order of the table array as ni_route_array_find_match(es) do.
+ */
+static ni_route_t *
+ni_route_index_find_match(const ni_route_index_t *idx, const ni_route_t *rp,
+		ni_bool_t (*match)(const ni_route_t *, const ni_route_t *))
+{
+	const ni_route_index_slot_t *first = NULL;
+	unsigned int mask = idx->size - 1;
+	unsigned int pos;
+	ni_route_t *r;
+
+	for (pos = ni_route_index_hash(rp) & mask; (r = idx->slot[pos].route); pos = (pos + 1) & mask) {
+		if (r == NI_ROUTE_INDEX_DELETED || !match(r, rp))
+			continue;
+
+		if (!first || idx->slot[pos].seq < first->seq)
+			first = &idx->slot[pos];
+	}
+	return first ? first->route : NULL;
+}
+
+static int
+ni_route_index_slot_cmp(const void *_s1, const void *_s2)
+{
+	const ni_route_index_slot_t *s1 = *(const ni_route_index_slot_t **)_s1;
+	const ni_route_index_slot_t *s2 = *(const ni_route_index_slot_t **)_s2;
+
+	return (s1->seq > s2->seq) - (s1->seq < s2->seq);
+}
+
+static unsigned int
+ni_route_index_find_matches(const ni_route_index_t *idx, const ni_route_t *rp,
+		ni_bool_t (*match)(const ni_route_t *, const ni_route_t *),
+		ni_route_array_t *matches)
+{
+	const ni_route_index_slot_t *buf[NI_ROUTE_INDEX_MIN], **hits = buf;
+	unsigned int mask = idx->size - 1;
+	unsigned int count = matches->count;
+	unsigned int pos, nhits = 0, i;
+	ni_route_t *r;
+
+	for (pos = ni_route_index_hash(rp) & mask; (r = idx->slot[pos].route); pos = (pos + 1) & mask) {
+		if (r == NI_ROUTE_INDEX_DELETED || !match(r, rp))
+			continue;
+
+		if (nhits == NI_ROUTE_INDEX_MIN && hits == buf) {
+			/* the slots cannot hold more than idx->count hits */
+			hits = xcalloc(idx->count, sizeof(hits[0]));
+			memcpy(hits, buf, sizeof(buf));
+		}
+		hits[nhits++] = &idx->slot[pos];
+	}
+
+	if (nhits > 1)
+		qsort(hits, nhits, sizeof(hits[0]), ni_route_index_slot_cmp);
+
+	for (i = 0; i < nhits; ++i) {
+		r = hits[i]->route;
+
+		/* do not add same route (another ref) multiple times */
+		if (!ni_route_array_find_match(matches, r, ni_route_equal_ref))
+			ni_route_array_append(matches, ni_route_ref(r));
+	}
+
+	if (hits != buf)
+		free(hits);
+	return matches->count - count;
+}
+
 /*
  * ni_route_table functions
  */
@@ -1734,21 +1949,89 @@ void
 ni_route_table_clear(ni_route_table_t *tab)
 {
 	if (tab) {
+		ni_route_index_destroy(&tab->index);
 		ni_route_array_destroy(&tab->routes);
 	}
 }
 
+ni_bool_t
+ni_route_table_add_route(ni_route_table_t *tab, ni_route_t *rp)
+{
+	if (!tab || !ni_route_array_append(&tab->routes, rp))
+		return FALSE;
+
+	ni_route_index_add(&tab->index, &tab->routes, rp);
+	return TRUE;
+}
+
+ni_bool_t
+ni_route_table_del_route(ni_route_table_t *tab, ni_route_t *rp)
+{
+	if (!tab || !rp)
+		return FALSE;
+
+	/* an indexed table knows without a scan whether it has rp */
+	if (tab->index.size && !ni_route_index_del(&tab->index, rp))
+		return FALSE;
+
+	return ni_route_array_delete_ref(&tab->routes, rp);
+}
+
+ni_route_t *
+ni_route_table_find_match(ni_route_table_t *tab, const ni_route_t *rp,
+		ni_bool_t (*match)(const ni_route_t *, const ni_route_t *))
+{
+	if (!tab || !rp || !match)
+		return NULL;
+
+	if (ni_route_index_usable(&tab->index, match))
+		return ni_route_index_find_match(&tab->index, rp, match);
+
+	return ni_route_array_find_match(&tab->routes, rp, match);
+}
+
+/*
+ * Remove all routes not carrying the given refresh sequence number
+ * in a single pass and hand over their references to the removed
+ * array; the caller releases them once the other devices in their
+ * nexthops are done with them.
+ */
+unsigned int
+ni_route_table_remove_by_seq(ni_route_table_t *tab, unsigned int seq,
+		ni_route_array_t *removed)
+{
+	unsigned int i, j, count;
+	ni_route_t *rp;
+
+	if (!tab || !removed)
+		return 0;
+
+	count = removed->count;
+	for (i = j = 0; i < tab->routes.count; ++i) {
+		rp = tab->routes.data[i];
+		if (rp && rp->seq != seq && ni_route_array_append(removed, rp)) {
+			ni_route_index_del(&tab->index, rp);
+			continue;
+		}
+		tab->routes.data[j++] = rp;
+	}
+	for (i = j; i < tab->routes.count; ++i)
+		tab->routes.data[i] = NULL;
+	tab->routes.count = j;
+
+	return removed->count - count;
+}
+
 /*
  * ni_route_tables list functions
  */
 ni_bool_t
 ni_route_tables_add_route(ni_route_table_t **list, ni_route_t *rp)
 {
-	ni_route_table_t *tab;
+	if (!rp)
+		return FALSE;
 
-	if (rp && (tab = ni_route_tables_get(list, rp->table)))
-		return ni_route_array_append(&tab->routes, rp);
-	return FALSE;
+	return ni_route_table_add_route(ni_route_tables_get(list, rp->table), rp);
 }
 
 ni_bool_t
@@ -1770,23 +2053,20 @@ ni_route_tables_add_routes(ni_route_table_t **list, ni_route_array_t *routes)
 ni_bool_t
 ni_route_tables_del_route(ni_route_table_t *list, ni_route_t *rp)
 {
-	ni_route_table_t *tab;
-
-	if (!rp || !(tab = ni_route_tables_find(list, rp->table)))
+	if (!rp)
 		return FALSE;
 
-	return ni_route_array_delete_ref(&tab->routes, rp);
+	return ni_route_table_del_route(ni_route_tables_find(list, rp->table), rp);
 }
 
 ni_route_t *
 ni_route_tables_find_match(ni_route_table_t *list, const ni_route_t *rp,
 		ni_bool_t (*match)(const ni_route_t *, const ni_route_t *))
 {
-	ni_route_table_t *tab;
-
-	if (!rp || !(tab = ni_route_tables_find(list, rp->table)))
+	if (!rp)
 		return NULL;
-	return ni_route_array_find_match(&tab->routes, rp, match);
+
+	return ni_route_table_find_match(ni_route_tables_find(list, rp->table), rp, match);
 }
 
 unsigned int
@@ -1796,9 +2076,12 @@ ni_route_tables_find_matches(ni_route_table_t *list, const ni_route_t *rp,
 {
 	ni_route_table_t *tab;
 
-	if (!rp || !(tab = ni_route_tables_find(list, rp->table)))
+	if (!rp || !match || !matches || !(tab = ni_route_tables_find(list, rp->table)))
 		return 0;
 
+	if (ni_route_index_usable(&tab->index, match))
+		return ni_route_index_find_matches(&tab->index, rp, match, matches);
+
 	return ni_route_array_find_matches(&tab->routes, rp, match, matches);
 }
 
@@ -11,6 +11,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/un.h>
 #include <signal.h>
 #include <string.h>
@@ -29,12 +30,15 @@
 #include "appconfig.h"
 
 #define	NI_SOCKET_ARRAY_CHUNK	16
+#define	NI_SOCKET_EPOLL_EVENTS	64
 
 static void			__ni_socket_close(ni_socket_t *);
 static void			__ni_default_error_handler(ni_socket_t *);
 static void			__ni_default_hangup_handler(ni_socket_t *);
+static ni_bool_t		__ni_socket_array_watch(ni_socket_array_t *, ni_socket_t *);
+static void			__ni_socket_array_unwatch(ni_socket_array_t *, ni_socket_t *);
 
-static ni_socket_array_t	__ni_sockets;
+static ni_socket_array_t	__ni_sockets = NI_SOCKET_ARRAY_INIT;
 
 
 /*
@@ -46,14 +50,25 @@ ni_socket_activate(ni_socket_t *sock)
 	return ni_socket_array_activate(&__ni_sockets, sock);
 }
 
-static inline void
-__ni_socket_deactivate(ni_socket_t **slot)
+/*
+ * Deactivate a socket while the array is processed; the array
+ * slot is cleared and reclaimed by ni_socket_array_cleanup.
+ */
+static void
+__ni_socket_deactivate(ni_socket_array_t *array, ni_socket_t *sock)
 {
-	ni_socket_t *sock = *slot;
+	unsigned int i;
 
-	*slot = NULL;
-	sock->active = NULL;
-	ni_socket_release(sock);
+	for (i = 0; i < array->count; ++i) {
+		if (sock != array->data[i])
+			continue;
+
+		array->data[i] = NULL;
+		__ni_socket_array_unwatch(array, sock);
+		sock->active = NULL;
+		ni_socket_release(sock);
+		return;
+	}
 }
 
 ni_bool_t
@@ -111,37 +126,28 @@ __ni_default_hangup_handler(ni_socket_t *sock)
 
 
 /*
- * Wait for incoming data on any of the sockets.
+ * Compute the poll timeout from the socket timeouts
  */
-int
-ni_socket_array_wait(ni_socket_array_t *array, long timeout)
+static long
+__ni_socket_array_get_timeout(ni_socket_array_t *array, ni_socket_t **data,
+				unsigned int count, long timeout)
 {
-	struct pollfd pfd[array->count];
 	struct timeval now, expires;
-	unsigned int i, socket_count;
-
-	/* First step - cleanup empty socket slots from the array. */
-	ni_socket_array_cleanup(array);
+	unsigned int i;
 
-	/* Second step - build pollfd array and get timeouts */
 	timerclear(&expires);
-	socket_count = 0;
-	for (i = 0; i < array->count; ++i) {
-		ni_socket_t *sock = array->data[i];
+	for (i = 0; i < count; ++i) {
+		ni_socket_t *sock = data[i];
 		struct timeval socket_expires;
 
-		if (sock->active != array)
+		if (!sock || sock->active != array || !sock->get_timeout)
 			continue;
 
 		timerclear(&socket_expires);
-		if (sock->get_timeout && sock->get_timeout(sock, &socket_expires) == 0) {
+		if (sock->get_timeout(sock, &socket_expires) == 0) {
 			if (!timerisset(&expires) || timercmp(&socket_expires, &expires, <))
 				expires = socket_expires;
 		}
-
-		pfd[socket_count].fd = sock->__fd;
-		pfd[socket_count].events = sock->poll_flags;
-		socket_count++;
 	}
 
 	gettimeofday(&now, NULL);
@@ -158,6 +164,92 @@ ni_socket_array_wait(ni_socket_array_t *array, long timeout)
 				timeout = delta_ms;
 		}
 	}
+	return timeout;
+}
+
+static void
+__ni_socket_array_check_timeout(ni_socket_array_t *array, ni_socket_t **data,
+				unsigned int count)
+{
+	struct timeval now;
+	unsigned int i;
+
+	gettimeofday(&now, NULL);
+	for (i = 0; i < count; ++i) {
+		ni_socket_t *sock = data[i];
+
+		if (!sock || sock->active != array)
+			continue;
+
+		if (sock->check_timeout)
+			sock->check_timeout(sock, &now);
+	}
+}
+
+/*
+ * Process the poll events reported for a socket
+ */
+static void
+__ni_socket_array_dispatch(ni_socket_array_t *array, ni_socket_t *sock, int revents)
+{
+	if (revents & POLLERR) {
+		/* Deactivate socket */
+		__ni_socket_deactivate(array, sock);
+		sock->handle_error(sock);
+		return;
+	}
+
+	if (revents & POLLIN) {
+		if (sock->receive == NULL) {
+			ni_error("socket %d has no receive callback", sock->__fd);
+			__ni_socket_deactivate(array, sock);
+		} else {
+			sock->receive(sock);
+		}
+		if (sock->__fd < 0)
+			return;
+	}
+
+	if (revents & POLLHUP) {
+		if (sock->handle_hangup)
+			sock->handle_hangup(sock);
+		if (sock->__fd < 0)
+			return;
+	} else
+
+	if (revents & POLLOUT) {
+		if (sock->transmit == NULL) {
+			ni_error("socket %d has no transmit callback", sock->__fd);
+			__ni_socket_deactivate(array, sock);
+		} else {
+			sock->transmit(sock);
+		}
+	}
+}
+
+/*
+ * Wait for incoming data using poll; the pollfd array is rebuilt
+ * from all active sockets in each call.
+ */
+static int
+__ni_socket_array_poll_wait(ni_socket_array_t *array, long timeout)
+{
+	struct pollfd pfd[array->count];
+	unsigned int i, socket_count;
+
+	/* Build pollfd array and get timeouts */
+	socket_count = 0;
+	for (i = 0; i < array->count; ++i) {
+		ni_socket_t *sock = array->data[i];
+
+		if (sock->active != array)
+			continue;
+
+		pfd[socket_count].fd = sock->__fd;
+		pfd[socket_count].events = sock->poll_flags;
+		socket_count++;
+	}
+	timeout = __ni_socket_array_get_timeout(array, array->data, array->count, timeout);
 
 	if (socket_count == 0 && timeout < 0) {
 		ni_debug_socket("no sockets left to watch");
@@ -181,60 +273,107 @@ ni_socket_array_wait(ni_socket_array_t *array, long timeout)
 			continue;
 
 		ni_socket_hold(sock);
+		__ni_socket_array_dispatch(array, sock, pfd[i].revents);
+		ni_socket_release(sock);
+	}
 
-		if (pfd[i].revents & POLLERR) {
-			/* Deactivate socket */
-			__ni_socket_deactivate(&array->data[i]);
-			sock->handle_error(sock);
-			goto done_with_this_socket;
-		}
+	__ni_socket_array_check_timeout(array, array->data,
+			array->count < socket_count ? array->count : socket_count);
+	return 0;
+}
 
-		if (pfd[i].revents & POLLIN) {
-			if (sock->receive == NULL) {
-				ni_error("socket %d has no receive callback", sock->__fd);
-				__ni_socket_deactivate(&array->data[i]);
-			} else {
-				sock->receive(sock);
-			}
-			if (sock->__fd < 0)
-				goto done_with_this_socket;
-		}
+/*
+ * Wait for incoming data using epoll; the sockets are registered
+ * once on activation and only the ready ones are processed.
+ */
+static inline int
+__ni_socket_epoll_to_poll(uint32_t events)
+{
+	int revents = 0;
+
+	if (events & EPOLLIN)
+		revents |= POLLIN;
+	if (events & EPOLLOUT)
+		revents |= POLLOUT;
+	if (events & EPOLLERR)
+		revents |= POLLERR;
+	if (events & EPOLLHUP)
+		revents |= POLLHUP;
+	return revents;
+}
 
-		if (pfd[i].revents & POLLHUP) {
-			if (sock->handle_hangup)
-				sock->handle_hangup(sock);
-			if (sock->__fd < 0)
-				goto done_with_this_socket;
-		} else
-
-		if (pfd[i].revents & POLLOUT) {
-			if (sock->transmit == NULL) {
-				ni_error("socket %d has no transmit callback", sock->__fd);
-				__ni_socket_deactivate(&array->data[i]);
-			} else {
-				sock->transmit(sock);
-			}
-		}
+static inline uint32_t
+__ni_socket_poll_to_epoll(int flags)
+{
+	uint32_t events = 0;
 
-done_with_this_socket:
-		ni_socket_release(sock);
+	if (flags & POLLIN)
+		events |= EPOLLIN;
+	if (flags & POLLOUT)
+		events |= EPOLLOUT;
+	return events;
+}
+
+static int
+__ni_socket_array_epoll_wait(ni_socket_array_t *array, long timeout)
+{
+	struct epoll_event events[NI_SOCKET_EPOLL_EVENTS];
+	ni_socket_t *ready[NI_SOCKET_EPOLL_EVENTS];
+	int i, n;
+
+	timeout = __ni_socket_array_get_timeout(array, array->tdata, array->tcount, timeout);
+
+	if (array->count == 0 && timeout < 0) {
+		ni_debug_socket("no sockets left to watch");
+		return 1;
 	}
 
-	gettimeofday(&now, NULL);
-	for (i = 0; i < array->count && i < socket_count; ++i) {
-		ni_socket_t *sock = array->data[i];
+	n = epoll_wait(array->epfd, events, NI_SOCKET_EPOLL_EVENTS, timeout);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		ni_error("epoll_wait returns error: %m");
+		return -1;
+	}
 
-		if (!sock || sock->active != array)
-			continue;
+	/* Hold all ready sockets first, so a callback releasing
+	 * another ready socket cannot free it under our feet. */
+	for (i = 0; i < n; ++i)
+		ready[i] = ni_socket_hold(events[i].data.ptr);
 
-		if (sock->check_timeout)
-			sock->check_timeout(sock, &now);
+	for (i = 0; i < n; ++i) {
+		ni_socket_t *sock = ready[i];
+
+		if (sock->active == array && sock->__fd >= 0)
+			__ni_socket_array_dispatch(array, sock,
+					__ni_socket_epoll_to_poll(events[i].events));
+		ni_socket_release(sock);
 	}
 
+	__ni_socket_array_check_timeout(array, array->tdata, array->tcount);
+	return 0;
+}
+
+/*
+ * Wait for incoming data on any of the sockets.
+ */
+int
+ni_socket_array_wait(ni_socket_array_t *array, long timeout)
+{
+	int ret;
+
+	/* First step - cleanup empty socket slots from the array. */
+	ni_socket_array_cleanup(array);
+
+	if (array->backend == NI_CONFIG_SOCKET_BACKEND_EPOLL)
+		ret = __ni_socket_array_epoll_wait(array, timeout);
+	else
+		ret = __ni_socket_array_poll_wait(array, timeout);
+
 	/* Finally cleanup deactivated/released sockets */
 	ni_socket_array_cleanup(array);
 
-	return 0;
+	return ret;
 }
 
 int
@@ -282,6 +421,9 @@ ni_socket_wrap(int fd, int sotype)
 static void
 __ni_socket_close(ni_socket_t *sock)
 {
+	if (sock->active)
+		__ni_socket_array_unwatch(sock->active, sock);
+
 	if (sock->close) {
 		sock->close(sock);
 	} else if (sock->__fd >= 0) {
@@ -310,6 +452,8 @@ void
 ni_socket_array_init(ni_socket_array_t *array)
 {
 	memset(array, 0, sizeof(*array));
+	array->backend = NI_CONFIG_SOCKET_BACKEND_DEFAULT;
+	array->epfd = -1;
 }
 
 void
@@ -322,13 +466,18 @@ ni_socket_array_destroy(ni_socket_array_t *array)
 			sock = array->data[array->count];
 			array->data[array->count] = NULL;
 			if (sock) {
-				if (sock->active == array)
+				if (sock->active == array) {
+					__ni_socket_array_unwatch(array, sock);
 					sock->active = NULL;
+				}
 				ni_socket_release(sock);
 			}
 		}
 		free(array->data);
-		memset(array, 0, sizeof(*array));
+		free(array->tdata);
+		if (array->epfd >= 0)
+			close(array->epfd);
+		ni_socket_array_init(array);
 	}
 }
 
@@ -342,6 +491,141 @@ ni_socket_array_cleanup(ni_socket_array_t *array)
 			array->data[j++] = array->data[i];
 	}
 	array->count = j;
+
+	for (i = j = 0; i < array->tcount; ++i) {
+		if (array->tdata[i])
+			array->tdata[j++] = array->tdata[i];
+	}
+	array->tcount = j;
+}
+
+/*
+ * Select the mechanism used to wait for socket events.
+ * Already active sockets are (un)registered accordingly.
+ */
+ni_bool_t
+ni_socket_array_set_backend(ni_socket_array_t *array, ni_config_socket_backend_t backend)
+{
+	unsigned int i;
+
+	if (!array)
+		return FALSE;
+
+	if (backend == NI_CONFIG_SOCKET_BACKEND_DEFAULT)
+		backend = ni_config_socket_backend();
+
+	if (array->backend == backend)
+		return TRUE;
+
+	for (i = 0; i < array->count; ++i) {
+		ni_socket_t *sock = array->data[i];
+
+		if (sock && sock->active == array)
+			__ni_socket_array_unwatch(array, sock);
+	}
+	if (array->epfd >= 0) {
+		close(array->epfd);
+		array->epfd = -1;
+	}
+	array->backend = NI_CONFIG_SOCKET_BACKEND_POLL;
+
+	if (backend == NI_CONFIG_SOCKET_BACKEND_EPOLL) {
+		if ((array->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+			ni_warn("unable to create epoll socket set, using poll: %m");
+		else
+			array->backend = NI_CONFIG_SOCKET_BACKEND_EPOLL;
+	}
+
+	ni_debug_socket("using %s socket event backend",
+			ni_config_socket_backend_type_to_name(array->backend));
+
+	for (i = 0; i < array->count; ++i) {
+		ni_socket_t *sock = array->data[i];
+
+		if (sock && sock->active == array && !__ni_socket_array_watch(array, sock))
+			__ni_socket_deactivate(array, sock);
+	}
+	ni_socket_array_cleanup(array);
+	return array->backend == backend;
+}
+
+/*
+ * Register an active socket in the epoll set and the timeout index
+ */
+static ni_bool_t
+__ni_socket_array_watch(ni_socket_array_t *array, ni_socket_t *sock)
+{
+	struct epoll_event ev;
+
+	/* Sockets without fd (e.g. timer only) are not in the epoll set */
+	if (array->backend == NI_CONFIG_SOCKET_BACKEND_EPOLL && !sock->epoll && sock->__fd >= 0) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = __ni_socket_poll_to_epoll(sock->poll_flags);
+		ev.data.ptr = sock;
+		if (epoll_ctl(array->epfd, EPOLL_CTL_ADD, sock->__fd, &ev) < 0) {
+			ni_error("unable to add socket %d to epoll set: %m", sock->__fd);
+			return FALSE;
+		}
+		sock->epoll = 1;
+		sock->epoll_events = ev.events;
+	}
+
+	if (sock->get_timeout || sock->check_timeout) {
+		if ((array->tcount % NI_SOCKET_ARRAY_CHUNK) == 0) {
+			array->tdata = xrealloc(array->tdata, (array->tcount +
+					NI_SOCKET_ARRAY_CHUNK) * sizeof(ni_socket_t *));
+		}
+		array->tdata[array->tcount++] = sock;
+	}
+	return TRUE;
+}
+
+static void
+__ni_socket_array_unwatch(ni_socket_array_t *array, ni_socket_t *sock)
+{
+	unsigned int i;
+
+	for (i = 0; i < array->tcount; ++i) {
+		if (sock == array->tdata[i])
+			array->tdata[i] = NULL;
+	}
+
+	if (!sock->epoll)
+		return;
+
+	if (array->epfd >= 0 && sock->__fd >= 0)
+		epoll_ctl(array->epfd, EPOLL_CTL_DEL, sock->__fd, NULL);
+	sock->epoll = 0;
+	sock->epoll_events = 0;
+}
+
+/*
+ * Update the events we're interested in
+ */
+void
+ni_socket_set_poll_flags(ni_socket_t *sock, int flags)
+{
+	ni_socket_array_t *array;
+	struct epoll_event ev;
+
+	if (!sock)
+		return;
+
+	sock->poll_flags = flags;
+	if (!sock->epoll || !(array = sock->active) || array->epfd < 0)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = __ni_socket_poll_to_epoll(flags);
+	if ((int)ev.events == sock->epoll_events)
+		return;
+
+	ev.data.ptr = sock;
+	if (epoll_ctl(array->epfd, EPOLL_CTL_MOD, sock->__fd, &ev) < 0) {
+		ni_error("unable to modify socket %d epoll events: %m", sock->__fd);
+		return;
+	}
+	sock->epoll_events = ev.events;
 }
 
 static inline void
@@ -390,8 +674,10 @@ ni_socket_array_remove_at(ni_socket_array_t *array, unsigned int index)
 	}
 	array->data[array->count] = NULL;
 
-	if (sock && sock->active == array)
+	if (sock && sock->active == array) {
+		__ni_socket_array_unwatch(array, sock);
 		sock->active = NULL;
+	}
 	return sock;
 }
 
@@ -433,12 +719,20 @@ ni_socket_array_activate(ni_socket_array_t *array, ni_socket_t *sock)
 	if (sock->active)
 		return sock->active == array;
 
+	if (array->backend == NI_CONFIG_SOCKET_BACKEND_DEFAULT)
+		ni_socket_array_set_backend(array, NI_CONFIG_SOCKET_BACKEND_DEFAULT);
+
 	if (!ni_socket_array_append(array, sock))
 		return FALSE;
 
+	sock->poll_flags = POLLIN;
+	if (!__ni_socket_array_watch(array, sock)) {
+		ni_socket_array_remove(array, sock);
+		return FALSE;
+	}
+
 	ni_socket_hold(sock);
 	sock->active = array;
-	sock->poll_flags = POLLIN;
 	return TRUE;
 }
 
@@ -12,14 +12,17 @@
 #include <wicked/types.h>
 #include <wicked/socket.h>
 #include "buffer.h"
+#include "appconfig.h"
 
 struct ni_socket {
 	unsigned int		refcount;
 	ni_socket_array_t *	active;
 
 	int		__fd;
-	unsigned int	error  : 1;
+	unsigned int	error  : 1,
+			epoll  : 1;	/* registered in the array epoll set */
 	int		poll_flags;
+	int		epoll_events;
 
 	ni_buffer_t	rbuf;
 	ni_buffer_t	wbuf;
@@ -43,13 +46,21 @@ struct ni_socket {
 struct ni_socket_array {
 	unsigned int	count;
 	ni_socket_t **	data;
+
+	ni_config_socket_backend_t backend;
+	int		epfd;
+
+	/* sockets with get_timeout/check_timeout callbacks */
+	unsigned int	tcount;
+	ni_socket_t **	tdata;
 };
 
-#define NI_SOCKET_ARRAY_INIT	{ .count = 0, .data = NULL }
+#define NI_SOCKET_ARRAY_INIT	{ .count = 0, .data = NULL, .backend = NI_CONFIG_SOCKET_BACKEND_DEFAULT, .epfd = -1 }
 
 extern void		ni_socket_array_init(ni_socket_array_t *);
 extern void		ni_socket_array_destroy(ni_socket_array_t *);
 extern void		ni_socket_array_cleanup(ni_socket_array_t *);
+extern ni_bool_t	ni_socket_array_set_backend(ni_socket_array_t *, ni_config_socket_backend_t);
 
 extern ni_bool_t	ni_socket_array_append(ni_socket_array_t *, ni_socket_t *);
 extern ni_socket_t *	ni_socket_array_remove_at(ni_socket_array_t *, unsigned int);
@@ -59,5 +70,7 @@ extern unsigned int	ni_socket_array_find(ni_socket_array_t *, ni_socket_t *);
 extern ni_bool_t	ni_socket_array_activate(ni_socket_array_t *, ni_socket_t *);
 extern ni_bool_t	ni_socket_array_deactivate(ni_socket_array_t *, ni_socket_t *);
 
+extern void		ni_socket_set_poll_flags(ni_socket_t *, int);
+
 #endif /* __WICKED_SOCKET_PRIV_H__ */
 
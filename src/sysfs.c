@@ -9,6 +9,9 @@
 
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include <net/if_arp.h>
 
 #include <wicked/netinfo.h>
@@ -47,6 +50,8 @@
 
 static const char *	__ni_sysfs_netif_attrpath(const char *ifname, const char *attr);
 static const char *	__ni_sysfs_netif_get_attr(const char *ifname, const char *attr);
+static int		__ni_sysfs_dir_get_attrs(const char *, const ni_sysfs_attr_t *);
+static int		__ni_sysfs_dir_read(const char *, const char *, char *, size_t);
 static int		__ni_sysfs_netif_put_attr(const char *, const char *, const char *);
 static int		__ni_sysfs_printf(const char *, const char *, ...);
 static int		__ni_sysfs_read_list(const char *, ni_string_array_t *);
@@ -199,20 +204,20 @@ static const char *
 __ni_sysfs_netif_get_attr(const char *ifname, const char *attr_name)
 {
 	static char buffer[256];
-	const char *filename;
-	char *result = NULL;
-	FILE *fp;
 
-	filename = __ni_sysfs_netif_attrpath(ifname, attr_name);
-	if (!(fp = fopen(filename, "r")))
+	if (__ni_sysfs_dir_read(__ni_sysfs_netif_attrpath(ifname, NULL),
+				attr_name, buffer, sizeof(buffer)) <= 0)
 		return NULL;
+	return buffer;
+}
 
-	if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		buffer[strcspn(buffer, "\n")] = '\0';
-		result = buffer;
-	}
-	fclose(fp);
-	return result;
+/*
+ * Read a list of attributes of a network interface
+ */
+int
+ni_sysfs_netif_get_attrs(const char *ifname, const ni_sysfs_attr_t *attrs)
+{
+	return __ni_sysfs_dir_get_attrs(__ni_sysfs_netif_attrpath(ifname, NULL), attrs);
 }
 
 static int
@@ -245,8 +250,12 @@ __ni_sysfs_netif_attrpath(const char *ifname, const char *attr_name)
 {
 	static char pathbuf[PATH_MAX];
 
-	snprintf(pathbuf, sizeof(pathbuf), "%s/%s/%s",
-			_PATH_SYS_CLASS_NET, ifname, attr_name);
+	if (attr_name)
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s/%s",
+				_PATH_SYS_CLASS_NET, ifname, attr_name);
+	else
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s",
+				_PATH_SYS_CLASS_NET, ifname);
 	return pathbuf;
 }
 
@@ -323,9 +332,19 @@ int
 ni_sysfs_bonding_get_attr(const char *ifname, const char *attr_name, char **result)
 {
 	static char pathbuf[PATH_MAX];
+	char buffer[256];
 
-	snprintf(pathbuf, sizeof(pathbuf), "%s/%s/bonding/%s", _PATH_SYS_CLASS_NET, ifname, attr_name);
-	return __ni_sysfs_read_string(pathbuf, result);
+	snprintf(pathbuf, sizeof(pathbuf), "%s/%s/bonding", _PATH_SYS_CLASS_NET, ifname);
+	switch (__ni_sysfs_dir_read(pathbuf, attr_name, buffer, sizeof(buffer))) {
+	case -1:
+		return -1;
+	case 0:
+		ni_string_free(result);
+		return 0;
+	default:
+		ni_string_dup(result, buffer);
+		return 0;
+	}
 }
 
 int
@@ -470,18 +489,23 @@ ni_sysfs_bridge_update_config(const char *ifname, const ni_bridge_t *bridge)
 void
 ni_sysfs_bridge_get_status(const char *ifname, ni_bridge_status_t *bs)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/stp_state", &bs->stp_state);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/root_id", &bs->root_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/bridge_id", &bs->bridge_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/group_addr", &bs->group_addr);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_port", &bs->root_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_path_cost", &bs->root_path_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change", &bs->topology_change);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change_detected", &bs->topology_change_detected);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/gc_timer", &bs->gc_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/tcn_timer", &bs->tcn_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/hello_timer", &bs->hello_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/topology_change_timer", &bs->topology_change_timer);
+	const ni_sysfs_attr_t attrs[] = {
+		{ SYSFS_BRIDGE_ATTR "/stp_state",		NI_SYSFS_ATTR_UINT,	&bs->stp_state		},
+		{ SYSFS_BRIDGE_ATTR "/root_id",			NI_SYSFS_ATTR_STRING,	&bs->root_id		},
+		{ SYSFS_BRIDGE_ATTR "/bridge_id",		NI_SYSFS_ATTR_STRING,	&bs->bridge_id		},
+		{ SYSFS_BRIDGE_ATTR "/group_addr",		NI_SYSFS_ATTR_STRING,	&bs->group_addr		},
+		{ SYSFS_BRIDGE_ATTR "/root_port",		NI_SYSFS_ATTR_UINT,	&bs->root_port		},
+		{ SYSFS_BRIDGE_ATTR "/root_path_cost",		NI_SYSFS_ATTR_UINT,	&bs->root_path_cost	},
+		{ SYSFS_BRIDGE_ATTR "/topology_change",		NI_SYSFS_ATTR_UINT,	&bs->topology_change	},
+		{ SYSFS_BRIDGE_ATTR "/topology_change_detected",NI_SYSFS_ATTR_UINT,	&bs->topology_change_detected },
+		{ SYSFS_BRIDGE_ATTR "/gc_timer",		NI_SYSFS_ATTR_ULONG,	&bs->gc_timer		},
+		{ SYSFS_BRIDGE_ATTR "/tcn_timer",		NI_SYSFS_ATTR_ULONG,	&bs->tcn_timer		},
+		{ SYSFS_BRIDGE_ATTR "/hello_timer",		NI_SYSFS_ATTR_ULONG,	&bs->hello_timer	},
+		{ SYSFS_BRIDGE_ATTR "/topology_change_timer",	NI_SYSFS_ATTR_ULONG,	&bs->topology_change_timer },
+		{ NULL,						NI_SYSFS_ATTR_STRING,	NULL			}
+	};
+
+	ni_sysfs_netif_get_attrs(ifname, attrs);
 }
 
 int
@@ -516,28 +540,48 @@ ni_sysfs_bridge_port_update_config(const char *ifname, const ni_bridge_port_t *p
 void
 ni_sysfs_bridge_port_get_status(const char *ifname, ni_bridge_port_status_t *ps)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/priority", &ps->priority);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/path_cost", &ps->path_cost);
-
-	ni_sysfs_netif_get_int(ifname, SYSFS_BRIDGE_PORT_ATTR "/state", &ps->state);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_no", &ps->port_no);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_id", &ps->port_no);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_root", &ps->designated_root);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_bridge", &ps->designated_bridge);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_port", &ps->designated_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_cost", &ps->designated_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/change_ack", &ps->change_ack);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/hairpin_mode", &ps->hairpin_mode);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/config_pending", &ps->config_pending);
-
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/hold_timer", &ps->hold_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/message_age_timer", &ps->message_age_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/forward_delay_timer", &ps->forward_delay_timer);
+	const ni_sysfs_attr_t attrs[] = {
+		{ SYSFS_BRIDGE_PORT_ATTR "/priority",		NI_SYSFS_ATTR_UINT,	&ps->priority		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/path_cost",		NI_SYSFS_ATTR_UINT,	&ps->path_cost		},
+
+		{ SYSFS_BRIDGE_PORT_ATTR "/state",		NI_SYSFS_ATTR_INT,	&ps->state		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/port_no",		NI_SYSFS_ATTR_UINT,	&ps->port_no		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/port_id",		NI_SYSFS_ATTR_UINT,	&ps->port_no		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/designated_root",	NI_SYSFS_ATTR_STRING,	&ps->designated_root	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/designated_bridge",	NI_SYSFS_ATTR_STRING,	&ps->designated_bridge	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/designated_port",	NI_SYSFS_ATTR_UINT,	&ps->designated_port	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/designated_cost",	NI_SYSFS_ATTR_UINT,	&ps->designated_cost	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/change_ack",		NI_SYSFS_ATTR_UINT,	&ps->change_ack		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/hairpin_mode",	NI_SYSFS_ATTR_UINT,	&ps->hairpin_mode	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/config_pending",	NI_SYSFS_ATTR_UINT,	&ps->config_pending	},
+
+		{ SYSFS_BRIDGE_PORT_ATTR "/hold_timer",		NI_SYSFS_ATTR_ULONG,	&ps->hold_timer		},
+		{ SYSFS_BRIDGE_PORT_ATTR "/message_age_timer",	NI_SYSFS_ATTR_ULONG,	&ps->message_age_timer	},
+		{ SYSFS_BRIDGE_PORT_ATTR "/forward_delay_timer",NI_SYSFS_ATTR_ULONG,	&ps->forward_delay_timer },
+		{ NULL,						NI_SYSFS_ATTR_STRING,	NULL			}
+	};
+
+	ni_sysfs_netif_get_attrs(ifname, attrs);
 }
 
 /*
  * Get/set IPv4 sysctls
  */
+static int
+__ni_sysctl_ifconfig_read(const char *dirname, const char *ctl_name, char *buf, size_t size)
+{
+	switch (__ni_sysfs_dir_read(dirname, ctl_name, buf, size)) {
+	case -1:
+		ni_error("%s/%s: unable to read file: %m", dirname, ctl_name);
+		return -1;
+	case 0:
+		ni_error("%s/%s: empty file", dirname, ctl_name);
+		return -1;
+	default:
+		return 0;
+	}
+}
+
 static inline const char *
 __ni_sysctl_ipv4_ifconfig_path(const char *ifname, const char *ctl_name)
 {
@@ -561,43 +605,25 @@ ni_sysctl_ipv4_ifconfig_is_present(const char *ifname)
 int
 ni_sysctl_ipv4_ifconfig_get_int(const char *ifname, const char *ctl_name, int *value)
 {
-	const char *pathname = __ni_sysctl_ipv4_ifconfig_path(ifname, ctl_name);
-	char *result = NULL;
-	int ret;
+	char result[64];
 
 	*value = 0;
-	if (__ni_sysfs_read_string(pathname, &result) < 0) {
-		ni_error("%s: unable to read file: %m", pathname);
+	if (__ni_sysctl_ifconfig_read(__ni_sysctl_ipv4_ifconfig_path(ifname, NULL),
+					ctl_name, result, sizeof(result)) < 0)
 		return -1;
-	}
-	if (result == NULL) {
-		ni_error("%s: empty file", pathname);
-		return -1;
-	}
-	ret = ni_parse_int(result, value, 0);
-	ni_string_free(&result);
-	return ret;
+	return ni_parse_int(result, value, 0);
 }
 
 int
 ni_sysctl_ipv4_ifconfig_get_uint(const char *ifname, const char *ctl_name, unsigned int *value)
 {
-	const char *pathname = __ni_sysctl_ipv4_ifconfig_path(ifname, ctl_name);
-	char *result = NULL;
-	int ret;
+	char result[64];
 
 	*value = 0;
-	if (__ni_sysfs_read_string(pathname, &result) < 0) {
-		ni_error("%s: unable to read file: %m", pathname);
-		return -1;
-	}
-	if (result == NULL) {
-		ni_error("%s: empty file", pathname);
+	if (__ni_sysctl_ifconfig_read(__ni_sysctl_ipv4_ifconfig_path(ifname, NULL),
+					ctl_name, result, sizeof(result)) < 0)
 		return -1;
-	}
-	ret = ni_parse_uint(result, value, 0);
-	ni_string_free(&result);
-	return ret;
+	return ni_parse_uint(result, value, 0);
 }
 
 int
@@ -638,43 +664,25 @@ ni_sysctl_ipv6_ifconfig_is_present(const char *ifname)
 int
 ni_sysctl_ipv6_ifconfig_get_int(const char *ifname, const char *ctl_name, int *value)
 {
-	const char *pathname = __ni_sysctl_ipv6_ifconfig_path(ifname, ctl_name);
-	char *result = NULL;
-	int ret;
+	char result[64];
 
 	*value = 0;
-	if (__ni_sysfs_read_string(pathname, &result) < 0) {
-		ni_error("%s: unable to read file: %m", pathname);
-		return -1;
-	}
-	if (result == NULL) {
-		ni_error("%s: empty file", pathname);
+	if (__ni_sysctl_ifconfig_read(__ni_sysctl_ipv6_ifconfig_path(ifname, NULL),
+					ctl_name, result, sizeof(result)) < 0)
 		return -1;
-	}
-	ret = ni_parse_int(result, value, 0);
-	ni_string_free(&result);
-	return ret;
+	return ni_parse_int(result, value, 0);
 }
 
 int
 ni_sysctl_ipv6_ifconfig_get_uint(const char *ifname, const char *ctl_name, unsigned int *value)
 {
-	const char *pathname = __ni_sysctl_ipv6_ifconfig_path(ifname, ctl_name);
-	char *result = NULL;
-	int ret;
+	char result[64];
 
 	*value = 0;
-	if (__ni_sysfs_read_string(pathname, &result) < 0) {
-		ni_error("%s: unable to read file: %m", pathname);
+	if (__ni_sysctl_ifconfig_read(__ni_sysctl_ipv6_ifconfig_path(ifname, NULL),
+					ctl_name, result, sizeof(result)) < 0)
 		return -1;
-	}
-	if (result == NULL) {
-		ni_error("%s: empty file", pathname);
-		return -1;
-	}
-	ret = ni_parse_uint(result, value, 0);
-	ni_string_free(&result);
-	return ret;
+	return ni_parse_uint(result, value, 0);
 }
 
 int
@@ -756,6 +764,291 @@ __ni_sysfs_read_string(const char *pathname, char **result)
 	return 0;
 }
 
+/*
+ * Cache of open attribute directories, e.g. /sys/class/net/<ifname>
+ * or /proc/sys/net/ipv6/conf/<ifname>. Attributes are read using
+ * openat and pread instead of resolving the whole path every time.
+ *
+ * A directory fd refers to the device it has been opened for, even
+ * when the device is renamed later. The refresh and the link events
+ * expire the cache; the first use of a directory afterwards verifies
+ * it still is the directory the path resolves to now.
+ *
+ * The cache is sized from the number of devices, so the directories
+ * of all devices stay open during a refresh; the least recently used
+ * directory is closed when the limit is reached.
+ */
+#define NI_SYSFS_DIR_CACHE_MIN		16
+#define NI_SYSFS_DIR_CACHE_PER_DEV	3	/* net class, ipv4 and ipv6 conf */
+
+typedef struct ni_sysfs_dir	ni_sysfs_dir_t;
+struct ni_sysfs_dir {
+	ni_sysfs_dir_t *	hnext;
+	ni_sysfs_dir_t *	prev;		/* LRU list, most recent first */
+	ni_sysfs_dir_t *	next;
+
+	char *			path;
+	unsigned int		hash;
+	int			fd;
+	dev_t			dev;
+	ino_t			ino;
+	unsigned int		epoch;
+};
+
+static struct {
+	unsigned int		epoch;
+	unsigned int		count;
+	unsigned int		limit;
+	unsigned int		hsize;
+	ni_sysfs_dir_t **	htable;
+	ni_sysfs_dir_t *	head;
+	ni_sysfs_dir_t *	tail;
+} ni_sysfs_dir_cache = { .epoch = 1, .limit = NI_SYSFS_DIR_CACHE_MIN };
+
+static void
+__ni_sysfs_dir_lru_unlink(ni_sysfs_dir_t *dir)
+{
+	if (dir->prev)
+		dir->prev->next = dir->next;
+	else
+		ni_sysfs_dir_cache.head = dir->next;
+	if (dir->next)
+		dir->next->prev = dir->prev;
+	else
+		ni_sysfs_dir_cache.tail = dir->prev;
+	dir->prev = dir->next = NULL;
+}
+
+static void
+__ni_sysfs_dir_lru_push(ni_sysfs_dir_t *dir)
+{
+	dir->prev = NULL;
+	dir->next = ni_sysfs_dir_cache.head;
+	if (dir->next)
+		dir->next->prev = dir;
+	else
+		ni_sysfs_dir_cache.tail = dir;
+	ni_sysfs_dir_cache.head = dir;
+}
+
+static void
+__ni_sysfs_dir_close(ni_sysfs_dir_t *dir)
+{
+	ni_sysfs_dir_t **pos;
+
+	pos = &ni_sysfs_dir_cache.htable[dir->hash & (ni_sysfs_dir_cache.hsize - 1)];
+	for ( ; *pos; pos = &(*pos)->hnext) {
+		if (*pos == dir) {
+			*pos = dir->hnext;
+			break;
+		}
+	}
+	__ni_sysfs_dir_lru_unlink(dir);
+	ni_sysfs_dir_cache.count--;
+
+	close(dir->fd);
+	ni_string_free(&dir->path);
+	free(dir);
+}
+
+static void
+__ni_sysfs_dir_cache_rehash(unsigned int hsize)
+{
+	ni_sysfs_dir_t *dir, **bucket;
+
+	free(ni_sysfs_dir_cache.htable);
+	ni_sysfs_dir_cache.htable = xcalloc(hsize, sizeof(ni_sysfs_dir_t *));
+	ni_sysfs_dir_cache.hsize = hsize;
+
+	for (dir = ni_sysfs_dir_cache.head; dir; dir = dir->next) {
+		bucket = &ni_sysfs_dir_cache.htable[dir->hash & (hsize - 1)];
+		dir->hnext = *bucket;
+		*bucket = dir;
+	}
+}
+
+/*
+ * Size the cache to keep the directories of @ndevs devices open.
+ * It is not grown beyond a quarter of the open file limit.
+ */
+void
+ni_sysfs_dir_cache_reserve(unsigned int ndevs)
+{
+	static unsigned int max_limit;
+	unsigned int limit;
+	struct rlimit rlim;
+
+	if (!max_limit) {
+		max_limit = NI_SYSFS_DIR_CACHE_MIN;
+		if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY)
+			max_limit = max_t(unsigned int, max_limit, rlim.rlim_cur / 4);
+		else
+			max_limit = max_t(unsigned int, max_limit, 1024);
+	}
+
+	if (ndevs > (max_limit - NI_SYSFS_DIR_CACHE_MIN) / NI_SYSFS_DIR_CACHE_PER_DEV)
+		limit = max_limit;
+	else
+		limit = NI_SYSFS_DIR_CACHE_MIN + ndevs * NI_SYSFS_DIR_CACHE_PER_DEV;
+
+	if (limit > ni_sysfs_dir_cache.limit)
+		ni_sysfs_dir_cache.limit = limit;
+}
+
+/*
+ * Revalidate the cached directories on their next use
+ */
+void
+ni_sysfs_dir_cache_expire(void)
+{
+	do {
+		ni_sysfs_dir_cache.epoch++;
+	} while (!ni_sysfs_dir_cache.epoch);
+}
+
+static int
+__ni_sysfs_dir_open(const char *path)
+{
+	ni_sysfs_dir_t *dir, **bucket;
+	unsigned int hash, hsize;
+	struct stat stb;
+	int fd;
+
+	hash = ni_hash_string(path);
+	if (ni_sysfs_dir_cache.hsize) {
+		dir = ni_sysfs_dir_cache.htable[hash & (ni_sysfs_dir_cache.hsize - 1)];
+		for ( ; dir; dir = dir->hnext) {
+			if (dir->hash == hash && ni_string_eq(dir->path, path))
+				break;
+		}
+	} else {
+		dir = NULL;
+	}
+
+	if (dir) {
+		if (dir->epoch != ni_sysfs_dir_cache.epoch) {
+			if (stat(path, &stb) < 0 || !S_ISDIR(stb.st_mode) ||
+			    dir->dev != stb.st_dev || dir->ino != stb.st_ino) {
+				/* renamed, deleted or deleted and re-created */
+				__ni_sysfs_dir_close(dir);
+				goto open;
+			}
+			dir->epoch = ni_sysfs_dir_cache.epoch;
+		}
+		__ni_sysfs_dir_lru_unlink(dir);
+		__ni_sysfs_dir_lru_push(dir);
+		return dir->fd;
+	}
+
+open:
+	if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+		return -1;
+
+	if (fstat(fd, &stb) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	while (ni_sysfs_dir_cache.tail && ni_sysfs_dir_cache.count >= ni_sysfs_dir_cache.limit)
+		__ni_sysfs_dir_close(ni_sysfs_dir_cache.tail);
+
+	for (hsize = ni_sysfs_dir_cache.hsize ? : 32; hsize < ni_sysfs_dir_cache.limit; )
+		hsize <<= 1;
+	if (hsize != ni_sysfs_dir_cache.hsize)
+		__ni_sysfs_dir_cache_rehash(hsize);
+
+	dir = xcalloc(1, sizeof(*dir));
+	ni_string_dup(&dir->path, path);
+	dir->hash = hash;
+	dir->fd = fd;
+	dir->dev = stb.st_dev;
+	dir->ino = stb.st_ino;
+	dir->epoch = ni_sysfs_dir_cache.epoch;
+
+	bucket = &ni_sysfs_dir_cache.htable[hash & (hsize - 1)];
+	dir->hnext = *bucket;
+	*bucket = dir;
+	__ni_sysfs_dir_lru_push(dir);
+	ni_sysfs_dir_cache.count++;
+	return fd;
+}
+
+/*
+ * Read the first line of the attribute @name in the directory fd
+ * into @buf; returns the number of bytes read or -1 on error.
+ */
+static int
+__ni_sysfs_dir_read_at(int dirfd, const char *name, char *buf, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	len = pread(fd, buf, size - 1, 0);
+	close(fd);
+	if (len < 0)
+		return -1;
+
+	buf[len] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return len;
+}
+
+static int
+__ni_sysfs_dir_read(const char *path, const char *name, char *buf, size_t size)
+{
+	int dirfd;
+
+	if ((dirfd = __ni_sysfs_dir_open(path)) < 0)
+		return -1;
+
+	return __ni_sysfs_dir_read_at(dirfd, name, buf, size);
+}
+
+/*
+ * Read a list of attributes from a directory, terminated by an entry
+ * without name. Attributes which could not be read or parsed are left
+ * untouched; returns the number of attributes read or -1 if the
+ * directory is gone.
+ */
+static int
+__ni_sysfs_dir_get_attrs(const char *path, const ni_sysfs_attr_t *attrs)
+{
+	const ni_sysfs_attr_t *attr;
+	char buffer[256];
+	int dirfd, count = 0;
+
+	if ((dirfd = __ni_sysfs_dir_open(path)) < 0)
+		return -1;
+
+	for (attr = attrs; attr->name; ++attr) {
+		if (__ni_sysfs_dir_read_at(dirfd, attr->name, buffer, sizeof(buffer)) <= 0)
+			continue;
+
+		switch (attr->type) {
+		case NI_SYSFS_ATTR_INT:
+			if (ni_parse_int(buffer, attr->value, 0) < 0)
+				continue;
+			break;
+		case NI_SYSFS_ATTR_UINT:
+			if (ni_parse_uint(buffer, attr->value, 0) < 0)
+				continue;
+			break;
+		case NI_SYSFS_ATTR_ULONG:
+			if (ni_parse_ulong(buffer, attr->value, 0) < 0)
+				continue;
+			break;
+		case NI_SYSFS_ATTR_STRING:
+			ni_string_dup((char **)attr->value, buffer);
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
 /*
  * Discover iBFT information stored in sysfs
  */
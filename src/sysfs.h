@@ -10,11 +10,25 @@
 #include <wicked/bridge.h>
 #include <wicked/pci.h>
 
+typedef enum {
+	NI_SYSFS_ATTR_INT,
+	NI_SYSFS_ATTR_UINT,
+	NI_SYSFS_ATTR_ULONG,
+	NI_SYSFS_ATTR_STRING,
+} ni_sysfs_attr_type_t;
+
+typedef struct ni_sysfs_attr {
+	const char *		name;
+	ni_sysfs_attr_type_t	type;
+	void *			value;
+} ni_sysfs_attr_t;
+
 extern int	ni_sysfs_netif_get_int(const char *, const char *, int *);
 extern int	ni_sysfs_netif_get_long(const char *, const char *, long *);
 extern int	ni_sysfs_netif_get_uint(const char *, const char *, unsigned int *);
 extern int	ni_sysfs_netif_get_ulong(const char *, const char *, unsigned long *);
 extern int	ni_sysfs_netif_get_string(const char *, const char *, char **);
+extern int	ni_sysfs_netif_get_attrs(const char *, const ni_sysfs_attr_t *);
 extern int	ni_sysfs_netif_put_int(const char *, const char *, int);
 extern int	ni_sysfs_netif_put_long(const char *, const char *, long);
 extern int	ni_sysfs_netif_put_uint(const char *, const char *, unsigned int);
@@ -46,6 +60,8 @@ extern void	ni_sysfs_bridge_port_get_config(const char *, ni_bridge_port_t *);
 extern int	ni_sysfs_bridge_port_update_config(const char *, const ni_bridge_port_t *);
 extern void	ni_sysfs_bridge_port_get_status(const char *, ni_bridge_port_status_t *);
 extern ni_pci_dev_t *ni_sysfs_netdev_get_pci(const char *ifname);
+extern void	ni_sysfs_dir_cache_expire(void);
+extern void	ni_sysfs_dir_cache_reserve(unsigned int);
 
 extern int	ni_sysctl_ipv6_ifconfig_is_present(const char *ifname);
 extern int	ni_sysctl_ipv6_ifconfig_get_int(const char *, const char *, int *);
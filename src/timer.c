@@ -8,22 +8,80 @@
 #endif
 
 #include <sys/time.h>
+#include <string.h>
+#include <time.h>
 #include <wicked/socket.h>
 #include "netinfo_priv.h"
 #include "util_priv.h"
 
+/*
+ * Active timers are kept in a binary min-heap ordered by expiry time
+ * (and arm sequence for timers expiring at the same time), so arming,
+ * rearming and cancelling a timer are O(log n) operations.
+ *
+ * Released timers are recycled via a free list and never returned to
+ * the heap allocator, so a stale handle passed to ni_timer_cancel() or
+ * ni_timer_rearm() still points to a valid timer structure. The handle
+ * carries no generation though: once the structure has been recycled,
+ * a stale handle refers to the new timer, exactly as a pointer to a
+ * freed and reallocated timer did before. The free list is used in
+ * release order to keep a just released structure unused as long as
+ * possible; callers still have to forget their handle on cancel and
+ * in the timer callback.
+ */
+#define NI_TIMER_HEAP_CHUNK	64
+#define NI_TIMER_INACTIVE	-1U
+
 struct ni_timer {
-	ni_timer_t *		next;
+	ni_timer_t *		next;		/* free list */
+	unsigned int		index;		/* heap position */
 	unsigned int		ident;
-	struct timeval		expires;
+	unsigned long		seq;
+	struct timeval		expires;	/* CLOCK_MONOTONIC */
 	ni_timeout_callback_t	*callback;
 	void *			user_data;
 };
 
-static ni_timer_t *		ni_timer_list;
+typedef struct ni_timer_heap {
+	unsigned int		count;
+	unsigned int		size;
+	ni_timer_t **		data;
+} ni_timer_heap_t;
+
+static ni_timer_heap_t		ni_timer_heap;
+static ni_timer_t *		ni_timer_free_list;
+static ni_timer_t **		ni_timer_free_tail = &ni_timer_free_list;
 
 static void			__ni_timer_arm(ni_timer_t *, unsigned long);
 static ni_timer_t *		__ni_timer_disarm(const ni_timer_t *);
+static void			__ni_timer_monotonic(struct timeval *);
+
+static ni_timer_t *
+__ni_timer_new(void)
+{
+	ni_timer_t *timer;
+
+	if ((timer = ni_timer_free_list) != NULL) {
+		if (!(ni_timer_free_list = timer->next))
+			ni_timer_free_tail = &ni_timer_free_list;
+		memset(timer, 0, sizeof(*timer));
+	} else {
+		timer = xcalloc(1, sizeof(*timer));
+	}
+	timer->index = NI_TIMER_INACTIVE;
+	return timer;
+}
+
+static void
+__ni_timer_free(ni_timer_t *timer)
+{
+	timer->index = NI_TIMER_INACTIVE;
+	timer->callback = NULL;
+	timer->user_data = NULL;
+	timer->next = NULL;
+	*ni_timer_free_tail = timer;
+	ni_timer_free_tail = &timer->next;
+}
 
 const ni_timer_t *
 ni_timer_register(unsigned long timeout, ni_timeout_callback_t *callback, void *data)
@@ -31,7 +89,7 @@ ni_timer_register(unsigned long timeout, ni_timeout_callback_t *callback, void *
 	static unsigned int id_counter;
 	ni_timer_t *timer;
 
-	timer = xcalloc(1, sizeof(*timer));
+	timer = __ni_timer_new();
 	timer->callback = callback;
 	timer->user_data = data;
 	timer->ident = id_counter++;
@@ -51,7 +109,7 @@ ni_timer_cancel(const ni_timer_t *handle)
 
 	if ((timer = __ni_timer_disarm(handle)) != NULL) {
 		user_data = timer->user_data;
-		free(timer);
+		__ni_timer_free(timer);
 		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
 				"%s: released timer %p", __func__, timer);
 	} else {
@@ -74,6 +132,88 @@ ni_timer_rearm(const ni_timer_t *handle, unsigned long timeout)
 	 return timer;
 }
 
+/*
+ * Min-heap primitives
+ */
+static inline ni_bool_t
+__ni_timer_before(const ni_timer_t *a, const ni_timer_t *b)
+{
+	if (timercmp(&a->expires, &b->expires, !=))
+		return timercmp(&a->expires, &b->expires, <);
+	return a->seq < b->seq;
+}
+
+static inline void
+__ni_timer_heap_set(ni_timer_heap_t *heap, unsigned int index, ni_timer_t *timer)
+{
+	heap->data[index] = timer;
+	timer->index = index;
+}
+
+static void
+__ni_timer_heap_sift_up(ni_timer_heap_t *heap, unsigned int index)
+{
+	ni_timer_t *timer = heap->data[index];
+	unsigned int parent;
+
+	while (index > 0) {
+		parent = (index - 1) / 2;
+		if (!__ni_timer_before(timer, heap->data[parent]))
+			break;
+		__ni_timer_heap_set(heap, index, heap->data[parent]);
+		index = parent;
+	}
+	__ni_timer_heap_set(heap, index, timer);
+}
+
+static void
+__ni_timer_heap_sift_down(ni_timer_heap_t *heap, unsigned int index)
+{
+	ni_timer_t *timer = heap->data[index];
+	unsigned int child;
+
+	while ((child = 2 * index + 1) < heap->count) {
+		if (child + 1 < heap->count &&
+		    __ni_timer_before(heap->data[child + 1], heap->data[child]))
+			child++;
+		if (!__ni_timer_before(heap->data[child], timer))
+			break;
+		__ni_timer_heap_set(heap, index, heap->data[child]);
+		index = child;
+	}
+	__ni_timer_heap_set(heap, index, timer);
+}
+
+static void
+__ni_timer_heap_insert(ni_timer_heap_t *heap, ni_timer_t *timer)
+{
+	if (heap->count == heap->size) {
+		heap->size += NI_TIMER_HEAP_CHUNK;
+		heap->data = xrealloc(heap->data, heap->size * sizeof(ni_timer_t *));
+	}
+	heap->data[heap->count] = timer;
+	__ni_timer_heap_sift_up(heap, heap->count++);
+}
+
+static void
+__ni_timer_heap_delete(ni_timer_heap_t *heap, ni_timer_t *timer)
+{
+	unsigned int index = timer->index;
+	ni_timer_t *last;
+
+	timer->index = NI_TIMER_INACTIVE;
+	last = heap->data[--heap->count];
+	heap->data[heap->count] = NULL;
+	if (last == timer)
+		return;
+
+	__ni_timer_heap_set(heap, index, last);
+	if (index > 0 && __ni_timer_before(last, heap->data[(index - 1) / 2]))
+		__ni_timer_heap_sift_up(heap, index);
+	else
+		__ni_timer_heap_sift_down(heap, index);
+}
+
 long
 ni_timer_next_timeout(void)
 {
@@ -81,8 +221,10 @@ ni_timer_next_timeout(void)
 	ni_timer_t *timer;
 	long timeout;
 
-	ni_timer_get_time(&now);
-	while ((timer = ni_timer_list) != NULL) {
+	__ni_timer_monotonic(&now);
+	while (ni_timer_heap.count) {
+		timer = ni_timer_heap.data[0];
+
 		if (!timercmp(&timer->expires, &now, <)) {
 			timersub(&timer->expires, &now, &delta);
 			timeout = delta.tv_sec * 1000 + delta.tv_usec / 1000;
@@ -97,9 +239,9 @@ ni_timer_next_timeout(void)
 				__func__, timer,
 				(long) now.tv_sec, (long) now.tv_usec,
 				(long) timer->expires.tv_sec, (long) timer->expires.tv_usec);
-		ni_timer_list = timer->next;
+		__ni_timer_heap_delete(&ni_timer_heap, timer);
 		timer->callback(timer->user_data, timer);
-		free(timer);
+		__ni_timer_free(timer);
 	}
 
 	return -1;
@@ -108,11 +250,11 @@ ni_timer_next_timeout(void)
 static void
 __ni_timer_arm(ni_timer_t *timer, unsigned long timeout)
 {
-	ni_timer_t *tail, **pos;
+	static unsigned long seq_counter;
 
 	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
 			"%s: timer %p timeout %lu", __func__, timer, timeout);
-	ni_timer_get_time(&timer->expires);
+	__ni_timer_monotonic(&timer->expires);
 	timer->expires.tv_sec += timeout / 1000;
 	timer->expires.tv_usec += (timeout % 1000) * 1000;
 	if (timer->expires.tv_usec >= 1000000) {
@@ -120,34 +262,44 @@ __ni_timer_arm(ni_timer_t *timer, unsigned long timeout)
 		timer->expires.tv_usec -= 1000000;
 	}
 
-	for (pos = &ni_timer_list; (tail = *pos) != NULL; pos = &tail->next) {
-		if (timercmp(&timer->expires, &tail->expires, <))
-			break;
-	}
-
-	timer->next = tail;
-	*pos = timer;
+	timer->seq = seq_counter++;
+	__ni_timer_heap_insert(&ni_timer_heap, timer);
 }
 
 static ni_timer_t *
 __ni_timer_disarm(const ni_timer_t *handle)
 {
-	ni_timer_t **pos, *timer;
+	ni_timer_t *timer = (ni_timer_t *) handle;
 
-	for (pos = &ni_timer_list; (timer = *pos) != NULL; pos = &timer->next) {
-		if (timer == handle) {
-			*pos = timer->next;
-			timer->next = NULL;
-			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
-					"%s: timer %p found", __func__, handle);
-			return timer;
-		}
+	if (timer && timer->index < ni_timer_heap.count &&
+	    ni_timer_heap.data[timer->index] == timer) {
+		__ni_timer_heap_delete(&ni_timer_heap, timer);
+		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
+				"%s: timer %p found", __func__, handle);
+		return timer;
 	}
 	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
 			"%s: timer %p NOT found", __func__, handle);
 	return NULL;
 }
 
+/*
+ * Timer expiry is based on the monotonic clock, so timers are not
+ * affected by wallclock adjustments (e.g. ntp or manual date changes).
+ */
+static void
+__ni_timer_monotonic(struct timeval *tv)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		gettimeofday(tv, NULL);
+		return;
+	}
+	tv->tv_sec = ts.tv_sec;
+	tv->tv_usec = ts.tv_nsec / 1000;
+}
+
 int
 ni_timer_get_time(struct timeval *tv)
 {
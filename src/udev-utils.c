@@ -34,6 +34,7 @@
 #include <wicked/util.h>
 #include <wicked/netinfo.h>
 
+#include "netinfo_priv.h"
 #include "udev-utils.h"
 #include "process.h"
 #include "buffer.h"
@@ -315,9 +316,7 @@ ni_udev_netdev_update_name(ni_netdev_t *dev)
 	if (ni_string_empty(ifname))
 		return -1; /* device seems to be gone */
 
-	if (!ni_string_eq(dev->name, ifname))
-		ni_string_dup(&dev->name, ifname);
-
+	ni_netconfig_device_rename(ni_global_state_handle(0), dev, ifname);
 	return 0;
 }
 
@@ -668,8 +668,7 @@ __ni_uevent_ifevent_forwarder(const ni_var_array_t *vars, void *user_data)
 		if (!(ifname = if_indextoname(dev->link.ifindex, namebuf)))
 			return; /* device gone in the meantime */
 
-		if (!ni_string_eq(dev->name, ifname))
-			ni_string_dup(&dev->name, ifname);
+		ni_netconfig_device_rename(nc, dev, ifname);
 
 		dev->link.ifflags |= NI_IFF_DEVICE_READY;
 		__ni_netdev_process_events(nc, dev, old_flags);
@@ -2691,6 +2691,95 @@ xrealloc(void *ptr, size_t size)
 	return p;
 }
 
+/*
+ * Object pools
+ *
+ * Pooled objects are plain heap objects, linked into the free list
+ * through their first word when released. Building with
+ * NI_OBJPOOL_DISABLE or setting WICKED_OBJPOOL_DISABLE=yes in the
+ * environment bypasses the free list, so valgrind or ASan see every
+ * use after free.
+ */
+typedef struct ni_objpool_free	ni_objpool_free_t;
+struct ni_objpool_free {
+	ni_objpool_free_t *	next;
+};
+
+static ni_bool_t
+ni_objpool_disabled(void)
+{
+#ifdef NI_OBJPOOL_DISABLE
+	return TRUE;
+#else
+	static int disabled = -1;
+	ni_bool_t value = FALSE;
+
+	if (disabled < 0) {
+		ni_parse_boolean(getenv("WICKED_OBJPOOL_DISABLE"), &value);
+		disabled = value;
+	}
+	return disabled;
+#endif
+}
+
+static inline size_t
+ni_objpool_objsize(const ni_objpool_t *pool)
+{
+	if (pool->size < sizeof(ni_objpool_free_t))
+		return sizeof(ni_objpool_free_t);
+	return pool->size;
+}
+
+void *
+ni_objpool_alloc(ni_objpool_t *pool)
+{
+	ni_objpool_free_t *obj;
+
+	if ((obj = pool->free)) {
+		pool->free = obj->next;
+		pool->count--;
+		pool->stats.reused++;
+		memset(obj, 0, pool->size);
+	} else {
+		obj = xcalloc(1, ni_objpool_objsize(pool));
+	}
+
+	pool->stats.allocs++;
+	if (++pool->stats.inuse > pool->stats.peak)
+		pool->stats.peak = pool->stats.inuse;
+	return obj;
+}
+
+void
+ni_objpool_free(ni_objpool_t *pool, void *ptr)
+{
+	ni_objpool_free_t *obj = ptr;
+
+	if (!obj)
+		return;
+
+	pool->stats.frees++;
+	pool->stats.inuse--;
+	if (pool->count >= pool->limit || ni_objpool_disabled()) {
+		free(obj);
+		return;
+	}
+
+	obj->next = pool->free;
+	pool->free = obj;
+	pool->count++;
+}
+
+void
+ni_objpool_trace(const ni_objpool_t *pool)
+{
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_WICKED,
+		"%s pool: %u in use, %u peak, %u of %u free, %lu allocs, %lu reused, %lu frees",
+		pool->name, pool->stats.inuse, pool->stats.peak,
+		pool->count, pool->limit, pool->stats.allocs,
+		pool->stats.reused, pool->stats.frees);
+}
+
 ni_bool_t
 ni_try_mlock(const void *ptr, size_t len)
 {
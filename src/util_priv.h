@@ -14,6 +14,37 @@ extern void *	xrealloc(void *, size_t);
 
 extern char *	xstrdup(const char *);
 
+/*
+ * Pools for small, frequently allocated objects, e.g. the addresses
+ * and routes refreshed from rtnetlink. Up to limit freed objects are
+ * kept on a free list for reuse by the next refresh, the others are
+ * returned to the heap.
+ */
+typedef struct ni_objpool_stats {
+	unsigned int		inuse;
+	unsigned int		peak;
+	unsigned long		allocs;
+	unsigned long		reused;
+	unsigned long		frees;
+} ni_objpool_stats_t;
+
+typedef struct ni_objpool {
+	const char *		name;
+	size_t			size;
+	unsigned int		limit;
+
+	void *			free;
+	unsigned int		count;
+	ni_objpool_stats_t	stats;
+} ni_objpool_t;
+
+#define NI_OBJPOOL_INIT(_name, _type, _limit) \
+	{ .name = _name, .size = sizeof(_type), .limit = _limit }
+
+extern void *	ni_objpool_alloc(ni_objpool_t *);
+extern void	ni_objpool_free(ni_objpool_t *, void *);
+extern void	ni_objpool_trace(const ni_objpool_t *);
+
 #endif /* __WICKED_UTIL_PRIV_H__ */
 
 
@@ -26,10 +26,13 @@
 #endif
 
 #include <ctype.h>
+#include <string.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 
 #include <wicked/xml.h>
 #include <wicked/logging.h>
+#include "util_priv.h"
 #include "buffer.h"
 
 #undef XMLDEBUG_PARSER
@@ -52,22 +55,25 @@ typedef enum {
 	Comment,
 } xml_token_type_t;
 
-#define XML_READER_BUFSZ	512
+#define XML_READER_BUFSZ	4096
 typedef struct xml_reader {
 	const char *		filename;
 
 	ni_buffer_t *		in_buffer;
 
 	FILE *			file;
-	unsigned char *		buffer;		/* FIXME: use in_buffer for this as well */
-
 	unsigned int		no_close : 1;
 
 	char *			doctype;
 
-	/* This pointer must be unsigned char, else 0xFF would
+	/* The input is scanned in bulk from one contiguous span: either
+	 * the caller's in_buffer, or the whole file read into data.
+	 * These pointers must be unsigned char, else 0xFF would
 	 * be expanded to EOF */
-	unsigned char *		pos;
+	unsigned char *		data;
+	const unsigned char *	base;
+	const unsigned char *	pos;
+	const unsigned char *	end;
 
 	xml_parser_state_t	state;
 	unsigned int		lineCount;
@@ -101,8 +107,67 @@ static int		xml_reader_init_file(xml_reader_t *xr, FILE *fp, const char *locatio
 static int		xml_reader_init_buffer(xml_reader_t *xr, ni_buffer_t *buf, const char *location);
 static int		xml_reader_open(xml_reader_t *xr, const char *filename);
 static int		xml_reader_destroy(xml_reader_t *xr);
-static int		xml_getc(xml_reader_t *xr);
-static void		xml_ungetc(xml_reader_t *xr, int cc);
+
+/*
+ * Input scanning primitives
+ */
+static inline int
+xml_getc(xml_reader_t *xr)
+{
+	int cc;
+
+	if (xr->pos >= xr->end)
+		return EOF;
+
+	cc = *xr->pos++;
+	if (cc == '\n')
+		xr->lineCount++;
+	return cc;
+}
+
+static inline void
+xml_ungetc(xml_reader_t *xr, int cc)
+{
+	if (cc == EOF)
+		return;
+
+	if (xr->pos == xr->base || xr->pos[-1] != cc) {
+		ni_error("xml_ungetc: cannot put back");
+		return;
+	}
+
+	if (cc == '\n')
+		xr->lineCount--;
+	xr->pos--;
+}
+
+/*
+ * Move the read position forward to @to, a pointer into the input
+ * span, while keeping the line count up to date.
+ */
+static inline void
+xml_advance(xml_reader_t *xr, const unsigned char *to)
+{
+	const unsigned char *nl = xr->pos;
+
+	while ((nl = memchr(nl, '\n', to - nl)) != NULL) {
+		xr->lineCount++;
+		nl++;
+	}
+	xr->pos = to;
+}
+
+/*
+ * Copy the input from the read position up to @to into @res,
+ * and move past it.
+ */
+static inline void
+xml_advance_copy(xml_reader_t *xr, const unsigned char *to, ni_stringbuf_t *res)
+{
+	if (res && to > xr->pos)
+		ni_stringbuf_put(res, (const char *) xr->pos, to - xr->pos);
+	xml_advance(xr, to);
+}
 
 /*
  * Document reader implementation
@@ -200,17 +265,19 @@ xml_node_t *
 xml_node_scan(FILE *fp, const char *location)
 {
 	xml_reader_t reader;
-	xml_node_t *root = xml_node_new(NULL, NULL);
+	xml_node_t *root;
 
 	if (xml_reader_init_file(&reader, fp, location) < 0)
 		return NULL;
 
+	root = xml_node_new(NULL, NULL);
 	if (reader.shared_location)
 		root->location = xml_location_new(reader.shared_location, reader.lineCount);
 
 	/* Note! We do not deal with properly formatted XML documents here.
 	 * Specifically, we do not expect them to have a document header. */
 	if (!xml_process_element_nested(&reader, root, 0)) {
+		xml_reader_destroy(&reader);
 		xml_node_free(root);
 		return NULL;
 	}
@@ -246,11 +313,16 @@ xml_process_element_nested(xml_reader_t *xr, xml_node_t *cur, unsigned int nesti
 {
 	ni_stringbuf_t tokenValue, identifier;
 	xml_token_type_t token;
-	xml_node_t *child;
+	xml_node_t *child, **tail;
 
 	ni_stringbuf_init(&tokenValue);
 	ni_stringbuf_init(&identifier);
 
+	/* Append children via a tail pointer rather than having
+	 * xml_node_add_child walk the list for every element */
+	for (tail = &cur->children; *tail; tail = &(*tail)->next)
+		;
+
 	while (1) {
 		token = xml_get_token(xr, &tokenValue);
 
@@ -292,7 +364,10 @@ xml_process_element_nested(xml_reader_t *xr, xml_node_t *cur, unsigned int nesti
 				goto error;
 			}
 
-			child = xml_node_new(identifier.string, cur);
+			child = xml_node_new(identifier.string, NULL);
+			child->parent = cur;
+			*tail = child;
+			tail = &child->next;
 			if (xr->shared_location)
 				child->location = xml_location_new(xr->shared_location, xr->lineCount);
 
@@ -427,7 +502,8 @@ xml_get_tag_attributes(xml_reader_t *xr, xml_node_t *node)
 			break;
 		}
 
-		ni_stringbuf_move(&attrName, &tokenValue);
+		ni_stringbuf_truncate(&attrName, 0);
+		ni_stringbuf_put(&attrName, tokenValue.string, tokenValue.len);
 
 		token = xml_get_token(xr, &tokenValue);
 		if (token != Equals) {
@@ -443,7 +519,8 @@ xml_get_tag_attributes(xml_reader_t *xr, xml_node_t *node)
 		}
 
 		xml_debug("  attr %s=%s\n", attrName.string, tokenValue.string);
-		xml_node_add_attr(node, attrName.string, tokenValue.string);
+		xml_node_add_attr(node, attrName.string,
+				tokenValue.len ? tokenValue.string : NULL);
 
 		token = xml_get_token(xr, &tokenValue);
 	}
@@ -465,7 +542,8 @@ xml_get_token(xml_reader_t *xr, ni_stringbuf_t *res)
 #endif
 	xml_token_type_t token;
 
-	ni_stringbuf_clear(res);
+	/* Keep the buffer allocated, it's reused for the next token */
+	ni_stringbuf_truncate(res, 0);
 	switch (xr->state) {
 	default:
 		xml_parse_error(xr, "Unexpected state %u in XML reader", xr->state);
@@ -506,13 +584,13 @@ restart:
 
 	cc = xml_getc(xr);
 	if (cc == EOF) {
-		ni_stringbuf_clear(res);
+		ni_stringbuf_truncate(res, 0);
 		return EndOfDocument;
 	}
 
 	if (cc == '<') {
 		/* Discard the white space in @res - we're not interested in that. */
-		ni_stringbuf_clear(res);
+		ni_stringbuf_truncate(res, 0);
 
 		ni_stringbuf_putc(res, cc);
 
@@ -546,7 +624,7 @@ restart:
 			token = xml_skip_comment(xr);
 			if (token == Comment) {
 				xr->state = Initial;
-				ni_stringbuf_clear(res);
+				ni_stringbuf_truncate(res, 0);
 				goto restart;
 			}
 			return token;
@@ -559,23 +637,26 @@ restart:
 
 	// Looks like CDATA. 
 	// Ignore initial newline, then scan to next <
-	do {
-		if (cc == '<') {
+	xml_ungetc(xr, cc);
+	while (xr->pos < xr->end) {
+		const unsigned char *p;
+
+		/* Copy everything up to the next markup or entity in one go */
+		for (p = xr->pos; p < xr->end && *p != '<' && *p != '&'; ++p)
+			;
+		xml_advance_copy(xr, p, res);
+
+		if (p == xr->end || *p == '<') {
 			/* Looks like we're done.
 			 * FIXME: handle comments within CDATA?
 			 */
-			xml_ungetc(xr, cc);
 			break;
-		} else
-		if (cc == '&') {
-			if (!xml_expand_entity(xr, res))
-				return None;
-		} else {
-			ni_stringbuf_putc(res, cc);
 		}
 
-		cc = xml_getc(xr);
-	} while (cc != EOF);
+		xr->pos++;
+		if (!xml_expand_entity(xr, res))
+			return None;
+	}
 
 	ni_stringbuf_trim_empty_lines(res);
 
@@ -586,7 +667,8 @@ restart:
 xml_token_type_t
 xml_get_token_tag(xml_reader_t *xr, ni_stringbuf_t *res)
 {
-	int cc, oc;
+	const unsigned char *p;
+	int cc;
 
 	xml_skip_space(xr, NULL);
 
@@ -627,29 +709,25 @@ xml_get_token_tag(xml_reader_t *xr, ni_stringbuf_t *res)
 	case 'A' ... 'Z':
 	case '_':
 	case '!':
-		while ((cc = xml_getc(xr)) != EOF) {
-			if (!isalnum(cc) && cc != '_' && cc != '!' && cc != ':' && cc != '-') {
-				xml_ungetc(xr, cc);
+		for (p = xr->pos; p < xr->end; ++p) {
+			cc = *p;
+			if (!isalnum(cc) && cc != '_' && cc != '!' && cc != ':' && cc != '-')
 				break;
-			}
-			ni_stringbuf_putc(res, cc);
 		}
+		xml_advance_copy(xr, p, res);
 		return Identifier;
 
 	case '\'':
 	case '"':
-		ni_stringbuf_clear(res);
-		oc = cc;
-		while (1) {
-			cc = xml_getc(xr);
-			if (cc == EOF) {
-				xml_parse_error(xr, "Unexpected EOF while parsing quoted string");
-				return None;
-			}
-			if (cc == oc)
-				break;
-			ni_stringbuf_putc(res, cc);
+		ni_stringbuf_truncate(res, 0);
+		p = memchr(xr->pos, cc, xr->end - xr->pos);
+		if (p == NULL) {
+			xml_advance(xr, xr->end);
+			xml_parse_error(xr, "Unexpected EOF while parsing quoted string");
+			return None;
 		}
+		xml_advance_copy(xr, p, res);
+		xr->pos++;
 		return QuotedString;
 
 	default:
@@ -667,29 +745,25 @@ error:
 xml_token_type_t
 xml_skip_comment(xml_reader_t *xr)
 {
-	int match = 0, cc;
+	const unsigned char *p;
 
 	if (xml_getc(xr) != '-') {
 		xml_parse_error(xr, "Unexpected <!-...> element");
 		return None;
 	}
 
-	while ((cc = xml_getc(xr)) != EOF) {
-		if (cc == '-') {
-			match++;
-		} else {
-			if (cc == '>' && match >= 2) {
-#ifdef XMLDEBUG_PARSER
-				xml_debug("Processed comment\n");
-#endif
-				return Comment;
-			}
-			match = 0;
-		}
+	p = memmem(xr->pos, xr->end - xr->pos, "-->", 3);
+	if (p == NULL) {
+		xml_advance(xr, xr->end);
+		xml_parse_error(xr, "Unexpected end of file while parsing comment");
+		return None;
 	}
 
-	xml_parse_error(xr, "Unexpected end of file while parsing comment");
-	return None;
+	xml_advance(xr, p + 3);
+#ifdef XMLDEBUG_PARSER
+	xml_debug("Processed comment\n");
+#endif
+	return Comment;
 }
 
 
@@ -754,17 +828,11 @@ good:
 void
 xml_skip_space(xml_reader_t *xr, ni_stringbuf_t *result)
 {
-	int cc;
+	const unsigned char *p;
 
-	while ((cc = xml_getc(xr)) != EOF) {
-		if (!isspace(cc)) {
-			xml_ungetc(xr, cc);
-			break;
-		}
-
-		if (result)
-			ni_stringbuf_putc(result, cc);
-	}
+	for (p = xr->pos; p < xr->end && isspace(*p); ++p)
+		;
+	xml_advance_copy(xr, p, result);
 }
 
 void
@@ -849,6 +917,8 @@ xml_debug(const char *fmt, ...)
 /*
  * Location handling
  */
+static ni_objpool_t		xml_location_pool = NI_OBJPOOL_INIT("xml location", xml_location_t, 1024);
+
 inline const char *
 xml_node_location_filename(const xml_node_t *node)
 {
@@ -912,7 +982,7 @@ xml_location_new(struct xml_location_shared *shared_location, unsigned int line)
 	xml_location_t *location;
 
 	shared_location->refcount++;
-	location = xcalloc(1, sizeof(*location));
+	location = ni_objpool_alloc(&xml_location_pool);
 	location->shared = shared_location;
 	location->line = line;
 
@@ -1002,28 +1072,64 @@ void
 xml_location_free(xml_location_t *loc)
 {
 	xml_location_shared_release(loc->shared);
-	free(loc);
+	ni_objpool_free(&xml_location_pool, loc);
 }
 
 /*
  * XML Reader object
  */
-static int
-xml_reader_open(xml_reader_t *xr, const char *filename)
+static void
+xml_reader_init(xml_reader_t *xr, const char *filename)
 {
 	memset(xr, 0, sizeof(*xr));
 	xr->filename = filename;
+	xr->state = Initial;
+	xr->lineCount = 1;
+	xr->shared_location = xml_location_shared_new(filename);
+}
+
+/*
+ * Read the remaining file content in one go, so the parser can scan
+ * it in bulk rather than fetching it a line at a time.
+ */
+static void
+xml_reader_read_file(xml_reader_t *xr)
+{
+	size_t size = XML_READER_BUFSZ, len = 0, n;
+	struct stat stb;
+
+	if (fstat(fileno(xr->file), &stb) == 0 && S_ISREG(stb.st_mode)
+	 && stb.st_size >= XML_READER_BUFSZ)
+		size = stb.st_size + 1;
+
+	xr->data = xmalloc(size);
+	while (1) {
+		if (len == size) {
+			size *= 2;
+			xr->data = xrealloc(xr->data, size);
+		}
+		if ((n = fread(xr->data + len, 1, size - len, xr->file)) == 0)
+			break;
+		len += n;
+	}
+
+	xr->base = xr->pos = xr->data;
+	xr->end = xr->data + len;
+}
+
+static int
+xml_reader_open(xml_reader_t *xr, const char *filename)
+{
+	xml_reader_init(xr, filename);
 
 	xr->file = fopen(filename, "r");
 	if (xr->file == NULL) {
 		ni_error("Unable to open %s: %m", filename);
+		xml_reader_destroy(xr);
 		return -1;
 	}
 
-	xr->buffer = xmalloc(XML_READER_BUFSZ);
-	xr->state = Initial;
-	xr->lineCount = 1;
-	xr->shared_location = xml_location_shared_new(filename);
+	xml_reader_read_file(xr);
 	return 0;
 }
 
@@ -1033,16 +1139,11 @@ xml_reader_init_file(xml_reader_t *xr, FILE *fp, const char *location)
 	if (ni_string_empty(location))
 		location = "<stdin>";
 
-	memset(xr, 0, sizeof(*xr));
-	xr->filename = location;
+	xml_reader_init(xr, location);
 	xr->file = fp;
 	xr->no_close = 1;
 
-	xr->buffer = xmalloc(XML_READER_BUFSZ);
-	xr->state = Initial;
-	xr->lineCount = 1;
-	xr->shared_location = xml_location_shared_new(location);
-
+	xml_reader_read_file(xr);
 	return 0;
 }
 
@@ -1052,15 +1153,13 @@ xml_reader_init_buffer(xml_reader_t *xr, ni_buffer_t *buf, const char *location)
 	if (ni_string_empty(location))
 		location = "<buffer>";
 
-	memset(xr, 0, sizeof(*xr));
-	xr->filename = location;
+	xml_reader_init(xr, location);
 	xr->in_buffer = buf;
 	xr->no_close = 1;
 
-	xr->state = Initial;
-	xr->lineCount = 1;
-	xr->shared_location = xml_location_shared_new(location);
-
+	xr->base = buf->base;
+	xr->pos = buf->base + buf->head;
+	xr->end = buf->base + buf->tail;
 	return 0;
 }
 
@@ -1069,84 +1168,28 @@ xml_reader_destroy(xml_reader_t *xr)
 {
 	int rv = 0;
 
+	if (xr->in_buffer) {
+		/* Consume what we parsed, just like ni_buffer_getc would */
+		xr->in_buffer->head = xr->pos - xr->base;
+		xr->in_buffer = NULL;
+	}
+
 	if (xr->file && ferror(xr->file))
 		rv = -1;
 	if (xr->file && !xr->no_close) {
 		fclose(xr->file);
 		xr->file = NULL;
 	}
-	if (xr->buffer) {
-		free(xr->buffer);
-		xr->buffer = NULL;
+	if (xr->data) {
+		free(xr->data);
+		xr->data = NULL;
 	}
+	xr->base = xr->pos = xr->end = NULL;
 
+	ni_string_free(&xr->doctype);
 	if (xr->shared_location) {
 		xml_location_shared_release(xr->shared_location);
 		xr->shared_location = NULL;
 	}
 	return rv;
 }
-
-int
-xml_getc(xml_reader_t *xr)
-{
-	int cc;
-
-	if (xr->in_buffer) {
-		cc = ni_buffer_getc(xr->in_buffer);
-		if (cc == '\n')
-			xr->lineCount++;
-		return cc;
-	}
-
-	while (1) {
-		if (xr->pos) {
-			cc = *xr->pos++;
-			if (cc == '\n')
-				xr->lineCount++;
-			if (cc != '\0')
-				return cc;
-			xr->pos = NULL;
-		}
-
-		if (xr->file == NULL) {
-			/* Parsing just a string, no file backing */
-			break;
-		}
-
-		if (fgets((char *)xr->buffer, XML_READER_BUFSZ, xr->file) == NULL)
-			break;
-
-		xr->pos = xr->buffer;
-	}
-
-	return EOF;
-}
-
-void
-xml_ungetc(xml_reader_t *xr, int cc)
-{
-	if (xr->in_buffer) {
-		if (ni_buffer_ungetc(xr->in_buffer, cc) < 0)
-			ni_error("xml_ungetc: cannot put back");
-		if (cc == '\n')
-			xr->lineCount--;
-		return;
-	}
-
-	if (xr->pos == NULL
-	 || xr->pos == xr->buffer
-	 || xr->pos[-1] != cc) {
-		ni_error("xml_ungetc: cannot put back");
-		ni_error("  buffer=%p pos=%p *pos=0x%x cc=0x%x",
-				xr->buffer, xr->pos,
-				xr->pos? xr->pos[-1] : 0,
-				cc);
-		return;
-	}
-
-	if (cc == '\n')
-		xr->lineCount--;
-	xr->pos--;
-}
-
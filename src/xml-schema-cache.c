@@ -0,0 +1,1649 @@
+/*
+ * Binary cache of the compiled dbus xml schema.
+ *
+ * Building the schema scopes means parsing wicked.xml and every file it
+ * includes, and compiling all the type, service and method definitions,
+ * on each client invocation and daemon start. The cache stores the
+ * compiled scope tree as a flat, mmap-able stream of records referring
+ * to a string table. Types, groups and constraint maps are stored once
+ * and referred to by their index, so the loader rebuilds the same
+ * sharing of objects as ni_xs_process_schema() creates.
+ *
+ * The cache is keyed by the SHA1 digests of all schema files it was
+ * built from. Their size, mtime and inode are recorded as well, so an
+ * up to date cache is validated by a stat of each file; a file is read
+ * and hashed only when these differ. The cache data itself is protected
+ * by a checksum in the header.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <wicked/logging.h>
+#include <wicked/xml.h>
+#include "xml-schema.h"
+#include "buffer.h"
+#include "util_priv.h"
+
+#define NI_XS_CACHE_MAGIC	"WXSCACHE"
+#define NI_XS_CACHE_VERSION	2
+#define NI_XS_CACHE_DIGEST_LEN	20		/* SHA1 */
+#define NI_XS_CACHE_NONE	UINT32_MAX
+#define NI_XS_CACHE_MAX_FILES	256
+#define NI_XS_CACHE_MAX_DEPTH	64
+#define NI_XS_CACHE_MAX_SIZE	(64 * 1024 * 1024)
+
+typedef struct ni_xs_cache_header {
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		byteorder;
+	uint32_t		total_size;
+	uint32_t		nfiles;
+	uint32_t		nwords;
+	uint32_t		strtab_size;
+
+	/* number of objects in the record stream */
+	uint32_t		nbase;
+	uint32_t		ngroups;
+	uint32_t		nintmaps;
+	uint32_t		nranges;
+	uint32_t		ntypes;
+	uint32_t		nscopes;
+	uint32_t		nservices;
+	uint32_t		checksum;	/* of all data following the header */
+} ni_xs_cache_header_t;
+
+typedef struct ni_xs_cache_file {
+	uint64_t		size;
+	uint64_t		mtime_sec;
+	uint64_t		mtime_nsec;
+	uint64_t		ino;
+	uint64_t		dev;
+	uint32_t		name;
+	unsigned char		digest[NI_XS_CACHE_DIGEST_LEN];
+} ni_xs_cache_file_t;
+
+/*
+ * Map of the objects already written to their index
+ */
+typedef struct ni_xs_cache_ptrmap {
+	unsigned int		size;
+	unsigned int		count;
+	const void **		keys;
+	uint32_t *		ids;
+} ni_xs_cache_ptrmap_t;
+
+typedef struct ni_xs_cache_writer {
+	const ni_xs_scope_t *	root;
+	unsigned int		nbase;
+
+	ni_buffer_t		strtab;
+	ni_buffer_t		groups;
+	ni_buffer_t		intmaps;
+	ni_buffer_t		ranges;
+	ni_buffer_t		types;
+	ni_buffer_t		scopes;
+	ni_buffer_t		origdefs;
+
+	unsigned int		ngroups;
+	unsigned int		nintmaps;
+	unsigned int		nranges;
+	unsigned int		ntypes;
+	unsigned int		nscopes;
+	unsigned int		nservices;
+
+	ni_xs_cache_ptrmap_t	group_ids;
+	ni_xs_cache_ptrmap_t	intmap_ids;
+	ni_xs_cache_ptrmap_t	range_ids;
+	ni_xs_cache_ptrmap_t	type_ids;
+	ni_xs_cache_ptrmap_t	scope_ids;
+	ni_xs_cache_ptrmap_t	service_ids;
+} ni_xs_cache_writer_t;
+
+typedef struct ni_xs_cache_reader {
+	const ni_xs_cache_header_t *hdr;
+	const uint32_t *	words;
+	const char *		strtab;
+	unsigned int		pos;
+	ni_bool_t		error;
+
+	ni_xs_scope_t *		root;
+	ni_xs_group_t **	groups;
+	ni_xs_intmap_t **	intmaps;
+	ni_xs_range_t **	ranges;
+	ni_xs_type_t **		types;
+	ni_xs_scope_t **	scopes;
+	ni_xs_service_t **	services;
+	struct {
+		uint32_t	scope;
+		uint32_t	index;
+	} *			origdefs;
+
+	unsigned int		ngroups;
+	unsigned int		nintmaps;
+	unsigned int		nranges;
+	unsigned int		ntypes;
+	unsigned int		nscopes;
+	unsigned int		nservices;
+} ni_xs_cache_reader_t;
+
+static inline uint32_t
+ni_xs_cache_byteorder(void)
+{
+	return 0x01020304;
+}
+
+/*
+ * FNV-1a, to detect a damaged cache file
+ */
+static uint32_t
+ni_xs_cache_checksum(uint32_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--)
+		hash = (hash ^ *p++) * 16777619U;
+	return hash;
+}
+
+#define NI_XS_CACHE_CHECKSUM_INIT	2166136261U
+
+/*
+ * Pointer map
+ */
+static inline unsigned int
+ni_xs_cache_ptrmap_slot(const ni_xs_cache_ptrmap_t *map, const void *key)
+{
+	return (((uintptr_t) key >> 3) * 2654435761U) & (map->size - 1);
+}
+
+static uint32_t
+ni_xs_cache_ptrmap_get(const ni_xs_cache_ptrmap_t *map, const void *key)
+{
+	unsigned int slot;
+
+	if (!key || !map->size)
+		return NI_XS_CACHE_NONE;
+
+	for (slot = ni_xs_cache_ptrmap_slot(map, key); map->keys[slot];
+			slot = (slot + 1) & (map->size - 1)) {
+		if (map->keys[slot] == key)
+			return map->ids[slot];
+	}
+	return NI_XS_CACHE_NONE;
+}
+
+static void
+ni_xs_cache_ptrmap_set(ni_xs_cache_ptrmap_t *map, const void *key, uint32_t id)
+{
+	unsigned int slot;
+
+	if ((map->count + 1) * 2 > map->size) {
+		ni_xs_cache_ptrmap_t old = *map;
+		unsigned int i;
+
+		map->size = old.size ? old.size * 2 : 256;
+		map->count = 0;
+		map->keys = xcalloc(map->size, sizeof(map->keys[0]));
+		map->ids = xcalloc(map->size, sizeof(map->ids[0]));
+		for (i = 0; i < old.size; ++i) {
+			if (old.keys[i])
+				ni_xs_cache_ptrmap_set(map, old.keys[i], old.ids[i]);
+		}
+		free(old.keys);
+		free(old.ids);
+	}
+
+	for (slot = ni_xs_cache_ptrmap_slot(map, key); map->keys[slot];
+			slot = (slot + 1) & (map->size - 1))
+		;
+	map->keys[slot] = key;
+	map->ids[slot] = id;
+	map->count++;
+}
+
+static void
+ni_xs_cache_ptrmap_destroy(ni_xs_cache_ptrmap_t *map)
+{
+	free(map->keys);
+	free(map->ids);
+	memset(map, 0, sizeof(*map));
+}
+
+/*
+ * Schema source files
+ */
+static ni_bool_t
+ni_xs_cache_digest_file(const char *filename, size_t *lenp, unsigned char *digest)
+{
+	ni_hashctx_t *ctx;
+	ni_bool_t rv = FALSE;
+	void *data;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "re")))
+		return FALSE;
+
+	data = ni_file_read(fp, lenp, NI_XS_CACHE_MAX_SIZE);
+	fclose(fp);
+	if (data == NULL)
+		return FALSE;
+
+	if ((ctx = ni_hashctx_new(NI_HASHCTX_SHA1))) {
+		ni_hashctx_put(ctx, data, *lenp);
+		ni_hashctx_finish(ctx);
+		rv = ni_hashctx_get_digest(ctx, digest, NI_XS_CACHE_DIGEST_LEN) == NI_XS_CACHE_DIGEST_LEN;
+		ni_hashctx_free(ctx);
+	}
+	free(data);
+	return rv;
+}
+
+static void
+ni_xs_cache_file_set_stat(ni_xs_cache_file_t *cf, const struct stat *stb)
+{
+	cf->size = stb->st_size;
+	cf->mtime_sec = stb->st_mtim.tv_sec;
+	cf->mtime_nsec = stb->st_mtim.tv_nsec;
+	cf->ino = stb->st_ino;
+	cf->dev = stb->st_dev;
+}
+
+static ni_bool_t
+ni_xs_cache_file_stat_equal(const ni_xs_cache_file_t *cf, const struct stat *stb)
+{
+	return cf->size == (uint64_t) stb->st_size
+	    && cf->mtime_sec == (uint64_t) stb->st_mtim.tv_sec
+	    && cf->mtime_nsec == (uint64_t) stb->st_mtim.tv_nsec
+	    && cf->ino == (uint64_t) stb->st_ino
+	    && cf->dev == (uint64_t) stb->st_dev;
+}
+
+/*
+ * Write the compiled schema
+ */
+static void
+ni_xs_cache_put_word(ni_buffer_t *bp, uint32_t word)
+{
+	ni_buffer_ensure_tailroom(bp, sizeof(word));
+	ni_buffer_put(bp, &word, sizeof(word));
+}
+
+static void
+ni_xs_cache_put_u64(ni_buffer_t *bp, uint64_t value)
+{
+	ni_xs_cache_put_word(bp, value & 0xffffffff);
+	ni_xs_cache_put_word(bp, value >> 32);
+}
+
+static uint32_t
+ni_xs_cache_string(ni_xs_cache_writer_t *w, const char *string)
+{
+	uint32_t offset;
+	size_t len;
+
+	if (string == NULL)
+		return NI_XS_CACHE_NONE;
+
+	len = strlen(string) + 1;
+	offset = ni_buffer_count(&w->strtab);
+	ni_buffer_ensure_tailroom(&w->strtab, len);
+	ni_buffer_put(&w->strtab, string, len);
+	return offset;
+}
+
+static void
+ni_xs_cache_put_string(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const char *string)
+{
+	ni_xs_cache_put_word(bp, ni_xs_cache_string(w, string));
+}
+
+static void
+ni_xs_cache_put_vars(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const ni_var_array_t *vars)
+{
+	unsigned int i;
+
+	ni_xs_cache_put_word(bp, vars->count);
+	for (i = 0; i < vars->count; ++i) {
+		ni_xs_cache_put_string(w, bp, vars->data[i].name);
+		ni_xs_cache_put_string(w, bp, vars->data[i].value);
+	}
+}
+
+static void
+ni_xs_cache_put_node(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const xml_node_t *node)
+{
+	const xml_node_t *child;
+	unsigned int count;
+
+	if (node == NULL || node->name == NULL) {
+		ni_xs_cache_put_word(bp, NI_XS_CACHE_NONE);
+		return;
+	}
+
+	ni_xs_cache_put_string(w, bp, node->name);
+	ni_xs_cache_put_string(w, bp, node->cdata);
+	ni_xs_cache_put_vars(w, bp, &node->attrs);
+
+	for (count = 0, child = node->children; child; child = child->next)
+		count++;
+	ni_xs_cache_put_word(bp, count);
+	for (child = node->children; child; child = child->next)
+		ni_xs_cache_put_node(w, bp, child);
+}
+
+static uint32_t
+ni_xs_cache_put_group(ni_xs_cache_writer_t *w, const ni_xs_group_t *group)
+{
+	uint32_t id;
+
+	if (group == NULL)
+		return NI_XS_CACHE_NONE;
+	if ((id = ni_xs_cache_ptrmap_get(&w->group_ids, group)) != NI_XS_CACHE_NONE)
+		return id;
+
+	ni_xs_cache_put_word(&w->groups, group->relation);
+	ni_xs_cache_put_string(w, &w->groups, group->name);
+
+	id = w->ngroups++;
+	ni_xs_cache_ptrmap_set(&w->group_ids, group, id);
+	return id;
+}
+
+static uint32_t
+ni_xs_cache_put_intmap(ni_xs_cache_writer_t *w, const ni_xs_intmap_t *map)
+{
+	const ni_intmap_t *bit;
+	unsigned int count;
+	uint32_t id;
+
+	if (map == NULL)
+		return NI_XS_CACHE_NONE;
+	if ((id = ni_xs_cache_ptrmap_get(&w->intmap_ids, map)) != NI_XS_CACHE_NONE)
+		return id;
+
+	for (count = 0, bit = map->bits; bit && bit->name; ++bit)
+		count++;
+	ni_xs_cache_put_word(&w->intmaps, count);
+	for (bit = map->bits; bit && bit->name; ++bit) {
+		ni_xs_cache_put_string(w, &w->intmaps, bit->name);
+		ni_xs_cache_put_word(&w->intmaps, bit->value);
+	}
+
+	id = w->nintmaps++;
+	ni_xs_cache_ptrmap_set(&w->intmap_ids, map, id);
+	return id;
+}
+
+static uint32_t
+ni_xs_cache_put_range(ni_xs_cache_writer_t *w, const ni_xs_range_t *range)
+{
+	uint32_t id;
+
+	if (range == NULL)
+		return NI_XS_CACHE_NONE;
+	if ((id = ni_xs_cache_ptrmap_get(&w->range_ids, range)) != NI_XS_CACHE_NONE)
+		return id;
+
+	ni_xs_cache_put_u64(&w->ranges, range->min);
+	ni_xs_cache_put_u64(&w->ranges, range->max);
+
+	id = w->nranges++;
+	ni_xs_cache_ptrmap_set(&w->range_ids, range, id);
+	return id;
+}
+
+static uint32_t		ni_xs_cache_put_type(ni_xs_cache_writer_t *, const ni_xs_type_t *);
+
+static ni_bool_t
+ni_xs_cache_put_name_type_deps(ni_xs_cache_writer_t *w, const ni_xs_name_type_array_t *array,
+				unsigned int first)
+{
+	unsigned int i;
+
+	for (i = first; i < array->count; ++i) {
+		if (ni_xs_cache_put_type(w, array->data[i].type) == NI_XS_CACHE_NONE)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+ni_xs_cache_put_name_types(ni_xs_cache_writer_t *w, ni_buffer_t *bp,
+				const ni_xs_name_type_array_t *array, unsigned int first)
+{
+	const ni_xs_name_type_t *nt;
+	unsigned int i;
+
+	ni_xs_cache_put_word(bp, array->count - first);
+	for (i = first; i < array->count; ++i) {
+		nt = &array->data[i];
+		ni_xs_cache_put_string(w, bp, nt->name);
+		ni_xs_cache_put_word(bp, ni_xs_cache_ptrmap_get(&w->type_ids, nt->type));
+		ni_xs_cache_put_string(w, bp, nt->description);
+		ni_xs_cache_put_word(bp, nt->on_demand);
+	}
+}
+
+/*
+ * The name of a type refers to its entry in the scope it has been
+ * defined in; types defined in a temporary scope have none.
+ */
+static void
+ni_xs_cache_put_origdef(ni_xs_cache_writer_t *w, const ni_xs_type_t *type)
+{
+	const ni_xs_scope_t *scope = type->origdef.scope;
+	uint32_t id, index = NI_XS_CACHE_NONE;
+	unsigned int i;
+
+	if ((id = ni_xs_cache_ptrmap_get(&w->scope_ids, scope)) != NI_XS_CACHE_NONE) {
+		for (i = 0; i < scope->types.count; ++i) {
+			if (scope->types.data[i].name == type->origdef.name) {
+				index = i;
+				break;
+			}
+		}
+	}
+	if (index == NI_XS_CACHE_NONE)
+		id = NI_XS_CACHE_NONE;
+
+	ni_xs_cache_put_word(&w->origdefs, id);
+	ni_xs_cache_put_word(&w->origdefs, index);
+}
+
+/*
+ * Write a type after all the types it refers to, so the loader
+ * can build them in the order of the stream.
+ */
+static uint32_t
+ni_xs_cache_put_type(ni_xs_cache_writer_t *w, const ni_xs_type_t *type)
+{
+	ni_buffer_t *bp = &w->types;
+	uint32_t id;
+	unsigned int i;
+
+	if (type == NULL)
+		return NI_XS_CACHE_NONE;
+	if ((id = ni_xs_cache_ptrmap_get(&w->type_ids, type)) != NI_XS_CACHE_NONE)
+		return id;
+
+	switch (type->class) {
+	case NI_XS_TYPE_VOID:
+	case NI_XS_TYPE_SCALAR:
+		break;
+	case NI_XS_TYPE_STRUCT:
+		if (!ni_xs_cache_put_name_type_deps(w, &type->u.struct_info->children, 0))
+			return NI_XS_CACHE_NONE;
+		break;
+	case NI_XS_TYPE_UNION:
+		if (!ni_xs_cache_put_name_type_deps(w, &type->u.union_info->children, 0))
+			return NI_XS_CACHE_NONE;
+		break;
+	case NI_XS_TYPE_DICT:
+		if (!ni_xs_cache_put_name_type_deps(w, &type->u.dict_info->children, 0))
+			return NI_XS_CACHE_NONE;
+		break;
+	case NI_XS_TYPE_ARRAY:
+		if (ni_xs_cache_put_type(w, type->u.array_info->element_type) == NI_XS_CACHE_NONE)
+			return NI_XS_CACHE_NONE;
+		break;
+	default:
+		return NI_XS_CACHE_NONE;
+	}
+
+	ni_xs_cache_put_word(bp, type->class);
+	ni_xs_cache_put_string(w, bp, type->name);
+	ni_xs_cache_put_string(w, bp, type->description);
+	ni_xs_cache_put_word(bp, type->constraint.mandatory);
+	ni_xs_cache_put_word(bp, ni_xs_cache_put_group(w, type->constraint.group));
+	ni_xs_cache_put_node(w, bp, type->meta);
+
+	switch (type->class) {
+	case NI_XS_TYPE_SCALAR: {
+			const ni_xs_scalar_info_t *info = type->u.scalar_info;
+
+			ni_xs_cache_put_string(w, bp, info->basic_name);
+			ni_xs_cache_put_word(bp, info->type);
+			ni_xs_cache_put_word(bp, ni_xs_cache_put_intmap(w, info->constraint.enums));
+			ni_xs_cache_put_word(bp, ni_xs_cache_put_intmap(w, info->constraint.bitmap));
+			ni_xs_cache_put_word(bp, ni_xs_cache_put_intmap(w, info->constraint.bitmask));
+			ni_xs_cache_put_word(bp, ni_xs_cache_put_range(w, info->constraint.range));
+		}
+		break;
+
+	case NI_XS_TYPE_STRUCT:
+		ni_xs_cache_put_name_types(w, bp, &type->u.struct_info->children, 0);
+		break;
+
+	case NI_XS_TYPE_UNION:
+		ni_xs_cache_put_string(w, bp, type->u.union_info->discriminant);
+		ni_xs_cache_put_name_types(w, bp, &type->u.union_info->children, 0);
+		break;
+
+	case NI_XS_TYPE_DICT: {
+			const ni_xs_dict_info_t *info = type->u.dict_info;
+
+			ni_xs_cache_put_name_types(w, bp, &info->children, 0);
+			ni_xs_cache_put_word(bp, info->groups.count);
+			for (i = 0; i < info->groups.count; ++i)
+				ni_xs_cache_put_word(bp, ni_xs_cache_put_group(w, info->groups.data[i]));
+		}
+		break;
+
+	case NI_XS_TYPE_ARRAY: {
+			const ni_xs_array_info_t *info = type->u.array_info;
+
+			ni_xs_cache_put_word(bp, ni_xs_cache_ptrmap_get(&w->type_ids, info->element_type));
+			ni_xs_cache_put_string(w, bp, info->element_name);
+			ni_xs_cache_put_u64(bp, info->minlen);
+			ni_xs_cache_put_u64(bp, info->maxlen);
+			ni_xs_cache_put_string(w, bp, info->notation ? info->notation->name : NULL);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	ni_xs_cache_put_origdef(w, type);
+
+	id = w->nbase + w->ntypes++;
+	ni_xs_cache_ptrmap_set(&w->type_ids, type, id);
+	return id;
+}
+
+static ni_bool_t
+ni_xs_cache_put_method(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const ni_xs_method_t *method)
+{
+	if (!ni_xs_cache_put_name_type_deps(w, &method->arguments, 0))
+		return FALSE;
+	if (method->retval && ni_xs_cache_put_type(w, method->retval) == NI_XS_CACHE_NONE)
+		return FALSE;
+
+	ni_xs_cache_put_string(w, bp, method->name);
+	ni_xs_cache_put_string(w, bp, method->description);
+	ni_xs_cache_put_name_types(w, bp, &method->arguments, 0);
+	ni_xs_cache_put_word(bp, ni_xs_cache_ptrmap_get(&w->type_ids, method->retval));
+	ni_xs_cache_put_node(w, bp, method->meta);
+	return TRUE;
+}
+
+static ni_bool_t
+ni_xs_cache_put_methods(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const ni_xs_method_t *list)
+{
+	const ni_xs_method_t *method;
+	unsigned int count;
+
+	for (count = 0, method = list; method; method = method->next)
+		count++;
+	ni_xs_cache_put_word(bp, count);
+	for (method = list; method; method = method->next) {
+		if (!ni_xs_cache_put_method(w, bp, method))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_xs_cache_put_service(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const ni_xs_service_t *service)
+{
+	ni_xs_cache_put_string(w, bp, service->name);
+	ni_xs_cache_put_string(w, bp, service->interface);
+	ni_xs_cache_put_string(w, bp, service->description);
+	ni_xs_cache_put_vars(w, bp, &service->attributes);
+	if (!ni_xs_cache_put_methods(w, bp, service->methods)
+	 || !ni_xs_cache_put_methods(w, bp, service->signals))
+		return FALSE;
+
+	ni_xs_cache_ptrmap_set(&w->service_ids, service, w->nservices++);
+	return TRUE;
+}
+
+static void
+ni_xs_cache_index_scopes(ni_xs_cache_writer_t *w, const ni_xs_scope_t *scope)
+{
+	const ni_xs_scope_t *child;
+
+	ni_xs_cache_ptrmap_set(&w->scope_ids, scope, w->nscopes++);
+	for (child = scope->children; child; child = child->next)
+		ni_xs_cache_index_scopes(w, child);
+}
+
+/*
+ * Scopes are written parent first, in the order of the children lists,
+ * so the loader links them the same way.
+ */
+static ni_bool_t
+ni_xs_cache_put_scope(ni_xs_cache_writer_t *w, const ni_xs_scope_t *scope)
+{
+	ni_buffer_t *bp = &w->scopes;
+	const ni_xs_scope_t *child;
+	const ni_xs_service_t *service;
+	const ni_xs_class_t *class;
+	unsigned int first, count;
+
+	first = scope == w->root ? w->nbase : 0;
+	if (!ni_xs_cache_put_name_type_deps(w, &scope->types, first))
+		return FALSE;
+
+	ni_xs_cache_put_word(bp, ni_xs_cache_ptrmap_get(&w->scope_ids, scope->parent));
+	ni_xs_cache_put_string(w, bp, scope->name);
+	ni_xs_cache_put_word(bp, ni_xs_cache_ptrmap_get(&w->service_ids, scope->defined_by.service));
+	ni_xs_cache_put_name_types(w, bp, &scope->types, first);
+	ni_xs_cache_put_vars(w, bp, &scope->constants);
+
+	for (count = 0, class = scope->classes; class; class = class->next)
+		count++;
+	ni_xs_cache_put_word(bp, count);
+	for (class = scope->classes; class; class = class->next) {
+		ni_xs_cache_put_string(w, bp, class->name);
+		ni_xs_cache_put_string(w, bp, class->base_name);
+	}
+
+	for (count = 0, service = scope->services; service; service = service->next)
+		count++;
+	ni_xs_cache_put_word(bp, count);
+	for (service = scope->services; service; service = service->next) {
+		if (!ni_xs_cache_put_service(w, bp, service))
+			return FALSE;
+	}
+
+	for (child = scope->children; child; child = child->next) {
+		if (!ni_xs_cache_put_scope(w, child))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_xs_cache_put_files(ni_xs_cache_writer_t *w, ni_buffer_t *bp, const ni_string_array_t *files,
+			const struct timespec *started)
+{
+	ni_string_array_t seen = NI_STRING_ARRAY_INIT;
+	struct stat before, after;
+	ni_xs_cache_file_t cf;
+	const char *name;
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < files->count; ++i) {
+		name = files->data[i];
+		if (ni_string_array_index(&seen, name) >= 0)
+			continue;
+		ni_string_array_append(&seen, name);
+
+		memset(&cf, 0, sizeof(cf));
+		if (stat(name, &before) < 0
+		 || !ni_xs_cache_digest_file(name, &len, cf.digest)
+		 || stat(name, &after) < 0)
+			goto failed;
+
+		/* Do not record a file modified while we've been using it,
+		 * or that may still be modified within its mtime resolution. */
+		if (len != (size_t) before.st_size
+		 || before.st_mtim.tv_sec != after.st_mtim.tv_sec
+		 || before.st_mtim.tv_nsec != after.st_mtim.tv_nsec
+		 || before.st_mtim.tv_sec > started->tv_sec
+		 || (before.st_mtim.tv_sec == started->tv_sec &&
+		     before.st_mtim.tv_nsec >= started->tv_nsec)) {
+			ni_debug_dbus("schema file %s is being modified, not caching the schema", name);
+			goto failed;
+		}
+
+		ni_xs_cache_file_set_stat(&cf, &before);
+		cf.name = ni_xs_cache_string(w, name);
+		ni_buffer_ensure_tailroom(bp, sizeof(cf));
+		ni_buffer_put(bp, &cf, sizeof(cf));
+	}
+
+	ni_string_array_destroy(&seen);
+	return i > 0 && i <= NI_XS_CACHE_MAX_FILES;
+
+failed:
+	ni_string_array_destroy(&seen);
+	return FALSE;
+}
+
+/*
+ * Write to a temp file and rename, so concurrent readers never
+ * see a partially written cache.
+ */
+static int
+ni_xs_cache_write_file(const char *cachefile, const ni_xs_cache_header_t *hdr,
+			const void *files, size_t fsize, const ni_buffer_t **parts,
+			unsigned int nparts, const void *strtab, size_t ssize)
+{
+	ni_xs_cache_header_t head = *hdr;
+	char tempname[PATH_MAX];
+	unsigned int i;
+	int fd;
+	FILE *fp;
+
+	head.checksum = ni_xs_cache_checksum(NI_XS_CACHE_CHECKSUM_INIT, files, fsize);
+	for (i = 0; i < nparts; ++i)
+		head.checksum = ni_xs_cache_checksum(head.checksum,
+				ni_buffer_head(parts[i]), ni_buffer_count(parts[i]));
+	head.checksum = ni_xs_cache_checksum(head.checksum, strtab, ssize);
+
+	snprintf(tempname, sizeof(tempname), "%s.XXXXXX", cachefile);
+	if ((fd = mkstemp(tempname)) < 0) {
+		ni_debug_dbus("cannot create schema cache \"%s\": %m", tempname);
+		return -1;
+	}
+	if (fchmod(fd, 0644) < 0 || !(fp = fdopen(fd, "w"))) {
+		close(fd);
+		unlink(tempname);
+		return -1;
+	}
+
+	fwrite(&head, sizeof(head), 1, fp);
+	fwrite(files, fsize, 1, fp);
+	for (i = 0; i < nparts; ++i)
+		fwrite(ni_buffer_head(parts[i]), ni_buffer_count(parts[i]), 1, fp);
+	fwrite(strtab, ssize, 1, fp);
+
+	if (fflush(fp) != 0 || ferror(fp)) {
+		ni_debug_dbus("cannot write schema cache \"%s\": %m", tempname);
+		fclose(fp);
+		unlink(tempname);
+		return -1;
+	}
+	fclose(fp);
+
+	if (rename(tempname, cachefile) < 0) {
+		ni_debug_dbus("cannot rename schema cache to \"%s\": %m", cachefile);
+		unlink(tempname);
+		return -1;
+	}
+	return 0;
+}
+
+static int
+ni_xs_cache_write(const char *cachefile, const ni_xs_scope_t *root, unsigned int nbase,
+		const ni_string_array_t *files, const struct timespec *started)
+{
+	ni_xs_cache_writer_t w;
+	ni_xs_cache_header_t hdr;
+	ni_buffer_t filetab;
+	const ni_buffer_t *parts[6];
+	size_t nwords, total;
+	unsigned int i;
+	int rv = -1;
+
+	memset(&w, 0, sizeof(w));
+	w.root = root;
+	w.nbase = nbase;
+	ni_buffer_init_dynamic(&filetab, 64 * sizeof(ni_xs_cache_file_t));
+	ni_buffer_init_dynamic(&w.strtab, 65536);
+	ni_buffer_init_dynamic(&w.groups, 1024);
+	ni_buffer_init_dynamic(&w.intmaps, 16384);
+	ni_buffer_init_dynamic(&w.ranges, 1024);
+	ni_buffer_init_dynamic(&w.types, 65536);
+	ni_buffer_init_dynamic(&w.scopes, 65536);
+	ni_buffer_init_dynamic(&w.origdefs, 16384);
+
+	if (!ni_xs_cache_put_files(&w, &filetab, files, started))
+		goto out;
+
+	/* the base types are referred to by their index in the root scope */
+	for (i = 0; i < nbase; ++i)
+		ni_xs_cache_ptrmap_set(&w.type_ids, root->types.data[i].type, i);
+
+	ni_xs_cache_index_scopes(&w, root);
+	if (!ni_xs_cache_put_scope(&w, root)) {
+		ni_debug_dbus("cannot serialize schema, not caching it");
+		goto out;
+	}
+
+	/* base type names, verified against the scope we load into */
+	for (i = 0; i < nbase; ++i)
+		ni_xs_cache_put_string(&w, &w.origdefs, root->types.data[i].name);
+
+	parts[0] = &w.groups;
+	parts[1] = &w.intmaps;
+	parts[2] = &w.ranges;
+	parts[3] = &w.types;
+	parts[4] = &w.scopes;
+	parts[5] = &w.origdefs;
+	for (nwords = 0, i = 0; i < 6; ++i)
+		nwords += ni_buffer_count(parts[i]) / sizeof(uint32_t);
+
+	/* keep the string table terminated for the loader's checks */
+	ni_buffer_ensure_tailroom(&w.strtab, 1);
+	ni_buffer_putc(&w.strtab, '\0');
+
+	total = sizeof(hdr) + ni_buffer_count(&filetab) + nwords * sizeof(uint32_t)
+	      + ni_buffer_count(&w.strtab);
+	if (total > NI_XS_CACHE_MAX_SIZE)
+		goto out;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, NI_XS_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = NI_XS_CACHE_VERSION;
+	hdr.byteorder = ni_xs_cache_byteorder();
+	hdr.total_size = total;
+	hdr.nfiles = ni_buffer_count(&filetab) / sizeof(ni_xs_cache_file_t);
+	hdr.nwords = nwords;
+	hdr.strtab_size = ni_buffer_count(&w.strtab);
+	hdr.nbase = nbase;
+	hdr.ngroups = w.ngroups;
+	hdr.nintmaps = w.nintmaps;
+	hdr.nranges = w.nranges;
+	hdr.ntypes = w.ntypes;
+	hdr.nscopes = w.nscopes;
+	hdr.nservices = w.nservices;
+
+	rv = ni_xs_cache_write_file(cachefile, &hdr, ni_buffer_head(&filetab),
+			ni_buffer_count(&filetab), parts, 6,
+			ni_buffer_head(&w.strtab), ni_buffer_count(&w.strtab));
+	if (rv == 0) {
+		ni_debug_dbus("wrote schema cache %s (%u files, %u types, %u scopes, %zu bytes)",
+				cachefile, hdr.nfiles, hdr.ntypes, hdr.nscopes, total);
+	}
+
+out:
+	ni_buffer_destroy(&filetab);
+	ni_buffer_destroy(&w.strtab);
+	ni_buffer_destroy(&w.groups);
+	ni_buffer_destroy(&w.intmaps);
+	ni_buffer_destroy(&w.ranges);
+	ni_buffer_destroy(&w.types);
+	ni_buffer_destroy(&w.scopes);
+	ni_buffer_destroy(&w.origdefs);
+	ni_xs_cache_ptrmap_destroy(&w.group_ids);
+	ni_xs_cache_ptrmap_destroy(&w.intmap_ids);
+	ni_xs_cache_ptrmap_destroy(&w.range_ids);
+	ni_xs_cache_ptrmap_destroy(&w.type_ids);
+	ni_xs_cache_ptrmap_destroy(&w.scope_ids);
+	ni_xs_cache_ptrmap_destroy(&w.service_ids);
+	return rv;
+}
+
+/*
+ * Load the compiled schema
+ */
+static uint32_t
+ni_xs_cache_get_word(ni_xs_cache_reader_t *r)
+{
+	if (r->error || r->pos >= r->hdr->nwords) {
+		r->error = TRUE;
+		return NI_XS_CACHE_NONE;
+	}
+	return r->words[r->pos++];
+}
+
+static uint64_t
+ni_xs_cache_get_u64(ni_xs_cache_reader_t *r)
+{
+	uint64_t lo, hi;
+
+	lo = ni_xs_cache_get_word(r);
+	hi = ni_xs_cache_get_word(r);
+	return lo | (hi << 32);
+}
+
+/* a count of records of at least @size words each */
+static unsigned int
+ni_xs_cache_get_count(ni_xs_cache_reader_t *r, unsigned int size)
+{
+	uint32_t count = ni_xs_cache_get_word(r);
+
+	if (!r->error && count > (r->hdr->nwords - r->pos) / size)
+		r->error = TRUE;
+	return r->error ? 0 : count;
+}
+
+static const char *
+ni_xs_cache_get_string(ni_xs_cache_reader_t *r)
+{
+	uint32_t offset = ni_xs_cache_get_word(r);
+
+	if (r->error || offset == NI_XS_CACHE_NONE)
+		return NULL;
+	if (offset >= r->hdr->strtab_size) {
+		r->error = TRUE;
+		return NULL;
+	}
+	return r->strtab + offset;
+}
+
+/* an object index, NI_XS_CACHE_NONE is accepted when @optional */
+static uint32_t
+ni_xs_cache_get_index(ni_xs_cache_reader_t *r, unsigned int count, ni_bool_t optional)
+{
+	uint32_t id = ni_xs_cache_get_word(r);
+
+	if (r->error)
+		return NI_XS_CACHE_NONE;
+	if (id == NI_XS_CACHE_NONE && optional)
+		return id;
+	if (id >= count)
+		r->error = TRUE;
+	return r->error ? NI_XS_CACHE_NONE : id;
+}
+
+static ni_xs_type_t *
+ni_xs_cache_get_type(ni_xs_cache_reader_t *r, ni_bool_t optional)
+{
+	uint32_t id = ni_xs_cache_get_index(r, r->ntypes, optional);
+
+	return id == NI_XS_CACHE_NONE ? NULL : r->types[id];
+}
+
+static void
+ni_xs_cache_get_vars(ni_xs_cache_reader_t *r, ni_var_array_t *vars)
+{
+	unsigned int i, count;
+	const char *name, *value;
+
+	count = ni_xs_cache_get_count(r, 2);
+	for (i = 0; i < count && !r->error; ++i) {
+		name = ni_xs_cache_get_string(r);
+		value = ni_xs_cache_get_string(r);
+		if (name)
+			ni_var_array_set(vars, name, value);
+		else
+			r->error = TRUE;
+	}
+}
+
+static xml_node_t *
+ni_xs_cache_get_node(ni_xs_cache_reader_t *r, xml_node_t *parent, unsigned int depth)
+{
+	unsigned int i, count;
+	const char *name;
+	xml_node_t *node;
+
+	name = ni_xs_cache_get_string(r);
+	if (name == NULL || depth > NI_XS_CACHE_MAX_DEPTH) {
+		if (parent || depth > NI_XS_CACHE_MAX_DEPTH)
+			r->error = TRUE;
+		return NULL;
+	}
+
+	node = xml_node_new(name, parent);
+	xml_node_set_cdata(node, ni_xs_cache_get_string(r));
+	ni_xs_cache_get_vars(r, &node->attrs);
+
+	count = ni_xs_cache_get_count(r, 1);
+	for (i = 0; i < count && !r->error; ++i)
+		ni_xs_cache_get_node(r, node, depth + 1);
+
+	if (r->error && parent == NULL) {
+		xml_node_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static void
+ni_xs_cache_get_name_types(ni_xs_cache_reader_t *r, ni_xs_name_type_array_t *array)
+{
+	unsigned int i, count;
+	const char *name, *description;
+	ni_xs_type_t *type;
+	uint32_t on_demand;
+
+	count = ni_xs_cache_get_count(r, 4);
+	for (i = 0; i < count && !r->error; ++i) {
+		name = ni_xs_cache_get_string(r);
+		type = ni_xs_cache_get_type(r, FALSE);
+		description = ni_xs_cache_get_string(r);
+		on_demand = ni_xs_cache_get_word(r);
+		if (r->error)
+			break;
+
+		ni_xs_name_type_array_append(array, name, type, description);
+		array->data[array->count - 1].on_demand = !!on_demand;
+	}
+}
+
+static ni_bool_t
+ni_xs_cache_get_groups(ni_xs_cache_reader_t *r)
+{
+	unsigned int relation;
+	const char *name;
+
+	for (r->ngroups = 0; r->ngroups < r->hdr->ngroups && !r->error; r->ngroups++) {
+		relation = ni_xs_cache_get_word(r);
+		name = ni_xs_cache_get_string(r);
+		if (r->error)
+			break;
+		r->groups[r->ngroups] = ni_xs_group_new(relation, name);
+	}
+	return !r->error;
+}
+
+static ni_bool_t
+ni_xs_cache_get_intmaps(ni_xs_cache_reader_t *r)
+{
+	ni_xs_intmap_t *map;
+	unsigned int i, count;
+
+	for (r->nintmaps = 0; r->nintmaps < r->hdr->nintmaps && !r->error; r->nintmaps++) {
+		count = ni_xs_cache_get_count(r, 2);
+		if (r->error)
+			break;
+
+		map = xcalloc(1, sizeof(*map));
+		map->refcount = 1;
+		map->bits = xcalloc(count + 1, sizeof(map->bits[0]));
+		r->intmaps[r->nintmaps] = map;
+
+		for (i = 0; i < count; ++i) {
+			map->bits[i].name = xstrdup(ni_xs_cache_get_string(r));
+			map->bits[i].value = ni_xs_cache_get_word(r);
+			if (map->bits[i].name == NULL)
+				r->error = TRUE;
+			if (r->error)
+				break;
+		}
+		if (r->error) {
+			r->nintmaps++;
+			break;
+		}
+	}
+	return !r->error;
+}
+
+static ni_bool_t
+ni_xs_cache_get_ranges(ni_xs_cache_reader_t *r)
+{
+	uint64_t min, max;
+
+	for (r->nranges = 0; r->nranges < r->hdr->nranges && !r->error; r->nranges++) {
+		min = ni_xs_cache_get_u64(r);
+		max = ni_xs_cache_get_u64(r);
+		if (r->error)
+			break;
+		r->ranges[r->nranges] = ni_xs_range_new(min, max);
+	}
+	return !r->error;
+}
+
+static ni_xs_intmap_t *
+ni_xs_cache_get_intmap(ni_xs_cache_reader_t *r)
+{
+	uint32_t id = ni_xs_cache_get_index(r, r->nintmaps, TRUE);
+
+	return id == NI_XS_CACHE_NONE ? NULL : r->intmaps[id];
+}
+
+/*
+ * The scalar basic names are static strings of the base types.
+ */
+static const char *
+ni_xs_cache_basic_name(ni_xs_cache_reader_t *r, const char *name)
+{
+	const ni_xs_type_t *type;
+	unsigned int i;
+
+	for (i = 0; name && i < r->hdr->nbase; ++i) {
+		type = r->types[i];
+		if (type->class == NI_XS_TYPE_SCALAR
+		 && ni_string_eq(type->u.scalar_info->basic_name, name))
+			return type->u.scalar_info->basic_name;
+	}
+	r->error = TRUE;
+	return NULL;
+}
+
+static ni_xs_type_t *
+ni_xs_cache_get_one_type(ni_xs_cache_reader_t *r)
+{
+	const char *name, *description, *string;
+	unsigned int class, mandatory, i, count;
+	ni_xs_type_t *type = NULL, *element;
+	ni_xs_group_t *group = NULL;
+	xml_node_t *meta;
+	uint32_t id;
+
+	class = ni_xs_cache_get_word(r);
+	name = ni_xs_cache_get_string(r);
+	description = ni_xs_cache_get_string(r);
+	mandatory = ni_xs_cache_get_word(r);
+	if ((id = ni_xs_cache_get_index(r, r->ngroups, TRUE)) != NI_XS_CACHE_NONE)
+		group = r->groups[id];
+	meta = ni_xs_cache_get_node(r, NULL, 0);
+	if (r->error)
+		goto failed;
+
+	switch (class) {
+	case NI_XS_TYPE_VOID:
+		type = __ni_xs_type_new(NI_XS_TYPE_VOID);
+		break;
+
+	case NI_XS_TYPE_SCALAR:
+		string = ni_xs_cache_basic_name(r, ni_xs_cache_get_string(r));
+		id = ni_xs_cache_get_word(r);
+		if (r->error)
+			goto failed;
+
+		type = ni_xs_scalar_new(string, id);
+		ni_xs_scalar_set_enum(type, ni_xs_cache_get_intmap(r));
+		ni_xs_scalar_set_bitmap(type, ni_xs_cache_get_intmap(r));
+		ni_xs_scalar_set_bitmask(type, ni_xs_cache_get_intmap(r));
+		if ((id = ni_xs_cache_get_index(r, r->nranges, TRUE)) != NI_XS_CACHE_NONE)
+			ni_xs_scalar_set_range(type, r->ranges[id]);
+		break;
+
+	case NI_XS_TYPE_STRUCT:
+		type = ni_xs_struct_new(NULL);
+		ni_xs_cache_get_name_types(r, &type->u.struct_info->children);
+		break;
+
+	case NI_XS_TYPE_UNION:
+		type = ni_xs_union_new(NULL, ni_xs_cache_get_string(r));
+		ni_xs_cache_get_name_types(r, &type->u.union_info->children);
+		break;
+
+	case NI_XS_TYPE_DICT:
+		type = ni_xs_dict_new(NULL);
+		ni_xs_cache_get_name_types(r, &type->u.dict_info->children);
+		count = ni_xs_cache_get_count(r, 1);
+		for (i = 0; i < count && !r->error; ++i) {
+			if ((id = ni_xs_cache_get_index(r, r->ngroups, FALSE)) != NI_XS_CACHE_NONE)
+				ni_xs_group_array_append(&type->u.dict_info->groups, r->groups[id]);
+		}
+		break;
+
+	case NI_XS_TYPE_ARRAY: {
+			const char *element_name;
+			unsigned long minlen, maxlen;
+
+			element = ni_xs_cache_get_type(r, FALSE);
+			element_name = ni_xs_cache_get_string(r);
+			minlen = ni_xs_cache_get_u64(r);
+			maxlen = ni_xs_cache_get_u64(r);
+			string = ni_xs_cache_get_string(r);
+			if (r->error)
+				goto failed;
+
+			type = ni_xs_array_new(element, element_name, minlen, maxlen);
+			if (string && !(type->u.array_info->notation = ni_xs_get_array_notation(string)))
+				r->error = TRUE;
+		}
+		break;
+
+	default:
+		r->error = TRUE;
+		goto failed;
+	}
+
+	ni_string_dup(&type->name, name);
+	ni_string_dup(&type->description, description);
+	type->constraint.mandatory = !!mandatory;
+	type->constraint.group = ni_xs_group_clone(group);
+	type->meta = meta;
+	return type;
+
+failed:
+	if (meta)
+		xml_node_free(meta);
+	return NULL;
+}
+
+static ni_bool_t
+ni_xs_cache_get_types(ni_xs_cache_reader_t *r)
+{
+	ni_xs_type_t *type;
+
+	for (r->ntypes = r->hdr->nbase; r->ntypes < r->hdr->nbase + r->hdr->ntypes; r->ntypes++) {
+		type = ni_xs_cache_get_one_type(r);
+		if (type == NULL || r->error) {
+			if (type)
+				r->types[r->ntypes++] = type;
+			r->error = TRUE;
+			break;
+		}
+		r->types[r->ntypes] = type;
+	}
+	return !r->error;
+}
+
+static void
+ni_xs_cache_get_methods(ni_xs_cache_reader_t *r, ni_xs_method_t **list)
+{
+	ni_xs_method_t *method;
+	unsigned int i, count;
+	ni_xs_type_t *retval;
+	const char *name;
+
+	count = ni_xs_cache_get_count(r, 5);
+	for (i = 0; i < count && !r->error; ++i) {
+		if (!(name = ni_xs_cache_get_string(r))) {
+			r->error = TRUE;
+			break;
+		}
+		method = ni_xs_method_new(list, name);
+		ni_string_dup(&method->description, ni_xs_cache_get_string(r));
+		ni_xs_cache_get_name_types(r, &method->arguments);
+		if ((retval = ni_xs_cache_get_type(r, TRUE)))
+			method->retval = ni_xs_type_hold(retval);
+		method->meta = ni_xs_cache_get_node(r, NULL, 0);
+	}
+}
+
+static ni_bool_t
+ni_xs_cache_get_scopes(ni_xs_cache_reader_t *r)
+{
+	ni_xs_service_t *service;
+	ni_xs_scope_t *scope;
+	ni_xs_class_t *class, **tail;
+	const char *name, *interface;
+	unsigned int i, count;
+	uint32_t parent, id;
+
+	for (r->nscopes = 0; r->nscopes < r->hdr->nscopes && !r->error; r->nscopes++) {
+		parent = ni_xs_cache_get_index(r, r->nscopes, TRUE);
+		name = ni_xs_cache_get_string(r);
+		id = ni_xs_cache_get_index(r, r->nservices, TRUE);
+		if (r->error)
+			break;
+
+		if (r->nscopes == 0) {
+			if (parent != NI_XS_CACHE_NONE || !ni_string_eq(name, r->root->name))
+				r->error = TRUE;
+			scope = r->scopes[0];
+		} else {
+			if (parent == NI_XS_CACHE_NONE || name == NULL)
+				r->error = TRUE;
+			if (r->error)
+				break;
+			scope = ni_xs_scope_new(r->scopes[parent], name);
+			r->scopes[r->nscopes] = scope;
+		}
+		if (id != NI_XS_CACHE_NONE)
+			scope->defined_by.service = r->services[id];
+
+		ni_xs_cache_get_name_types(r, &scope->types);
+		ni_xs_cache_get_vars(r, &scope->constants);
+
+		count = ni_xs_cache_get_count(r, 2);
+		for (tail = &scope->classes; *tail; tail = &(*tail)->next)
+			;
+		for (i = 0; i < count && !r->error; ++i) {
+			class = xcalloc(1, sizeof(*class));
+			ni_string_dup(&class->name, ni_xs_cache_get_string(r));
+			ni_string_dup(&class->base_name, ni_xs_cache_get_string(r));
+			*tail = class;
+			tail = &class->next;
+		}
+
+		count = ni_xs_cache_get_count(r, 6);
+		for (i = 0; i < count && !r->error; ++i) {
+			name = ni_xs_cache_get_string(r);
+			interface = ni_xs_cache_get_string(r);
+			if (r->error || r->nservices >= r->hdr->nservices) {
+				r->error = TRUE;
+				break;
+			}
+
+			service = ni_xs_service_new(name, interface, scope);
+			r->services[r->nservices++] = service;
+			ni_string_dup(&service->description, ni_xs_cache_get_string(r));
+			ni_xs_cache_get_vars(r, &service->attributes);
+			ni_xs_cache_get_methods(r, &service->methods);
+			ni_xs_cache_get_methods(r, &service->signals);
+		}
+	}
+	return !r->error;
+}
+
+/*
+ * The origdefs refer to the scope types by index; as the loaded root
+ * scope types are appended to the base types, they are validated
+ * before and applied after the definitions are moved into the root.
+ */
+static ni_bool_t
+ni_xs_cache_get_origdefs(ni_xs_cache_reader_t *r)
+{
+	const ni_xs_scope_t *scope;
+	unsigned int i, count;
+	uint32_t id, index;
+
+	r->origdefs = xcalloc(r->ntypes + 1, sizeof(r->origdefs[0]));
+	for (i = r->hdr->nbase; i < r->ntypes && !r->error; ++i) {
+		id = ni_xs_cache_get_index(r, r->nscopes, TRUE);
+		index = ni_xs_cache_get_word(r);
+		r->origdefs[i].scope = id;
+		r->origdefs[i].index = index;
+		if (r->error || id == NI_XS_CACHE_NONE)
+			continue;
+
+		scope = r->scopes[id];
+		count = scope->types.count;
+		if (id == 0)
+			count += r->hdr->nbase;
+		if (index >= count)
+			r->error = TRUE;
+	}
+	return !r->error;
+}
+
+static void
+ni_xs_cache_apply_origdefs(ni_xs_cache_reader_t *r, ni_xs_scope_t *root)
+{
+	ni_xs_scope_t *scope;
+	ni_xs_type_t *type;
+	unsigned int i;
+
+	for (i = r->hdr->nbase; i < r->ntypes; ++i) {
+		if (r->origdefs[i].scope == NI_XS_CACHE_NONE)
+			continue;
+
+		type = r->types[i];
+		scope = r->origdefs[i].scope ? r->scopes[r->origdefs[i].scope] : root;
+		type->origdef.scope = scope;
+		type->origdef.name = scope->types.data[r->origdefs[i].index].name;
+	}
+}
+
+static ni_bool_t
+ni_xs_cache_check_base(ni_xs_cache_reader_t *r)
+{
+	unsigned int i;
+
+	for (i = 0; i < r->hdr->nbase && !r->error; ++i) {
+		if (!ni_string_eq(ni_xs_cache_get_string(r), r->root->types.data[i].name))
+			r->error = TRUE;
+	}
+	return !r->error;
+}
+
+/*
+ * Move the loaded definitions into the root scope
+ */
+static void
+ni_xs_cache_splice(ni_xs_scope_t *root, ni_xs_scope_t *temp)
+{
+	ni_xs_name_type_t *nt;
+	ni_xs_scope_t *child;
+	unsigned int i;
+
+	for (i = 0, nt = temp->types.data; i < temp->types.count; ++i, ++nt) {
+		ni_xs_name_type_array_append(&root->types, nt->name, nt->type, nt->description);
+		root->types.data[root->types.count - 1].on_demand = nt->on_demand;
+	}
+	ni_xs_name_type_array_destroy(&temp->types);
+
+	root->children = temp->children;
+	for (child = root->children; child; child = child->next)
+		child->parent = root;
+	temp->children = NULL;
+
+	root->services = temp->services;
+	temp->services = NULL;
+	root->classes = temp->classes;
+	temp->classes = NULL;
+
+	ni_var_array_destroy(&root->constants);
+	root->constants = temp->constants;
+	ni_var_array_init(&temp->constants);
+}
+
+static void
+ni_xs_cache_reader_destroy(ni_xs_cache_reader_t *r)
+{
+	ni_xs_scope_t *temp = r->scopes ? r->scopes[0] : NULL;
+	ni_xs_class_t *class;
+	unsigned int i;
+
+	if (temp) {
+		while ((class = temp->classes) != NULL) {
+			temp->classes = class->next;
+			ni_string_free(&class->name);
+			ni_string_free(&class->base_name);
+			free(class);
+		}
+		ni_xs_scope_free(temp);
+	}
+
+	/* drop the references of the object tables */
+	for (i = r->hdr->nbase; i < r->ntypes; ++i)
+		ni_xs_type_release(r->types[i]);
+	for (i = 0; i < r->ngroups; ++i)
+		ni_xs_group_free(r->groups[i]);
+	for (i = 0; i < r->nintmaps; ++i)
+		ni_xs_intmap_free(r->intmaps[i]);
+	for (i = 0; i < r->nranges; ++i)
+		ni_xs_range_free(r->ranges[i]);
+
+	free(r->groups);
+	free(r->intmaps);
+	free(r->ranges);
+	free(r->types);
+	free(r->scopes);
+	free(r->services);
+	free(r->origdefs);
+}
+
+static ni_bool_t
+ni_xs_cache_decode(const ni_xs_cache_header_t *hdr, ni_xs_scope_t *root)
+{
+	ni_xs_cache_reader_t r;
+	const ni_xs_cache_file_t *files;
+	ni_bool_t rv = FALSE;
+	unsigned int i;
+
+	memset(&r, 0, sizeof(r));
+	r.hdr = hdr;
+	r.root = root;
+	files = (const ni_xs_cache_file_t *) (hdr + 1);
+	r.words = (const uint32_t *) (files + hdr->nfiles);
+	r.strtab = (const char *) (r.words + hdr->nwords);
+
+	if (hdr->nbase != root->types.count || hdr->nscopes == 0)
+		return FALSE;
+
+	r.groups = xcalloc(hdr->ngroups + 1, sizeof(r.groups[0]));
+	r.intmaps = xcalloc(hdr->nintmaps + 1, sizeof(r.intmaps[0]));
+	r.ranges = xcalloc(hdr->nranges + 1, sizeof(r.ranges[0]));
+	r.types = xcalloc(hdr->nbase + hdr->ntypes + 1, sizeof(r.types[0]));
+	r.scopes = xcalloc(hdr->nscopes, sizeof(r.scopes[0]));
+	r.services = xcalloc(hdr->nservices + 1, sizeof(r.services[0]));
+
+	for (i = 0; i < hdr->nbase; ++i)
+		r.types[i] = root->types.data[i].type;
+	r.ntypes = hdr->nbase;
+
+	/* the root scope's definitions are loaded into a temporary scope
+	 * first, so nothing is left behind in it on a broken cache */
+	r.scopes[0] = ni_xs_scope_new(NULL, root->name);
+
+	if (ni_xs_cache_get_groups(&r)
+	 && ni_xs_cache_get_intmaps(&r)
+	 && ni_xs_cache_get_ranges(&r)
+	 && ni_xs_cache_get_types(&r)
+	 && ni_xs_cache_get_scopes(&r)
+	 && ni_xs_cache_get_origdefs(&r)
+	 && ni_xs_cache_check_base(&r)
+	 && r.pos == hdr->nwords) {
+		ni_xs_cache_splice(root, r.scopes[0]);
+		ni_xs_cache_apply_origdefs(&r, root);
+		rv = TRUE;
+	}
+
+	ni_xs_cache_reader_destroy(&r);
+	return rv;
+}
+
+static ni_bool_t
+ni_xs_cache_check_header(const ni_xs_cache_header_t *hdr, size_t size)
+{
+	uint64_t expect;
+
+	if (size < sizeof(*hdr)
+	 || memcmp(hdr->magic, NI_XS_CACHE_MAGIC, sizeof(hdr->magic))
+	 || hdr->version != NI_XS_CACHE_VERSION
+	 || hdr->byteorder != ni_xs_cache_byteorder()
+	 || hdr->total_size != size
+	 || hdr->nfiles == 0 || hdr->nfiles > NI_XS_CACHE_MAX_FILES
+	 || hdr->strtab_size == 0)
+		return FALSE;
+
+	expect = sizeof(*hdr)
+	       + (uint64_t) hdr->nfiles * sizeof(ni_xs_cache_file_t)
+	       + (uint64_t) hdr->nwords * sizeof(uint32_t)
+	       + hdr->strtab_size;
+	if (expect != size)
+		return FALSE;
+
+	return hdr->checksum == ni_xs_cache_checksum(NI_XS_CACHE_CHECKSUM_INIT,
+					hdr + 1, size - sizeof(*hdr));
+}
+
+/*
+ * Verify that none of the schema files the cache was built from has
+ * changed. When the stat data of a file differs but its content did
+ * not change, @refresh is set to update the stat data in the cache.
+ */
+static ni_bool_t
+ni_xs_cache_check_files(const ni_xs_cache_header_t *hdr, ni_xs_cache_file_t *files,
+			const char *strtab, const char *filename, ni_bool_t *refresh)
+{
+	unsigned char digest[NI_XS_CACHE_DIGEST_LEN];
+	ni_xs_cache_file_t *cf;
+	const char *name;
+	struct stat stb;
+	unsigned int i;
+	size_t len;
+
+	for (i = 0, cf = files; i < hdr->nfiles; ++i, ++cf) {
+		if (cf->name >= hdr->strtab_size)
+			return FALSE;
+
+		name = strtab + cf->name;
+		if (i == 0 && !ni_string_eq(name, filename))
+			return FALSE;
+
+		if (stat(name, &stb) < 0)
+			return FALSE;
+		if (ni_xs_cache_file_stat_equal(cf, &stb))
+			continue;
+
+		if (!ni_xs_cache_digest_file(name, &len, digest)
+		 || len != cf->size || memcmp(digest, cf->digest, sizeof(digest))) {
+			ni_debug_dbus("schema file %s changed, discarding cache", name);
+			return FALSE;
+		}
+		ni_xs_cache_file_set_stat(cf, &stb);
+		*refresh = TRUE;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_xs_cache_load(const char *filename, const char *cachefile, ni_xs_scope_t *scope)
+{
+	const ni_xs_cache_header_t *hdr;
+	ni_xs_cache_file_t *files = NULL;
+	ni_bool_t refresh = FALSE;
+	ni_bool_t rv = FALSE;
+	const char *strtab;
+	struct stat stb;
+	size_t fsize;
+	void *map;
+	int fd;
+
+	if ((fd = open(cachefile, O_RDONLY | O_CLOEXEC)) < 0)
+		return FALSE;
+
+	if (fstat(fd, &stb) < 0 || stb.st_size < (off_t) sizeof(ni_xs_cache_header_t)
+	 || stb.st_size > NI_XS_CACHE_MAX_SIZE) {
+		close(fd);
+		return FALSE;
+	}
+
+	map = mmap(NULL, stb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	hdr = map;
+	if (!ni_xs_cache_check_header(hdr, stb.st_size)
+	 || ((const char *) map)[stb.st_size - 1] != '\0') {
+		ni_debug_dbus("schema cache %s is invalid, discarding", cachefile);
+		goto out;
+	}
+
+	/* the file table is updated in a copy when refreshing it */
+	fsize = hdr->nfiles * sizeof(*files);
+	files = xcalloc(1, fsize);
+	memcpy(files, hdr + 1, fsize);
+	strtab = (const char *) map + stb.st_size - hdr->strtab_size;
+	if (!ni_xs_cache_check_files(hdr, files, strtab, filename, &refresh))
+		goto out;
+
+	if (!(rv = ni_xs_cache_decode(hdr, scope))) {
+		ni_debug_dbus("schema cache %s is corrupted, discarding", cachefile);
+		goto out;
+	}
+	ni_debug_dbus("loaded schema from cache %s", cachefile);
+
+	if (refresh) {
+		const ni_buffer_t *parts[1];
+		ni_buffer_t words;
+
+		ni_buffer_init_reader(&words, (char *) (hdr + 1) + fsize,
+				hdr->nwords * sizeof(uint32_t));
+		parts[0] = &words;
+		ni_xs_cache_write_file(cachefile, hdr, files, fsize, parts, 1,
+				strtab, hdr->strtab_size);
+	}
+
+out:
+	free(files);
+	munmap(map, stb.st_size);
+	return rv;
+}
+
+/*
+ * Load the compiled schema from the cache if it is up to date, and
+ * from the XML schema files otherwise. In the latter case, try to
+ * (re)create the cache file.
+ */
+int
+ni_xs_process_schema_cache(const char *filename, const char *cachefile, ni_xs_scope_t *scope)
+{
+	ni_string_array_t files = NI_STRING_ARRAY_INIT;
+	struct timespec started;
+	unsigned int nbase;
+	int rv;
+
+	if (filename == NULL) {
+		ni_error("%s: NULL filename", __func__);
+		return -1;
+	}
+
+	/* we can cache only what the schema files add to a scope of types */
+	if (ni_string_empty(cachefile) || scope->parent || scope->children
+	 || scope->services || scope->classes || scope->constants.count)
+		return ni_xs_process_schema_file(filename, scope);
+
+	if (ni_xs_cache_load(filename, cachefile, scope))
+		return 0;
+
+	nbase = scope->types.count;
+	clock_gettime(CLOCK_REALTIME, &started);
+
+	ni_xs_schema_files_record(&files);
+	rv = ni_xs_process_schema_file(filename, scope);
+	ni_xs_schema_files_record(NULL);
+
+	if (rv == 0)
+		ni_xs_cache_write(cachefile, scope, nbase, &files, &started);
+
+	ni_string_array_destroy(&files);
+	return rv;
+}
@@ -26,7 +26,6 @@ static int		ni_xs_build_typelist(xml_node_t *, ni_xs_name_type_array_t *, ni_xs_
 static ni_xs_type_t *	ni_xs_build_simple_type(xml_node_t *, const char *, ni_xs_scope_t *, ni_xs_group_array_t *);
 static ni_xs_type_t *	ni_xs_build_complex_type(xml_node_t *, const char *, ni_xs_scope_t *);
 static void		ni_xs_name_type_array_copy(ni_xs_name_type_array_t *, const ni_xs_name_type_array_t *);
-static void		ni_xs_name_type_array_destroy(ni_xs_name_type_array_t *);
 static ni_xs_type_t *	ni_xs_build_one_type(xml_node_t *, ni_xs_scope_t *);
 static void		ni_xs_service_free(ni_xs_service_t *);
 static ni_bool_t	ni_xs_type_build_constraints(ni_xs_type_t **, const xml_node_t *, ni_xs_group_array_t *);
@@ -36,24 +35,15 @@ static ni_xs_intmap_t *	ni_xs_build_bitmask_constraint(const xml_node_t *);
 static ni_xs_intmap_t *	ni_xs_build_bitmap_constraint(const xml_node_t *);
 static ni_xs_intmap_t *	ni_xs_build_enum_constraint(const xml_node_t *);
 static ni_xs_range_t *	ni_xs_build_range_constraint(const xml_node_t *);
-static void		ni_xs_intmap_free(ni_xs_intmap_t *);
-static void		ni_xs_range_free(ni_xs_range_t *);
 static void		__ni_xs_intmap_free(ni_intmap_t *);
-static ni_xs_group_t *	ni_xs_group_clone(ni_xs_group_t *group);
-static void		ni_xs_group_free(ni_xs_group_t *group);
-static void		ni_xs_group_array_append(ni_xs_group_array_t *, ni_xs_group_t *);
 static void		ni_xs_group_array_copy(ni_xs_group_array_t *, const ni_xs_group_array_t *);
 static void		ni_xs_group_array_destroy(ni_xs_group_array_t *);
 static ni_xs_group_t *	ni_xs_group_get(ni_xs_group_array_t *, unsigned int, const char *);
-static void		ni_xs_scalar_set_bitmask(ni_xs_type_t *, ni_xs_intmap_t *);
-static void		ni_xs_scalar_set_bitmap(ni_xs_type_t *, ni_xs_intmap_t *);
-static void		ni_xs_scalar_set_enum(ni_xs_type_t *, ni_xs_intmap_t *);
-static void		ni_xs_scalar_set_range(ni_xs_type_t *, ni_xs_range_t *);
 
 /*
  * Constructor functions for basic and complex types
  */
-static ni_xs_type_t *
+ni_xs_type_t *
 __ni_xs_type_new(unsigned int class)
 {
 	ni_xs_type_t *type = xcalloc(1, sizeof(*type));
@@ -345,6 +335,7 @@ ni_xs_name_type_array_append(ni_xs_name_type_array_t *array, const char *name, n
 	def->name = xstrdup(name);
 	def->type = ni_xs_type_hold(type);
 	def->description = xstrdup(description);
+	def->on_demand = FALSE;
 }
 
 void
@@ -355,8 +346,10 @@ ni_xs_name_type_array_copy(ni_xs_name_type_array_t *dst, const ni_xs_name_type_a
 
 	if (dst->count)
 		ni_xs_name_type_array_destroy(dst);
-	for (i = 0, def = src->data; i < src->count; ++i, ++def)
+	for (i = 0, def = src->data; i < src->count; ++i, ++def) {
 		ni_xs_name_type_array_append(dst, def->name, def->type, def->description);
+		dst->data[dst->count - 1].on_demand = def->on_demand;
+	}
 }
 
 static ni_xs_type_t *
@@ -506,7 +499,7 @@ ni_xs_scope_typedef(ni_xs_scope_t *dict, const char *name, ni_xs_type_t *type, c
 /*
  * Service definitions
  */
-static ni_xs_method_t *
+ni_xs_method_t *
 ni_xs_method_new(ni_xs_method_t **list, const char *name)
 {
 	ni_xs_method_t *method;
@@ -535,7 +528,7 @@ ni_xs_method_free(ni_xs_method_t *method)
 	free(method);
 }
 
-static ni_xs_service_t *
+ni_xs_service_t *
 ni_xs_service_new(const char *name, const char *interface, ni_xs_scope_t *scope)
 {
 	ni_xs_service_t *service, **tail;
@@ -606,6 +599,18 @@ ni_xs_is_reserved_name(const char *name)
 	return __string_is_in_list(name, reserved);
 }
 
+/*
+ * Record the names of all schema files processed, including the
+ * included ones, as the schema cache needs to validate them.
+ */
+static ni_string_array_t *	ni_xs_schema_files;
+
+void
+ni_xs_schema_files_record(ni_string_array_t *files)
+{
+	ni_xs_schema_files = files;
+}
+
 /*
  * Parse an XML schema file and process it
  */
@@ -622,6 +627,9 @@ ni_xs_process_schema_file(const char *filename, ni_xs_scope_t *scope)
 		return -1;
 	}
 
+	if (ni_xs_schema_files)
+		ni_string_array_append(ni_xs_schema_files, filename);
+
 	doc = xml_document_read(filename);
 	if (doc == NULL) {
 		ni_error("cannot parse schema file \"%s\"", filename);
@@ -1007,6 +1015,7 @@ ni_xs_build_typelist(xml_node_t *node, ni_xs_name_type_array_t *result, ni_xs_sc
 
 	for (child = node->children; child; child = child->next) {
 		const char *memberName = NULL;
+		const char *attrValue;
 		ni_xs_type_t *memberType;
 
 		if (child->name == NULL) {
@@ -1095,6 +1104,12 @@ ni_xs_build_typelist(xml_node_t *node, ni_xs_name_type_array_t *result, ni_xs_sc
 
 		ni_xs_name_type_array_append(result, memberName, memberType, ni_xs_get_description(child));
 		ni_xs_type_release(memberType);
+
+		/* Members flagged on-demand="true" are expensive to compute or
+		 * transfer; they're only serialized when a client asks for them. */
+		if ((attrValue = xml_node_get_attr(child, "on-demand")) != NULL
+		 && !strcasecmp(attrValue, "true"))
+			result->data[result->count - 1].on_demand = TRUE;
 	}
 
 	return result->count;
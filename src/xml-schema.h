@@ -175,6 +175,7 @@ struct ni_xs_name_type {
 	char *			name;
 	ni_xs_type_t *		type;
 	char *			description;
+	ni_bool_t		on_demand;
 };
 
 typedef struct ni_xs_name_type_array {
@@ -353,10 +354,36 @@ extern ni_xs_type_t *	ni_xs_scope_lookup_local(const ni_xs_scope_t *, const char
 extern int		ni_xs_process_schema_file(const char *, ni_xs_scope_t *);
 extern int		ni_xs_process_schema(xml_node_t *, ni_xs_scope_t *);
 
+extern int		ni_xs_process_schema_cache(const char *, const char *, ni_xs_scope_t *);
+extern void		ni_xs_schema_files_record(ni_string_array_t *);
+
 extern ni_xs_type_t *	ni_xs_scalar_new(const char *, unsigned int);
 extern int		ni_xs_scope_typedef(ni_xs_scope_t *, const char *, ni_xs_type_t *, const char *);
 extern void		ni_xs_type_free(ni_xs_type_t *type);
 
+/* Constructors used to rebuild a compiled schema from the cache */
+extern ni_xs_type_t *	__ni_xs_type_new(unsigned int);
+extern ni_xs_type_t *	ni_xs_struct_new(ni_xs_name_type_array_t *);
+extern ni_xs_type_t *	ni_xs_union_new(ni_xs_name_type_array_t *, const char *);
+extern ni_xs_type_t *	ni_xs_dict_new(ni_xs_name_type_array_t *);
+extern ni_xs_type_t *	ni_xs_array_new(ni_xs_type_t *, const char *, unsigned long, unsigned long);
+extern void		ni_xs_scalar_set_bitmask(ni_xs_type_t *, ni_xs_intmap_t *);
+extern void		ni_xs_scalar_set_bitmap(ni_xs_type_t *, ni_xs_intmap_t *);
+extern void		ni_xs_scalar_set_enum(ni_xs_type_t *, ni_xs_intmap_t *);
+extern void		ni_xs_scalar_set_range(ni_xs_type_t *, ni_xs_range_t *);
+extern void		ni_xs_intmap_free(ni_xs_intmap_t *);
+extern ni_xs_range_t *	ni_xs_range_new(unsigned long, unsigned long);
+extern void		ni_xs_range_free(ni_xs_range_t *);
+extern ni_xs_group_t *	ni_xs_group_new(int, const char *);
+extern ni_xs_group_t *	ni_xs_group_clone(ni_xs_group_t *);
+extern void		ni_xs_group_free(ni_xs_group_t *);
+extern void		ni_xs_group_array_append(ni_xs_group_array_t *, ni_xs_group_t *);
+extern void		ni_xs_name_type_array_append(ni_xs_name_type_array_t *, const char *,
+						ni_xs_type_t *, const char *);
+extern void		ni_xs_name_type_array_destroy(ni_xs_name_type_array_t *);
+extern ni_xs_method_t *	ni_xs_method_new(ni_xs_method_t **, const char *);
+extern ni_xs_service_t *ni_xs_service_new(const char *, const char *, ni_xs_scope_t *);
+
 const ni_xs_type_t *	ni_xs_name_type_array_find(const ni_xs_name_type_array_t *, const char *);
 
 extern void		ni_xs_register_array_notation(const ni_xs_notation_t *);
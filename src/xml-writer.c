@@ -438,7 +438,9 @@ xml_writer_close(xml_writer_t *writer)
 	if (writer->file && ferror(writer->file))
 		rv = -1;
 	if (writer->file && !writer->noclose) {
-		fclose(writer->file);
+		/* buffered data may only fail to flush here */
+		if (fclose(writer->file))
+			rv = -1;
 		writer->file = NULL;
 	}
 	if (writer->hash) {
@@ -31,6 +31,12 @@
 #define XML_DOCUMENTARRAY_CHUNK		1
 #define XML_NODEARRAY_CHUNK		8
 
+/*
+ * Nodes are allocated and released in large numbers while parsing
+ * and freeing documents, so they are kept in an object pool.
+ */
+static ni_objpool_t		xml_node_pool = NI_OBJPOOL_INIT("xml node", xml_node_t, 1024);
+
 xml_document_t *
 xml_document_new()
 {
@@ -141,7 +147,7 @@ xml_node_new(const char *ident, xml_node_t *parent)
 {
 	xml_node_t *node;
 
-	node = xcalloc(1, sizeof(xml_node_t));
+	node = ni_objpool_alloc(&xml_node_pool);
 	if (ident)
 		node->name = xstrdup(ident);
 
@@ -302,7 +308,7 @@ xml_node_free(xml_node_t *node)
 	ni_var_array_destroy(&node->attrs);
 	free(node->cdata);
 	free(node->name);
-	free(node);
+	ni_objpool_free(&xml_node_pool, node);
 }
 
 void
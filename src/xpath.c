@@ -57,6 +57,17 @@ typedef struct xpath_operator {
 	__xpath_node_comp_fn_t **comparison_table;
 } xpath_operator_t;
 
+/*
+ * A simple location path, such as "a/b/c" or "/a/b/@c", consisting of
+ * child steps only and an optional trailing attribute, is evaluated by
+ * walking the xml tree directly instead of building a result per step.
+ */
+typedef struct xpath_path {
+	unsigned int		count;
+	const char **		names;		/* of child steps, NULL for "*" */
+	const char *		attr;		/* trailing @attr or NULL */
+} xpath_path_t;
+
 struct xpath_enode {
 	const xpath_operator_t *ops;
 
@@ -65,6 +76,8 @@ struct xpath_enode {
 
 	char *			identifier;
 	xpath_integer_t		integer;
+
+	xpath_path_t *		path;		/* root of a simple path only */
 };
 
 static xpath_operator_t	__xpath_operator_node;
@@ -89,6 +102,9 @@ static void		__xpath_skipws(const char **);
 
 static xpath_enode_t *	xpath_enode_new(const xpath_operator_t *);
 static void		xpath_enode_free(xpath_enode_t *);
+static xpath_path_t *	__xpath_path_compile(const xpath_enode_t *);
+static int		__xpath_path_eval(const xpath_path_t *, xml_node_t *,
+					xpath_result_t *, xml_node_t **, unsigned int);
 
 #ifdef NI_XPATH_DEBUG_LEVEL
 # define xtrace(fmt, args...)	ni_debug_verbose(NI_XPATH_DEBUG_LEVEL, NI_TRACE_XPATH, fmt, ##args)
@@ -122,6 +138,7 @@ xpath_expression_parse(const char *expr)
 	if (*expr)
 		goto failed;
 
+	tree->path = __xpath_path_compile(tree);
 	return tree;
 
 failed:
@@ -137,15 +154,54 @@ failed:
 xpath_result_t *
 xpath_expression_eval(const xpath_enode_t *enode, xml_node_t *xn)
 {
-	xpath_result_t *in = xpath_result_new(XPATH_ELEMENT);
+	xpath_result_t *in;
 	xpath_result_t *result;
 
+	if (enode->path) {
+		result = xpath_result_new(enode->path->attr ? XPATH_STRING : XPATH_ELEMENT);
+		__xpath_path_eval(enode->path, xn, result, NULL, 0);
+		return result;
+	}
+
+	in = xpath_result_new(XPATH_ELEMENT);
 	xpath_result_append_element(in, xn);
 	result = __xpath_expression_eval(enode, in);
 	xpath_result_free(in);
 	return result;
 }
 
+/*
+ * Evaluate a parsed XPATH expression producing elements and store
+ * up to max of them in the nodes array. Simple paths are evaluated
+ * without any intermediate results.
+ * Returns the number of nodes stored, or -1 on error.
+ */
+int
+xpath_expression_eval_elements(const xpath_enode_t *enode, xml_node_t *xn,
+				xml_node_t **nodes, unsigned int max)
+{
+	xpath_result_t *result;
+	unsigned int i, count;
+
+	if (enode->path && !enode->path->attr)
+		return __xpath_path_eval(enode->path, xn, NULL, nodes, max);
+
+	if (!(result = xpath_expression_eval(enode, xn)))
+		return -1;
+
+	for (i = count = 0; i < result->count; ++i) {
+		if (result->node[i].type != XPATH_ELEMENT) {
+			xpath_result_free(result);
+			return -1;
+		}
+		if (count < max)
+			nodes[count++] = result->node[i].value.node;
+	}
+
+	xpath_result_free(result);
+	return count;
+}
+
 /*
  * Free a parsed XPATH expression
  */
@@ -155,12 +211,86 @@ xpath_expression_free(xpath_enode_t *enode)
 	if (!enode)
 		return;
 	if (enode->left)
-		xpath_enode_free(enode->left);
+		xpath_expression_free(enode->left);
 	if (enode->right)
-		xpath_enode_free(enode->right);
+		xpath_expression_free(enode->right);
 	xpath_enode_free(enode);
 }
 
+/*
+ * The expressions referenced by the schema and in the config files
+ * are evaluated over and over again, so we keep them compiled in an
+ * interned cache. The expressions are owned by the cache and must
+ * not be freed by the caller. They are valid until the next call of
+ * xpath_expression_get(): the cache is flushed when it is full, so
+ * expressions of e.g. arbitrary client command line arguments can't
+ * make it grow without bounds. Keep an expression of your own using
+ * xpath_expression_parse() when it's needed for longer.
+ */
+#define XPATH_EXPRESSION_CACHE_SIZE	256
+#define XPATH_EXPRESSION_CACHE_MAX	1024
+
+typedef struct xpath_expression_cache_entry	xpath_expression_cache_entry_t;
+struct xpath_expression_cache_entry {
+	xpath_expression_cache_entry_t *next;
+	unsigned int		hash;
+	char *			expr;
+	xpath_enode_t *		enode;
+};
+
+static xpath_expression_cache_entry_t *	xpath_expression_cache[XPATH_EXPRESSION_CACHE_SIZE];
+static unsigned int			xpath_expression_cache_count;
+
+const xpath_enode_t *
+xpath_expression_get(const char *expr)
+{
+	xpath_expression_cache_entry_t *entry, **bucket;
+	xpath_enode_t *enode;
+	unsigned int hash;
+
+	if (!expr)
+		return NULL;
+
+	hash = ni_hash_string(expr);
+	bucket = &xpath_expression_cache[hash % XPATH_EXPRESSION_CACHE_SIZE];
+	for (entry = *bucket; entry; entry = entry->next) {
+		if (entry->hash == hash && !strcmp(entry->expr, expr))
+			return entry->enode;
+	}
+
+	if (!(enode = xpath_expression_parse(expr)))
+		return NULL;
+
+	if (xpath_expression_cache_count >= XPATH_EXPRESSION_CACHE_MAX)
+		xpath_expression_cache_flush();
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->hash = hash;
+	entry->expr = xstrdup(expr);
+	entry->enode = enode;
+	entry->next = *bucket;
+	*bucket = entry;
+	xpath_expression_cache_count++;
+	return enode;
+}
+
+void
+xpath_expression_cache_flush(void)
+{
+	xpath_expression_cache_entry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < XPATH_EXPRESSION_CACHE_SIZE; ++i) {
+		while ((entry = xpath_expression_cache[i])) {
+			xpath_expression_cache[i] = entry->next;
+			xpath_expression_free(entry->enode);
+			free(entry->expr);
+			free(entry);
+		}
+	}
+	xpath_expression_cache_count = 0;
+}
+
 /*
  * Convenience function: parse XPATH expression, evaluate it once,
  * and return the resulting string.
@@ -169,15 +299,14 @@ char *
 xml_xpath_eval_string(xml_document_t *doc, xml_node_t *xn, const char *expr)
 {
 	xpath_result_t *xresult;
-	xpath_enode_t *expr_tree;
+	const xpath_enode_t *expr_tree;
 	char *result = NULL;
 
-	expr_tree = xpath_expression_parse(expr);
+	expr_tree = xpath_expression_get(expr);
 	if (!expr_tree)
 		return NULL;
 
 	xresult = xpath_expression_eval(expr_tree, xn);
-	xpath_expression_free(expr_tree);
 
 	if (!xresult)
 		return NULL;
@@ -1549,9 +1678,92 @@ static void
 xpath_enode_free(xpath_enode_t *enode)
 {
 	ni_string_free(&enode->identifier);
+	if (enode->path) {
+		free(enode->path->names);
+		free(enode->path);
+	}
 	free(enode);
 }
 
+/*
+ * Check whether the expression is a simple location path of child
+ * steps on the context node with an optional trailing attribute,
+ * and record the step names for __xpath_path_eval.
+ */
+static xpath_path_t *
+__xpath_path_compile(const xpath_enode_t *enode)
+{
+	const xpath_enode_t *step;
+	const char *attr = NULL;
+	xpath_path_t *path;
+	unsigned int n;
+
+	if (enode->ops == &__xpath_operator_getattr) {
+		if (!(attr = enode->identifier))
+			return NULL;
+		enode = enode->left;
+	}
+
+	for (n = 0, step = enode; step && step->ops == &__xpath_operator_child; step = step->left)
+		n++;
+	if (!step || step->ops != &__xpath_operator_node || step->left || step->right)
+		return NULL;
+	if (!n && !attr)
+		return NULL;
+
+	path = xcalloc(1, sizeof(*path));
+	path->attr = attr;
+	path->count = n;
+	if (n)
+		path->names = xcalloc(n, sizeof(path->names[0]));
+	for (step = enode; n--; step = step->left)
+		path->names[n] = step->identifier;
+	return path;
+}
+
+/*
+ * Walk the children matching the path depth first, which yields the
+ * same nodes in the same order as evaluating step by step.
+ * The matches are appended to the result or stored in the nodes array.
+ */
+static void
+__xpath_path_match(const xpath_path_t *path, unsigned int depth, xml_node_t *xn,
+			xpath_result_t *result, xml_node_t **nodes, unsigned int max,
+			unsigned int *count)
+{
+	const char *name, *value;
+	xml_node_t *cn;
+
+	if (depth == path->count) {
+		if (path->attr) {
+			if ((value = xml_node_get_attr(xn, path->attr)) != NULL)
+				xpath_result_append_string(result, value);
+		} else if (result) {
+			xpath_result_append_element(result, xn);
+		} else if (*count < max) {
+			nodes[(*count)++] = xn;
+		}
+		return;
+	}
+
+	name = path->names[depth];
+	for (cn = xn->children; cn; cn = cn->next) {
+		if (!name || !strcmp(cn->name, name))
+			__xpath_path_match(path, depth + 1, cn, result, nodes, max, count);
+	}
+}
+
+static int
+__xpath_path_eval(const xpath_path_t *path, xml_node_t *xn,
+			xpath_result_t *result, xml_node_t **nodes, unsigned int max)
+{
+	unsigned int count = 0;
+
+	xtrace("  EVAL simple path on <%s>", xn->name ?: "ROOT");
+	__xpath_path_match(path, 0, xn, result, nodes, max, &count);
+	return count;
+}
+
 static void
 __xpath_node_destroy(xpath_node_t *xpn)
 {
@@ -0,0 +1,215 @@
+/*
+ *	Test of the interface config diff used by ifreload.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#include <wicked/util.h>
+#include <wicked/xml.h>
+#include <wicked/objectmodel.h>
+#include <wicked/fsm.h>
+#include "client/ifconfig.h"
+
+#define IFCONFIG(control, link, ipv4, dhcp, vlan)			\
+	"<interface>"							\
+	  "<name>eth0.10</name>"					\
+	  "<control>" control "</control>"				\
+	  "<link>" link "</link>"					\
+	  vlan								\
+	  "<ipv4:static>" ipv4 "</ipv4:static>"				\
+	  dhcp								\
+	"</interface>"
+
+#define CONTROL		"<mode>boot</mode>"
+#define LINK		"<mtu>1500</mtu>"
+#define ADDRS		"<address><local>192.168.1.1/24</local></address>"	\
+			"<address><local>192.168.2.1/24</local></address>"
+#define ROUTES		"<route><destination>10.0.0.0/8</destination>"		\
+			  "<nexthop><gateway>192.168.1.254</gateway></nexthop></route>" \
+			"<route><destination>172.16.0.0/12</destination>"	\
+			  "<nexthop><gateway>192.168.2.254</gateway></nexthop></route>"
+#define DHCP		"<ipv4:dhcp><enabled>true</enabled></ipv4:dhcp>"
+#define VLAN		"<vlan><device>eth0</device><tag>10</tag></vlan>"
+
+static const char *	base = IFCONFIG(CONTROL, LINK, ADDRS ROUTES, DHCP, VLAN);
+
+static const struct {
+	const char *		name;
+	const char *		config;
+	ni_ifconfig_reload_t	mode;
+	const char *		subsystem;
+} tests[] = {
+	{ "unchanged",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES, DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_NONE, NULL },
+	{ "reordered addresses and routes",
+		IFCONFIG(CONTROL, LINK,
+			"<route><destination>172.16.0.0/12</destination>"
+			  "<nexthop><gateway>192.168.2.254</gateway></nexthop></route>"
+			"<address><local>192.168.2.1/24</local></address>"
+			"<route><destination>10.0.0.0/8</destination>"
+			  "<nexthop><gateway>192.168.1.254</gateway></nexthop></route>"
+			"<address><local>192.168.1.1/24</local></address>",
+			DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_NONE, NULL },
+	{ "one changed address",
+		IFCONFIG(CONTROL, LINK,
+			"<address><local>192.168.1.1/24</local></address>"
+			"<address><local>192.168.3.1/24</local></address>"
+			ROUTES, DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_IN_PLACE, "ipv4:static" },
+	{ "added route",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES
+			"<route><destination>0.0.0.0/0</destination>"
+			  "<nexthop><gateway>192.168.1.253</gateway></nexthop></route>",
+			DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_IN_PLACE, "ipv4:static" },
+	{ "changed link/mtu",
+		IFCONFIG(CONTROL, "<mtu>9000</mtu>", ADDRS ROUTES, DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_IN_PLACE, "link" },
+	{ "changed dhcp option",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES,
+			"<ipv4:dhcp><enabled>true</enabled>"
+			  "<hostname>foo</hostname></ipv4:dhcp>", VLAN),
+		NI_IFCONFIG_RELOAD_IN_PLACE, "ipv4:dhcp" },
+	{ "removed ipv4:dhcp",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES, "", VLAN),
+		NI_IFCONFIG_RELOAD_FULL, "ipv4:dhcp" },
+	{ "changed control/mode",
+		IFCONFIG("<mode>hotplug</mode>", LINK, ADDRS ROUTES, DHCP, VLAN),
+		NI_IFCONFIG_RELOAD_FULL, "control" },
+	{ "changed vlan tag",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES, DHCP,
+			"<vlan><device>eth0</device><tag>20</tag></vlan>"),
+		NI_IFCONFIG_RELOAD_FULL, "vlan" },
+	{ "vlan replaced by bond",
+		IFCONFIG(CONTROL, LINK, ADDRS ROUTES, DHCP,
+			"<bond><mode>active-backup</mode>"
+			  "<slaves><slave><device>eth1</device></slave></slaves></bond>"),
+		NI_IFCONFIG_RELOAD_FULL, "bond" },
+};
+
+/*
+ * The rules match by path components: "ipv4" must not match the
+ * "ipv4:static" subsystem, which has its own removal mode.
+ */
+static const struct {
+	ni_ifconfig_diff_type_t	type;
+	const char *		path;
+	ni_ifconfig_reload_t	mode;
+} paths[] = {
+	{ NI_IFCONFIG_DIFF_REMOVED,	"ipv4",				NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"ipv4/enabled",			NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_REMOVED,	"ipv4:static",			NI_IFCONFIG_RELOAD_FULL		},
+	{ NI_IFCONFIG_DIFF_REMOVED,	"ipv4:static/address",		NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_ADDED,	"ipv4:static",			NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_REMOVED,	"ipv4:dhcp",			NI_IFCONFIG_RELOAD_FULL		},
+	{ NI_IFCONFIG_DIFF_REMOVED,	"ipv4:dhcpx",			NI_IFCONFIG_RELOAD_FULL		},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"link/mtu",			NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"link/mtux",			NI_IFCONFIG_RELOAD_FULL		},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"control/mode",			NI_IFCONFIG_RELOAD_FULL		},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"control/boot-stage",		NI_IFCONFIG_RELOAD_IN_PLACE	},
+	{ NI_IFCONFIG_DIFF_MODIFIED,	"description",			NI_IFCONFIG_RELOAD_NONE		},
+};
+
+static const char *
+reload_name(ni_ifconfig_reload_t mode)
+{
+	switch (mode) {
+	case NI_IFCONFIG_RELOAD_NONE:		return "none";
+	case NI_IFCONFIG_RELOAD_IN_PLACE:	return "in-place";
+	case NI_IFCONFIG_RELOAD_FULL:		return "full";
+	}
+	return "unknown";
+}
+
+static xml_document_t *
+parse_config(const char *string, xml_node_t **ifnode)
+{
+	xml_document_t *doc;
+
+	*ifnode = NULL;
+	if (!(doc = xml_document_from_string(string, NULL)))
+		return NULL;
+
+	*ifnode = xml_node_get_child(xml_document_root(doc), "interface");
+	return doc;
+}
+
+int main(void)
+{
+	xml_document_t *odoc, *ndoc;
+	xml_node_t *old, *new;
+	ni_string_array_t subsystems = NI_STRING_ARRAY_INIT;
+	ni_ifconfig_reload_t mode;
+	ni_ifconfig_diff_t diff;
+	unsigned int i;
+	int failed = 0;
+	ni_bool_t ok;
+
+	if (!(odoc = parse_config(base, &old)) || !old) {
+		printf("cannot parse base config: FAILED\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+		if (!(ndoc = parse_config(tests[i].config, &new)) || !new) {
+			printf("%-32s: cannot parse config: FAILED\n", tests[i].name);
+			xml_document_free(ndoc);
+			failed++;
+			continue;
+		}
+
+		mode = ni_ifconfig_reload_mode(old, new, &subsystems);
+		ok = mode == tests[i].mode;
+		if (tests[i].subsystem)
+			ok = ok && ni_string_array_index(&subsystems, tests[i].subsystem) >= 0;
+		else
+			ok = ok && subsystems.count == 0;
+
+		printf("%-32s: %-8s %-12s %s\n", tests[i].name, reload_name(mode),
+				tests[i].subsystem ? tests[i].subsystem : "-",
+				ok ? "ok" : "FAILED");
+		if (!ok)
+			failed++;
+
+		ni_string_array_destroy(&subsystems);
+		xml_document_free(ndoc);
+	}
+	xml_document_free(odoc);
+
+	for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+		memset(&diff, 0, sizeof(diff));
+		diff.type = paths[i].type;
+		diff.path = paths[i].path;
+
+		mode = ni_ifconfig_diff_reload(&diff);
+		ok = mode == paths[i].mode;
+		printf("%-8s %-24s: %-8s %s\n", ni_ifconfig_diff_type_to_name(diff.type),
+				diff.path, reload_name(mode), ok ? "ok" : "FAILED");
+		if (!ok)
+			failed++;
+	}
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
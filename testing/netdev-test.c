@@ -0,0 +1,60 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/util.h>
+
+#include "netinfo_priv.h"
+
+static int
+check_lookup(ni_netconfig_t *nc, const char *name, const ni_netdev_t *expect)
+{
+	ni_netdev_t *dev = ni_netdev_by_name(nc, name);
+
+	printf("lookup %-8s -> %s: %s\n", name, dev ? dev->name : "(none)",
+			dev == expect ? "ok" : "FAILED");
+	return dev == expect ? 0 : 1;
+}
+
+int main(void)
+{
+	ni_netconfig_t *nc;
+	ni_netdev_t *eth0, *eth1, *other;
+	int failed = 0;
+
+	if (!(nc = ni_netconfig_new()))
+		return 1;
+
+	eth0 = ni_netdev_new("eth0", 2);
+	eth1 = ni_netdev_new("eth1", 3);
+	ni_netconfig_device_append(nc, eth0);
+	ni_netconfig_device_append(nc, eth1);
+
+	failed += check_lookup(nc, "eth0", eth0);
+	failed += check_lookup(nc, "eth1", eth1);
+
+	/* udev rename of an indexed device */
+	ni_netconfig_device_rename(nc, eth0, "lan0");
+	failed += check_lookup(nc, "lan0", eth0);
+	failed += check_lookup(nc, "eth0", NULL);
+	failed += ni_netdev_by_index(nc, 2) == eth0 ? 0 : 1;
+
+	/* name swap, eth1 -> eth0 after the previous rename */
+	ni_netconfig_device_rename(nc, eth1, "eth0");
+	failed += check_lookup(nc, "eth0", eth1);
+	failed += check_lookup(nc, "eth1", NULL);
+
+	/* a device not (yet) in the list must not be indexed */
+	other = ni_netdev_new("tmp0", 4);
+	ni_netconfig_device_rename(nc, other, "wan0");
+	failed += ni_string_eq(other->name, "wan0") ? 0 : 1;
+	failed += check_lookup(nc, "wan0", NULL);
+	ni_netdev_put(other);
+
+	ni_netconfig_free(nc);
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+/*
+ *	Test of the OVSDB client against a socketpair peer replaying
+ *	canned JSON-RPC replies of the database server.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/socket.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <wicked/util.h>
+#include <wicked/ovs.h>
+#include "ovsdb.h"
+
+/*
+ * The replies are queued before the client sends its request;
+ * the ids match the client's request sequence numbers.
+ */
+static const char *	monitor_replies =
+	/* the server may ping us at any time */
+	"{\"id\":\"echo\",\"method\":\"echo\",\"params\":[]}"
+	"{\"id\":1,\"error\":null,\"result\":{"
+	  "\"Bridge\":{"
+	    "\"u-br0\":{\"new\":{\"name\":\"br0\",\"ports\":[\"set\",["
+	      "[\"uuid\",\"u-p0\"],[\"uuid\",\"u-p1\"],"
+	      "[\"uuid\",\"u-p2\"],[\"uuid\",\"u-p3\"]]]}}"
+	  "},"
+	  "\"Port\":{"
+	    "\"u-p0\":{\"new\":{\"name\":\"br0\",\"interfaces\":[\"uuid\",\"u-i0\"],"
+	      "\"tag\":[\"set\",[]],\"fake_bridge\":false}},"
+	    "\"u-p1\":{\"new\":{\"name\":\"eth1\",\"interfaces\":[\"uuid\",\"u-i1\"],"
+	      "\"tag\":[\"set\",[]],\"fake_bridge\":false}},"
+	    "\"u-p2\":{\"new\":{\"name\":\"br0.10\",\"interfaces\":[\"uuid\",\"u-i2\"],"
+	      "\"tag\":10,\"fake_bridge\":true}},"
+	    "\"u-p3\":{\"new\":{\"name\":\"eth2\",\"interfaces\":[\"uuid\",\"u-i3\"],"
+	      "\"tag\":10,\"fake_bridge\":false}}"
+	  "}"
+	"}}";
+
+static const char *	transact_replies =
+	/* the updates of the commit arrive before its reply */
+	"{\"id\":null,\"method\":\"update\",\"params\":[null,{"
+	  "\"Bridge\":{\"u-br1\":{\"new\":{\"name\":\"br1\",\"ports\":[\"uuid\",\"u-p4\"]}}},"
+	  "\"Port\":{\"u-p4\":{\"new\":{\"name\":\"br1\",\"interfaces\":[\"uuid\",\"u-i4\"],"
+	    "\"tag\":[\"set\",[]],\"fake_bridge\":false}}}"
+	"}]}"
+	"{\"id\":2,\"error\":null,\"result\":[{\"uuid\":[\"uuid\",\"u-i4\"]},"
+	  "{\"uuid\":[\"uuid\",\"u-p4\"]},{\"uuid\":[\"uuid\",\"u-br1\"]},{\"count\":1}]}"
+	"{\"id\":3,\"error\":null,\"result\":[]}";
+
+static const char *	transact_failure =
+	"{\"id\":4,\"error\":null,\"result\":[{},{\"error\":\"constraint violation\","
+	  "\"details\":\"duplicate name\"}]}";
+
+static int	failed;
+
+static void
+check(ni_bool_t ok, const char *what)
+{
+	printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failed++;
+}
+
+static void
+server_reply(int fd, const char *data)
+{
+	size_t len = strlen(data);
+
+	if (write(fd, data, len) != (ssize_t)len) {
+		perror("write");
+		exit(1);
+	}
+}
+
+/* returns everything the client has sent so far */
+static char *
+server_request(int fd)
+{
+	static char buf[16384];
+	ssize_t len;
+
+	len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+	buf[len > 0 ? len : 0] = '\0';
+	return buf;
+}
+
+int main(void)
+{
+	ni_ovs_bridge_port_array_t ports;
+	ni_ovsdb_txn_t *txn;
+	char *name = NULL;
+	const char *req;
+	uint16_t vlan = 0;
+	int sv[2];
+
+	ni_ovs_bridge_port_array_init(&ports);
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	/* monitor call; the echo request has to be answered */
+	server_reply(sv[1], monitor_replies);
+	check(ni_ovsdb_connect_fd(sv[0]), "connect and monitor");
+	req = server_request(sv[1]);
+	check(strstr(req, "\"method\": \"monitor\"") && strstr(req, "\"Open_vSwitch\""),
+			"monitor request");
+	check(strstr(req, "\"id\": \"echo\"") != NULL, "echo reply");
+
+	/* queries answered from the mirrored tables */
+	check(ni_ovsdb_bridge_exists("br0") == 0, "bridge br0 exists");
+	check(ni_ovsdb_bridge_exists("br0.10") == 0, "vlan bridge br0.10 exists");
+	check(ni_ovsdb_bridge_exists("br1") == 1, "bridge br1 does not exist");
+	check(ni_ovsdb_bridge_to_vlan("br0.10", &vlan) == 0 && vlan == 10, "br0.10 vlan");
+	check(ni_ovsdb_bridge_to_parent("br0.10", &name) == 0 &&
+			ni_string_eq(name, "br0"), "br0.10 parent");
+	ni_string_free(&name);
+
+	check(ni_ovsdb_bridge_ports("br0", &ports) == 0 && ports.count == 1 &&
+			ni_string_eq(ports.data[0]->device.name, "eth1"), "br0 ports");
+	ni_ovs_bridge_port_array_destroy(&ports);
+	check(ni_ovsdb_bridge_ports("br0.10", &ports) == 0 && ports.count == 1 &&
+			ni_string_eq(ports.data[0]->device.name, "eth2"), "br0.10 ports");
+	ni_ovs_bridge_port_array_destroy(&ports);
+
+	check(ni_ovsdb_port_to_bridge("eth1", &name) == 0 &&
+			ni_string_eq(name, "br0"), "eth1 bridge");
+	ni_string_free(&name);
+	check(ni_ovsdb_port_to_bridge("eth2", &name) == 0 &&
+			ni_string_eq(name, "br0.10"), "eth2 bridge");
+	ni_string_free(&name);
+
+	/* transact, then the echo the commit waits for */
+	server_reply(sv[1], transact_replies);
+	txn = ni_ovsdb_txn_new();
+	check(ni_ovsdb_txn_bridge_add(txn, "br1", NULL, 0, FALSE), "add bridge br1");
+	check(ni_ovsdb_txn_commit(txn) == 0, "commit");
+	ni_ovsdb_txn_free(txn);
+	req = server_request(sv[1]);
+	check(strstr(req, "\"method\": \"transact\"") && strstr(req, "\"op\": \"insert\"") &&
+			strstr(req, "\"method\": \"echo\""), "transact and echo requests");
+	check(ni_ovsdb_bridge_exists("br1") == 0, "bridge br1 exists after update");
+
+	/* a failed operation fails the commit */
+	server_reply(sv[1], transact_failure);
+	txn = ni_ovsdb_txn_new();
+	check(ni_ovsdb_txn_port_del(txn, "br0", "eth1"), "delete port eth1");
+	check(ni_ovsdb_txn_commit(txn) < 0, "failed commit");
+	ni_ovsdb_txn_free(txn);
+	req = server_request(sv[1]);
+	check(strstr(req, "\"op\": \"delete\"") && !strstr(req, "\"method\": \"echo\""),
+			"delete request without echo");
+
+	/* the server went away */
+	close(sv[1]);
+	txn = ni_ovsdb_txn_new();
+	check(ni_ovsdb_txn_bridge_del(txn, "br1"), "delete bridge br1");
+	check(ni_ovsdb_txn_commit(txn) < 0, "commit after server closed");
+	ni_ovsdb_txn_free(txn);
+	check(ni_ovsdb_bridge_exists("br0") == 1, "tables dropped on disconnect");
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
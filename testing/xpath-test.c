@@ -9,6 +9,7 @@
 
 #include <stdlib.h>
 #include <getopt.h>
+#include <time.h>
 #include <wicked/netinfo.h>
 #include <wicked/xpath.h>
 #include <wicked/logging.h>
@@ -16,20 +17,82 @@
 enum {
 	OPT_DEBUG,
 	OPT_REFERENCE,
+	OPT_BENCHMARK,
 };
 
 static struct option	options[] = {
 	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
 	{ "reference",		required_argument,	NULL,	OPT_REFERENCE },
+	{ "benchmark",		required_argument,	NULL,	OPT_BENCHMARK },
 
 	{ NULL }
 };
 
+static double
+elapsed_usec(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) * 1e6 + (now.tv_nsec - begin->tv_nsec) / 1e3;
+}
+
+/*
+ * Compare evaluating the expression the way callers used to do it,
+ * parsing it every time, with the cached expression and the element
+ * evaluation without result arrays.
+ */
+static int
+benchmark(const char *expression, xml_node_t *refnode, unsigned int loops)
+{
+	const xpath_enode_t *cached;
+	xpath_enode_t *enode;
+	xpath_result_t *result;
+	xml_node_t *nodes[64];
+	struct timespec begin;
+	unsigned int i;
+	double usec;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < loops; ++i) {
+		if (!(enode = xpath_expression_parse(expression)))
+			return 1;
+		result = xpath_expression_eval(enode, refnode);
+		xpath_result_free(result);
+		xpath_expression_free(enode);
+	}
+	usec = elapsed_usec(&begin);
+	printf("parse+eval:    %10.3f usec/call\n", usec / loops);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < loops; ++i) {
+		if (!(cached = xpath_expression_get(expression)))
+			return 1;
+		result = xpath_expression_eval(cached, refnode);
+		xpath_result_free(result);
+	}
+	usec = elapsed_usec(&begin);
+	printf("cached eval:   %10.3f usec/call\n", usec / loops);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < loops; ++i) {
+		cached = xpath_expression_get(expression);
+		if (xpath_expression_eval_elements(cached, refnode, nodes, 64) < 0) {
+			printf("element eval:  not an element expression\n");
+			return 0;
+		}
+	}
+	usec = elapsed_usec(&begin);
+	printf("element eval:  %10.3f usec/call\n", usec / loops);
+
+	return 0;
+}
 
 int
 main(int argc, char **argv)
 {
 	const char *opt_reference = NULL;
+	unsigned int opt_benchmark = 0;
 	const char *expression = NULL, *filename = "-";
 	xml_document_t *doc;
 	xml_node_t *refnode;
@@ -42,7 +105,7 @@ main(int argc, char **argv)
 		default:
 		usage:
 			fprintf(stderr,
-				"./xpath-test [--reference <expression>] <expression> [filename]\n"
+				"./xpath-test [--reference <expression>] [--benchmark <loops>] <expression> [filename]\n"
 			       );
 			return 1;
 
@@ -57,6 +120,13 @@ main(int argc, char **argv)
 			opt_reference = optarg;
 			break;
 
+		case OPT_BENCHMARK:
+			if (ni_parse_uint(optarg, &opt_benchmark, 10) < 0 || !opt_benchmark) {
+				fprintf(stderr, "Bad benchmark loop count \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
 		}
 	}
 
@@ -104,6 +174,9 @@ main(int argc, char **argv)
 		xpath_expression_free(enode);
 	}
 
+	if (opt_benchmark)
+		return benchmark(expression, refnode, opt_benchmark);
+
 	enode = xpath_expression_parse(expression);
 	if (!enode) {
 		fprintf(stderr, "Error parsing XPATH expression %s\n", expression);